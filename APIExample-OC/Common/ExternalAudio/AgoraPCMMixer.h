@@ -0,0 +1,37 @@
+//
+//  AgoraPCMMixer.h
+//  APIExample-OC
+//
+
+#import <Foundation/Foundation.h>
+
+@class AgoraRtcEngineKit;
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Mixes local PCM sources (music, sound effects, speech, ...) and pushes the mix to a custom audio
+// track every 10 ms, instead of a track or an SDK mixing call per source. Each source pushes 16-bit
+// interleaved frames at the mixer's rate from its own thread without locking; see AudioSourceMixer.
+@interface AgoraPCMMixer : NSObject
+
+- (instancetype)initWithAgoraKit:(AgoraRtcEngineKit *)agoraKit
+                         trackId:(NSInteger)trackId
+                      sampleRate:(NSInteger)sampleRate
+                        channels:(NSInteger)channels;
+
+// Returns the new source, or -1 when all 16 are taken or `channels` is not 1 or 2.
+- (NSInteger)addSourceWithChannels:(NSInteger)channels;
+// Stop pushing to the source first.
+- (void)removeSource:(NSInteger)source;
+// `gain` is linear; `pan` goes from -1 (left) to 1 (right).
+- (void)setGain:(float)gain pan:(float)pan forSource:(NSInteger)source;
+// From one thread per source. Returns the frames taken, fewer than `frames` when its buffer of
+// 500 ms is full.
+- (NSInteger)pushFrames:(const int16_t *)data count:(NSInteger)frames toSource:(NSInteger)source;
+
+- (void)start;
+- (void)stop;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,95 @@
+//
+//  AgoraPCMMixer.mm
+//  APIExample-OC
+//
+
+#import "AgoraPCMMixer.h"
+#import <AgoraRtcKit/AgoraRtcEngineKit.h>
+#include "AudioSourceMixer.h"
+#include <memory>
+#include <vector>
+
+static const double kBufferSeconds = 0.5;
+
+@interface AgoraPCMMixer ()
+
+@property (nonatomic, weak) AgoraRtcEngineKit *agoraKit;
+@property (nonatomic, assign) NSInteger trackId;
+@property (nonatomic, strong) dispatch_queue_t mixQueue;
+@property (nonatomic, strong) dispatch_source_t timer;
+
+@end
+
+@implementation AgoraPCMMixer {
+    std::unique_ptr<AudioSourceMixer> _mixer;
+    // Used on mixQueue only.
+    std::vector<int16_t> _frame;
+}
+
+- (instancetype)initWithAgoraKit:(AgoraRtcEngineKit *)agoraKit
+                         trackId:(NSInteger)trackId
+                      sampleRate:(NSInteger)sampleRate
+                        channels:(NSInteger)channels {
+    if (self = [super init]) {
+        self.agoraKit = agoraKit;
+        self.trackId = trackId;
+        _mixer.reset(new AudioSourceMixer((int)sampleRate, (int)channels, (size_t)(sampleRate * kBufferSeconds)));
+        _frame.resize(_mixer->framesPer10Ms() * _mixer->channels());
+        self.mixQueue = dispatch_queue_create("AgoraPCMMixerQueue", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (NSInteger)addSourceWithChannels:(NSInteger)channels {
+    return _mixer->addSource((int)channels);
+}
+
+- (void)removeSource:(NSInteger)source {
+    _mixer->removeSource((int)source);
+}
+
+- (void)setGain:(float)gain pan:(float)pan forSource:(NSInteger)source {
+    _mixer->setGain((int)source, gain);
+    _mixer->setPan((int)source, pan);
+}
+
+- (NSInteger)pushFrames:(const int16_t *)data count:(NSInteger)frames toSource:(NSInteger)source {
+    return _mixer->push((int)source, data, (size_t)frames);
+}
+
+- (void)start {
+    if (self.timer) {
+        return;
+    }
+    self.timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.mixQueue);
+    dispatch_source_set_timer(self.timer, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_MSEC), 10 * NSEC_PER_MSEC, NSEC_PER_MSEC);
+    __weak typeof(self) weakSelf = self;
+    dispatch_source_set_event_handler(self.timer, ^{
+        [weakSelf pushMix];
+    });
+    dispatch_resume(self.timer);
+}
+
+- (void)stop {
+    if (self.timer) {
+        dispatch_source_cancel(self.timer);
+        self.timer = nil;
+    }
+}
+
+- (void)pushMix {
+    const size_t frames = _mixer->framesPer10Ms();
+    _mixer->pull(_frame.data(), frames);
+    [self.agoraKit pushExternalAudioFrameRawData:_frame.data()
+                                         samples:frames * _mixer->channels()
+                                      sampleRate:_mixer->sampleRate()
+                                        channels:_mixer->channels()
+                                         trackId:self.trackId
+                                       timestamp:0];
+}
+
+- (void)dealloc {
+    [self stop];
+}
+
+@end
@@ -0,0 +1,188 @@
+//
+//  AudioChannelMixer.cpp
+//  AgoraAudioIO
+//
+
+#include "AudioChannelMixer.h"
+#include "../../../SimpleFilter/AudioKernels.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_MIXER_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AUDIO_MIXER_SSE2 1
+#endif
+
+static const float kMinus3Db = 0.7071f;
+
+static void monoToStereo(const int16_t* input, int16_t* output, size_t frames) {
+    size_t f = 0;
+#if defined(AUDIO_MIXER_NEON)
+    for (; f + 8 <= frames; f += 8) {
+        int16x8_t v = vld1q_s16(input + f);
+        int16x8x2_t pair = {{v, v}};
+        vst2q_s16(output + 2 * f, pair);
+    }
+#elif defined(AUDIO_MIXER_SSE2)
+    for (; f + 8 <= frames; f += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + f));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * f), _mm_unpacklo_epi16(v, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * f + 8), _mm_unpackhi_epi16(v, v));
+    }
+#endif
+    for (; f < frames; f++) {
+        output[2 * f] = output[2 * f + 1] = input[f];
+    }
+}
+
+// (L + R + 1) >> 1 on every path.
+static void stereoToMono(const int16_t* input, int16_t* output, size_t frames) {
+    size_t f = 0;
+#if defined(AUDIO_MIXER_NEON)
+    for (; f + 8 <= frames; f += 8) {
+        int16x8x2_t pair = vld2q_s16(input + 2 * f);
+        vst1q_s16(output + f, vrhaddq_s16(pair.val[0], pair.val[1]));
+    }
+#elif defined(AUDIO_MIXER_SSE2)
+    const __m128i one = _mm_set1_epi32(1);
+    for (; f + 8 <= frames; f += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 2 * f));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 2 * f + 8));
+        // Left is the sign-extended low half of each 32-bit frame, right the high half.
+        __m128i sumA = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(a, 16));
+        __m128i sumB = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(b, 16), 16), _mm_srai_epi32(b, 16));
+        sumA = _mm_srai_epi32(_mm_add_epi32(sumA, one), 1);
+        sumB = _mm_srai_epi32(_mm_add_epi32(sumB, one), 1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + f), _mm_packs_epi32(sumA, sumB));
+    }
+#endif
+    for (; f < frames; f++) {
+        output[f] = static_cast<int16_t>((input[2 * f] + input[2 * f + 1] + 1) >> 1);
+    }
+}
+
+// output += gain * input
+static void accumulate(float* output, const float* input, float gain, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_MIXER_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(output + i, vmlaq_f32(vld1q_f32(output + i), vld1q_f32(input + i), g));
+    }
+#elif defined(AUDIO_MIXER_SSE2)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(_mm_loadu_ps(input + i), g)));
+    }
+#endif
+    for (; i < count; i++) {
+        output[i] += gain * input[i];
+    }
+}
+
+bool AudioChannelMixer::setLayout(int inputChannels, int outputChannels) {
+    if (inputChannels <= 0 || outputChannels <= 0 || inputChannels > kMaxChannels || outputChannels > kMaxChannels) {
+        return false;
+    }
+    if (inputChannels == inputChannels_ && outputChannels == outputChannels_) {
+        return true;
+    }
+    inputChannels_ = inputChannels;
+    outputChannels_ = outputChannels;
+    useMatrix_ = inputChannels != outputChannels && (inputChannels > 2 || outputChannels > 2);
+
+    float matrix[kMaxChannels * kMaxChannels] = {0};
+    if (outputChannels == 1) {
+        for (int i = 0; i < inputChannels; i++) {
+            matrix[i] = 1;
+        }
+    } else if (outputChannels == 2 && inputChannels == 6) {
+        const float left[6] = {1, 0, kMinus3Db, 0, kMinus3Db, 0};
+        const float right[6] = {0, 1, kMinus3Db, 0, 0, kMinus3Db};
+        memcpy(matrix, left, sizeof(left));
+        memcpy(matrix + inputChannels, right, sizeof(right));
+    } else if (outputChannels == 2 && inputChannels == 4) {
+        const float left[4] = {1, 0, kMinus3Db, 0};
+        const float right[4] = {0, 1, 0, kMinus3Db};
+        memcpy(matrix, left, sizeof(left));
+        memcpy(matrix + inputChannels, right, sizeof(right));
+    } else if (outputChannels == 2 && inputChannels > 2) {
+        for (int i = 0; i < inputChannels; i++) {
+            matrix[(i & 1) * inputChannels + i] = 1;
+        }
+    } else if (inputChannels == 1) {
+        matrix[0] = 1;
+        matrix[inputChannels] = 1;
+    } else {
+        for (int o = 0; o < std::min(inputChannels, outputChannels); o++) {
+            matrix[o * inputChannels + o] = 1;
+        }
+    }
+    loadMatrix(matrix);
+    return true;
+}
+
+void AudioChannelMixer::setMatrix(const float* matrix) {
+    loadMatrix(matrix);
+    useMatrix_ = true;
+}
+
+void AudioChannelMixer::loadMatrix(const float* matrix) {
+    for (int o = 0; o < outputChannels_; o++) {
+        float sum = 0;
+        for (int i = 0; i < inputChannels_; i++) {
+            sum += matrix[o * inputChannels_ + i];
+        }
+        // Only rows that mix several channels are scaled down.
+        const float scale = sum > 1 ? 1 / sum : 1;
+        for (int i = 0; i < inputChannels_; i++) {
+            matrix_[o * inputChannels_ + i] = matrix[o * inputChannels_ + i] * scale;
+        }
+    }
+}
+
+void AudioChannelMixer::process(const int16_t* input, int16_t* output, size_t frames) {
+    if (inputChannels_ == outputChannels_ && !useMatrix_) {
+        if (input != output) {
+            memcpy(output, input, frames * inputChannels_ * sizeof(int16_t));
+        }
+    } else if (useMatrix_) {
+        processMatrix(input, output, frames);
+    } else if (inputChannels_ == 1) {
+        monoToStereo(input, output, frames);
+    } else {
+        stereoToMono(input, output, frames);
+    }
+}
+
+void AudioChannelMixer::processMatrix(const int16_t* input, int16_t* output, size_t frames) {
+    for (size_t done = 0; done < frames; done += kBlockFrames) {
+        const size_t count = std::min<size_t>(kBlockFrames, frames - done);
+        const int16_t* in = input + done * inputChannels_;
+        int16_t* out = output + done * outputChannels_;
+        for (int c = 0; c < inputChannels_; c++) {
+            float* plane = input_ + c * kBlockFrames;
+            for (size_t f = 0; f < count; f++) {
+                plane[f] = in[f * inputChannels_ + c];
+            }
+        }
+        for (int o = 0; o < outputChannels_; o++) {
+            std::fill(output_, output_ + count, 0.0f);
+            for (int c = 0; c < inputChannels_; c++) {
+                const float gain = matrix_[o * inputChannels_ + c];
+                if (gain != 0) {
+                    accumulate(output_, input_ + c * kBlockFrames, gain, count);
+                }
+            }
+            // Rounds halves away from zero and saturates.
+            agora::extension::floatToS16(output_, rounded_, count);
+            for (size_t f = 0; f < count; f++) {
+                out[f * outputChannels_ + o] = rounded_[f];
+            }
+        }
+    }
+}
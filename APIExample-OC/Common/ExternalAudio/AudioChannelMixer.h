@@ -0,0 +1,50 @@
+//
+//  AudioChannelMixer.h
+//  AgoraAudioIO
+//
+
+#ifndef AudioChannelMixer_h
+#define AudioChannelMixer_h
+
+#include <cstddef>
+#include <cstdint>
+
+// Converts interleaved 16-bit frames from one channel layout to another.
+//
+// Mono <-> stereo run directly on the samples (stereo to mono averages with rounding). Other layouts
+// go through a mix matrix on deinterleaved float planes. The default matrices assume WAVE channel
+// order (L R C LFE Ls Rs ...): 5.1 and quad fold down to stereo the ITU way, without the LFE; other
+// layouts split odd and even channels between left and right, or average everything for mono.
+// Upmixes from mono or stereo fill the front pair and leave the rest silent. Downmix rows are scaled
+// to sum to 1 so a full-scale input cannot clip.
+class AudioChannelMixer {
+public:
+    enum { kMaxChannels = 8 };
+
+    // Selects the layouts and the default matrix. Returns false for an unsupported layout.
+    bool setLayout(int inputChannels, int outputChannels);
+    // Replaces the matrix for the current layouts: `outputChannels` rows of `inputChannels` gains each.
+    void setMatrix(const float* matrix);
+
+    int inputChannels() const { return inputChannels_; }
+    int outputChannels() const { return outputChannels_; }
+
+    // `input` and `output` must not overlap unless the layouts are equal.
+    void process(const int16_t* input, int16_t* output, size_t frames);
+
+private:
+    enum { kBlockFrames = 256 };
+
+    void loadMatrix(const float* matrix);
+    void processMatrix(const int16_t* input, int16_t* output, size_t frames);
+
+    int inputChannels_ = 0;
+    int outputChannels_ = 0;
+    bool useMatrix_ = false;
+    float matrix_[kMaxChannels * kMaxChannels];
+    float input_[kMaxChannels * kBlockFrames];
+    float output_[kBlockFrames];
+    int16_t rounded_[kBlockFrames];
+};
+
+#endif /* AudioChannelMixer_h */
@@ -0,0 +1,253 @@
+//
+//  AudioResampler.cpp
+//  AgoraAudioIO
+//
+
+#include "AudioResampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_RESAMPLER_NEON 1
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define AUDIO_RESAMPLER_SSE 1
+#endif
+
+// Kernel length when upsampling; downsampling stretches it by the ratio, up to kMaxTaps.
+static const int kBaseTaps = 64;
+static const int kMaxTaps = 256;
+// Passband edge as a fraction of the lower Nyquist frequency, and the Kaiser window shape (~80 dB).
+static const double kCutoff = 0.9;
+static const double kKaiserBeta = 8.0;
+static const int kInterpolationShift = 24;
+
+static double besselI0(double x) {
+    double sum = 1;
+    double term = 1;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+// Dot product of `taps` (a multiple of 8) samples with a kernel.
+static inline float dot(const float* x, const float* h, int taps) {
+#if defined(AUDIO_RESAMPLER_NEON)
+    float32x4_t a0 = vdupq_n_f32(0);
+    float32x4_t a1 = vdupq_n_f32(0);
+    for (int k = 0; k < taps; k += 8) {
+        a0 = vmlaq_f32(a0, vld1q_f32(x + k), vld1q_f32(h + k));
+        a1 = vmlaq_f32(a1, vld1q_f32(x + k + 4), vld1q_f32(h + k + 4));
+    }
+    float32x4_t s = vaddq_f32(a0, a1);
+    float32x2_t t = vadd_f32(vget_low_f32(s), vget_high_f32(s));
+    return vget_lane_f32(vpadd_f32(t, t), 0);
+#elif defined(AUDIO_RESAMPLER_SSE)
+    __m128 a0 = _mm_setzero_ps();
+    __m128 a1 = _mm_setzero_ps();
+    for (int k = 0; k < taps; k += 8) {
+        a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(h + k)));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_loadu_ps(h + k + 4)));
+    }
+    __m128 s = _mm_add_ps(a0, a1);
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+#else
+    float sum = 0;
+    for (int k = 0; k < taps; k++) {
+        sum += x[k] * h[k];
+    }
+    return sum;
+#endif
+}
+
+static inline int16_t toS16(float value) {
+    value = std::min(std::max(value, -32768.0f), 32767.0f);
+    return static_cast<int16_t>(lrintf(value));
+}
+
+static int gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+bool AudioResampler::setFormat(int inputRate, int outputRate, int channels) {
+    if (inputRate <= 0 || outputRate <= 0 || channels <= 0 || channels > kMaxChannels) {
+        return false;
+    }
+    if (inputRate == inputRate_ && outputRate == outputRate_ && channels == channels_) {
+        return true;
+    }
+    inputRate_ = inputRate;
+    outputRate_ = outputRate;
+    channels_ = channels;
+    passthrough_ = inputRate == outputRate;
+    if (passthrough_) {
+        taps_ = 0;
+        kernels_.clear();
+    } else {
+        const double ratio = static_cast<double>(inputRate) / outputRate;
+        int taps = static_cast<int>(std::ceil(kBaseTaps * std::max(ratio, 1.0)));
+        taps_ = std::min((taps + 7) / 8 * 8, kMaxTaps);
+        const int divisor = gcd(inputRate, outputRate);
+        const int interpolation = outputRate / divisor;
+        interpolate_ = interpolation > kMaxPhases;
+        if (interpolate_) {
+            // 32.32 fixed point; the rounding is far below any clock drift.
+            denominator_ = 1ull << 32;
+            step_ = static_cast<uint64_t>(std::llround(ratio * denominator_));
+            buildKernels(kInterpolatedPhases, kCutoff * std::min(1.0, 1 / ratio));
+        } else {
+            denominator_ = interpolation;
+            step_ = inputRate / divisor;
+            buildKernels(interpolation, kCutoff * std::min(1.0, 1 / ratio));
+        }
+    }
+    capacity_ = taps_ + kMaxPushFrames;
+    input_.assign(capacity_ * channels_, 0.0f);
+    reset();
+    return true;
+}
+
+void AudioResampler::buildKernels(int phases, double cutoff) {
+    phases_ = phases;
+    kernels_.assign(static_cast<size_t>(phases + 1) * taps_, 0.0f);
+    const double half = taps_ / 2;
+    const double windowScale = 1 / besselI0(kKaiserBeta);
+    for (int p = 0; p <= phases; p++) {
+        float* kernel = &kernels_[static_cast<size_t>(p) * taps_];
+        const double fraction = static_cast<double>(p) / phases;
+        double sum = 0;
+        for (int k = 0; k < taps_; k++) {
+            // Distance of the tap from the output instant, in input frames.
+            const double d = k - half + 1 - fraction;
+            const double x = d / half;
+            if (x <= -1 || x >= 1) {
+                continue;
+            }
+            const double arg = M_PI * cutoff * d;
+            const double sinc = d == 0 ? 1 : std::sin(arg) / arg;
+            const double value = cutoff * sinc * besselI0(kKaiserBeta * std::sqrt(1 - x * x)) * windowScale;
+            kernel[k] = static_cast<float>(value);
+            sum += value;
+        }
+        // Exact unity gain at DC for every phase.
+        for (int k = 0; k < taps_; k++) {
+            kernel[k] = static_cast<float>(kernel[k] / sum);
+        }
+    }
+}
+
+void AudioResampler::reset() {
+    std::fill(input_.begin(), input_.end(), 0.0f);
+    phase_ = 0;
+    start_ = 0;
+    // Half a kernel of silence centres the first output on the first input frame.
+    size_ = passthrough_ ? 0 : taps_ / 2 - 1;
+}
+
+int64_t AudioResampler::windowStart(size_t index) const {
+    return start_ + static_cast<int64_t>((phase_ + index * step_) / denominator_);
+}
+
+size_t AudioResampler::inputFramesFor(size_t outputFrames) const {
+    if (outputFrames == 0 || channels_ == 0) {
+        return 0;
+    }
+    const int64_t end = passthrough_ ? start_ + static_cast<int64_t>(outputFrames) : windowStart(outputFrames - 1) + taps_;
+    return end > static_cast<int64_t>(size_) ? static_cast<size_t>(end - size_) : 0;
+}
+
+size_t AudioResampler::availableFrames() const {
+    if (passthrough_) {
+        return size_ - static_cast<size_t>(start_);
+    }
+    const int64_t room = static_cast<int64_t>(size_) - taps_ - start_;
+    if (room < 0) {
+        return 0;
+    }
+    // Outputs whose window starts at most `room` frames on.
+    return static_cast<size_t>(((room + 1) * denominator_ - phase_ + step_ - 1) / step_);
+}
+
+size_t AudioResampler::push(const int16_t* input, size_t frames) {
+    if (channels_ == 0) {
+        return 0;
+    }
+    if (start_ > 0) {
+        // Drop the frames no window will reach again.
+        const size_t kept = size_ - static_cast<size_t>(start_);
+        for (int c = 0; c < channels_; c++) {
+            float* plane = &input_[c * capacity_];
+            memmove(plane, plane + start_, kept * sizeof(float));
+        }
+        size_ = kept;
+        start_ = 0;
+    }
+    frames = std::min(frames, capacity_ - size_);
+    for (int c = 0; c < channels_; c++) {
+        float* plane = &input_[c * capacity_ + size_];
+        for (size_t f = 0; f < frames; f++) {
+            plane[f] = input[f * channels_ + c];
+        }
+    }
+    size_ += frames;
+    return frames;
+}
+
+size_t AudioResampler::pull(int16_t* output, size_t frames) {
+    frames = std::min(frames, availableFrames());
+    if (passthrough_) {
+        for (int c = 0; c < channels_; c++) {
+            const float* plane = &input_[c * capacity_ + start_];
+            for (size_t f = 0; f < frames; f++) {
+                output[f * channels_ + c] = static_cast<int16_t>(plane[f]);
+            }
+        }
+        start_ += frames;
+        return frames;
+    }
+
+    const uint64_t stepWhole = step_ / denominator_;
+    const uint64_t stepFraction = step_ % denominator_;
+    const float interpolationScale = 1.0f / (1 << kInterpolationShift);
+    const uint64_t interpolationMask = (1ull << kInterpolationShift) - 1;
+    for (size_t f = 0; f < frames; f++) {
+        const float* kernel;
+        float weight = 0;
+        if (interpolate_) {
+            kernel = &kernels_[(phase_ >> kInterpolationShift) * taps_];
+            weight = (phase_ & interpolationMask) * interpolationScale;
+        } else {
+            kernel = &kernels_[phase_ * taps_];
+        }
+        for (int c = 0; c < channels_; c++) {
+            const float* x = &input_[c * capacity_ + start_];
+            float value = dot(x, kernel, taps_);
+            if (interpolate_) {
+                value += (dot(x, kernel + taps_, taps_) - value) * weight;
+            }
+            output[f * channels_ + c] = toS16(value);
+        }
+        phase_ += stepFraction;
+        start_ += stepWhole;
+        if (phase_ >= denominator_) {
+            phase_ -= denominator_;
+            start_++;
+        }
+    }
+    return frames;
+}
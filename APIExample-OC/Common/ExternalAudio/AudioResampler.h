@@ -0,0 +1,74 @@
+//
+//  AudioResampler.h
+//  AgoraAudioIO
+//
+
+#ifndef AudioResampler_h
+#define AudioResampler_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Polyphase windowed-sinc sample-rate converter for interleaved 16-bit PCM.
+//
+// Rates whose reduced ratio needs at most kMaxPhases filter phases (48k <-> 44.1k, 16k -> 48k, ...)
+// use an exact table of precomputed kernels; any other ratio interpolates between kInterpolatedPhases
+// kernels. Input is pushed and output pulled, so the converter can sit on either side of a ring
+// buffer, and state carries over between frames. Equal rates pass straight through.
+// Not thread-safe: use it from one thread at a time.
+class AudioResampler {
+public:
+    enum { kMaxChannels = 8, kMaxPushFrames = 4096 };
+
+    // Sets up the conversion; does nothing if nothing changed, otherwise drops the buffered input.
+    // Returns false for an unsupported format.
+    bool setFormat(int inputRate, int outputRate, int channels);
+    void reset();
+
+    int inputRate() const { return inputRate_; }
+    int outputRate() const { return outputRate_; }
+    int channels() const { return channels_; }
+
+    // Input frames still to be pushed before `outputFrames` frames can be pulled.
+    size_t inputFramesFor(size_t outputFrames) const;
+    // Frames that can be pulled from the input buffered so far.
+    size_t availableFrames() const;
+
+    // Appends up to kMaxPushFrames interleaved frames. Returns the number taken.
+    size_t push(const int16_t* input, size_t frames);
+    // Writes up to `frames` interleaved frames. Returns the number written.
+    size_t pull(int16_t* output, size_t frames);
+
+private:
+    enum { kMaxPhases = 320, kInterpolatedPhases = 256 };
+
+    // First input frame of the filter window for the output `index` frames ahead.
+    int64_t windowStart(size_t index) const;
+    void buildKernels(int phases, double cutoff);
+
+    int inputRate_ = 0;
+    int outputRate_ = 0;
+    int channels_ = 0;
+    bool passthrough_ = true;
+    // Kernels are `taps_` long, padded with zeros to a multiple of 8; `phases_` + 1 of them, the last
+    // one being used only when interpolating.
+    int taps_ = 0;
+    int phases_ = 0;
+    bool interpolate_ = false;
+    std::vector<float> kernels_;
+
+    // Position of the next output: its window starts at input frame `start_` of the buffer, shifted
+    // by `phase_` / `denominator_` of a frame. Each output moves it on by `step_` / `denominator_`.
+    uint64_t denominator_ = 1;
+    uint64_t step_ = 0;
+    uint64_t phase_ = 0;
+    int64_t start_ = 0;
+
+    // Planar input, `capacity_` frames per channel, of which `size_` are filled.
+    std::vector<float> input_;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+};
+
+#endif /* AudioResampler_h */
@@ -0,0 +1,382 @@
+//
+//  AudioSourceMixer.cpp
+//  AgoraAudioIO
+//
+
+#include "AudioSourceMixer.h"
+#include "../../../SimpleFilter/AudioKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AUDIO_SOURCE_MIXER_NEON 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AUDIO_SOURCE_MIXER_SSE2 1
+#endif
+
+// -1 dBFS.
+static const float kCeiling = 32768.0f * 0.8913f;
+static const double kReleaseSeconds = 0.05;
+
+// output += input * gain, the gain moving along the ramp.
+static void mixMono(const int16_t* input, float* output, float gain, float step, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_SOURCE_MIXER_NEON)
+    const float start[4] = {gain, gain + step, gain + 2 * step, gain + 3 * step};
+    float32x4_t g = vld1q_f32(start);
+    const float32x4_t stride = vdupq_n_f32(4 * step);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vcvtq_f32_s32(vmovl_s16(vld1_s16(input + i)));
+        vst1q_f32(output + i, vmlaq_f32(vld1q_f32(output + i), x, g));
+        g = vaddq_f32(g, stride);
+    }
+#elif defined(AUDIO_SOURCE_MIXER_SSE2)
+    __m128 g = _mm_setr_ps(gain, gain + step, gain + 2 * step, gain + 3 * step);
+    const __m128 stride = _mm_set1_ps(4 * step);
+    for (; i + 4 <= count; i += 4) {
+        __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(input + i));
+        __m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16));
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(x, g)));
+        g = _mm_add_ps(g, stride);
+    }
+#endif
+    for (; i < count; i++) {
+        output[i] += input[i] * (gain + i * step);
+    }
+}
+
+// Interleaved stereo into two planes, each with its own ramp.
+static void mixStereo(const int16_t* input, float* left, float* right, float leftGain, float leftStep,
+                      float rightGain, float rightStep, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_SOURCE_MIXER_NEON)
+    const float leftStart[4] = {leftGain, leftGain + leftStep, leftGain + 2 * leftStep, leftGain + 3 * leftStep};
+    const float rightStart[4] = {rightGain, rightGain + rightStep, rightGain + 2 * rightStep, rightGain + 3 * rightStep};
+    float32x4_t gl = vld1q_f32(leftStart);
+    float32x4_t gr = vld1q_f32(rightStart);
+    const float32x4_t strideL = vdupq_n_f32(4 * leftStep);
+    const float32x4_t strideR = vdupq_n_f32(4 * rightStep);
+    for (; i + 4 <= count; i += 4) {
+        int16x4x2_t pair = vld2_s16(input + 2 * i);
+        vst1q_f32(left + i, vmlaq_f32(vld1q_f32(left + i), vcvtq_f32_s32(vmovl_s16(pair.val[0])), gl));
+        vst1q_f32(right + i, vmlaq_f32(vld1q_f32(right + i), vcvtq_f32_s32(vmovl_s16(pair.val[1])), gr));
+        gl = vaddq_f32(gl, strideL);
+        gr = vaddq_f32(gr, strideR);
+    }
+#elif defined(AUDIO_SOURCE_MIXER_SSE2)
+    __m128 gl = _mm_setr_ps(leftGain, leftGain + leftStep, leftGain + 2 * leftStep, leftGain + 3 * leftStep);
+    __m128 gr = _mm_setr_ps(rightGain, rightGain + rightStep, rightGain + 2 * rightStep, rightGain + 3 * rightStep);
+    const __m128 strideL = _mm_set1_ps(4 * leftStep);
+    const __m128 strideR = _mm_set1_ps(4 * rightStep);
+    for (; i + 4 <= count; i += 4) {
+        // Left is the sign-extended low half of each 32-bit frame, right the high half.
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 2 * i));
+        __m128 l = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(raw, 16), 16));
+        __m128 r = _mm_cvtepi32_ps(_mm_srai_epi32(raw, 16));
+        _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), _mm_mul_ps(l, gl)));
+        _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), _mm_mul_ps(r, gr)));
+        gl = _mm_add_ps(gl, strideL);
+        gr = _mm_add_ps(gr, strideR);
+    }
+#endif
+    for (; i < count; i++) {
+        left[i] += input[2 * i] * (leftGain + i * leftStep);
+        right[i] += input[2 * i + 1] * (rightGain + i * rightStep);
+    }
+}
+
+// Interleaved stereo into one plane: output += (L + R) * gain.
+static void mixStereoToMono(const int16_t* input, float* output, float gain, float step, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_SOURCE_MIXER_NEON)
+    const float start[4] = {gain, gain + step, gain + 2 * step, gain + 3 * step};
+    float32x4_t g = vld1q_f32(start);
+    const float32x4_t stride = vdupq_n_f32(4 * step);
+    for (; i + 4 <= count; i += 4) {
+        int16x4x2_t pair = vld2_s16(input + 2 * i);
+        float32x4_t x = vcvtq_f32_s32(vaddl_s16(pair.val[0], pair.val[1]));
+        vst1q_f32(output + i, vmlaq_f32(vld1q_f32(output + i), x, g));
+        g = vaddq_f32(g, stride);
+    }
+#elif defined(AUDIO_SOURCE_MIXER_SSE2)
+    __m128 g = _mm_setr_ps(gain, gain + step, gain + 2 * step, gain + 3 * step);
+    const __m128 stride = _mm_set1_ps(4 * step);
+    for (; i + 4 <= count; i += 4) {
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 2 * i));
+        __m128i sum = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(raw, 16), 16), _mm_srai_epi32(raw, 16));
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(_mm_cvtepi32_ps(sum), g)));
+        g = _mm_add_ps(g, stride);
+    }
+#endif
+    for (; i < count; i++) {
+        output[i] += (input[2 * i] + input[2 * i + 1]) * (gain + i * step);
+    }
+}
+
+static float peak(const float* input, size_t count) {
+    size_t i = 0;
+    float result = 0;
+#if defined(AUDIO_SOURCE_MIXER_NEON)
+    float32x4_t m = vdupq_n_f32(0);
+    for (; i + 4 <= count; i += 4) {
+        m = vmaxq_f32(m, vabsq_f32(vld1q_f32(input + i)));
+    }
+    float lanes[4];
+    vst1q_f32(lanes, m);
+    result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#elif defined(AUDIO_SOURCE_MIXER_SSE2)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 m = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        m = _mm_max_ps(m, _mm_andnot_ps(sign, _mm_loadu_ps(input + i)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, m);
+    result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+    for (; i < count; i++) {
+        result = std::max(result, std::fabs(input[i]));
+    }
+    return result;
+}
+
+AudioSourceMixer::AudioSourceMixer(int sampleRate, int channels, size_t capacityFrames)
+    : sampleRate_(sampleRate), channels_(std::min(std::max(channels, 1), 2)) {
+    capacity_ = 1;
+    while (capacity_ < capacityFrames) {
+        capacity_ <<= 1;
+    }
+    release_ = static_cast<float>(1 - std::exp(-1 / (kReleaseSeconds * std::max(sampleRate, 1))));
+    for (Source& source : sources_) {
+        source.samples.reset(new int16_t[2 * capacity_]());
+    }
+}
+
+int AudioSourceMixer::addSource(int channels) {
+    if (channels != 1 && channels != 2) {
+        return -1;
+    }
+    for (int i = 0; i < kMaxSources; i++) {
+        Source& source = sources_[i];
+        int expected = kFree;
+        if (source.state.compare_exchange_strong(expected, kClaimed, std::memory_order_acquire)) {
+            // The ring is empty: the consumer caught up with the producer when it freed the slot.
+            source.channels = channels;
+            source.gain.store(1.0f, std::memory_order_relaxed);
+            source.pan.store(0.0f, std::memory_order_relaxed);
+            source.underruns.store(0, std::memory_order_relaxed);
+            source.producerReadIndex = source.readIndex.load(std::memory_order_acquire);
+            source.state.store(kActive, std::memory_order_release);
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AudioSourceMixer::removeSource(int source) {
+    if (source < 0 || source >= kMaxSources) {
+        return;
+    }
+    // The consumer frees it on its next pull, once it is done reading it.
+    int expected = kActive;
+    sources_[source].state.compare_exchange_strong(expected, kRemoving, std::memory_order_acq_rel);
+}
+
+void AudioSourceMixer::setGain(int source, float gain) {
+    if (source >= 0 && source < kMaxSources) {
+        sources_[source].gain.store(std::max(gain, 0.0f), std::memory_order_relaxed);
+    }
+}
+
+void AudioSourceMixer::setPan(int source, float pan) {
+    if (source >= 0 && source < kMaxSources) {
+        sources_[source].pan.store(std::min(std::max(pan, -1.0f), 1.0f), std::memory_order_relaxed);
+    }
+}
+
+size_t AudioSourceMixer::push(int source, const int16_t* data, size_t frames) {
+    if (source < 0 || source >= kMaxSources) {
+        return 0;
+    }
+    Source& s = sources_[source];
+    if (s.state.load(std::memory_order_relaxed) != kActive) {
+        return 0;
+    }
+    const size_t write = s.writeIndex.load(std::memory_order_relaxed);
+    if (capacity_ - (write - s.producerReadIndex) < frames) {
+        s.producerReadIndex = s.readIndex.load(std::memory_order_acquire);
+    }
+    const size_t count = std::min(frames, capacity_ - (write - s.producerReadIndex));
+    const size_t offset = write & (capacity_ - 1);
+    const size_t first = std::min(count, capacity_ - offset);
+    memcpy(s.samples.get() + offset * s.channels, data, first * s.channels * sizeof(int16_t));
+    memcpy(s.samples.get(), data + first * s.channels, (count - first) * s.channels * sizeof(int16_t));
+    s.writeIndex.store(write + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioSourceMixer::writableFrames(int source) const {
+    if (source < 0 || source >= kMaxSources) {
+        return 0;
+    }
+    const Source& s = sources_[source];
+    return capacity_ - (s.writeIndex.load(std::memory_order_relaxed) - s.readIndex.load(std::memory_order_acquire));
+}
+
+uint64_t AudioSourceMixer::underruns(int source) const {
+    if (source < 0 || source >= kMaxSources) {
+        return 0;
+    }
+    return sources_[source].underruns.load(std::memory_order_relaxed);
+}
+
+void AudioSourceMixer::targetGains(const Source& source, float* gains) const {
+    const float gain = source.gain.load(std::memory_order_relaxed);
+    if (channels_ == 1) {
+        // mixStereoToMono adds the two sides together.
+        gains[0] = source.channels == 2 ? 0.5f * gain : gain;
+        gains[1] = 0;
+        return;
+    }
+    const float pan = source.pan.load(std::memory_order_relaxed);
+    if (source.channels == 1) {
+        const double angle = (pan + 1) * M_PI / 4;
+        gains[0] = static_cast<float>(gain * std::cos(angle));
+        gains[1] = static_cast<float>(gain * std::sin(angle));
+    } else {
+        gains[0] = pan > 0 ? static_cast<float>(gain * std::cos(pan * M_PI / 2)) : gain;
+        gains[1] = pan < 0 ? static_cast<float>(gain * std::cos(pan * M_PI / 2)) : gain;
+    }
+}
+
+void AudioSourceMixer::pull(int16_t* output, size_t frames) {
+    if (frames == 0) {
+        return;
+    }
+    Ramp ramps[kMaxSources][2];
+    float targets[kMaxSources][2];
+    for (int i = 0; i < kMaxSources; i++) {
+        Source& source = sources_[i];
+        const int state = source.state.load(std::memory_order_acquire);
+        if (state == kRemoving) {
+            // Drops what is left, which leaves the ring empty for the next source in the slot.
+            source.readIndex.store(source.writeIndex.load(std::memory_order_acquire), std::memory_order_release);
+            source.mixing = false;
+            source.state.store(kFree, std::memory_order_release);
+            continue;
+        }
+        if (state != kActive) {
+            continue;
+        }
+        targetGains(source, targets[i]);
+        if (!source.mixing) {
+            // A new source starts at its settings rather than gliding in from silence.
+            source.mixing = true;
+            source.gains[0] = targets[i][0];
+            source.gains[1] = targets[i][1];
+            source.consumerWriteIndex = source.readIndex.load(std::memory_order_relaxed);
+        }
+        for (int c = 0; c < channels_; c++) {
+            ramps[i][c].value = source.gains[c];
+            ramps[i][c].step = (targets[i][c] - source.gains[c]) / frames;
+        }
+        const size_t read = source.readIndex.load(std::memory_order_relaxed);
+        if (source.consumerWriteIndex - read < frames) {
+            source.consumerWriteIndex = source.writeIndex.load(std::memory_order_acquire);
+        }
+        const size_t available = source.consumerWriteIndex - read;
+        if (available > 0 && available < frames) {
+            source.underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    for (size_t done = 0; done < frames;) {
+        const size_t count = std::min(frames - done, static_cast<size_t>(kBlockFrames));
+        std::fill(mix_, mix_ + 2 * kBlockFrames, 0.0f);
+        for (int i = 0; i < kMaxSources; i++) {
+            if (sources_[i].mixing) {
+                mixBlock(sources_[i], ramps[i], count);
+            }
+        }
+        limit(count);
+        // Rounds halves away from zero and saturates.
+        if (channels_ == 1) {
+            agora::extension::floatToS16(mix_, output + done, count);
+        } else {
+            agora::extension::planesToS16(mix_, mix_ + kBlockFrames, output + 2 * done, count);
+        }
+        done += count;
+    }
+
+    for (int i = 0; i < kMaxSources; i++) {
+        if (sources_[i].mixing) {
+            sources_[i].gains[0] = targets[i][0];
+            sources_[i].gains[1] = targets[i][1];
+        }
+    }
+}
+
+void AudioSourceMixer::mixBlock(Source& source, Ramp* ramps, size_t frames) {
+    const size_t read = source.readIndex.load(std::memory_order_relaxed);
+    const size_t count = std::min(frames, source.consumerWriteIndex - read);
+    const int channels = source.channels;
+    // At most two runs, before and after the end of the ring.
+    for (size_t done = 0; done < count;) {
+        const size_t offset = (read + done) & (capacity_ - 1);
+        const size_t run = std::min(count - done, capacity_ - offset);
+        const int16_t* input = source.samples.get() + offset * channels;
+        const float offsetL = ramps[0].value + done * ramps[0].step;
+        if (channels_ == 1) {
+            if (channels == 1) {
+                mixMono(input, mix_ + done, offsetL, ramps[0].step, run);
+            } else {
+                mixStereoToMono(input, mix_ + done, offsetL, ramps[0].step, run);
+            }
+        } else {
+            const float offsetR = ramps[1].value + done * ramps[1].step;
+            if (channels == 1) {
+                mixMono(input, mix_ + done, offsetL, ramps[0].step, run);
+                mixMono(input, mix_ + kBlockFrames + done, offsetR, ramps[1].step, run);
+            } else {
+                mixStereo(input, mix_ + done, mix_ + kBlockFrames + done, offsetL, ramps[0].step, offsetR, ramps[1].step, run);
+            }
+        }
+        done += run;
+    }
+    source.readIndex.store(read + count, std::memory_order_release);
+    // The ramps move on over the frames the source did not have too.
+    for (int c = 0; c < channels_; c++) {
+        ramps[c].value += frames * ramps[c].step;
+    }
+}
+
+void AudioSourceMixer::limit(size_t frames) {
+    float* left = mix_;
+    float* right = channels_ == 2 ? mix_ + kBlockFrames : mix_;
+    // Most blocks need nothing: the gain is back at 1 and nothing is over the ceiling.
+    if (envelope_ == 1.0f && peak(left, frames) <= kCeiling && (channels_ == 1 || peak(right, frames) <= kCeiling)) {
+        return;
+    }
+    float envelope = envelope_;
+    for (size_t f = 0; f < frames; f++) {
+        const float level = std::max(std::fabs(left[f]), std::fabs(right[f]));
+        const float target = level > kCeiling ? kCeiling / level : 1.0f;
+        if (target < envelope) {
+            envelope = target;
+        } else {
+            envelope += (target - envelope) * release_;
+            if (target == 1.0f && envelope > 0.99999f) {
+                envelope = 1.0f;
+            }
+        }
+        left[f] *= envelope;
+        if (right != left) {
+            right[f] *= envelope;
+        }
+    }
+    envelope_ = envelope;
+}
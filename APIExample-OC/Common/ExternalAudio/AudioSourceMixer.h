@@ -0,0 +1,112 @@
+//
+//  AudioSourceMixer.h
+//  AgoraAudioIO
+//
+
+#ifndef AudioSourceMixer_h
+#define AudioSourceMixer_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Mixes several local PCM sources (music, sound effects, speech, ...) into the one stream that is
+// pushed with pushExternalAudioFrameRawData.
+//
+// Every source has its own single-producer single-consumer ring of interleaved 16-bit frames, mono
+// or stereo, at the mix's rate: one thread pushes into it and the thread that pulls the mix reads
+// it, and neither ever locks, waits or allocates. The pull sums the sources in float with their gain
+// and pan, which glide to new settings over one pull, then a peak limiter with instant attack keeps
+// the sum under -1 dBFS before it is rounded to 16 bits. A source that runs dry contributes what it
+// has, then silence.
+//
+// addSource, removeSource, setGain and setPan may be called from any thread. Stop pushing to a
+// source before removing it; its slot can be taken again after the next pull. Only the constructor
+// allocates.
+class AudioSourceMixer {
+public:
+    enum { kMaxSources = 16 };
+
+    // A mix of `channels`, 1 or 2. Each source buffers up to `capacityFrames`, rounded up to a power of two.
+    AudioSourceMixer(int sampleRate, int channels, size_t capacityFrames);
+
+    int sampleRate() const { return sampleRate_; }
+    int channels() const { return channels_; }
+    // Frames in one 10 ms pull.
+    size_t framesPer10Ms() const { return sampleRate_ / 100; }
+
+    // Returns the new source, or -1 if `channels` is not 1 or 2 or every slot is taken.
+    int addSource(int channels);
+    void removeSource(int source);
+    // Linear, 1 for unity.
+    void setGain(int source, float gain);
+    // -1 for left, 0 for the centre, 1 for right. Mono sources pan with a constant-power law, -3 dB
+    // on both sides at the centre; stereo ones are balanced by turning the far side down. Has no
+    // effect on a mono mix.
+    void setPan(int source, float pan);
+
+    // For the source's producer: appends up to `frames` interleaved frames and returns how many fitted.
+    size_t push(int source, const int16_t* data, size_t frames);
+    size_t writableFrames(int source) const;
+    // Pulls that found fewer frames of the source than they needed, but not none.
+    uint64_t underruns(int source) const;
+
+    // For the consumer: mixes `frames` interleaved frames into `output`.
+    void pull(int16_t* output, size_t frames);
+
+private:
+    enum { kBlockFrames = 480, kCacheLine = 64 };
+    enum SourceState {
+        kFree = 0,
+        kClaimed,
+        kActive,
+        kRemoving
+    };
+
+    // Gain per mix channel, moving by `step` a frame.
+    struct Ramp {
+        float value;
+        float step;
+    };
+
+    struct Source {
+        // Frame counts since the ring was made, each written by one side only and on its own cache
+        // line. Each side keeps the other's as of its last look, so it only reloads it when it seems
+        // to have run out of frames or room.
+        alignas(kCacheLine) std::atomic<size_t> writeIndex = {0};
+        size_t producerReadIndex = 0;
+        alignas(kCacheLine) std::atomic<size_t> readIndex = {0};
+        size_t consumerWriteIndex = 0;
+
+        alignas(kCacheLine) std::atomic<int> state = {kFree};
+        // Set before the source becomes active.
+        int channels = 1;
+        std::atomic<float> gain = {1.0f};
+        std::atomic<float> pan = {0.0f};
+        std::atomic<uint64_t> underruns = {0};
+        std::unique_ptr<int16_t[]> samples;
+
+        // The consumer's: whether it is mixing the source, and where its gains got to.
+        bool mixing = false;
+        float gains[2] = {0, 0};
+    };
+
+    // Gains per mix channel for the source's current settings.
+    void targetGains(const Source& source, float* gains) const;
+    // Adds the source's next `frames` to mix_, as far as it has them.
+    void mixBlock(Source& source, Ramp* ramps, size_t frames);
+    void limit(size_t frames);
+
+    int sampleRate_;
+    int channels_;
+    size_t capacity_;
+    // Limiter gain, and the part of the way back to 1 it goes each frame.
+    float envelope_ = 1;
+    float release_;
+    Source sources_[kMaxSources];
+    // The mix, one plane per channel.
+    float mix_[2 * kBlockFrames];
+};
+
+#endif /* AudioSourceMixer_h */
@@ -0,0 +1,175 @@
+//
+//  AudioSourceMixerTest.cpp
+//  AgoraAudioIO
+//
+//  Checks, stress test and benchmark for AudioSourceMixer. Not part of the app target, build and run it on its own:
+//      c++ -O2 -std=c++14 -pthread AudioSourceMixer.cpp ../../../SimpleFilter/AudioKernels.cpp AudioSourceMixerTest.cpp -o AudioSourceMixerTest && ./AudioSourceMixerTest
+//  Returns non-zero if any check fails.
+//
+
+#include "AudioSourceMixer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static int gFailures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        gFailures++;
+    }
+}
+
+// What every path must produce from a float sample: halves away from zero, saturated.
+static int16_t roundS16(float value) {
+    value = std::min(std::max(value, -32768.0f), 32767.0f);
+    return static_cast<int16_t>(value + (value < 0 ? -0.5f : 0.5f));
+}
+
+static void testPassthrough() {
+    AudioSourceMixer mixer(48000, 1, 4096);
+    const int source = mixer.addSource(1);
+    std::vector<int16_t> in(480), out(480);
+    for (int16_t& s : in) {
+        s = static_cast<int16_t>(rand() % 40000 - 20000);
+    }
+    mixer.push(source, in.data(), 480);
+    mixer.pull(out.data(), 480);
+    check(in == out, "one source at unity comes out unchanged");
+}
+
+// Gain 0.5 on odd samples puts every output on a tie, mono and stereo.
+static void testRounding() {
+    for (int channels = 1; channels <= 2; channels++) {
+        AudioSourceMixer mixer(48000, channels, 8192);
+        const int source = mixer.addSource(channels);
+        mixer.setGain(source, 0.5f);
+        std::vector<int16_t> in(960 * channels), out(480 * channels);
+        for (size_t i = 0; i < in.size(); i++) {
+            in[i] = static_cast<int16_t>(static_cast<int>(i % 301) * 2 - 301);
+        }
+        // The first pull glides to the new gain.
+        mixer.push(source, in.data(), 480);
+        mixer.pull(out.data(), 480);
+        mixer.push(source, in.data() + 480 * channels, 480);
+        mixer.pull(out.data(), 480);
+        bool same = true;
+        for (size_t i = 0; i < out.size(); i++) {
+            same = same && out[i] == roundS16(in[480 * channels + i] * 0.5f);
+        }
+        check(same, channels == 1 ? "mono output rounds halves away from zero" : "stereo output rounds halves away from zero");
+    }
+}
+
+static void testLimiter() {
+    AudioSourceMixer mixer(48000, 2, 8192);
+    const int stereo = mixer.addSource(2);
+    const int mono = mixer.addSource(1);
+    std::vector<int16_t> a(9600), b(4800), out(960);
+    for (int i = 0; i < 4800; i++) {
+        a[2 * i] = a[2 * i + 1] = b[i] = static_cast<int16_t>(32000 * std::sin(i * 0.05));
+    }
+    mixer.push(stereo, a.data(), 4800);
+    mixer.push(mono, b.data(), 4800);
+    int peak = 0;
+    for (int k = 0; k < 10; k++) {
+        mixer.pull(out.data(), 480);
+        for (int16_t s : out) {
+            peak = std::max(peak, std::abs(static_cast<int>(s)));
+        }
+    }
+    check(peak <= static_cast<int>(32768 * 0.8913f) + 1, "the limiter holds the sum under -1 dBFS");
+}
+
+// A producer thread pushes 16 sources while this one pulls; the audible source must come out as a gapless
+// ramp.
+static void testTwoThreads() {
+    AudioSourceMixer mixer(48000, 1, 2048);
+    int sources[16];
+    for (int i = 0; i < 16; i++) {
+        sources[i] = mixer.addSource(1);
+        mixer.setGain(sources[i], i == 0 ? 1.0f : 0.0f);
+    }
+    const size_t total = 48000 * 4;
+    std::thread producer([&] {
+        std::vector<int16_t> block(100);
+        size_t pushed[16] = {};
+        while (pushed[0] < total) {
+            for (int i = 0; i < 16; i++) {
+                for (size_t k = 0; k < block.size(); k++) {
+                    block[k] = static_cast<int16_t>((pushed[i] + k) % 20000);
+                }
+                pushed[i] += mixer.push(sources[i], block.data(), block.size());
+            }
+            std::this_thread::yield();
+        }
+    });
+    std::vector<int16_t> out(480);
+    size_t pulled = 0, errors = 0;
+    int16_t expected = 0;
+    while (pulled < total) {
+        if (mixer.writableFrames(sources[0]) > 2048 - 480) {
+            std::this_thread::yield();
+            continue;
+        }
+        mixer.pull(out.data(), 480);
+        for (int16_t s : out) {
+            errors += s != expected;
+            expected = static_cast<int16_t>((expected + 1) % 20000);
+        }
+        pulled += 480;
+    }
+    producer.join();
+    check(errors == 0 && mixer.underruns(sources[0]) == 0, "frames cross the rings intact and in order");
+}
+
+// 16 sources, 12 stereo and 4 mono, into a 48 kHz stereo mix in 10 ms pulls, with gain changes now and then.
+static void benchPull() {
+    AudioSourceMixer mixer(48000, 2, 8192);
+    int sources[16];
+    for (int i = 0; i < 16; i++) {
+        sources[i] = mixer.addSource(i % 4 == 0 ? 1 : 2);
+        mixer.setGain(sources[i], 0.1f);
+        mixer.setPan(sources[i], (i - 8) / 8.0f);
+    }
+    std::vector<int16_t> in(960), out(960);
+    for (int16_t& s : in) {
+        s = static_cast<int16_t>(rand() % 20000 - 10000);
+    }
+    std::vector<double> pulls, pushes;
+    for (int round = 0; round < 3000; round++) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 16; i++) {
+            mixer.push(sources[i], in.data(), 480);
+        }
+        const auto pushed = std::chrono::steady_clock::now();
+        if (round % 50 == 0) {
+            for (int i = 0; i < 16; i++) {
+                mixer.setGain(sources[i], 0.1f + 0.01f * (round % 7));
+            }
+        }
+        mixer.pull(out.data(), 480);
+        const auto pulled = std::chrono::steady_clock::now();
+        pushes.push_back(std::chrono::duration<double, std::micro>(pushed - start).count());
+        pulls.push_back(std::chrono::duration<double, std::micro>(pulled - pushed).count());
+    }
+    std::sort(pulls.begin(), pulls.end());
+    std::sort(pushes.begin(), pushes.end());
+    printf("16 sources: pull median %.2f us, p99 %.2f us; 16 pushes of 480 frames median %.2f us\n",
+           pulls[pulls.size() / 2], pulls[pulls.size() * 99 / 100], pushes[pushes.size() / 2]);
+}
+
+int main() {
+    testPassthrough();
+    testRounding();
+    testLimiter();
+    testTwoThreads();
+    benchPull();
+    printf(gFailures ? "%d checks failed\n" : "all checks passed\n", gFailures);
+    return gFailures ? 1 : 0;
+}
@@ -18,9 +18,15 @@
 
 @interface ExternalAudio : NSObject
 @property (nonatomic, weak) id<ExternalAudioDelegate> delegate;
+// Meters the loudness of each remote user's audio before it is mixed, see remoteLoudnessForUid:.
+@property (nonatomic, assign) BOOL meterRemoteLoudness;
 
 + (instancetype)sharedExternalAudio;
 - (void)setupExternalAudioWithAgoraKit:(AgoraRtcEngineKit *)agoraKit sampleRate:(uint)sampleRate channels:(uint)channels audioCRMode:(AudioCRMode)audioCRMode IOType:(IOUnitType)ioType;
 - (void)startWork;
 - (void)stopWork;
+// Latest EBU R128 reading for a remote user, updated every 100 ms: "momentary", "short_term" and
+// "integrated" in LUFS, "rms_db", "peak_db", "true_peak_db" and "max_true_peak_db". Nil while the
+// user is not metered; up to 16 users are metered at once.
+- (NSDictionary<NSString *, NSNumber *> *)remoteLoudnessForUid:(NSUInteger)uid;
 @end
@@ -9,6 +9,13 @@
 #import "ExternalAudio.h"
 #import "AudioController.h"
 #import "AudioWriteToFile.h"
+#include "AudioResampler.h"
+#include "AudioChannelMixer.h"
+#include "../ExternalVideo/CircularBuffer.h"
+#include "../../../SimpleFilter/LoudnessMeter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 
 #if TARGET_OS_IPHONE
 #import <AgoraRtcKit/AgoraRtcEngineKit.h>
@@ -41,128 +48,175 @@ private:
     // total buffer length of per second
     enum { kBufferLengthBytes = 441 * 2 * 2 * 50 }; //
     
+    // Bytes for one path, used under that path's lock, so the single-producer single-consumer rule of
+    // the lock-free buffers always holds. The memory is mapped twice back to back where the system allows
+    // it, so every run of bytes in it is contiguous and is used where it lies; otherwise a run across the
+    // end of the ring is copied out in two pieces. A ring that would overflow starts over.
+    static CircularBuffer createRing(size_t length)
+    {
+        CircularBuffer ring = CircularBufferCreateMirrored(length);
+        return ring ? ring : CircularBufferCreateSPSC(length);
+    }
+    
+    static void writeRing(CircularBuffer ring, const void* bytes, int length)
+    {
+        if (length <= 0 || (size_t)length > CircularBufferGetCapacity(ring)) {
+            return;
+        }
+        if (CircularBufferGetFreeSize(ring) < (size_t)length) {
+            CircularBufferReset(ring);
+        }
+        CircularBufferTryPush(ring, bytes, length);
+    }
+    
     // capture
-    char byteBuffer[kBufferLengthBytes]; // char take up 1 byte, byterBuffer[] take up 88200 bytes
-    int readIndex = 0;
-    int writeIndex = 0;
-    int availableBytes = 0;
-    int channels = 1;
+    CircularBuffer captureRing = createRing(kBufferLengthBytes);
+    // A run across the end of an unmirrored capture ring, put together for the resampler.
+    int16_t captured_run[AudioResampler::kMaxPushFrames];
     
     // play
-    char byteBuffer_play[kBufferLengthBytes];
-    int readIndex_play = 0;
-    int writeIndex_play = 0;
-    int availableBytes_play = 0;
+    CircularBuffer playRing = createRing(kBufferLengthBytes);
     int channels_play = 1;
     
+    // Convert between the external device format and the format of the SDK frames. Each is used only
+    // under its path's lock.
+    AudioResampler captureResampler;
+    AudioResampler playResampler;
+    AudioChannelMixer captureMixer;
+    AudioChannelMixer playMixer;
+    int16_t resampled[AudioResampler::kMaxPushFrames];
+    int16_t resampled_play[AudioResampler::kMaxPushFrames];
+    int16_t mixed_play[AudioResampler::kMaxPushFrames];
+    
+    // Loudness of the remote streams before mixing. A slot belongs to a uid from its first frame until
+    // the table is full and a stream that has not been heard for a second is needed for a new uid, so
+    // the audio thread never allocates. The uids are atomic for the readers; everything else in a slot
+    // is written by the audio thread only, and the meters serialize their own readers.
+    enum { kMeteredStreams = 16, kIdleMs = 1000 };
+    struct RemoteMeter {
+        std::atomic<agora::rtc::uid_t> uid = {0};
+        int64_t lastHeardMs = 0;
+        agora::extension::LoudnessMeter meter;
+    };
+    RemoteMeter remoteMeters[kMeteredStreams];
+    
+    RemoteMeter* remoteMeterFor(agora::rtc::uid_t uid, int64_t nowMs)
+    {
+        RemoteMeter* empty = nullptr;
+        RemoteMeter* idle = nullptr;
+        for (RemoteMeter& slot : remoteMeters) {
+            agora::rtc::uid_t owner = slot.uid.load(std::memory_order_relaxed);
+            if (owner == uid) {
+                return &slot;
+            }
+            if (owner == 0) {
+                empty = empty ? empty : &slot;
+            } else if (!idle || slot.lastHeardMs < idle->lastHeardMs) {
+                idle = &slot;
+            }
+        }
+        RemoteMeter* slot = empty;
+        if (!slot) {
+            if (nowMs - idle->lastHeardMs < kIdleMs) {
+                return nullptr;
+            }
+            slot = idle;
+        }
+        slot->meter.reset();
+        slot->uid.store(uid, std::memory_order_release);
+        return slot;
+    }
+    
 public:
+    ExternalAudioFrameObserver() = default;
+    ExternalAudioFrameObserver(const ExternalAudioFrameObserver&) = delete;
+    ExternalAudioFrameObserver& operator=(const ExternalAudioFrameObserver&) = delete;
+    
+    ~ExternalAudioFrameObserver()
+    {
+        CircularBufferFree(captureRing);
+        CircularBufferFree(playRing);
+    }
+    
+    // Format of the external capture and render devices; both rings hold audio in it.
     int sampleRate = 0;
+    int channels = 1;
     int sampleRate_play = 0;
     
     bool isExternalCapture = false;
     bool isExternalRender = false;
+    // Meter the remote streams before mixing; takes effect when the observer is registered again.
+    std::atomic<bool> meterRemote = {false};
     
 #pragma mark- <C++ Capture>
-    // push audio data to special buffer(Array byteBuffer)
+    // push audio data to special buffer(captureRing)
     // bytesLength = date length
     void pushExternalData(void* data, int bytesLength)
     {
         @synchronized(threadLockCapture) {
-            
-            if (availableBytes + bytesLength > kBufferLengthBytes) {
-                
-                readIndex = 0;
-                writeIndex = 0;
-                availableBytes = 0;
-            }
-            
-            if (writeIndex + bytesLength > kBufferLengthBytes) {
-                
-                int left = kBufferLengthBytes - writeIndex;
-                memcpy(byteBuffer + writeIndex, data, left);
-                memcpy(byteBuffer, (char *)data + left, bytesLength - left);
-                writeIndex = bytesLength - left;
-            }
-            else {
-                
-                memcpy(byteBuffer + writeIndex, data, bytesLength);
-                writeIndex += bytesLength;
-            }
-            availableBytes += bytesLength;
+            writeRing(captureRing, data, bytesLength);
         }
     
     }
     
-    // copy byteBuffer to audioFrame.buffer
+    // copy captureRing to audioFrame.buffer
     virtual bool onRecordAudioFrame(const char* channelId, AudioFrame& audioFrame) override
     {
         @synchronized(threadLockCapture) {
             
             if (isExternalCapture == false) return true;
             
-            int readBytes = sampleRate / 100 * channels * audioFrame.bytesPerSample;
-            
-            if (availableBytes < readBytes) {
+            // The SDK asks for its own rate, which need not be the capture device's.
+            int outputRate = audioFrame.samplesPerSec > 0 ? audioFrame.samplesPerSec : sampleRate;
+            int outputFrames = audioFrame.samplesPerChannel > 0 ? audioFrame.samplesPerChannel : outputRate / 100;
+            if (!captureResampler.setFormat(sampleRate, outputRate, channels)
+                || !captureMixer.setLayout(channels, audioFrame.channels)
+                || outputFrames * channels > AudioResampler::kMaxPushFrames) {
                 return false;
             }
             
-            audioFrame.samplesPerSec = sampleRate;
-            unsigned char tmp[960]; // The most rate:@48k fs, channels = 1, the most total size = 960;
-            
-            if (readIndex + readBytes > kBufferLengthBytes) {
-                int left = kBufferLengthBytes - readIndex;
-                memcpy(tmp, byteBuffer + readIndex, left);
-                memcpy(tmp + left, byteBuffer, readBytes - left);
-                readIndex = readBytes - left;
+            int readBytes = (int)captureResampler.inputFramesFor(outputFrames) * channels * audioFrame.bytesPerSample;
+            if (readBytes > (int)sizeof(captured_run) || CircularBufferGetDataSize(captureRing) < (size_t)readBytes) {
+                return false;
             }
-            else {
-                memcpy(tmp, byteBuffer + readIndex, readBytes);
-                readIndex += readBytes;
+            // Resampled straight out of the ring when the run is in one piece.
+            const void *captured = nullptr;
+            size_t contiguous = 0;
+            bool inPlace = CircularBufferPeekRead(captureRing, readBytes, &captured, &contiguous);
+            if (!inPlace) {
+                CircularBufferPop(captureRing, readBytes, captured_run);
+                captured = captured_run;
             }
             
-            availableBytes -= readBytes;
+            audioFrame.samplesPerSec = outputRate;
             
-            if (channels == audioFrame.channels) {
-                memcpy(audioFrame.buffer, tmp, readBytes);
+            captureResampler.push((const int16_t *)captured, readBytes / (channels * audioFrame.bytesPerSample));
+            captureResampler.pull(resampled, outputFrames);
+            if (inPlace) {
+                CircularBufferConsumeRead(captureRing, readBytes);
             }
-            [AudioWriteToFile writeToFileWithData:audioFrame.buffer length:readBytes];
+            
+            captureMixer.process(resampled, (int16_t *)audioFrame.buffer, outputFrames);
+            
+            int frameBytes = outputFrames * audioFrame.channels * audioFrame.bytesPerSample;
+            [AudioWriteToFile writeToFileWithData:audioFrame.buffer length:frameBytes];
             return true;
         }
         
     }
     
 #pragma mark- <C++ Render>
-    // read Audio data from byteBuffer_play to audioUnit
+    // read Audio data from playRing to audioUnit
     int readAudioData(void* data, int bytesLength)
     {
         @synchronized(threadLockPlay) {
             
-            if (NULL == data || bytesLength < 1 || availableBytes_play < bytesLength) {
+            if (NULL == data || bytesLength < 1 || CircularBufferGetDataSize(playRing) < (size_t)bytesLength) {
                 return 0;
             }
             
-            int readBytes = bytesLength;
-            
-            unsigned char tmp[4096]; // unsigned char takes up 1 byte
-            
-            if (readIndex_play + readBytes > kBufferLengthBytes) {
-                
-                int left = kBufferLengthBytes - readIndex_play;
-                memcpy(tmp, byteBuffer_play + readIndex_play, left);
-                memcpy(tmp + left, byteBuffer_play, readBytes - left);
-                readIndex_play = readBytes - left;
-            }
-            else {
-                
-                memcpy(tmp, byteBuffer_play + readIndex_play, readBytes);
-                readIndex_play += readBytes;
-            }
-            
-            availableBytes_play -= readBytes;
-            
-            if (channels_play == 1) {
-                memcpy(data, tmp, readBytes);
-            }
+            // Copied straight into the device's buffer, in two pieces when the run crosses the end of the ring.
+            int readBytes = (int)CircularBufferPop(playRing, bytesLength, data);
             
             [AudioWriteToFile writeToFileWithData:data length:readBytes];
             
@@ -175,40 +229,33 @@ public:
         return true;
     }
     
-    // recive remote audio stream, push audio data to byteBuffer_play
+    // recive remote audio stream, push audio data to playRing
     virtual bool onPlaybackAudioFrame(const char* channelId, AudioFrame& audioFrame) override
     {
         @synchronized(threadLockPlay) {
         
             if (isExternalRender == false) return true;
 
-            int bytesLength = audioFrame.samplesPerChannel * audioFrame.channels * audioFrame.bytesPerSample;
-            char *data = (char *)audioFrame.buffer;
-            
             sampleRate_play = audioFrame.samplesPerSec;
             channels_play = audioFrame.channels;
             
-            if (availableBytes_play + bytesLength > kBufferLengthBytes) {
-                
-                readIndex_play = 0;
-                writeIndex_play = 0;
-                availableBytes_play = 0;
-            }
-            
-            if (writeIndex_play + bytesLength > kBufferLengthBytes) {
-                
-                int left = kBufferLengthBytes - writeIndex_play;
-                memcpy(byteBuffer_play + writeIndex_play, data, left);
-                memcpy(byteBuffer_play, (char *)data + left, bytesLength - left);
-                writeIndex_play = bytesLength - left;
+            // The ring holds audio in the render device's format.
+            if (!playMixer.setLayout(channels_play, channels)) {
+                return true;
             }
-            else {
-                
-                memcpy(byteBuffer_play + writeIndex_play, data, bytesLength);
-                writeIndex_play += bytesLength;
+            const int16_t *frame = (int16_t *)audioFrame.buffer;
+            int frames = audioFrame.samplesPerChannel;
+            int maxFrames = AudioResampler::kMaxPushFrames / std::max(channels_play, channels);
+            if (sampleRate > 0 && playResampler.setFormat(sampleRate_play, sampleRate, channels_play)) {
+                playResampler.push(frame, frames);
+                frames = (int)playResampler.pull(resampled_play, maxFrames);
+                frame = resampled_play;
             }
+            frames = std::min(frames, maxFrames);
+            playMixer.process(frame, mixed_play, frames);
             
-            availableBytes_play += bytesLength;
+            int bytesLength = frames * channels * audioFrame.bytesPerSample;
+            writeRing(playRing, mixed_play, bytesLength);
             
             return true;
         }
@@ -219,12 +266,37 @@ public:
         return AudioParams();
     }
     
-    virtual bool onPlaybackAudioFrameBeforeMixing(const char* channelId, agora::rtc::uid_t uid, AudioFrame& audioFrame) override { return true; }
+    // meter each remote stream, see remoteLoudness
+    virtual bool onPlaybackAudioFrameBeforeMixing(const char* channelId, agora::rtc::uid_t uid, AudioFrame& audioFrame) override
+    {
+        if (!meterRemote.load(std::memory_order_relaxed) || uid == 0 || audioFrame.bytesPerSample != agora::rtc::TWO_BYTES_PER_SAMPLE || !audioFrame.buffer) {
+            return true;
+        }
+        int64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        RemoteMeter* slot = remoteMeterFor(uid, nowMs);
+        if (slot) {
+            slot->lastHeardMs = nowMs;
+            slot->meter.process((const int16_t *)audioFrame.buffer, audioFrame.samplesPerChannel, audioFrame.channels, audioFrame.samplesPerSec);
+        }
+        return true;
+    }
     
     virtual bool onMixedAudioFrame(const char* channelId, AudioFrame& audioFrame) override { return true; }
     
     virtual int getObservedAudioFramePosition() override {
-        return AUDIO_FRAME_POSITION_NONE;
+        return meterRemote.load() ? AUDIO_FRAME_POSITION_BEFORE_MIXING : AUDIO_FRAME_POSITION_NONE;
+    }
+    
+    // The latest reading for a remote uid; false while it is not being metered.
+    bool remoteLoudness(agora::rtc::uid_t uid, agora::extension::LoudnessReading& reading)
+    {
+        for (RemoteMeter& slot : remoteMeters) {
+            if (uid != 0 && slot.uid.load(std::memory_order_acquire) == uid) {
+                reading = slot.meter.read();
+                return true;
+            }
+        }
+        return false;
     }
     virtual AudioParams getPlaybackAudioParams() override {
         return AudioParams();
@@ -263,7 +335,8 @@ static ExternalAudioFrameObserver* s_audioFrameObserver;
     if (mediaEngine) {
         s_audioFrameObserver = new ExternalAudioFrameObserver();
         s_audioFrameObserver -> sampleRate = sampleRate;
-        s_audioFrameObserver -> sampleRate_play = channels;
+        s_audioFrameObserver -> channels = channels;
+        s_audioFrameObserver -> meterRemote = self.meterRemoteLoudness;
         mediaEngine->registerAudioFrameObserver(s_audioFrameObserver);
     }
     
@@ -288,10 +361,39 @@ static ExternalAudioFrameObserver* s_audioFrameObserver;
 }
 
 - (void)cancelRegister {
+    [self registerAudioFrameObserver:NULL];
+}
+
+- (void)registerAudioFrameObserver:(ExternalAudioFrameObserver *)observer {
     agora::rtc::IRtcEngine* rtc_engine = (agora::rtc::IRtcEngine*)self.agoraKit.getNativeHandle;
     agora::util::AutoPtr<agora::media::IMediaEngine> mediaEngine;
     mediaEngine.queryInterface(rtc_engine, agora::rtc::AGORA_IID_MEDIA_ENGINE);
-    mediaEngine->registerAudioFrameObserver(NULL);
+    if (mediaEngine) {
+        mediaEngine->registerAudioFrameObserver(observer);
+    }
+}
+
+- (void)setMeterRemoteLoudness:(BOOL)meterRemoteLoudness {
+    _meterRemoteLoudness = meterRemoteLoudness;
+    if (s_audioFrameObserver && self.agoraKit) {
+        s_audioFrameObserver -> meterRemote = meterRemoteLoudness;
+        // The SDK asks for the observed positions when the observer is registered.
+        [self registerAudioFrameObserver:s_audioFrameObserver];
+    }
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)remoteLoudnessForUid:(NSUInteger)uid {
+    agora::extension::LoudnessReading reading;
+    if (!s_audioFrameObserver || !s_audioFrameObserver -> remoteLoudness((agora::rtc::uid_t)uid, reading)) {
+        return nil;
+    }
+    return @{@"momentary": @(reading.momentary),
+             @"short_term": @(reading.shortTerm),
+             @"integrated": @(reading.integrated),
+             @"rms_db": @(reading.rmsDb),
+             @"peak_db": @(reading.peakDb),
+             @"true_peak_db": @(reading.truePeakDb),
+             @"max_true_peak_db": @(reading.maxTruePeakDb)};
 }
 
 - (void)audioController:(AudioController *)controller didCaptureData:(unsigned char *)data bytesLength:(int)bytesLength {
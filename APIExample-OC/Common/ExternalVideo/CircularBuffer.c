@@ -8,6 +8,16 @@
 
 #include "CircularBuffer.h"
 #include <string.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#elif defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#define CIRCULAR_BUFFER_CACHE_LINE 64
 
 struct s_circularBuffer{
     
@@ -16,7 +26,17 @@ struct s_circularBuffer{
     size_t tailOffset; //head offset, the oldest byte position offset
     size_t headOffset; //tail offset, the lastest byte position offset
     void *buffer;
-
+    bool spsc;
+    bool mirrored; //buffer is mapped twice back to back, see CircularBufferMapMirrored
+    
+    //lock-free mode only: bytes written and read since creation, each advanced by one thread only. The padding keeps each side's fields off the other's cache line, so the two threads do not steal a line from each other on every call. Each side keeps the other's count as of its last look and only loads it again when it seems to be out of room or data.
+    char padding0[CIRCULAR_BUFFER_CACHE_LINE];
+    _Atomic size_t writeCount;
+    size_t producerReadCount;
+    char padding1[CIRCULAR_BUFFER_CACHE_LINE];
+    _Atomic size_t readCount;
+    size_t consumerWriteCount;
+    char padding2[CIRCULAR_BUFFER_CACHE_LINE];
 };
 
 extern CircularBuffer CircularBufferCreate(size_t size)
@@ -26,12 +46,128 @@ extern CircularBuffer CircularBufferCreate(size_t size)
     CircularBuffer buffer = (CircularBuffer)p;
     buffer->buffer = p + sizeof(struct s_circularBuffer);
     buffer->size = size;
+    buffer->spsc = false;
+    buffer->mirrored = false;
     CircularBufferReset(buffer);
     return buffer;
 }
 
+extern CircularBuffer CircularBufferCreateSPSC(size_t size)
+{
+    size_t totalSize = sizeof(struct s_circularBuffer) + size;
+    void *p = malloc(totalSize);
+    CircularBuffer buffer = (CircularBuffer)p;
+    buffer->buffer = p + sizeof(struct s_circularBuffer);
+    buffer->size = size;
+    buffer->dataSize = 0;
+    buffer->headOffset = -1;
+    buffer->tailOffset = -1;
+    buffer->spsc = true;
+    buffer->mirrored = false;
+    atomic_init(&buffer->writeCount, 0);
+    atomic_init(&buffer->readCount, 0);
+    buffer->producerReadCount = 0;
+    buffer->consumerWriteCount = 0;
+    return buffer;
+}
+
+extern CircularBuffer CircularBufferCreateMirrored(size_t size)
+{
+    size_t mappedSize = size;
+    void *memory = CircularBufferMapMirrored(&mappedSize);
+    if(memory == NULL)
+        return NULL;
+    
+    //just the bookkeeping, the data lives in the mapping
+    CircularBuffer buffer = CircularBufferCreateSPSC(0);
+    buffer->buffer = memory;
+    buffer->size = mappedSize;
+    buffer->mirrored = true;
+    return buffer;
+}
+
+bool CircularBufferIsSPSC(CircularBuffer cBuf)
+{
+    return cBuf->spsc;
+}
+
+static size_t inter_circularBuffer_page_size(void)
+{
+#if defined(__APPLE__)
+    return vm_page_size;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void *CircularBufferMapMirrored(size_t *size)
+{
+    size_t pageSize = inter_circularBuffer_page_size();
+    size_t length = (*size + pageSize - 1) / pageSize * pageSize;
+    if(length == 0)
+        length = pageSize;
+    
+#if defined(__APPLE__)
+    vm_address_t address = 0;
+    if(vm_allocate(mach_task_self(), &address, 2 * length, VM_FLAGS_ANYWHERE) != KERN_SUCCESS)
+        return NULL;
+    
+    //maps the first half over the second in one step, so no other mapping can take the hole in between
+    vm_address_t mirror = address + length;
+    vm_prot_t currentProtection, maxProtection;
+    kern_return_t result = vm_remap(mach_task_self(), &mirror, length, 0, VM_FLAGS_FIXED | VM_FLAGS_OVERWRITE,
+                                    mach_task_self(), address, FALSE, &currentProtection, &maxProtection, VM_INHERIT_DEFAULT);
+    if(result != KERN_SUCCESS || mirror != address + length)
+    {
+        vm_deallocate(mach_task_self(), address, 2 * length);
+        return NULL;
+    }
+    *size = length;
+    return (void *)address;
+#elif defined(__linux__) && defined(SYS_memfd_create)
+    int fd = (int)syscall(SYS_memfd_create, "CircularBuffer", 1 /* MFD_CLOEXEC */);
+    if(fd < 0)
+        return NULL;
+    
+    //reserves both halves, then maps the same file pages into each
+    char *address = NULL;
+    if(ftruncate(fd, (off_t)length) == 0)
+    {
+        address = mmap(NULL, 2 * length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(address == MAP_FAILED)
+            address = NULL;
+    }
+    if(address != NULL
+       && (mmap(address, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+           || mmap(address + length, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED))
+    {
+        munmap(address, 2 * length);
+        address = NULL;
+    }
+    close(fd);
+    if(address != NULL)
+        *size = length;
+    return address;
+#else
+    return NULL;
+#endif
+}
+
+void CircularBufferUnmapMirrored(void *memory, size_t size)
+{
+    if(memory == NULL)
+        return;
+#if defined(__APPLE__)
+    vm_deallocate(mach_task_self(), (vm_address_t)memory, 2 * size);
+#else
+    munmap(memory, 2 * size);
+#endif
+}
+
 void CircularBufferFree(CircularBuffer cBuf)
 {
+    if(cBuf->mirrored)
+        CircularBufferUnmapMirrored(cBuf->buffer, cBuf->size);
     CircularBufferReset(cBuf);
     cBuf->size = 0;
     cBuf->dataSize = 0;
@@ -41,6 +177,14 @@ void CircularBufferFree(CircularBuffer cBuf)
 
 void CircularBufferReset(CircularBuffer cBuf)
 {
+    if(cBuf->spsc)
+    {
+        //the consumer catches up with everything written so far
+        size_t written = atomic_load_explicit(&cBuf->writeCount, memory_order_acquire);
+        cBuf->consumerWriteCount = written;
+        atomic_store_explicit(&cBuf->readCount, written, memory_order_release);
+        return;
+    }
     cBuf->headOffset = -1;
     cBuf->tailOffset = -1;
     cBuf->dataSize = 0;
@@ -58,13 +202,83 @@ size_t CircularBufferGetSize(CircularBuffer cBuf)
 
 size_t CircularBufferGetDataSize(CircularBuffer cBuf)
 {
+    if(cBuf->spsc)
+    {
+        //read first: the writer only moves ahead of it, so the difference never goes negative
+        size_t read = atomic_load_explicit(&cBuf->readCount, memory_order_acquire);
+        size_t written = atomic_load_explicit(&cBuf->writeCount, memory_order_acquire);
+        return written - read;
+    }
     return cBuf->dataSize;
 }
 
+size_t CircularBufferGetFreeSize(CircularBuffer cBuf)
+{
+    return cBuf->size - CircularBufferGetDataSize(cBuf);
+}
+
+//lock-free mode: the producer's push, wait-free
+static size_t inter_circularBuffer_spsc_push(CircularBuffer cBuf, const void *src, size_t length)
+{
+    size_t written = atomic_load_explicit(&cBuf->writeCount, memory_order_relaxed);
+    if(cBuf->size - (written - cBuf->producerReadCount) < length)
+        cBuf->producerReadCount = atomic_load_explicit(&cBuf->readCount, memory_order_acquire);
+    
+    size_t freeLen = cBuf->size - (written - cBuf->producerReadCount);
+    size_t wrLen = length < freeLen ? length : freeLen;
+    if(wrLen == 0)
+        return 0;
+    
+    size_t offset = written % cBuf->size;
+    size_t frg1Len = cBuf->mirrored ? wrLen : cBuf->size - offset;
+    if(frg1Len > wrLen)
+        frg1Len = wrLen;
+    memcpy((char *)cBuf->buffer + offset, src, frg1Len);
+    memcpy(cBuf->buffer, (const char *)src + frg1Len, wrLen - frg1Len);
+    
+    //publishes the bytes along with the count
+    atomic_store_explicit(&cBuf->writeCount, written + wrLen, memory_order_release);
+    return wrLen;
+}
+
+//lock-free mode: the consumer's read, wait-free
+static size_t inter_circularBuffer_spsc_read(CircularBuffer cBuf, size_t length, void *dataOut, bool resetHead)
+{
+    size_t read = atomic_load_explicit(&cBuf->readCount, memory_order_relaxed);
+    if(cBuf->consumerWriteCount - read < length)
+        cBuf->consumerWriteCount = atomic_load_explicit(&cBuf->writeCount, memory_order_acquire);
+    
+    size_t dataSize = cBuf->consumerWriteCount - read;
+    size_t rdLen = length < dataSize ? length : dataSize;
+    if(rdLen == 0)
+        return 0;
+    
+    if(dataOut)
+    {
+        size_t offset = read % cBuf->size;
+        size_t frg1Len = cBuf->mirrored ? rdLen : cBuf->size - offset;
+        if(frg1Len > rdLen)
+            frg1Len = rdLen;
+        memcpy(dataOut, (const char *)cBuf->buffer + offset, frg1Len);
+        memcpy((char *)dataOut + frg1Len, cBuf->buffer, rdLen - frg1Len);
+    }
+    
+    //hands the space back only once the bytes are copied out
+    if(resetHead)
+        atomic_store_explicit(&cBuf->readCount, read + rdLen, memory_order_release);
+    return rdLen;
+}
+
 void CircularBufferPush(CircularBuffer cBuf,void *src, size_t length)
 {
     if(length == 0)
         return;
+    
+    if(cBuf->spsc)
+    {
+        inter_circularBuffer_spsc_push(cBuf, src, length);
+        return;
+    }
 
     size_t writableLen = length;
     void *pSrc = src;
@@ -128,8 +342,22 @@ void CircularBufferPush(CircularBuffer cBuf,void *src, size_t length)
     }
 }
 
+size_t CircularBufferTryPush(CircularBuffer cBuf, const void *src, size_t length)
+{
+    if(cBuf->spsc)
+        return inter_circularBuffer_spsc_push(cBuf, src, length);
+    
+    size_t freeLen = cBuf->size - cBuf->dataSize;
+    size_t wrLen = length < freeLen ? length : freeLen;
+    CircularBufferPush(cBuf, (void *)src, wrLen);
+    return wrLen;
+}
+
 size_t inter_circularBuffer_read(CircularBuffer cBuf, size_t length, void *dataOut, bool resetHead)
 {
+    if(cBuf->spsc)
+        return inter_circularBuffer_spsc_read(cBuf, length, dataOut, resetHead);
+    
     if(cBuf->dataSize == 0 || length == 0)
         return 0;
     
@@ -207,6 +435,107 @@ size_t CircularBufferRead(CircularBuffer cBuf, size_t length, void *dataOut)
     return inter_circularBuffer_read(cBuf,length,dataOut,false);
 }
 
+bool CircularBufferReserveWrite(CircularBuffer cBuf, size_t length, void **ptr, size_t *available)
+{
+    size_t offset, avLen;
+    if(cBuf->spsc)
+    {
+        //fresh look at the consumer, so all the space it has handed back is counted
+        size_t written = atomic_load_explicit(&cBuf->writeCount, memory_order_relaxed);
+        cBuf->producerReadCount = atomic_load_explicit(&cBuf->readCount, memory_order_acquire);
+        size_t freeLen = cBuf->size - (written - cBuf->producerReadCount);
+        offset = cBuf->size ? written % cBuf->size : 0;
+        avLen = cBuf->mirrored ? freeLen : cBuf->size - offset;
+        if(avLen > freeLen)
+            avLen = freeLen;
+    }
+    else if(cBuf->dataSize == 0)
+    {
+        //an empty buffer starts over from the beginning, where all of it is in one piece
+        CircularBufferReset(cBuf);
+        offset = 0;
+        avLen = cBuf->size;
+    }
+    else if(cBuf->tailOffset >= cBuf->headOffset)
+    {
+        offset = cBuf->tailOffset + 1;
+        if(offset == cBuf->size)
+        {
+            offset = 0;
+            avLen = cBuf->headOffset;
+        }
+        else
+            avLen = cBuf->size - offset;
+    }
+    else
+    {
+        offset = cBuf->tailOffset + 1;
+        avLen = cBuf->headOffset - offset;
+    }
+    
+    *ptr = (char *)cBuf->buffer + offset;
+    *available = avLen;
+    return avLen >= length;
+}
+
+void CircularBufferCommitWrite(CircularBuffer cBuf, size_t length)
+{
+    if(length == 0)
+        return;
+    
+    if(cBuf->spsc)
+    {
+        //publishes the bytes along with the count
+        size_t written = atomic_load_explicit(&cBuf->writeCount, memory_order_relaxed);
+        atomic_store_explicit(&cBuf->writeCount, written + length, memory_order_release);
+        return;
+    }
+    
+    //the same place CircularBufferReserveWrite handed out
+    size_t offset = cBuf->dataSize == 0 ? 0 : (cBuf->tailOffset + 1) % cBuf->size;
+    if(cBuf->dataSize == 0)
+        cBuf->headOffset = 0;
+    cBuf->tailOffset = offset + length - 1;
+    cBuf->dataSize += length;
+}
+
+bool CircularBufferPeekRead(CircularBuffer cBuf, size_t length, const void **ptr, size_t *available)
+{
+    size_t offset, avLen;
+    if(cBuf->spsc)
+    {
+        size_t read = atomic_load_explicit(&cBuf->readCount, memory_order_relaxed);
+        cBuf->consumerWriteCount = atomic_load_explicit(&cBuf->writeCount, memory_order_acquire);
+        size_t dataSize = cBuf->consumerWriteCount - read;
+        offset = cBuf->size ? read % cBuf->size : 0;
+        avLen = cBuf->mirrored ? dataSize : cBuf->size - offset;
+        if(avLen > dataSize)
+            avLen = dataSize;
+    }
+    else if(cBuf->dataSize == 0)
+    {
+        offset = 0;
+        avLen = 0;
+    }
+    else
+    {
+        offset = cBuf->headOffset;
+        if(cBuf->headOffset <= cBuf->tailOffset)
+            avLen = cBuf->tailOffset - cBuf->headOffset + 1;
+        else
+            avLen = cBuf->size - cBuf->headOffset;
+    }
+    
+    *ptr = (const char *)cBuf->buffer + offset;
+    *available = avLen;
+    return avLen >= length;
+}
+
+size_t CircularBufferConsumeRead(CircularBuffer cBuf, size_t length)
+{
+    return inter_circularBuffer_read(cBuf,length,NULL,true);
+}
+
 
 //print circular buffer's content into str,
 void CircularBufferPrint(CircularBuffer cBuf, bool hex)
@@ -223,6 +552,14 @@ void CircularBufferPrint(CircularBuffer cBuf, bool hex)
         {
             c = '_';
         }
+        else if (cBuf->spsc)
+        {
+            size_t headOffset = atomic_load_explicit(&cBuf->readCount, memory_order_acquire) % cSize;
+            if((i + cSize - headOffset) % cSize < CircularBufferGetDataSize(cBuf))
+                c = b[i];
+            else
+                c = '_';
+        }
         else if (cBuf->tailOffset < cBuf->headOffset)
         {
             if(i>cBuf->tailOffset && i<cBuf->headOffset)
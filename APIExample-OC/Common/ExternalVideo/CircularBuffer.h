@@ -15,15 +15,35 @@
  A circular buffer(circular queue, cyclic buffer or ring buffer), is a data structure that uses a single, fixed-size buffer as if it were connected end-to-end. This structure lends itself easily to buffering data streams. visit https://en.wikipedia.org/wiki/Circular_buffer to see more information.
  */
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct s_circularBuffer* CircularBuffer;
 
 // Construct CircularBuffer with ‘size' in byte. You must call CircularBufferFree() in balance for destruction.
 extern CircularBuffer CircularBufferCreate(size_t size);
 
+// Construct a lock-free CircularBuffer for exactly one producer thread and one consumer thread, such as a Core Audio IO thread and an SDK thread. Push and pop never lock, allocate or wait on the other side, so either may run on a real-time thread without any lock around it.
+// The producer calls CircularBufferPush/CircularBufferTryPush, the consumer CircularBufferPop/CircularBufferRead/CircularBufferReset; the sizes may be read from either. A push that does not fit keeps the data already buffered and drops what does not fit, where a buffer from CircularBufferCreate overwrites its oldest data instead.
+extern CircularBuffer CircularBufferCreateSPSC(size_t size);
+
+// Construct a lock-free CircularBuffer, as CircularBufferCreateSPSC does, whose memory is mapped twice back to back, so that the data and the free space are each always in one piece and a push or pop is a single memcpy. The capacity is 'size' rounded up to whole memory pages. Return NULL when the system cannot map the memory.
+extern CircularBuffer CircularBufferCreateMirrored(size_t size);
+
+// Whether the buffer was constructed by CircularBufferCreateSPSC or CircularBufferCreateMirrored.
+extern bool CircularBufferIsSPSC(CircularBuffer cBuf);
+
+// Map '*size' bytes, rounded up to whole memory pages and written back to '*size', twice back to back: byte i and byte i + *size are the same memory, so any run of up to *size bytes starting in the first half is contiguous. (memfd + mmap on Linux, vm_remap on Apple.) Return NULL on failure. You must call CircularBufferUnmapMirrored() in balance.
+extern void *CircularBufferMapMirrored(size_t *size);
+
+// Unmap memory from CircularBufferMapMirrored, with the size it returned.
+extern void CircularBufferUnmapMirrored(void *memory, size_t size);
+
 // Destruct CircularBuffer
 extern void CircularBufferFree(CircularBuffer cBuf);
 
-// Reset the CircularBuffer
+// Reset the CircularBuffer. For a lock-free buffer this drops the buffered data and is for the consumer only.
 extern void CircularBufferReset(CircularBuffer cBuf);
 
 //get the capacity of CircularBuffer
@@ -35,16 +55,43 @@ extern size_t CircularBufferGetSize(CircularBuffer cBuf);
 //get occupied data size of CircularBuffer
 extern size_t CircularBufferGetDataSize(CircularBuffer cBuf);
 
+//get the size that can be pushed without dropping or overwriting anything
+extern size_t CircularBufferGetFreeSize(CircularBuffer cBuf);
+
 // Push data to the tail of a circular buffer from 'src' with 'length' size in byte.
 extern void CircularBufferPush(CircularBuffer cBuf,void *src, size_t length);
 
+// Push as much data as fits without overwriting anything from 'src' with 'length' size in byte, return the actual data size in byte pushed.
+extern size_t CircularBufferTryPush(CircularBuffer cBuf, const void *src, size_t length);
+
 // Pop data from a circular buffer to 'dataOut'  with wished 'length' size in byte,return the actual data size in byte popped out,which is less or equal to the input 'length parameter.
 extern size_t CircularBufferPop(CircularBuffer cBuf, size_t length, void *dataOut);
 
 // Read data from a circular buffer to 'dataOut'  with wished 'length' size in byte,return the actual data size in byte popped out,which is less or equal to the input 'length parameter.
 extern size_t CircularBufferRead(CircularBuffer cBuf, size_t length, void *dataOut);
 
+/*
+ Zero-copy access: the producer writes straight into the buffer's memory and the consumer reads straight out of it, instead of copying through its own buffers with Push/Pop.
+ Reserve/Peek give the free space or the data from the current position up to the end of the memory, so one call may return less than is there; a buffer from CircularBufferCreateMirrored always returns all of it in one piece. For a lock-free buffer, Reserve/Commit belong to the producer and Peek/Consume to the consumer.
+ */
+
+// Set '*ptr' to where the next data goes and '*available' to the contiguous free size there in byte. Return true when 'length' bytes fit, which never overwrites data.
+extern bool CircularBufferReserveWrite(CircularBuffer cBuf, size_t length, void **ptr, size_t *available);
+
+// Append 'length' bytes written at the pointer from CircularBufferReserveWrite, at most the size it reported.
+extern void CircularBufferCommitWrite(CircularBuffer cBuf, size_t length);
+
+// Set '*ptr' to the oldest data and '*available' to its contiguous size in byte. Return true when 'length' bytes are there. The data stays valid until it is consumed.
+extern bool CircularBufferPeekRead(CircularBuffer cBuf, size_t length, const void **ptr, size_t *available);
+
+// Drop the oldest 'length' bytes, usually once the data from CircularBufferPeekRead has been used, return the actual data size in byte dropped.
+extern size_t CircularBufferConsumeRead(CircularBuffer cBuf, size_t length);
+
 //for test purpose, print the circular buffer's data content by printf(...); the 'hex' parameters indicates that if the data should be printed in asscii string or hex data format.
 extern void CircularBufferPrint(CircularBuffer cBuf, bool hex);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,477 @@
+//
+//  CircularBufferTest.c
+//
+//  Stress test and benchmark for CircularBuffer. Not part of the app target, build and run it on its own:
+//      cc -O2 -std=gnu11 -pthread CircularBuffer.c CircularBufferTest.c -o CircularBufferTest && ./CircularBufferTest
+//  Returns non-zero if any check fails.
+//
+
+
+#include "CircularBuffer.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STRESS_BYTES (64u*1024*1024)
+#define BENCH_BYTES (256u*1024*1024)
+#define LATENCY_PUSHES 20000
+
+static long gFailures;
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static void check(bool ok, const char *what)
+{
+    if(!ok)
+    {
+        printf("FAILED: %s\n", what);
+        gFailures++;
+    }
+}
+
+//byte n of the test stream, so the consumer can check every byte arrived once and in order
+static uint8_t streamByte(size_t n)
+{
+    return (uint8_t)(n * 7 + (n >> 8));
+}
+
+static uint32_t nextRandom(uint32_t *seed)
+{
+    *seed = *seed * 1103515245u + 12345u;
+    return *seed >> 8;
+}
+
+//----- two threads -----
+
+//the same buffer driven either lock-free or with every call under one mutex, as the buffer was used before the lock-free mode
+typedef struct {
+    CircularBuffer buffer;
+    bool locked;
+    pthread_mutex_t lock;
+    size_t total;
+    size_t chunk; //0 for random sizes
+    volatile bool stop;
+} Pipe;
+
+static size_t pipePush(Pipe *pipe, const void *src, size_t length)
+{
+    if(!pipe->locked)
+        return CircularBufferTryPush(pipe->buffer, src, length);
+    pthread_mutex_lock(&pipe->lock);
+    size_t pushed = CircularBufferTryPush(pipe->buffer, src, length);
+    pthread_mutex_unlock(&pipe->lock);
+    return pushed;
+}
+
+static size_t pipePop(Pipe *pipe, void *dst, size_t length)
+{
+    if(!pipe->locked)
+        return CircularBufferPop(pipe->buffer, length, dst);
+    pthread_mutex_lock(&pipe->lock);
+    size_t popped = CircularBufferPop(pipe->buffer, length, dst);
+    pthread_mutex_unlock(&pipe->lock);
+    return popped;
+}
+
+static void pipeInit(Pipe *pipe, CircularBuffer buffer, size_t total, size_t chunk)
+{
+    memset(pipe, 0, sizeof(*pipe));
+    pipe->buffer = buffer;
+    pipe->locked = !CircularBufferIsSPSC(buffer);
+    pthread_mutex_init(&pipe->lock, NULL);
+    pipe->total = total;
+    pipe->chunk = chunk;
+}
+
+static void pipeDestroy(Pipe *pipe)
+{
+    CircularBufferFree(pipe->buffer);
+    pthread_mutex_destroy(&pipe->lock);
+}
+
+static void *streamProducer(void *arg)
+{
+    Pipe *pipe = arg;
+    uint8_t chunk[4096];
+    uint32_t seed = 1;
+    size_t sent = 0;
+    while(sent < pipe->total)
+    {
+        size_t length = pipe->chunk ? pipe->chunk : 1 + nextRandom(&seed) % 1500;
+        if(length > pipe->total - sent)
+            length = pipe->total - sent;
+        for(size_t i = 0; i < length; i++)
+            chunk[i] = streamByte(sent + i);
+        size_t offset = 0;
+        while(offset < length)
+        {
+            size_t pushed = pipePush(pipe, chunk + offset, length - offset);
+            offset += pushed;
+            if(!pushed)
+                sched_yield();
+        }
+        sent += length;
+    }
+    return NULL;
+}
+
+//streams pipe->total bytes from a producer thread to this one; returns the bytes that arrived wrong when `verify`
+static long runStream(Pipe *pipe, bool verify, double *seconds)
+{
+    pthread_t producer;
+    uint8_t chunk[4096];
+    uint32_t seed = 7;
+    size_t received = 0;
+    long errors = 0;
+    double start = now();
+    pthread_create(&producer, NULL, streamProducer, pipe);
+    while(received < pipe->total)
+    {
+        size_t length = pipe->chunk ? pipe->chunk : 1 + nextRandom(&seed) % 1700;
+        size_t popped = pipePop(pipe, chunk, length);
+        if(!popped)
+        {
+            sched_yield();
+            continue;
+        }
+        if(verify)
+        {
+            for(size_t i = 0; i < popped; i++)
+                errors += chunk[i] != streamByte(received + i);
+        }
+        received += popped;
+    }
+    pthread_join(producer, NULL);
+    *seconds = now() - start;
+    return errors;
+}
+
+//one producer and one consumer with random, unaligned sizes through a small buffer, so both wrap and run into each other all the time
+static void testStress(CircularBuffer buffer, const char *name)
+{
+    Pipe pipe;
+    double seconds;
+    pipeInit(&pipe, buffer, STRESS_BYTES, 0);
+    long errors = runStream(&pipe, true, &seconds);
+    printf("%s stress: %u MB in %.2f s, %ld bad bytes\n", name, STRESS_BYTES >> 20, seconds, errors);
+    check(errors == 0, "stream arrives intact");
+    check(CircularBufferGetDataSize(pipe.buffer) == 0, "stream drained");
+    pipeDestroy(&pipe);
+}
+
+static void benchThroughput(size_t chunk)
+{
+    double mb[2];
+    for(int locked = 0; locked < 2; locked++)
+    {
+        Pipe pipe;
+        double seconds;
+        pipeInit(&pipe, locked ? CircularBufferCreate(19200) : CircularBufferCreateSPSC(19200), BENCH_BYTES, chunk);
+        runStream(&pipe, false, &seconds);
+        mb[locked] = BENCH_BYTES / seconds / 1e6;
+        pipeDestroy(&pipe);
+    }
+    printf("throughput, %4zu-byte chunks: spsc %6.0f MB/s, mutex %6.0f MB/s\n", chunk, mb[0], mb[1]);
+}
+
+static int compareDoubles(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+//pops 10 ms of 48 kHz stereo whenever there is some and spends a while on it, holding the lock meanwhile in the mutex mode
+static void *busyConsumer(void *arg)
+{
+    Pipe *pipe = arg;
+    uint8_t chunk[1920];
+    while(!pipe->stop)
+    {
+        if(pipe->locked)
+            pthread_mutex_lock(&pipe->lock);
+        CircularBufferPop(pipe->buffer, sizeof(chunk), chunk);
+        for(volatile int i = 0; i < 2000; i++);
+        if(pipe->locked)
+            pthread_mutex_unlock(&pipe->lock);
+    }
+    return NULL;
+}
+
+//how long a producer waits in push while the consumer is busy, which is what a real-time producer cares about
+static void benchPushLatency(void)
+{
+    static double latency[LATENCY_PUSHES];
+    uint8_t chunk[1920] = {0};
+    for(int locked = 0; locked < 2; locked++)
+    {
+        Pipe pipe;
+        pthread_t consumer;
+        pipeInit(&pipe, locked ? CircularBufferCreate(192000) : CircularBufferCreateSPSC(192000), 0, 0);
+        pthread_create(&consumer, NULL, busyConsumer, &pipe);
+        for(int i = 0; i < LATENCY_PUSHES; i++)
+        {
+            struct timespec pause = {0, 20000};
+            double start = now();
+            pipePush(&pipe, chunk, sizeof(chunk));
+            latency[i] = (now() - start) * 1e6;
+            nanosleep(&pause, NULL);
+        }
+        pipe.stop = true;
+        pthread_join(consumer, NULL);
+        qsort(latency, LATENCY_PUSHES, sizeof(double), compareDoubles);
+        printf("push latency, %-5s: median %.2f us, p99 %.2f us, max %.1f us\n", locked ? "mutex" : "spsc",
+               latency[LATENCY_PUSHES / 2], latency[LATENCY_PUSHES * 99 / 100], latency[LATENCY_PUSHES - 1]);
+        pipeDestroy(&pipe);
+    }
+}
+
+//----- one thread -----
+
+static void testSPSCBasics(void)
+{
+    CircularBuffer cBuf = CircularBufferCreateSPSC(8);
+    char out[9] = {0};
+    check(CircularBufferIsSPSC(cBuf), "spsc buffer reports spsc");
+    CircularBufferPush(cBuf, "abcdef", 6);
+    check(CircularBufferPop(cBuf, 4, out) == 4 && memcmp(out, "abcd", 4) == 0, "spsc pop");
+    check(CircularBufferTryPush(cBuf, "ghijkl", 6) == 6, "spsc push wraps");
+    check(CircularBufferTryPush(cBuf, "mn", 2) == 0 && CircularBufferGetFreeSize(cBuf) == 0, "spsc push stops when full");
+    check(CircularBufferRead(cBuf, 8, out) == 8 && memcmp(out, "efghijkl", 8) == 0, "spsc read across the wrap");
+    check(CircularBufferGetDataSize(cBuf) == 8, "read leaves the data");
+    CircularBufferReset(cBuf);
+    check(CircularBufferGetDataSize(cBuf) == 0 && CircularBufferGetFreeSize(cBuf) == 8, "spsc reset");
+    CircularBufferFree(cBuf);
+}
+
+static void testMirroredMapping(void)
+{
+    size_t size = 10000;
+    char *memory = CircularBufferMapMirrored(&size);
+    check(memory != NULL, "mirrored mapping");
+    if(memory == NULL)
+        return;
+    check(size >= 10000 && size % (size_t)sysconf(_SC_PAGESIZE) == 0, "mirrored size is whole pages");
+    memory[5] = 'x';
+    memory[size + 6] = 'y';
+    check(memory[size + 5] == 'x' && memory[6] == 'y', "both halves are the same memory");
+    CircularBufferUnmapMirrored(memory, size);
+}
+
+//random push and pop sizes, so the data keeps crossing the end of the first half; every push and pop must be one piece
+static void testMirroredPushPop(void)
+{
+    CircularBuffer cBuf = CircularBufferCreateMirrored(100);
+    check(cBuf != NULL, "mirrored buffer");
+    if(cBuf == NULL)
+        return;
+    check(CircularBufferIsSPSC(cBuf), "mirrored buffer is lock-free");
+    size_t capacity = CircularBufferGetCapacity(cBuf);
+    uint8_t *chunk = malloc(capacity);
+    uint32_t seed = 3;
+    size_t written = 0, read = 0;
+    long errors = 0, split = 0;
+    for(int i = 0; i < 20000; i++)
+    {
+        size_t length = 1 + nextRandom(&seed) % capacity;
+        for(size_t j = 0; j < length; j++)
+            chunk[j] = streamByte(written + j);
+        written += CircularBufferTryPush(cBuf, chunk, length);
+        
+        const void *data;
+        size_t contiguous;
+        CircularBufferPeekRead(cBuf, 0, &data, &contiguous);
+        split += contiguous != CircularBufferGetDataSize(cBuf);
+        
+        size_t popped = CircularBufferPop(cBuf, 1 + nextRandom(&seed) % capacity, chunk);
+        for(size_t j = 0; j < popped; j++)
+            errors += chunk[j] != streamByte(read + j);
+        read += popped;
+    }
+    printf("mirrored push/pop: %zu bytes through %zu, %ld bad bytes, %ld split runs\n", read, capacity, errors, split);
+    check(errors == 0, "mirrored data arrives intact");
+    check(split == 0, "mirrored data is always in one piece");
+    free(chunk);
+    CircularBufferFree(cBuf);
+}
+
+//a plain byte queue to check the buffer against
+typedef struct {
+    uint8_t *bytes;
+    size_t size;
+    size_t head;
+    size_t count;
+} Model;
+
+static void modelPush(Model *model, uint8_t byte)
+{
+    model->bytes[(model->head + model->count++) % model->size] = byte;
+}
+
+static uint8_t modelAt(const Model *model, size_t i)
+{
+    return model->bytes[(model->head + i) % model->size];
+}
+
+static void modelDrop(Model *model, size_t length)
+{
+    model->head = (model->head + length) % model->size;
+    model->count -= length;
+}
+
+//random Reserve/Commit, Peek/Consume, TryPush and Pop against the model, on one thread
+//a mirrored buffer must hand out all the free space and all the data in one piece
+static void testZeroCopyModel(CircularBuffer cBuf, const char *name, bool mirrored)
+{
+    size_t capacity = CircularBufferGetCapacity(cBuf);
+    Model model = {malloc(capacity), capacity, 0, 0};
+    uint8_t *chunk = malloc(capacity);
+    uint32_t seed = 5;
+    uint8_t next = 0;
+    long errors = 0;
+    for(int i = 0; i < 200000; i++)
+    {
+        size_t length = nextRandom(&seed) % (capacity / 2 + 1);
+        size_t freeLen = capacity - model.count;
+        switch(nextRandom(&seed) % 4)
+        {
+            case 0:
+            {
+                void *ptr;
+                size_t available;
+                bool fits = CircularBufferReserveWrite(cBuf, length, &ptr, &available);
+                errors += fits != (available >= length) || available > freeLen || (mirrored && available != freeLen);
+                size_t written = length < available ? length : available;
+                for(size_t j = 0; j < written; j++)
+                {
+                    ((uint8_t *)ptr)[j] = next;
+                    modelPush(&model, next++);
+                }
+                CircularBufferCommitWrite(cBuf, written);
+                break;
+            }
+            case 1:
+            {
+                const void *ptr;
+                size_t available;
+                CircularBufferPeekRead(cBuf, length, &ptr, &available);
+                errors += available > model.count || (model.count && !available) || (mirrored && available != model.count);
+                size_t peeked = length < available ? length : available;
+                for(size_t j = 0; j < peeked; j++)
+                    errors += ((const uint8_t *)ptr)[j] != modelAt(&model, j);
+                errors += CircularBufferConsumeRead(cBuf, peeked) != peeked;
+                modelDrop(&model, peeked);
+                break;
+            }
+            case 2:
+            {
+                size_t fit = length < freeLen ? length : freeLen;
+                for(size_t j = 0; j < fit; j++)
+                    chunk[j] = next++;
+                errors += CircularBufferTryPush(cBuf, chunk, fit) != fit;
+                for(size_t j = 0; j < fit; j++)
+                    modelPush(&model, chunk[j]);
+                break;
+            }
+            default:
+            {
+                size_t popped = CircularBufferPop(cBuf, length, chunk);
+                errors += popped != (length < model.count ? length : model.count);
+                for(size_t j = 0; j < popped; j++)
+                    errors += chunk[j] != modelAt(&model, j);
+                modelDrop(&model, popped);
+                break;
+            }
+        }
+        errors += CircularBufferGetDataSize(cBuf) != model.count;
+    }
+    printf("zero-copy model, %-8s: %ld errors\n", name, errors);
+    check(errors == 0, "zero-copy calls match the model");
+    free(chunk);
+    free(model.bytes);
+    CircularBufferFree(cBuf);
+}
+
+//10 ms of 48 kHz stereo from a render callback to the SDK: through Push/Pop, copying it in and out, or rendered into the buffer and handed on from there
+static void benchZeroCopy(CircularBuffer cBuf, const char *name)
+{
+    enum { frames = 480, bytes = frames * 4, rounds = 500000 };
+    static int16_t produced[frames * 2], consumed[frames * 2];
+    volatile long sink = 0;
+    long fallbacks = 0;
+    double start = now();
+    for(int i = 0; i < rounds; i++)
+    {
+        for(int j = 0; j < frames * 2; j++)
+            produced[j] = (int16_t)(i + j);
+        CircularBufferTryPush(cBuf, produced, bytes);
+        CircularBufferPop(cBuf, bytes, consumed);
+        for(int j = 0; j < frames * 2; j++)
+            sink += consumed[j];
+    }
+    double copied = (now() - start) / rounds * 1e9;
+    start = now();
+    for(int i = 0; i < rounds; i++)
+    {
+        void *ptr;
+        const void *data;
+        size_t available;
+        int16_t *out = produced;
+        bool reserved = CircularBufferReserveWrite(cBuf, bytes, &ptr, &available);
+        if(reserved)
+            out = ptr;
+        for(int j = 0; j < frames * 2; j++)
+            out[j] = (int16_t)(i + j);
+        if(reserved)
+            CircularBufferCommitWrite(cBuf, bytes);
+        else
+            CircularBufferTryPush(cBuf, produced, bytes);
+        const int16_t *in = consumed;
+        bool peeked = CircularBufferPeekRead(cBuf, bytes, &data, &available);
+        if(peeked)
+            in = data;
+        else
+            CircularBufferPop(cBuf, bytes, consumed);
+        for(int j = 0; j < frames * 2; j++)
+            sink += in[j];
+        if(peeked)
+            CircularBufferConsumeRead(cBuf, bytes);
+        fallbacks += !reserved + !peeked;
+    }
+    double inPlace = (now() - start) / rounds * 1e9;
+    printf("10 ms frame, %-8s: push/pop %.0f ns, reserve/peek %.0f ns, %.3f copies per frame\n", name, copied, inPlace, (double)fallbacks / rounds);
+    CircularBufferFree(cBuf);
+}
+
+int main(void)
+{
+    CircularBuffer mirrored;
+    testSPSCBasics();
+    testMirroredMapping();
+    testMirroredPushPop();
+    testZeroCopyModel(CircularBufferCreate(1000), "plain", false);
+    testZeroCopyModel(CircularBufferCreateSPSC(1000), "spsc", false);
+    if((mirrored = CircularBufferCreateMirrored(1000)))
+        testZeroCopyModel(mirrored, "mirrored", true);
+    testStress(CircularBufferCreateSPSC(19200), "spsc");
+    if((mirrored = CircularBufferCreateMirrored(19200)))
+        testStress(mirrored, "mirrored");
+    benchThroughput(1920);
+    benchThroughput(64);
+    benchPushLatency();
+    benchZeroCopy(CircularBufferCreate(39400), "plain");
+    benchZeroCopy(CircularBufferCreateSPSC(39400), "spsc");
+    if((mirrored = CircularBufferCreateMirrored(39400)))
+        benchZeroCopy(mirrored, "mirrored");
+    printf(gFailures ? "%ld checks failed\n" : "all checks passed\n", gFailures);
+    return gFailures ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+//
+//  AudioChain.cpp
+//  SimpleFilter
+//
+
+#include "AudioChain.hpp"
+#include "AudioKernels.hpp"
+#include "Biquad.hpp"
+#include "Dynamics.hpp"
+#include "PitchShift.hpp"
+#include "Reverb.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace agora {
+    namespace extension {
+        // Fixed gain in dB, for trimming the level between other stages.
+        class GainStage : public AudioStage {
+        public:
+            static std::unique_ptr<AudioStage> create(const JsonValue& spec) {
+                double db = spec.number("db", 0);
+                if (db < -96 || db > 48) {
+                    return nullptr;
+                }
+                std::unique_ptr<GainStage> stage(new GainStage());
+                stage->gain_ = static_cast<float>(std::pow(10.0, db / 20));
+                return stage;
+            }
+
+            void prepare(int /*sampleRateHz*/, int /*channels*/) override {}
+
+            void process(float* data, size_t frames, int channels) override {
+                applyGainF32(data, frames * channels, gain_);
+            }
+
+        private:
+            float gain_ = 1.0f;
+        };
+
+        struct StageType {
+            const char* name;
+            std::unique_ptr<AudioStage> (*create)(const JsonValue& spec);
+        };
+
+        static const StageType kStageTypes[] = {
+            {"gain", GainStage::create},
+            {"eq", BiquadStage::createEq},
+            {"highpass", BiquadStage::createHighPass},
+            {"compressor", CompressorStage::create},
+            {"limiter", LimiterStage::create},
+            {"pitch", PitchShiftStage::create},
+            {"reverb", ReverbStage::create},
+        };
+
+        std::unique_ptr<AudioChain> AudioChain::create(const std::string& config) {
+            std::unique_ptr<AudioChain> chain(new AudioChain());
+            // An empty value clears the chain.
+            if (config.find_first_not_of(" \t\r\n") == std::string::npos) {
+                return chain;
+            }
+            JsonValue root;
+            if (!JsonValue::parse(config, root) || !root.isArray()) {
+                return nullptr;
+            }
+            for (const JsonValue& spec : root.items()) {
+                if (!spec.isObject()) {
+                    return nullptr;
+                }
+                const std::string type = spec.string("type", "");
+                const StageType* found = nullptr;
+                for (const StageType& candidate : kStageTypes) {
+                    if (type == candidate.name) {
+                        found = &candidate;
+                    }
+                }
+                if (!found) {
+                    return nullptr;
+                }
+                std::unique_ptr<AudioStage> stage = found->create(spec);
+                if (!stage) {
+                    return nullptr;
+                }
+                if (!spec.boolean("bypass", false)) {
+                    chain->stages_.push_back(std::move(stage));
+                }
+            }
+            return chain;
+        }
+
+        int AudioChain::latencyFrames() const {
+            int latency = 0;
+            for (const auto& stage : stages_) {
+                latency += stage->latencyFrames();
+            }
+            return latency;
+        }
+
+        void AudioChain::prepare(int sampleRateHz, int channels) {
+            if (sampleRateHz == sampleRateHz_ && channels == channels_) {
+                return;
+            }
+            sampleRateHz_ = sampleRateHz;
+            channels_ = channels;
+            for (const auto& stage : stages_) {
+                stage->prepare(sampleRateHz, channels);
+            }
+        }
+
+        bool AudioChain::preparedFor(int sampleRateHz, int channels) const {
+            return stages_.empty() || (sampleRateHz == sampleRateHz_ && channels == channels_);
+        }
+
+        void AudioChain::continueFrom(AudioChain& previous) {
+            if (previous.sampleRateHz_ != sampleRateHz_ || previous.channels_ != channels_) {
+                return;
+            }
+            for (size_t i = 0; i < std::min(stages_.size(), previous.stages_.size()); i++) {
+                stages_[i]->continueFrom(*previous.stages_[i]);
+            }
+        }
+
+        void AudioChain::process(float* data, size_t frames, int channels) {
+            for (const auto& stage : stages_) {
+                stage->process(data, frames, channels);
+            }
+        }
+    }
+}
@@ -0,0 +1,65 @@
+//
+//  AudioChain.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_AUDIOCHAIN_H
+#define AGORA_AUDIOCHAIN_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Json.hpp"
+
+namespace agora {
+    namespace extension {
+        // One processing step of an AudioChain. Samples are interleaved floats in int16 scale and are
+        // processed in place, so a chain of stages never copies between them.
+        class AudioStage {
+        public:
+            virtual ~AudioStage() {}
+
+            // Sizes the state for a format. Called before the first frame and again whenever the format
+            // changes; this is the only place a stage may allocate.
+            virtual void prepare(int sampleRateHz, int channels) = 0;
+            virtual void process(float* data, size_t frames, int channels) = 0;
+            // Delay the stage adds to the signal, in sample frames.
+            virtual int latencyFrames() const { return 0; }
+            // Called on the audio thread when this stage replaces `previous`, which held the same position in
+            // the running chain and is prepared for the same format. Stages of the same kind can pick up its
+            // state here and glide to their own settings instead of starting from silence.
+            virtual void continueFrom(AudioStage& /*previous*/) {}
+        };
+
+        // An ordered list of stages built from a JSON array of stage objects, each naming its "type" next to
+        // that stage's parameters, e.g. [{"type":"gain","db":-6}]. A stage with "bypass": true is left out.
+        class AudioChain {
+        public:
+            // Returns nullptr if the JSON, a stage type or a stage parameter is invalid.
+            static std::unique_ptr<AudioChain> create(const std::string& config);
+
+            bool empty() const { return stages_.empty(); }
+            int latencyFrames() const;
+
+            // Prepares every stage for the format unless it already is. Allocates, so it is called off the
+            // audio thread.
+            void prepare(int sampleRateHz, int channels);
+            // Whether the chain can process the format; an empty chain can process any.
+            bool preparedFor(int sampleRateHz, int channels) const;
+            // Lets every stage continue from the one at its position in `previous` if both chains are
+            // prepared for the same format.
+            void continueFrom(AudioChain& previous);
+            // Runs the stages in order. The chain must be prepared for the format of the frames.
+            void process(float* data, size_t frames, int channels);
+
+        private:
+            std::vector<std::unique_ptr<AudioStage>> stages_;
+            int sampleRateHz_ = 0;
+            int channels_ = 0;
+        };
+    }
+}
+
+
+#endif //AGORA_AUDIOCHAIN_H
@@ -0,0 +1,315 @@
+//
+//  AudioKernels.cpp
+//  SimpleFilter
+//
+
+#include "AudioKernels.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace agora {
+    namespace extension {
+        // The vector paths clamp to the int16 range first, so the truncating conversion can neither
+        // overflow nor round differently from FloatS16ToS16: adding +-0.5 with the sign of the sample and
+        // truncating towards zero is exactly what the scalar version does.
+#if defined(SF_SIMD_SSE2)
+        // Without the clamp, values past the int16 range still saturate in the pack that follows, and to the
+        // same result as long as they fit in an int32: any gain under 32768 on int16 samples does.
+        static inline __m128i roundUnclampedToS16x4(__m128 v) {
+            v = _mm_add_ps(v, _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(v, _mm_set1_ps(-0.0f))));
+            return _mm_cvttps_epi32(v);
+        }
+
+        static inline __m128i roundToS16x4(__m128 v) {
+            return roundUnclampedToS16x4(_mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f)));
+        }
+
+        template <bool kClamp = true>
+        static inline __m128i scaleRound4(__m128i samples, __m128 gain) {
+            __m128 v = _mm_mul_ps(_mm_cvtepi32_ps(samples), gain);
+            return kClamp ? roundToS16x4(v) : roundUnclampedToS16x4(v);
+        }
+
+        template <bool kClamp = true>
+        static inline void scaleRound8(const int16_t* in, int16_t* out, __m128 gainLo, __m128 gainHi) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+            // Sign-extend by interleaving with the sign mask: one compare instead of a shift per half.
+            __m128i sign = _mm_cmpgt_epi16(_mm_setzero_si128(), s);
+            __m128i a = scaleRound4<kClamp>(_mm_unpacklo_epi16(s, sign), gainLo);
+            __m128i b = scaleRound4<kClamp>(_mm_unpackhi_epi16(s, sign), gainHi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(a, b));
+        }
+#elif defined(SF_SIMD_NEON)
+        static inline int32x4_t roundToS16x4(float32x4_t v) {
+            v = vminq_f32(vmaxq_f32(v, vdupq_n_f32(-32768.0f)), vdupq_n_f32(32767.0f));
+            uint32x4_t bits = vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(0.5f)),
+                                        vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x80000000u)));
+            return vcvtq_s32_f32(vaddq_f32(v, vreinterpretq_f32_u32(bits)));
+        }
+
+        static inline int32x4_t scaleRound4(int16x4_t samples, float32x4_t gain) {
+            return roundToS16x4(vmulq_f32(vcvtq_f32_s32(vmovl_s16(samples)), gain));
+        }
+
+        static inline void scaleRound8(const int16_t* in, int16_t* out, float32x4_t gainLo, float32x4_t gainHi) {
+            int16x8_t s = vld1q_s16(in);
+            int32x4_t a = scaleRound4(vget_low_s16(s), gainLo);
+            int32x4_t b = scaleRound4(vget_high_s16(s), gainHi);
+            vst1q_s16(out, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+        }
+#endif
+
+        void applyGainS16(const int16_t* in, int16_t* out, size_t count, float gain) {
+            size_t i = 0;
+#if defined(SF_SIMD_AVX2)
+            const __m256 g8 = _mm256_set1_ps(gain);
+            const __m256 lo8 = _mm256_set1_ps(-32768.0f);
+            const __m256 hi8 = _mm256_set1_ps(32767.0f);
+            const __m256 half8 = _mm256_set1_ps(0.5f);
+            const __m256 sign8 = _mm256_set1_ps(-0.0f);
+            auto scale8 = [&](__m128i samples) {
+                __m256 v = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(samples)), g8);
+                v = _mm256_min_ps(_mm256_max_ps(v, lo8), hi8);
+                v = _mm256_add_ps(v, _mm256_or_ps(half8, _mm256_and_ps(v, sign8)));
+                return _mm256_cvttps_epi32(v);
+            };
+            for (; i + 16 <= count; i += 16) {
+                __m256i a = scale8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+                __m256i b = scale8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8)));
+                // packs works within 128-bit lanes; the permute restores the sample order.
+                __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), packed);
+            }
+#endif
+#if defined(SF_SIMD_SSE2)
+            const __m128 g = _mm_set1_ps(gain);
+            // Gains this small cannot overflow the conversion, see roundUnclampedToS16x4.
+            if (std::fabs(gain) < 32768.0f) {
+                for (; i + 8 <= count; i += 8) {
+                    scaleRound8<false>(in + i, out + i, g, g);
+                }
+            }
+            for (; i + 8 <= count; i += 8) {
+                scaleRound8(in + i, out + i, g, g);
+            }
+#elif defined(SF_SIMD_NEON)
+            const float32x4_t g = vdupq_n_f32(gain);
+            for (; i + 8 <= count; i += 8) {
+                scaleRound8(in + i, out + i, g, g);
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = FloatS16ToS16(in[i] * gain);
+            }
+        }
+
+        // One block of eight samples per iteration; every lane carries the gain of its own sample frame, so
+        // the ramp costs one extra add or multiply per four samples. Two blocks are interleaved so the gain
+        // updates do not form one long dependency chain. kClamp is false when the ramp's gains are known to
+        // stay small enough to leave the clamp out.
+        template <bool kExponential, bool kClamp>
+        static void rampBlocks(const int16_t* in, int16_t* out, size_t count, float (&lanes)[16], float delta) {
+            size_t i = 0;
+#if defined(SF_SIMD_SSE2)
+            __m128 a0 = _mm_loadu_ps(lanes), a1 = _mm_loadu_ps(lanes + 4);
+            __m128 b0 = _mm_loadu_ps(lanes + 8), b1 = _mm_loadu_ps(lanes + 12);
+            const __m128 d = _mm_set1_ps(delta);
+            auto advance = [&](__m128 v) { return kExponential ? _mm_mul_ps(v, d) : _mm_add_ps(v, d); };
+            for (; i + 16 <= count; i += 16) {
+                scaleRound8<kClamp>(in + i, out + i, a0, a1);
+                scaleRound8<kClamp>(in + i + 8, out + i + 8, b0, b1);
+                a0 = advance(a0);
+                a1 = advance(a1);
+                b0 = advance(b0);
+                b1 = advance(b1);
+            }
+            _mm_storeu_ps(lanes, a0);
+            _mm_storeu_ps(lanes + 4, a1);
+            _mm_storeu_ps(lanes + 8, b0);
+            _mm_storeu_ps(lanes + 12, b1);
+#elif defined(SF_SIMD_NEON)
+            float32x4_t a0 = vld1q_f32(lanes), a1 = vld1q_f32(lanes + 4);
+            float32x4_t b0 = vld1q_f32(lanes + 8), b1 = vld1q_f32(lanes + 12);
+            const float32x4_t d = vdupq_n_f32(delta);
+            auto advance = [&](float32x4_t v) { return kExponential ? vmulq_f32(v, d) : vaddq_f32(v, d); };
+            for (; i + 16 <= count; i += 16) {
+                scaleRound8(in + i, out + i, a0, a1);
+                scaleRound8(in + i + 8, out + i + 8, b0, b1);
+                a0 = advance(a0);
+                a1 = advance(a1);
+                b0 = advance(b0);
+                b1 = advance(b1);
+            }
+            vst1q_f32(lanes, a0);
+            vst1q_f32(lanes + 4, a1);
+            vst1q_f32(lanes + 8, b0);
+            vst1q_f32(lanes + 12, b1);
+#else
+            for (; i + 16 <= count; i += 16) {
+                for (int l = 0; l < 16; l++) {
+                    out[i + l] = FloatS16ToS16(in[i + l] * lanes[l]);
+                    lanes[l] = kExponential ? lanes[l] * delta : lanes[l] + delta;
+                }
+            }
+#endif
+            for (size_t l = 0; i < count; i++, l++) {
+                out[i] = FloatS16ToS16(in[i] * lanes[l]);
+            }
+        }
+
+        void prepareGainRamp(GainRampLanes& ramp, int channels, float gain, float step, bool exponential, float end) {
+            ramp.channels = channels;
+            ramp.step = step;
+            ramp.exponential = exponential;
+            ramp.lanes[0] = gain;
+            ramp.clamp = true;
+            // Other channel counts do not map onto the lanes and ramp per frame from the first one instead.
+            if (channels <= 0 || 16 % channels != 0) {
+                return;
+            }
+            // Channel counts that divide 16 are powers of two, so a lane's frame is a shift away.
+            int shift = 0;
+            while ((1 << shift) < channels) {
+                shift++;
+            }
+            const int framesPerBlock = 16 >> shift;
+            float frameGains[16];
+            float frameGain = gain;
+            ramp.delta = exponential ? 1.0f : step * framesPerBlock;
+            for (int f = 0; f < framesPerBlock; f++) {
+                frameGains[f] = frameGain;
+                frameGain = exponential ? frameGain * step : gain + step * (f + 1);
+                ramp.delta = exponential ? ramp.delta * step : ramp.delta;
+            }
+            for (int l = 0; l < 16; l++) {
+                ramp.lanes[l] = frameGains[l >> shift];
+            }
+            // Ramps are monotonic, so their two ends bound every gain in between; the margin covers the drift
+            // of the repeated steps and the block the lanes may run past the end.
+            ramp.clamp = !(std::max(std::fabs(gain), std::fabs(end)) < 32768.0f);
+        }
+
+        float applyGainRampS16(const int16_t* in, int16_t* out, size_t frames, GainRampLanes& ramp) {
+            const int channels = ramp.channels;
+            if (channels <= 0 || 16 % channels != 0) {
+                float gain = ramp.lanes[0];
+                for (size_t f = 0; f < frames; f++) {
+                    applyGainS16(in + f * channels, out + f * channels, channels, gain);
+                    gain = ramp.exponential ? gain * ramp.step : gain + ramp.step;
+                }
+                ramp.lanes[0] = gain;
+                return gain;
+            }
+            const size_t count = frames * channels;
+            if (ramp.exponential) {
+                ramp.clamp ? rampBlocks<true, true>(in, out, count, ramp.lanes, ramp.delta)
+                           : rampBlocks<true, false>(in, out, count, ramp.lanes, ramp.delta);
+            } else {
+                ramp.clamp ? rampBlocks<false, true>(in, out, count, ramp.lanes, ramp.delta)
+                           : rampBlocks<false, false>(in, out, count, ramp.lanes, ramp.delta);
+            }
+            // Frames after the last whole block took the first lanes of the next one: move its other lanes to
+            // the front and follow them with the block after, so the next call starts at the right frame.
+            const size_t used = count % 16;
+            if (used != 0) {
+                float next[16];
+                for (size_t l = 0; l < 16; l++) {
+                    const float lane = ramp.lanes[(l + used) % 16];
+                    if (l + used < 16) {
+                        next[l] = lane;
+                    } else {
+                        next[l] = ramp.exponential ? lane * ramp.delta : lane + ramp.delta;
+                    }
+                }
+                std::copy(next, next + 16, ramp.lanes);
+            }
+            return ramp.lanes[0];
+        }
+
+        void s16ToFloat(const int16_t* in, float* out, size_t count) {
+            size_t i = 0;
+#if defined(SF_SIMD_SSE2)
+            for (; i + 8 <= count; i += 8) {
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                _mm_storeu_ps(out + i, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)));
+                _mm_storeu_ps(out + i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16)));
+            }
+#elif defined(SF_SIMD_NEON)
+            for (; i + 8 <= count; i += 8) {
+                int16x8_t s = vld1q_s16(in + i);
+                vst1q_f32(out + i, vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))));
+                vst1q_f32(out + i + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))));
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = in[i];
+            }
+        }
+
+        void floatToS16(const float* in, int16_t* out, size_t count) {
+            size_t i = 0;
+#if defined(SF_SIMD_SSE2)
+            for (; i + 8 <= count; i += 8) {
+                __m128i a = roundToS16x4(_mm_loadu_ps(in + i));
+                __m128i b = roundToS16x4(_mm_loadu_ps(in + i + 4));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(a, b));
+            }
+#elif defined(SF_SIMD_NEON)
+            for (; i + 8 <= count; i += 8) {
+                int32x4_t a = roundToS16x4(vld1q_f32(in + i));
+                int32x4_t b = roundToS16x4(vld1q_f32(in + i + 4));
+                vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+            }
+#endif
+            for (; i < count; i++) {
+                out[i] = FloatS16ToS16(in[i]);
+            }
+        }
+
+        void planesToS16(const float* left, const float* right, int16_t* out, size_t frames) {
+            size_t i = 0;
+#if defined(SF_SIMD_SSE2)
+            for (; i + 8 <= frames; i += 8) {
+                __m128i l = _mm_packs_epi32(roundToS16x4(_mm_loadu_ps(left + i)), roundToS16x4(_mm_loadu_ps(left + i + 4)));
+                __m128i r = _mm_packs_epi32(roundToS16x4(_mm_loadu_ps(right + i)), roundToS16x4(_mm_loadu_ps(right + i + 4)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_unpacklo_epi16(l, r));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+            }
+#elif defined(SF_SIMD_NEON)
+            for (; i + 4 <= frames; i += 4) {
+                int16x4x2_t pair = {{vqmovn_s32(roundToS16x4(vld1q_f32(left + i))), vqmovn_s32(roundToS16x4(vld1q_f32(right + i)))}};
+                vst2_s16(out + 2 * i, pair);
+            }
+#endif
+            for (; i < frames; i++) {
+                out[2 * i] = FloatS16ToS16(left[i]);
+                out[2 * i + 1] = FloatS16ToS16(right[i]);
+            }
+        }
+
+        void applyGainF32(float* data, size_t count, float gain) {
+            using namespace simd;
+            size_t i = 0;
+            const F32x4 g = splatF(gain);
+            for (; i + 4 <= count; i += 4) {
+                storeF(data + i, mul(loadF(data + i), g));
+            }
+            for (; i < count; i++) {
+                data[i] *= gain;
+            }
+        }
+
+        float applyGainRampF32(float* data, size_t frames, int channels, float gain, float step, bool exponential) {
+            // Ramps last a few frames at most, so this stays scalar.
+            for (size_t f = 0; f < frames; f++) {
+                for (int c = 0; c < channels; c++) {
+                    data[f * channels + c] *= gain;
+                }
+                gain = exponential ? gain * step : gain + step;
+            }
+            return gain;
+        }
+    }
+}
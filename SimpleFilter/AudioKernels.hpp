@@ -0,0 +1,63 @@
+//
+//  AudioKernels.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_AUDIOKERNELS_H
+#define AGORA_AUDIOKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace agora {
+    namespace extension {
+        // Rounds a float in int16 scale to the nearest int16, halves away from zero, saturating.
+        // The vector kernels below reproduce it bit for bit.
+        inline int16_t FloatS16ToS16(float v) {
+            static const float kMaxRound = (std::numeric_limits<int16_t>::max)() - 0.5f;
+            static const float kMinRound = (std::numeric_limits<int16_t>::min)() + 0.5f;
+            if (v > 0) {
+                return v >= kMaxRound ? (std::numeric_limits<int16_t>::max)() : static_cast<int16_t>(v + 0.5f);
+            }
+            return v <= kMinRound ? (std::numeric_limits<int16_t>::min)() : static_cast<int16_t>(v - 0.5f);
+        }
+
+        // out[i] = FloatS16ToS16(in[i] * gain). `in` and `out` may be the same buffer.
+        void applyGainS16(const int16_t* in, int16_t* out, size_t count, float gain);
+
+        // A gain ramp in progress: the gains of the next sixteen samples and what moves them one block on.
+        // Set up once per ramp, so that the calls applying it only carry on from where the last one stopped.
+        struct GainRampLanes {
+            float lanes[16];
+            float delta;
+            float step;
+            int channels;
+            bool exponential;
+            bool clamp;
+        };
+
+        // Starts a ramp from `gain` to `end`: `step` is added to the gain per sample frame, or multiplies it
+        // when `exponential`.
+        void prepareGainRamp(GainRampLanes& ramp, int channels, float gain, float step, bool exponential, float end);
+
+        // Applies the next `frames` frames of the ramp to interleaved audio with the channel count it was
+        // prepared for; all channels of a frame get the same gain. Returns the gain of the frame after the last
+        // one. `in` and `out` may be the same buffer.
+        float applyGainRampS16(const int16_t* in, int16_t* out, size_t frames, GainRampLanes& ramp);
+
+        // Conversions for float processing, which keeps samples in int16 scale: s16ToFloat is exact and
+        // floatToS16 rounds and saturates like FloatS16ToS16.
+        void s16ToFloat(const int16_t* in, float* out, size_t count);
+        void floatToS16(const float* in, int16_t* out, size_t count);
+        // floatToS16 for two planes of `frames` samples into interleaved stereo.
+        void planesToS16(const float* left, const float* right, int16_t* out, size_t frames);
+
+        // In-place float counterparts of applyGainS16 and applyGainRampS16.
+        void applyGainF32(float* data, size_t count, float gain);
+        float applyGainRampF32(float* data, size_t frames, int channels, float gain, float step, bool exponential);
+    }
+}
+
+
+#endif //AGORA_AUDIOKERNELS_H
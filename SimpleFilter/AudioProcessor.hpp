@@ -9,9 +9,18 @@
 #include <string>
 #include <mutex>
 #include <vector>
+#include <atomic>
+#include <memory>
 #include <AgoraRtcKit/AgoraRefPtr.h>
 #include "AgoraRtcKit/NGIAgoraMediaNode.h"
 #include "AgoraRtcKit/AgoraMediaBase.h"
+#include "AudioChain.hpp"
+#include "GainRamp.hpp"
+#include "LoudnessMeter.hpp"
+#include "Semaphore.hpp"
+#include "SpectrumAnalyzer.hpp"
+#include "VoiceActivity.hpp"
+#include "external_thread_pool.h"
 
 namespace agora {
     namespace extension {
@@ -22,19 +31,111 @@ namespace agora {
 
             void dataCallback(const char* data);
 
-            void setVolume(int volume) { volume_ = volume / 100.0f; }
+            // Handles the audio filter properties. Returns -1 for a bad value, -2 for an unknown key.
+            int setProperty(const std::string& key, const std::string& value);
+            // Read-only properties: "latency_ms", the delay the DSP chain adds, from the voice activity
+            // detector "speaking" and "noise_floor_db", "loudness", the meter's latest reading as JSON, and
+            // "spectrum" (bands only) or "spectrum_bins", the analyzer's latest spectrum as JSON.
+            // Returns -2 for an unknown key.
+            int getProperty(const std::string& key, std::string& value) const;
 
-            int setExtensionControl(agora::agora_refptr<rtc::IExtensionVideoFilter::Control> control){
+            void setVolume(int volume) { gain_.setTarget(volume / 100.0f); }
+
+            // Volume changes glide over `ms` milliseconds; 0 switches ramps off.
+            void setVolumeRampMs(int ms) { gain_.setRampMs(ms); }
+            void setVolumeRampShape(GainRamp::Shape shape) { gain_.setShape(shape); }
+
+            // Replaces the DSP chain that runs after the volume, see AudioChain for the format; an empty
+            // config removes it. The chain is built and prepared here, or on the chain worker if the format
+            // is not known yet or changes later, and handed to the audio thread, which crossfades from the
+            // old chain's output to the new one over one frame. Until a chain prepared for the current
+            // format arrives, the frames skip the chain. Returns -1 for an invalid config.
+            int setChain(const std::string& config);
+
+            // Voice activity: "vad" posts a "vad" event when speech starts or stops, at most once per
+            // "vad_event_interval_ms"; "noise_gate" attenuates the frames without speech by
+            // "noise_gate_depth_db". Either one runs the detector, which looks at the frames as captured.
+            void setVoiceEvents(bool enabled);
+            void setNoiseGate(bool enabled);
+
+            // "loudness_meter" measures the processed frames, see LoudnessMeter; "loudness_reset" restarts
+            // the integrated loudness and the maximum true peak.
+            void setLoudnessMeter(bool enabled) { loudnessMeter_ = enabled; }
+
+            // "spectrum" analyses the processed frames, see SpectrumAnalyzer, configured by "spectrum_size",
+            // "spectrum_hop" and "spectrum_bands". Switching it on starts from a fresh frame.
+            void setSpectrum(bool enabled);
+
+            int setExtensionControl(agora::agora_refptr<rtc::IAudioFilterV2::Control> control){
                 control_ = control;
                 return 0;
             };
         protected:
-            ~AdjustVolumeAudioProcessor() {}
+            ~AdjustVolumeAudioProcessor();
         private:
-            static int16_t FloatS16ToS16(float v);
-        private:
-            std::atomic<float> volume_ = {1.0f};
-            agora::agora_refptr<rtc::IExtensionVideoFilter::Control> control_;
+            using Samples = media::base::AudioPcmFrame;
+            enum { kRetiredSlots = 4 };
+
+            // Runs chain_ if it is prepared for the format.
+            void runChain(float* data, size_t frames, int channels, int sampleRateHz);
+            // The chain worker's loop, until stopChains_: rebuilds the config for the format the audio thread
+            // last saw when it asks for it, and frees the chains it retired.
+            void serveChains();
+            void startChainWorker();
+            // For the audio thread: a slot that stays free until it fills it, or nullptr if all are taken.
+            std::atomic<AudioChain*>* freeRetiredSlot();
+            void requestChainRebuild();
+            // Frees the chains the audio thread retired; not on the audio thread.
+            void collectRetired();
+            // Runs the detector on the input frame, steers the gate and posts the throttled event.
+            void detectVoice(const int16_t* data, size_t frames, int channels, int sampleRateHz);
+            // Feeds the processed frame to the loudness meter and the spectrum analyzer when they are on: the
+            // int16 frame as published, or the float one just before it is rounded, so levels the
+            // conversion clips still show above 0 dB.
+            template <typename Sample>
+            void measure(const Sample* data, size_t frames, int channels, int sampleRateHz);
+
+            GainRamp gain_;
+            VoiceActivityDetector vad_;
+            GainRamp gate_;
+            std::atomic<bool> voiceEvents_ = {false};
+            std::atomic<bool> noiseGate_ = {false};
+            std::atomic<float> gateFloor_ = {0.0316f};
+            std::atomic<int> eventIntervalMs_ = {200};
+            LoudnessMeter meter_;
+            std::atomic<bool> loudnessMeter_ = {false};
+            SpectrumAnalyzer spectrum_;
+            std::atomic<bool> spectrumEnabled_ = {false};
+            // A built chain waiting for the audio thread, and the ones it replaced or could not use, which
+            // only the audio thread fills and the setter and the chain worker free.
+            std::atomic<AudioChain*> pendingChain_ = {nullptr};
+            std::atomic<AudioChain*> retiredChains_[kRetiredSlots] = {};
+            // Last format seen by the audio thread, so new chains are prepared before they are handed over.
+            std::atomic<int> sampleRateHz_ = {0};
+            std::atomic<int> channels_ = {0};
+            std::atomic<int> latencyFrames_ = {0};
+
+            // Audio thread only.
+            std::unique_ptr<AudioChain> chain_;
+            float work_[Samples::kMaxDataSizeSamples];
+            float fade_[Samples::kMaxDataSizeSamples];
+            bool postedSpeaking_ = false;
+            int64_t sinceEvent_ = 0;
+            char event_[128];
+            agora::agora_refptr<rtc::IAudioFilterV2::Control> control_;
+
+            // The chain worker. The config and its generation are kept under chainMutex_ so a rebuild
+            // for an older config is dropped.
+            std::mutex chainMutex_;
+            // Posted by the audio thread when it retires a chain or asks for a rebuild, and to stop.
+            Semaphore chainWake_;
+            std::string chainConfig_;
+            uint64_t chainGeneration_ = 0;
+            bool stopChains_ = false;
+            std::atomic<bool> rebuildChain_ = {false};
+            int chainInvoker_ = -1;
+            // Last, so its thread is joined before anything it uses goes away.
+            std::unique_ptr<ThreadPool> chainPool_;
         };
     }
 }
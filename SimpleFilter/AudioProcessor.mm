@@ -3,31 +3,383 @@
 //
 
 #include "AudioProcessor.hpp"
-#include <chrono>
+#include "AudioKernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 
 
 namespace agora {
     namespace extension {
-        using limits_int16 = std::numeric_limits<int16_t>;
-        int16_t AdjustVolumeAudioProcessor::FloatS16ToS16(float v) {
-            static const float kMaxRound = (limits_int16::max)() - 0.5f;
-            static const float kMinRound = (limits_int16::min)() + 0.5f;
-            if (v > 0) {
-                return v >= kMaxRound ? (limits_int16::max)() : static_cast<int16_t>(v + 0.5f);
+        // The gate opens quickly so onsets are kept and closes slowly so word endings are not chopped.
+        static const int kGateOpenMs = 5;
+        static const int kGateCloseMs = 150;
+
+        static bool parseSwitch(const std::string& value, bool& enabled) {
+            if (value == "true" || value == "1") {
+                enabled = true;
+            } else if (value == "false" || value == "0") {
+                enabled = false;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        AdjustVolumeAudioProcessor::~AdjustVolumeAudioProcessor() {
+            {
+                std::lock_guard<std::mutex> lock(chainMutex_);
+                stopChains_ = true;
+            }
+            chainWake_.post();
+            if (chainInvoker_ >= 0) {
+                chainPool_->UnregisterInvoker(chainInvoker_);
+            }
+            // Joins the worker, which may still be publishing a chain.
+            chainPool_.reset();
+            delete pendingChain_.exchange(nullptr);
+            collectRetired();
+        }
+
+        int AdjustVolumeAudioProcessor::setProperty(const std::string& key, const std::string& value) {
+            if (key == "volume") {
+                setVolume(atoi(value.c_str()));
+            } else if (key == "volume_ramp_ms") {
+                setVolumeRampMs(atoi(value.c_str()));
+            } else if (key == "volume_ramp") {
+                setVolumeRampShape(value == "exponential" ? GainRamp::kExponential : GainRamp::kLinear);
+            } else if (key == "audio_chain") {
+                return setChain(value);
+            } else if (key == "vad" || key == "noise_gate") {
+                bool enabled = false;
+                if (!parseSwitch(value, enabled)) {
+                    return -1;
+                }
+                if (key == "vad") {
+                    setVoiceEvents(enabled);
+                } else {
+                    setNoiseGate(enabled);
+                }
+            } else if (key == "loudness_meter") {
+                bool enabled = false;
+                if (!parseSwitch(value, enabled)) {
+                    return -1;
+                }
+                setLoudnessMeter(enabled);
+            } else if (key == "loudness_reset") {
+                meter_.reset();
+            } else if (key == "spectrum") {
+                bool enabled = false;
+                if (!parseSwitch(value, enabled)) {
+                    return -1;
+                }
+                setSpectrum(enabled);
+            } else if (key == "spectrum_size") {
+                if (!spectrum_.setSize(atoi(value.c_str()))) {
+                    return -1;
+                }
+            } else if (key == "spectrum_hop") {
+                const int hop = atoi(value.c_str());
+                if (hop < 0) {
+                    return -1;
+                }
+                spectrum_.setHop(hop);
+            } else if (key == "spectrum_bands") {
+                if (!spectrum_.setBands(atoi(value.c_str()))) {
+                    return -1;
+                }
+            } else if (key == "vad_threshold_db") {
+                vad_.setThresholdDb(static_cast<float>(atof(value.c_str())));
+            } else if (key == "vad_hangover_ms") {
+                vad_.setHangoverMs(atoi(value.c_str()));
+            } else if (key == "vad_event_interval_ms") {
+                eventIntervalMs_ = std::max(atoi(value.c_str()), 0);
+            } else if (key == "noise_gate_depth_db") {
+                const double depthDb = atof(value.c_str());
+                if (depthDb > 0) {
+                    return -1;
+                }
+                gateFloor_ = static_cast<float>(std::pow(10.0, depthDb / 20));
+            } else {
+                return -2;
+            }
+            return 0;
+        }
+
+        int AdjustVolumeAudioProcessor::getProperty(const std::string& key, std::string& value) const {
+            if (key == "latency_ms") {
+                const int sampleRateHz = sampleRateHz_.load();
+                char text[32];
+                snprintf(text, sizeof(text), "%.2f", sampleRateHz > 0 ? latencyFrames_.load() * 1000.0 / sampleRateHz : 0.0);
+                value = text;
+                return 0;
+            }
+            if (key == "speaking") {
+                value = vad_.speaking() ? "true" : "false";
+                return 0;
+            }
+            if (key == "noise_floor_db") {
+                char text[32];
+                snprintf(text, sizeof(text), "%.1f", vad_.noiseFloorDb());
+                value = text;
+                return 0;
+            }
+            if (key == "loudness") {
+                value = meter_.read().toJson();
+                return 0;
+            }
+            if (key == "spectrum" || key == "spectrum_bins") {
+                value = spectrum_.read().toJson(key == "spectrum_bins");
+                return 0;
+            }
+            return -2;
+        }
+
+        void AdjustVolumeAudioProcessor::setVoiceEvents(bool enabled) {
+            if (enabled && !voiceEvents_.load() && !noiseGate_.load()) {
+                vad_.reset();
+            }
+            voiceEvents_ = enabled;
+        }
+
+        void AdjustVolumeAudioProcessor::setNoiseGate(bool enabled) {
+            if (enabled && !voiceEvents_.load() && !noiseGate_.load()) {
+                vad_.reset();
+            }
+            gate_.setShape(GainRamp::kExponential);
+            noiseGate_ = enabled;
+        }
+
+        void AdjustVolumeAudioProcessor::setSpectrum(bool enabled) {
+            if (enabled && !spectrumEnabled_.load()) {
+                spectrum_.reset();
+            }
+            spectrumEnabled_ = enabled;
+        }
+
+        int AdjustVolumeAudioProcessor::setChain(const std::string& config) {
+            std::unique_ptr<AudioChain> chain = AudioChain::create(config);
+            if (!chain) {
+                return -1;
+            }
+            const int sampleRateHz = sampleRateHz_.load();
+            const int channels = channels_.load();
+            if (sampleRateHz > 0 && channels > 0) {
+                chain->prepare(sampleRateHz, channels);
+            }
+            collectRetired();
+            AudioChain* unused = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(chainMutex_);
+                chainConfig_ = config;
+                chainGeneration_++;
+                if (!chain->empty()) {
+                    startChainWorker();
+                }
+                unused = pendingChain_.exchange(chain.release(), std::memory_order_acq_rel);
+            }
+            // A chain the audio thread has not picked up yet was never used and can go right away.
+            delete unused;
+            return 0;
+        }
+
+        void AdjustVolumeAudioProcessor::startChainWorker() {
+            if (chainPool_) {
+                return;
+            }
+            chainPool_.reset(new ThreadPool(1, true));
+            chainInvoker_ = chainPool_->RegisterInvoker("thread_audiofilter_chain");
+            if (chainInvoker_ >= 0) {
+                chainPool_->PostTask(chainInvoker_, [this] { serveChains(); });
+            }
+        }
+
+        void AdjustVolumeAudioProcessor::serveChains() {
+            // The last build, so the requests the audio thread keeps making until it picks the chain up, or
+            // after a config failed to build, do not build it again.
+            uint64_t builtGeneration = 0;
+            int builtRateHz = 0;
+            int builtChannels = 0;
+            bool buildFailed = false;
+            std::unique_lock<std::mutex> lock(chainMutex_);
+            while (!stopChains_) {
+                collectRetired();
+                const int sampleRateHz = sampleRateHz_.load();
+                const int channels = channels_.load();
+                const bool built = builtGeneration == chainGeneration_ && builtRateHz == sampleRateHz
+                    && builtChannels == channels && (buildFailed || pendingChain_.load());
+                if (!rebuildChain_.exchange(false, std::memory_order_acq_rel) || built) {
+                    // Until the audio thread retires a chain or asks for a rebuild, or until stop.
+                    lock.unlock();
+                    chainWake_.wait();
+                    lock.lock();
+                    continue;
+                }
+                const std::string config = chainConfig_;
+                const uint64_t generation = chainGeneration_;
+                lock.unlock();
+                std::unique_ptr<AudioChain> chain = AudioChain::create(config);
+                if (chain) {
+                    chain->prepare(sampleRateHz, channels);
+                }
+                AudioChain* unused = nullptr;
+                lock.lock();
+                builtGeneration = generation;
+                builtRateHz = sampleRateHz;
+                builtChannels = channels;
+                buildFailed = !chain;
+                if (chain && generation == chainGeneration_) {
+                    unused = pendingChain_.exchange(chain.release(), std::memory_order_acq_rel);
+                }
+                lock.unlock();
+                delete unused;
+                chain.reset();
+                lock.lock();
+            }
+        }
+
+        std::atomic<AudioChain*>* AdjustVolumeAudioProcessor::freeRetiredSlot() {
+            for (auto& slot : retiredChains_) {
+                if (!slot.load(std::memory_order_acquire)) {
+                    return &slot;
+                }
+            }
+            return nullptr;
+        }
+
+        void AdjustVolumeAudioProcessor::requestChainRebuild() {
+            if (!rebuildChain_.exchange(true, std::memory_order_acq_rel)) {
+                chainWake_.post();
+            }
+        }
+
+        void AdjustVolumeAudioProcessor::collectRetired() {
+            for (auto& slot : retiredChains_) {
+                delete slot.exchange(nullptr, std::memory_order_acq_rel);
             }
-            return v <= kMinRound ? (limits_int16::min)() : static_cast<int16_t>(v - 0.5f);
         }
 
         int AdjustVolumeAudioProcessor::processFrame(const media::base::AudioPcmFrame& inAudioPcmFrame,
                                                       media::base::AudioPcmFrame& adaptedPcmFrame) {
 //            PRINTF_ERROR("adaptAudioFrame %f", volume_.load());
-            size_t length = inAudioPcmFrame.samples_per_channel_ * inAudioPcmFrame.num_channels_;
-            for (int idx = 0; idx < length; idx++) {
-                adaptedPcmFrame.data_[idx] = FloatS16ToS16(inAudioPcmFrame.data_[idx] * volume_);
+            const size_t frames = inAudioPcmFrame.samples_per_channel_;
+            const int channels = static_cast<int>(inAudioPcmFrame.num_channels_);
+            const int sampleRateHz = inAudioPcmFrame.sample_rate_hz_;
+            const size_t count = frames * channels;
+            sampleRateHz_.store(sampleRateHz, std::memory_order_relaxed);
+            channels_.store(channels, std::memory_order_relaxed);
+            detectVoice(inAudioPcmFrame.data_, frames, channels, sampleRateHz);
+
+            if (count > Samples::kMaxDataSizeSamples
+                || ((!chain_ || chain_->empty()) && !pendingChain_.load(std::memory_order_relaxed) && gate_.isUnity())) {
+                // Only the volume, which rounds once either way: keep the int16 path.
+                latencyFrames_.store(0, std::memory_order_relaxed);
+                gain_.process(inAudioPcmFrame.data_, adaptedPcmFrame.data_, frames, channels, sampleRateHz);
+                measure(adaptedPcmFrame.data_, frames, channels, sampleRateHz);
+                return 0;
+            }
+
+            // Nothing is freed on this thread: a chain it is done with goes to a retired slot, and a pending
+            // chain waits until one is free. Only this thread fills the slots, so the one found stays free.
+            std::atomic<AudioChain*>* retired = freeRetiredSlot();
+            AudioChain* next = retired ? pendingChain_.exchange(nullptr, std::memory_order_acq_rel) : nullptr;
+            if (next && !next->preparedFor(sampleRateHz, channels)) {
+                // Built before the first frame or for a format that has changed since.
+                retired->store(next, std::memory_order_release);
+                chainWake_.post();
+                next = nullptr;
+                requestChainRebuild();
+            } else if (!next && chain_ && !chain_->preparedFor(sampleRateHz, channels)) {
+                requestChainRebuild();
+            }
+            // The SDK hands the filter 16-bit frames only, so these are the only conversions of the frame:
+            // the volume, the gate, every stage and the meters work on work_ in float, without rounding or
+            // clipping in between.
+            s16ToFloat(inAudioPcmFrame.data_, work_, count);
+            gain_.process(work_, frames, channels, sampleRateHz);
+            // Gated before the chain, so a compressor there does not bring the noise back up.
+            gate_.process(work_, frames, channels, sampleRateHz);
+            if (next) {
+                // Run both chains on this frame and crossfade, so neither the new stages starting from empty
+                // state nor the level difference between the chains is heard as a click.
+                if (chain_) {
+                    next->continueFrom(*chain_);
+                }
+                memcpy(fade_, work_, count * sizeof(float));
+                runChain(fade_, frames, channels, sampleRateHz);
+                AudioChain* previous = chain_.release();
+                chain_.reset(next);
+                runChain(work_, frames, channels, sampleRateHz);
+                const float step = 1.0f / frames;
+                for (size_t f = 0; f < frames; f++) {
+                    const float t = (f + 0.5f) * step;
+                    for (int c = 0; c < channels; c++) {
+                        float& sample = work_[f * channels + c];
+                        sample = fade_[f * channels + c] + (sample - fade_[f * channels + c]) * t;
+                    }
+                }
+                if (previous) {
+                    retired->store(previous, std::memory_order_release);
+                    chainWake_.post();
+                }
+            } else {
+                runChain(work_, frames, channels, sampleRateHz);
             }
+            measure(work_, frames, channels, sampleRateHz);
+            floatToS16(work_, adaptedPcmFrame.data_, count);
+            latencyFrames_.store(chain_ && chain_->preparedFor(sampleRateHz, channels) ? chain_->latencyFrames() : 0,
+                                 std::memory_order_relaxed);
             return 0;
         }
 
+        void AdjustVolumeAudioProcessor::runChain(float* data, size_t frames, int channels, int sampleRateHz) {
+            if (chain_ && chain_->preparedFor(sampleRateHz, channels)) {
+                chain_->process(data, frames, channels);
+            }
+        }
+
+        void AdjustVolumeAudioProcessor::detectVoice(const int16_t* data, size_t frames, int channels, int sampleRateHz) {
+            const bool events = voiceEvents_.load(std::memory_order_relaxed);
+            const bool gate = noiseGate_.load(std::memory_order_relaxed);
+            if (!events && !gate) {
+                if (gate_.target() != 1.0f) {
+                    gate_.setRampMs(kGateOpenMs);
+                    gate_.setTarget(1.0f);
+                }
+                return;
+            }
+            vad_.process(data, frames, channels, sampleRateHz);
+            const bool speaking = vad_.speaking();
+
+            const float target = gate && !speaking ? gateFloor_.load(std::memory_order_relaxed) : 1.0f;
+            if (target != gate_.target()) {
+                gate_.setRampMs(target == 1.0f ? kGateOpenMs : kGateCloseMs);
+                gate_.setTarget(target);
+            }
+
+            // Changes inside the interval are held back, and only the latest state is reported.
+            sinceEvent_ += frames;
+            if (events && control_ && speaking != postedSpeaking_
+                && sinceEvent_ * 1000 >= static_cast<int64_t>(eventIntervalMs_.load(std::memory_order_relaxed)) * sampleRateHz) {
+                snprintf(event_, sizeof(event_), "{\"speaking\":%s,\"level_db\":%.1f,\"noise_floor_db\":%.1f}",
+                         speaking ? "true" : "false", vad_.levelDb(), vad_.noiseFloorDb());
+                control_->postEvent("vad", event_);
+                postedSpeaking_ = speaking;
+                sinceEvent_ = 0;
+            }
+        }
+
+        template <typename Sample>
+        void AdjustVolumeAudioProcessor::measure(const Sample* data, size_t frames, int channels, int sampleRateHz) {
+            if (loudnessMeter_.load(std::memory_order_relaxed)) {
+                meter_.process(data, frames, channels, sampleRateHz);
+            }
+            if (spectrumEnabled_.load(std::memory_order_relaxed)) {
+                spectrum_.process(data, frames, channels, sampleRateHz);
+            }
+        }
+
         void AdjustVolumeAudioProcessor::dataCallback(const char* data){
             if (control_) {
                 control_->postEvent("volume", data);
@@ -0,0 +1,145 @@
+//
+//  BackgroundImage.cpp
+//  SimpleFilter
+//
+
+#include "BackgroundImage.hpp"
+#include "ImageScaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace agora {
+    namespace extension {
+        static size_t i420Size(int width, int height) {
+            return static_cast<size_t>(width) * height
+                + 2 * static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+        }
+
+        static bool wrapPacked(uint8_t* data, int width, int height, I420View& view) {
+            agora::rtc::VideoFrameData frame;
+            frame.type = agora::rtc::VideoFrameData::Type::kRawPixels;
+            frame.pixels.format = agora::rtc::RawPixelBuffer::Format::kI420;
+            frame.pixels.data = data;
+            frame.pixels.size = 0;
+            frame.width = width;
+            frame.height = height;
+            return wrapI420(frame, view);
+        }
+
+        bool parseColor(const std::string& text, int& r, int& g, int& b) {
+            if (!text.empty() && text[0] == '#') {
+                if (text.size() != 7) {
+                    return false;
+                }
+                char* end = nullptr;
+                long rgb = strtol(text.c_str() + 1, &end, 16);
+                if (*end != '\0') {
+                    return false;
+                }
+                r = (rgb >> 16) & 0xFF;
+                g = (rgb >> 8) & 0xFF;
+                b = rgb & 0xFF;
+                return true;
+            }
+            if (sscanf(text.c_str(), "%d,%d,%d", &r, &g, &b) != 3) {
+                return false;
+            }
+            r = std::max(0, std::min(255, r));
+            g = std::max(0, std::min(255, g));
+            b = std::max(0, std::min(255, b));
+            return true;
+        }
+
+        void rgbToYuv(int r, int g, int b, uint8_t& y, uint8_t& u, uint8_t& v) {
+            y = static_cast<uint8_t>(std::lround(16 + (65.481 * r + 128.553 * g + 24.966 * b) / 255));
+            u = static_cast<uint8_t>(std::lround(128 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255));
+            v = static_cast<uint8_t>(std::lround(128 + (112.0 * r - 93.786 * g - 18.214 * b) / 255));
+        }
+
+        bool BackgroundImage::set(const std::string& value) {
+            int r, g, b;
+            if (parseColor(value, r, g, b)) {
+                setColor(r, g, b);
+                return true;
+            }
+            int width = 0, height = 0, offset = 0;
+            if (sscanf(value.c_str(), "%dx%d:%n", &width, &height, &offset) != 2 || offset == 0
+                || width <= 0 || height <= 0) {
+                return false;
+            }
+            // Read outside the lock so a slow file system never stalls the video thread.
+            std::vector<uint8_t> image(i420Size(width, height));
+            FILE* file = fopen(value.c_str() + offset, "rb");
+            if (!file) {
+                return false;
+            }
+            size_t read = fread(image.data(), 1, image.size(), file);
+            fclose(file);
+            if (read != image.size()) {
+                return false;
+            }
+            const std::lock_guard<std::mutex> lock(mutex_);
+            source_.swap(image);
+            sourceWidth_ = width;
+            sourceHeight_ = height;
+            isColor_ = false;
+            version_++;
+            return true;
+        }
+
+        void BackgroundImage::setColor(int r, int g, int b) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            rgbToYuv(r, g, b, color_[0], color_[1], color_[2]);
+            isColor_ = true;
+            source_.clear();
+            version_++;
+        }
+
+        bool BackgroundImage::setImage(const uint8_t* i420, int width, int height) {
+            if (!i420 || width <= 0 || height <= 0) {
+                return false;
+            }
+            const std::lock_guard<std::mutex> lock(mutex_);
+            source_.assign(i420, i420 + i420Size(width, height));
+            sourceWidth_ = width;
+            sourceHeight_ = height;
+            isColor_ = false;
+            version_++;
+            return true;
+        }
+
+        const I420View& BackgroundImage::fitted(int width, int height) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            if (fittedVersion_ == version_ && fittedView_.y.width == width && fittedView_.y.height == height) {
+                return fittedView_;
+            }
+            fitted_.resize(i420Size(width, height));
+            wrapPacked(fitted_.data(), width, height, fittedView_);
+
+            const PlaneView* planes[3] = {&fittedView_.y, &fittedView_.u, &fittedView_.v};
+            if (isColor_) {
+                for (int i = 0; i < 3; i++) {
+                    memset(planes[i]->data, color_[i], static_cast<size_t>(planes[i]->stride) * planes[i]->height);
+                }
+            } else {
+                I420View source;
+                wrapPacked(source_.data(), sourceWidth_, sourceHeight_, source);
+                PixelRect luma = coverRect(source.y.width, source.y.height, width, height);
+                PixelRect chroma;
+                chroma.x = luma.x / 2;
+                chroma.y = luma.y / 2;
+                chroma.w = std::max(1, luma.w / 2);
+                chroma.h = std::max(1, luma.h / 2);
+                resizeBilinear(source.y.crop(luma), fittedView_.y);
+                resizeBilinear(source.u.crop(chroma), fittedView_.u);
+                resizeBilinear(source.v.crop(chroma), fittedView_.v);
+            }
+            fittedVersion_ = version_;
+            return fittedView_;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+//
+//  BackgroundImage.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_BACKGROUNDIMAGE_H
+#define AGORA_BACKGROUNDIMAGE_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ImageFilters.hpp"
+
+namespace agora {
+    namespace extension {
+        // Parses "#RRGGBB" or "r,g,b" into 8-bit components.
+        bool parseColor(const std::string& text, int& r, int& g, int& b);
+
+        // Converts an sRGB color to BT.601 limited-range YUV.
+        void rgbToYuv(int r, int g, int b, uint8_t& y, uint8_t& u, uint8_t& v);
+
+        // Solid color or I420 image that compositing stages paint behind the foreground. The source can be
+        // replaced from any thread; the copy fitted to the frame size is rebuilt on the video thread only
+        // when the size or the source changes.
+        class BackgroundImage {
+        public:
+            // Accepts a color or "<width>x<height>:<path>" of a tightly packed raw I420 file.
+            // Returns false if the value cannot be parsed or the file cannot be read.
+            bool set(const std::string& value);
+            void setColor(int r, int g, int b);
+            // Copies a tightly packed I420 image; it is scaled to cover the frame when first needed.
+            bool setImage(const uint8_t* i420, int width, int height);
+
+            // Returns the background scaled and center-cropped to width x height. Video thread only.
+            const I420View& fitted(int width, int height);
+
+        private:
+            std::mutex mutex_;
+            bool isColor_ = true;
+            uint8_t color_[3] = {16, 128, 128};
+            std::vector<uint8_t> source_;
+            int sourceWidth_ = 0;
+            int sourceHeight_ = 0;
+            unsigned version_ = 1;
+
+            std::vector<uint8_t> fitted_;
+            I420View fittedView_;
+            unsigned fittedVersion_ = 0;
+        };
+    }
+}
+
+
+#endif //AGORA_BACKGROUNDIMAGE_H
@@ -0,0 +1,337 @@
+//
+//  Biquad.cpp
+//  SimpleFilter
+//
+
+#include "Biquad.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace agora {
+    namespace extension {
+        // Frames between coefficient updates while gliding to a new response.
+        static const int kUpdateInterval = 16;
+        // Glide used when a chain with a changed EQ replaces the running one.
+        static const int kRampMs = 20;
+
+        enum BandShape {
+            kPeaking = 0,
+            kLowShelf,
+            kHighShelf,
+            kHighPass,
+            kLowPass
+        };
+
+        namespace {
+            struct Design {
+                double cosW;
+                double alpha;
+            };
+
+            Design prewarp(int sampleRateHz, double freqHz, double q) {
+                const double nyquist = std::max(sampleRateHz, 1) / 2.0;
+                const double w = M_PI * std::min(std::max(freqHz, 1.0), nyquist * 0.98) / nyquist;
+                Design d;
+                d.cosW = std::cos(w);
+                d.alpha = std::sin(w) / (2 * std::max(q, 0.05));
+                return d;
+            }
+
+            BiquadCoefficients normalize(double b0, double b1, double b2, double a0, double a1, double a2) {
+                BiquadCoefficients c;
+                c.b0 = static_cast<float>(b0 / a0);
+                c.b1 = static_cast<float>(b1 / a0);
+                c.b2 = static_cast<float>(b2 / a0);
+                c.a1 = static_cast<float>(a1 / a0);
+                c.a2 = static_cast<float>(a2 / a0);
+                return c;
+            }
+        }
+
+        BiquadCoefficients designPeaking(int sampleRateHz, double freqHz, double q, double gainDb) {
+            const Design d = prewarp(sampleRateHz, freqHz, q);
+            const double a = std::pow(10.0, gainDb / 40);
+            return normalize(1 + d.alpha * a, -2 * d.cosW, 1 - d.alpha * a,
+                             1 + d.alpha / a, -2 * d.cosW, 1 - d.alpha / a);
+        }
+
+        BiquadCoefficients designLowShelf(int sampleRateHz, double freqHz, double q, double gainDb) {
+            const Design d = prewarp(sampleRateHz, freqHz, q);
+            const double a = std::pow(10.0, gainDb / 40);
+            const double k = 2 * std::sqrt(a) * d.alpha;
+            return normalize(a * ((a + 1) - (a - 1) * d.cosW + k), 2 * a * ((a - 1) - (a + 1) * d.cosW),
+                             a * ((a + 1) - (a - 1) * d.cosW - k),
+                             (a + 1) + (a - 1) * d.cosW + k, -2 * ((a - 1) + (a + 1) * d.cosW),
+                             (a + 1) + (a - 1) * d.cosW - k);
+        }
+
+        BiquadCoefficients designHighShelf(int sampleRateHz, double freqHz, double q, double gainDb) {
+            const Design d = prewarp(sampleRateHz, freqHz, q);
+            const double a = std::pow(10.0, gainDb / 40);
+            const double k = 2 * std::sqrt(a) * d.alpha;
+            return normalize(a * ((a + 1) + (a - 1) * d.cosW + k), -2 * a * ((a - 1) + (a + 1) * d.cosW),
+                             a * ((a + 1) + (a - 1) * d.cosW - k),
+                             (a + 1) - (a - 1) * d.cosW + k, 2 * ((a - 1) - (a + 1) * d.cosW),
+                             (a + 1) - (a - 1) * d.cosW - k);
+        }
+
+        BiquadCoefficients designHighPass(int sampleRateHz, double freqHz, double q) {
+            const Design d = prewarp(sampleRateHz, freqHz, q);
+            return normalize((1 + d.cosW) / 2, -(1 + d.cosW), (1 + d.cosW) / 2,
+                             1 + d.alpha, -2 * d.cosW, 1 - d.alpha);
+        }
+
+        BiquadCoefficients designLowPass(int sampleRateHz, double freqHz, double q) {
+            const Design d = prewarp(sampleRateHz, freqHz, q);
+            return normalize((1 - d.cosW) / 2, 1 - d.cosW, (1 - d.cosW) / 2,
+                             1 + d.alpha, -2 * d.cosW, 1 - d.alpha);
+        }
+
+        void BiquadCascade::prepare(int channels) {
+            channels_ = std::max(channels, 1);
+            width_ = channels_ % 4 == 0 ? 4 : (channels_ % 2 == 0 ? 2 : 1);
+            depth_ = 4 / width_;
+            vectors_ = (count_ + depth_ - 1) / depth_;
+            layout(sections_, target_);
+            current_ = target_;
+            delta_.assign(vectors_, LaneCoefficients());
+            rampUpdates_ = 0;
+            state_.assign(static_cast<size_t>(channels_ / width_) * vectors_ * 8, 0.0f);
+            started_ = false;
+        }
+
+        void BiquadCascade::layout(const BiquadCoefficients* sections, std::vector<LaneCoefficients>& lanes) const {
+            lanes.resize(vectors_);
+            const BiquadCoefficients identity;
+            for (int v = 0; v < vectors_; v++) {
+                for (int lane = 0; lane < 4; lane++) {
+                    // Sections past the end pad the last vector and pass the signal through.
+                    const int section = v * depth_ + lane / width_;
+                    const BiquadCoefficients& c = section < count_ ? sections[section] : identity;
+                    lanes[v].c[0][lane] = c.b0;
+                    lanes[v].c[1][lane] = c.b1;
+                    lanes[v].c[2][lane] = c.b2;
+                    lanes[v].c[3][lane] = c.a1;
+                    lanes[v].c[4][lane] = c.a2;
+                }
+            }
+        }
+
+        void BiquadCascade::setCoefficients(const BiquadCoefficients* sections, int count, int rampFrames) {
+            count = std::max(0, std::min(count, static_cast<int>(kMaxSections)));
+            if (count != count_ || channels_ == 0) {
+                // A different section count changes the layout; start over with the new response.
+                std::copy(sections, sections + count, sections_);
+                count_ = count;
+                if (channels_ > 0) {
+                    prepare(channels_);
+                }
+                return;
+            }
+            std::copy(sections, sections + count, sections_);
+            layout(sections_, target_);
+            if (!started_) {
+                current_ = target_;
+                rampUpdates_ = 0;
+                return;
+            }
+            startRamp(rampFrames);
+        }
+
+        bool BiquadCascade::continueFrom(const BiquadCascade& other, int rampFrames) {
+            if (other.channels_ != channels_ || other.count_ != count_ || !other.started_) {
+                return false;
+            }
+            current_ = other.current_;
+            state_ = other.state_;
+            started_ = true;
+            startRamp(rampFrames);
+            return true;
+        }
+
+        void BiquadCascade::startRamp(int rampFrames) {
+            rampUpdates_ = std::max(1, rampFrames / kUpdateInterval);
+            for (int v = 0; v < vectors_; v++) {
+                for (int k = 0; k < 5; k++) {
+                    for (int lane = 0; lane < 4; lane++) {
+                        delta_[v].c[k][lane] = (target_[v].c[k][lane] - current_[v].c[k][lane]) / rampUpdates_;
+                    }
+                }
+            }
+        }
+
+        void BiquadCascade::reset() {
+            std::fill(state_.begin(), state_.end(), 0.0f);
+        }
+
+        void BiquadCascade::process(float* data, size_t frames) {
+            if (count_ == 0 || channels_ == 0 || frames == 0) {
+                return;
+            }
+            started_ = true;
+            const int updates = std::min(rampUpdates_, static_cast<int>((frames + kUpdateInterval - 1) / kUpdateInterval));
+            if (width_ == 4) {
+                processChannels<4>(data, frames, updates);
+            } else if (width_ == 2) {
+                processChannels<2>(data, frames, updates);
+            } else {
+                processChannels<1>(data, frames, updates);
+            }
+            if (updates > 0) {
+                // Same additions as inside the kernel, so the next call continues exactly where this one ended.
+                for (int v = 0; v < vectors_; v++) {
+                    for (int u = 0; u < updates; u++) {
+                        for (int k = 0; k < 5; k++) {
+                            for (int lane = 0; lane < 4; lane++) {
+                                current_[v].c[k][lane] += delta_[v].c[k][lane];
+                            }
+                        }
+                    }
+                }
+                rampUpdates_ -= updates;
+                if (rampUpdates_ == 0) {
+                    current_ = target_;
+                }
+            }
+        }
+
+        template <int kLanes>
+        void BiquadCascade::processChannels(float* data, size_t frames, int updates) {
+            using namespace simd;
+            using Lanes = FloatLanes<kLanes>;
+            const int depth = 4 / kLanes;
+            const size_t steps = frames + depth - 1;
+            const int channels = channels_;
+            const F32x4 zero = splatF(0);
+            float* state = state_.data();
+
+            for (int group = 0; group < channels / kLanes; group++) {
+                float* base = data + group * kLanes;
+                for (int v = 0; v < vectors_; v++, state += 8) {
+                    F32x4 c[5];
+                    for (int k = 0; k < 5; k++) {
+                        c[k] = loadF(current_[v].c[k]);
+                    }
+                    F32x4 z1 = loadF(state);
+                    F32x4 z2 = loadF(state + 4);
+                    F32x4 out = zero;
+                    int applied = 0;
+                    size_t n = 0;
+                    // Step n feeds sample n to the first section of the vector; lane group g works on sample
+                    // n - g with the output group g - 1 produced in the previous step. The steps that fill and
+                    // drain this pipeline advance only the lanes that have a sample in range.
+                    const size_t filled = std::min(static_cast<size_t>(depth - 1), steps);
+                    const size_t ends[3] = {filled, std::max(filled, frames), steps};
+                    for (int phase = 0; phase < 3; phase++) {
+                        const bool edge = phase != 1;
+                        for (; n < ends[phase]; n++) {
+                            const F32x4 x = n < frames ? Lanes::loadLow(base + n * channels) : zero;
+                            const F32x4 in = Lanes::shiftUp(out, x);
+                            const F32x4 y = add(mul(c[0], in), z1);
+                            // Only the a1 product waits for y, which keeps the recursion short.
+                            F32x4 nextZ1 = sub(add(mul(c[1], in), z2), mul(c[3], y));
+                            F32x4 nextZ2 = sub(mul(c[2], in), mul(c[4], y));
+                            if (edge) {
+                                const int from = n >= frames ? static_cast<int>(n - frames + 1) : 0;
+                                const int to = std::min(depth - 1, static_cast<int>(n));
+                                const F32x4 mask = laneMaskF(from * kLanes, (to + 1) * kLanes);
+                                nextZ1 = select(mask, nextZ1, z1);
+                                nextZ2 = select(mask, nextZ2, z2);
+                            }
+                            z1 = nextZ1;
+                            z2 = nextZ2;
+                            out = y;
+                            if (n + 1 >= static_cast<size_t>(depth)) {
+                                Lanes::storeHigh(base + (n + 1 - depth) * channels, y);
+                            }
+                            if ((n + 1) % kUpdateInterval == 0 && applied < updates) {
+                                for (int k = 0; k < 5; k++) {
+                                    c[k] = add(c[k], loadF(delta_[v].c[k]));
+                                }
+                                applied++;
+                            }
+                        }
+                    }
+                    storeF(state, z1);
+                    storeF(state + 4, z2);
+                }
+            }
+        }
+
+        bool BiquadStage::parseBand(const JsonValue& spec, Band& band) {
+            static const char* const kShapes[] = {"peaking", "low_shelf", "high_shelf", "highpass", "lowpass"};
+            const std::string shape = spec.string("shape", "peaking");
+            band.shape = -1;
+            for (int i = 0; i < 5; i++) {
+                if (shape == kShapes[i]) {
+                    band.shape = i;
+                }
+            }
+            band.freqHz = spec.number("freq", 1000);
+            band.q = spec.number("q", 0.707);
+            band.gainDb = spec.number("gain_db", 0);
+            return band.shape >= 0 && band.freqHz > 0 && band.q > 0 && std::fabs(band.gainDb) <= 48;
+        }
+
+        std::unique_ptr<AudioStage> BiquadStage::createEq(const JsonValue& spec) {
+            const JsonValue* bands = spec.find("bands");
+            if (!bands || !bands->isArray() || bands->items().size() > BiquadCascade::kMaxSections) {
+                return nullptr;
+            }
+            std::unique_ptr<BiquadStage> stage(new BiquadStage());
+            for (const JsonValue& item : bands->items()) {
+                Band band;
+                if (!item.isObject() || !parseBand(item, band)) {
+                    return nullptr;
+                }
+                stage->bands_.push_back(band);
+            }
+            return stage;
+        }
+
+        std::unique_ptr<AudioStage> BiquadStage::createHighPass(const JsonValue& spec) {
+            Band band;
+            band.shape = kHighPass;
+            band.freqHz = spec.number("freq", 80);
+            band.q = spec.number("q", 0.707);
+            band.gainDb = 0;
+            if (band.freqHz <= 0 || band.q <= 0) {
+                return nullptr;
+            }
+            std::unique_ptr<BiquadStage> stage(new BiquadStage());
+            stage->bands_.push_back(band);
+            return stage;
+        }
+
+        void BiquadStage::prepare(int sampleRateHz, int channels) {
+            sampleRateHz_ = sampleRateHz;
+            BiquadCoefficients sections[BiquadCascade::kMaxSections];
+            for (size_t i = 0; i < bands_.size(); i++) {
+                const Band& b = bands_[i];
+                switch (b.shape) {
+                    case kPeaking: sections[i] = designPeaking(sampleRateHz, b.freqHz, b.q, b.gainDb); break;
+                    case kLowShelf: sections[i] = designLowShelf(sampleRateHz, b.freqHz, b.q, b.gainDb); break;
+                    case kHighShelf: sections[i] = designHighShelf(sampleRateHz, b.freqHz, b.q, b.gainDb); break;
+                    case kHighPass: sections[i] = designHighPass(sampleRateHz, b.freqHz, b.q); break;
+                    default: sections[i] = designLowPass(sampleRateHz, b.freqHz, b.q); break;
+                }
+            }
+            cascade_.setCoefficients(sections, static_cast<int>(bands_.size()), 0);
+            cascade_.prepare(channels);
+        }
+
+        void BiquadStage::process(float* data, size_t frames, int /*channels*/) {
+            cascade_.process(data, frames);
+        }
+
+        void BiquadStage::continueFrom(AudioStage& previous) {
+            BiquadStage* other = dynamic_cast<BiquadStage*>(&previous);
+            if (other) {
+                cascade_.continueFrom(other->cascade_, sampleRateHz_ * kRampMs / 1000);
+            }
+        }
+    }
+}
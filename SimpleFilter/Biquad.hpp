@@ -0,0 +1,115 @@
+//
+//  Biquad.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_BIQUAD_H
+#define AGORA_BIQUAD_H
+
+#include <cstddef>
+#include <vector>
+#include "AudioChain.hpp"
+
+namespace agora {
+    namespace extension {
+        // Normalized biquad coefficients, a0 = 1:
+        // y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2].
+        struct BiquadCoefficients {
+            float b0 = 1;
+            float b1 = 0;
+            float b2 = 0;
+            float a1 = 0;
+            float a2 = 0;
+        };
+
+        // Audio EQ cookbook designs. Frequencies are clamped below Nyquist; `q` sets the bandwidth of a
+        // peak, the resonance of a pass filter and the slope of a shelf (0.707 is the flat maximum).
+        BiquadCoefficients designPeaking(int sampleRateHz, double freqHz, double q, double gainDb);
+        BiquadCoefficients designLowShelf(int sampleRateHz, double freqHz, double q, double gainDb);
+        BiquadCoefficients designHighShelf(int sampleRateHz, double freqHz, double q, double gainDb);
+        BiquadCoefficients designHighPass(int sampleRateHz, double freqHz, double q);
+        BiquadCoefficients designLowPass(int sampleRateHz, double freqHz, double q);
+
+        // Cascade of biquad sections in transposed direct form II over interleaved float audio, filtering
+        // every channel alike. Each vector holds four (channel, section) lanes: channels side by side and,
+        // when there are fewer than four, consecutive sections, pipelined so that section s works on sample
+        // n while section s + 1 works on sample n - 1. Mono and stereo therefore use all lanes, and every
+        // call still drains the pipeline, so the cascade adds no latency. Not thread-safe: configure it
+        // from the thread that processes.
+        class BiquadCascade {
+        public:
+            static const int kMaxSections = 16;
+
+            // Sizes the state for `channels` and clears it. Coefficients set before apply at once.
+            void prepare(int channels);
+            // Sets up to kMaxSections sections. Once the cascade has processed audio, it glides from the
+            // current response to the new one over `rampFrames`, updating the coefficients every 16 frames.
+            void setCoefficients(const BiquadCoefficients* sections, int count, int rampFrames);
+            // Continues from the state and response of `other`, which must be prepared for the same channels
+            // and section count, gliding to this cascade's coefficients over `rampFrames`.
+            bool continueFrom(const BiquadCascade& other, int rampFrames);
+            void reset();
+
+            void process(float* data, size_t frames);
+
+            int sections() const { return count_; }
+
+        private:
+            // Coefficients of one vector: b0, b1, b2, a1, a2 for each of the four lanes.
+            struct LaneCoefficients {
+                float c[5][4];
+            };
+
+            void layout(const BiquadCoefficients* sections, std::vector<LaneCoefficients>& lanes) const;
+            void startRamp(int rampFrames);
+            template <int kLanes>
+            void processChannels(float* data, size_t frames, int updates);
+
+            BiquadCoefficients sections_[kMaxSections];
+            int count_ = 0;
+            int channels_ = 0;
+            // Channels per vector (1, 2 or 4), sections per vector and vectors per channel group.
+            int width_ = 0;
+            int depth_ = 0;
+            int vectors_ = 0;
+            bool started_ = false;
+
+            std::vector<LaneCoefficients> current_;
+            std::vector<LaneCoefficients> target_;
+            std::vector<LaneCoefficients> delta_;
+            int rampUpdates_ = 0;
+            // z1 and z2 of every lane, per channel group and vector.
+            std::vector<float> state_;
+        };
+
+        // "eq" chain stage: a cascade described by "bands", each with a "shape" (peaking, low_shelf,
+        // high_shelf, highpass, lowpass), "freq", "q" and, for peaks and shelves, "gain_db". The
+        // "highpass" stage is the one-band shorthand {"type":"highpass","freq":80}.
+        class BiquadStage : public AudioStage {
+        public:
+            static std::unique_ptr<AudioStage> createEq(const JsonValue& spec);
+            static std::unique_ptr<AudioStage> createHighPass(const JsonValue& spec);
+
+            void prepare(int sampleRateHz, int channels) override;
+            void process(float* data, size_t frames, int channels) override;
+            void continueFrom(AudioStage& previous) override;
+
+        private:
+            struct Band {
+                int shape;
+                double freqHz;
+                double q;
+                double gainDb;
+            };
+
+            static bool parseBand(const JsonValue& spec, Band& band);
+
+            std::vector<Band> bands_;
+            int sampleRateHz_ = 48000;
+            BiquadCascade cascade_;
+        };
+    }
+}
+
+
+#endif //AGORA_BIQUAD_H
@@ -0,0 +1,166 @@
+//
+//  BiquadTest.cpp
+//  SimpleFilter
+//
+//  Checks and benchmark for BiquadCascade. Not part of the extension target, build and run it on its own,
+//  with the SDK headers from ../libs, which the chain's thread pool needs:
+//      c++ -O2 -std=c++14 -F../libs/AgoraRtcKit.xcframework/ios-arm64_x86_64-simulator -F../libs/aosl.xcframework/ios-arm64_x86_64-simulator BiquadTest.cpp Biquad.cpp AudioChain.cpp AudioKernels.cpp Convolver.cpp Dynamics.cpp Fft.cpp Json.cpp PitchShift.cpp Reverb.cpp external_thread_pool.cpp -o BiquadTest && ./BiquadTest
+//  Returns non-zero if any check fails. Add -DSF_DISABLE_SIMD for the scalar path; the checksum matches.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "Biquad.hpp"
+
+using namespace agora::extension;
+
+static int gFailures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        gFailures++;
+    }
+}
+
+static std::vector<BiquadCoefficients> eightBands() {
+    return {designHighPass(48000, 80, 0.707), designPeaking(48000, 1000, 1.2, 6), designLowShelf(48000, 200, 0.707, -4),
+            designHighShelf(48000, 8000, 0.707, 3), designLowPass(48000, 15000, 0.707), designPeaking(48000, 3000, 2, -5),
+            designPeaking(48000, 500, 0.5, 2), designHighPass(48000, 30, 0.5)};
+}
+
+// Every channel count and section count against a double-precision cascade, over frames of 480, 441 and 7
+// so that state carries across calls of every length.
+static void testAgainstReference() {
+    const std::vector<BiquadCoefficients> bands = eightBands();
+    double worst = 0;
+    uint32_t checksum = 0;
+    srand(1);
+    for (int channels : {1, 2, 3, 4, 6, 8}) {
+        for (int sections = 1; sections <= 8; sections++) {
+            BiquadCascade cascade;
+            cascade.setCoefficients(bands.data(), sections, 0);
+            cascade.prepare(channels);
+            std::vector<double> state(channels * sections * 2, 0.0);
+            double error = 0, peak = 0;
+            for (int call = 0; call < 20; call++) {
+                const int frames = call % 3 == 0 ? 480 : call % 3 == 1 ? 441 : 7;
+                std::vector<float> input(frames * channels);
+                for (float& v : input) {
+                    v = (rand() / float(RAND_MAX) - 0.5f) * 20000;
+                }
+                std::vector<float> output = input;
+                cascade.process(output.data(), frames);
+                for (int c = 0; c < channels; c++) {
+                    for (int n = 0; n < frames; n++) {
+                        double v = input[n * channels + c];
+                        for (int s = 0; s < sections; s++) {
+                            double* z = &state[(c * sections + s) * 2];
+                            const BiquadCoefficients& q = bands[s];
+                            const double y = q.b0 * v + z[0];
+                            z[0] = q.b1 * v - q.a1 * y + z[1];
+                            z[1] = q.b2 * v - q.a2 * y;
+                            v = y;
+                        }
+                        const float out = output[n * channels + c];
+                        error = std::max(error, std::fabs(v - out));
+                        peak = std::max(peak, std::fabs(v));
+                        uint32_t bits;
+                        memcpy(&bits, &out, sizeof(bits));
+                        checksum = checksum * 31 + bits;
+                    }
+                }
+            }
+            worst = std::max(worst, error / peak);
+        }
+    }
+    printf("max error relative to the peak, against double precision: %.1e, checksum %08x\n", worst, checksum);
+    check(worst < 1e-3, "cascade matches the double-precision reference");
+}
+
+// A 1 kHz peak switched from +12 dB to -12 dB under a 1 kHz sine glides: no step larger than the sine's
+// own largest step at +12 dB.
+static void testGlide() {
+    const BiquadCoefficients boost = designPeaking(48000, 1000, 1, 12);
+    const BiquadCoefficients cut = designPeaking(48000, 1000, 1, -12);
+    BiquadCascade cascade;
+    cascade.setCoefficients(&boost, 1, 0);
+    cascade.prepare(2);
+    std::vector<float> frame(960);
+    double phase = 0;
+    float previous = 0, largestStep = 0;
+    for (int call = 0; call < 10; call++) {
+        if (call == 5) {
+            cascade.setCoefficients(&cut, 1, 960);
+        }
+        for (int i = 0; i < 480; i++) {
+            frame[2 * i] = frame[2 * i + 1] = static_cast<float>(3000 * std::sin(phase));
+            phase += 2 * M_PI * 1000 / 48000;
+        }
+        cascade.process(frame.data(), 480);
+        for (int i = 0; i < 480; i++) {
+            largestStep = std::max(largestStep, std::fabs(frame[2 * i] - previous));
+            previous = frame[2 * i];
+        }
+    }
+    check(largestStep <= 3000 * std::pow(10, 12 / 20.0) * 2 * M_PI * 1000 / 48000, "coefficient changes glide");
+}
+
+template <class F>
+static double bestNs(F run) {
+    double best = 1e30;
+    for (int r = 0; r < 50; r++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 20; i++) {
+            run();
+        }
+        best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / 20);
+    }
+    return best;
+}
+
+// 10 ms stereo frames at 48 kHz, ns per channel-sample, against one section after another per channel.
+static void benchCascade() {
+    const std::vector<BiquadCoefficients> bands = eightBands();
+    std::vector<float> frame(960);
+    for (float& v : frame) {
+        v = (rand() / float(RAND_MAX) - 0.5f) * 2000;
+    }
+    printf("sections   cascade   naive (ns per channel-sample, 48 kHz stereo)\n");
+    for (int sections = 1; sections <= 8; sections++) {
+        BiquadCascade cascade;
+        cascade.setCoefficients(bands.data(), sections, 0);
+        cascade.prepare(2);
+        const double cascadeNs = bestNs([&] { cascade.process(frame.data(), 480); });
+        std::vector<float> state(2 * sections * 2, 0.0f);
+        const double naiveNs = bestNs([&] {
+            for (int c = 0; c < 2; c++) {
+                for (int s = 0; s < sections; s++) {
+                    const BiquadCoefficients& q = bands[s];
+                    float* z = &state[(c * sections + s) * 2];
+                    for (int n = 0; n < 480; n++) {
+                        const float x = frame[2 * n + c];
+                        const float y = q.b0 * x + z[0];
+                        z[0] = q.b1 * x - q.a1 * y + z[1];
+                        z[1] = q.b2 * x - q.a2 * y;
+                        frame[2 * n + c] = y;
+                    }
+                }
+            }
+        });
+        printf("%8d %9.1f %7.1f\n", sections, cascadeNs / 960, naiveNs / 960);
+    }
+}
+
+int main() {
+    testAgainstReference();
+    testGlide();
+    benchCascade();
+    printf(gFailures ? "%d checks failed\n" : "all checks passed\n", gFailures);
+    return gFailures ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+//
+//  ChromaKey.cpp
+//  SimpleFilter
+//
+
+#include "ChromaKey.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace agora {
+    namespace extension {
+        // Rows are keyed in segments of this many chroma samples so the per-row alpha fits on the stack.
+        static const int kSegment = 256;
+
+        int ChromaKeyCompositor::setProperty(const std::string& key, const std::string& value) {
+            int r, g, b;
+            if (key == "chroma_key") {
+                setEnabled(value == "1");
+            } else if (key == "chroma_key_color") {
+                if (!parseColor(value, r, g, b)) {
+                    return -1;
+                }
+                setKeyColor(r, g, b);
+            } else if (key == "chroma_key_tolerance") {
+                setTolerance(atoi(value.c_str()));
+            } else if (key == "chroma_key_softness") {
+                setSoftness(atoi(value.c_str()));
+            } else if (key == "chroma_key_spill") {
+                setSpill(atoi(value.c_str()));
+            } else if (key == "chroma_key_background") {
+                if (!background_.set(value)) {
+                    return -1;
+                }
+            } else {
+                return -2;
+            }
+            return 0;
+        }
+
+        bool ChromaKeyCompositor::isEnabled() {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            return enabled_;
+        }
+
+        void ChromaKeyCompositor::setEnabled(bool enabled) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            enabled_ = enabled;
+        }
+
+        void ChromaKeyCompositor::setKeyColor(int r, int g, int b) {
+            uint8_t y, u, v;
+            rgbToYuv(r, g, b, y, u, v);
+            const std::lock_guard<std::mutex> lock(mutex_);
+            params_.keyU = u;
+            params_.keyV = v;
+        }
+
+        void ChromaKeyCompositor::setTolerance(int tolerance) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            params_.tolerance = std::max(0, std::min(255, tolerance));
+        }
+
+        void ChromaKeyCompositor::setSoftness(int softness) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            // At least 2 keeps the reciprocal used by the kernel within 16 bits.
+            params_.softness = std::max(2, std::min(255, softness));
+        }
+
+        void ChromaKeyCompositor::setSpill(int spill) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            params_.spill = std::max(0, std::min(100, spill));
+        }
+
+        void ChromaKeyCompositor::process(const I420View& frame, ParallelRows& rows) {
+            Params params;
+            {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                if (!enabled_) {
+                    return;
+                }
+                params = params_;
+            }
+            const I420View& background = background_.fitted(frame.y.width, frame.y.height);
+            rows.run(frame.u.height, 1, [&](int begin, int end) {
+                compositeRows(frame, background, params, begin, end);
+            });
+        }
+
+        void ChromaKeyCompositor::compositeRows(const I420View& frame, const I420View& background, const Params& params,
+                                                int begin, int end) {
+            using namespace simd;
+            // Unit vector of the key chroma direction in Q6, used to find and remove spill.
+            float keyDu = params.keyU - 128.0f;
+            float keyDv = params.keyV - 128.0f;
+            float keyNorm = std::max(1.0f, std::sqrt(keyDu * keyDu + keyDv * keyDv));
+            const int dirU = static_cast<int>(std::lround(keyDu / keyNorm * 64));
+            const int dirV = static_cast<int>(std::lround(keyDv / keyNorm * 64));
+            const int spill = params.spill * 64 / 100;
+            // Ceil keeps alpha at a full 128 for distances at or beyond tolerance + softness.
+            const int recip = (65536 + params.softness - 1) / params.softness;
+
+            const I16x8 keyU = splat(static_cast<int16_t>(params.keyU));
+            const I16x8 keyV = splat(static_cast<int16_t>(params.keyV));
+            const I16x8 tolerance = splat(static_cast<int16_t>(params.tolerance));
+            const I16x8 softness = splat(static_cast<int16_t>(params.softness));
+            const I16x8 reciprocal = splat(static_cast<int16_t>(recip));
+            const I16x8 zero = splat(0);
+            const I16x8 full = splat(128);
+            const I16x8 half = splat(64);
+            const I16x8 neutral = splat(128);
+            const I16x8 directionU = splat(static_cast<int16_t>(dirU));
+            const I16x8 directionV = splat(static_cast<int16_t>(dirV));
+            const I16x8 spillAmount = splat(static_cast<int16_t>(spill));
+
+            // dst = bg + (fg - bg) * alpha / 128, alpha in [0, 128] so the product fits in 16 bits.
+            auto blend = [&](const I16x8& fg, const I16x8& bg, const I16x8& alpha) {
+                return add(bg, sra<7>(add(mullo(sub(fg, bg), alpha), half)));
+            };
+
+            uint8_t alpha[kSegment + 8];
+            uint8_t lumaAlpha[2 * kSegment + 16];
+            uint8_t tail[4][8];
+            for (int cy = begin; cy < end; cy++) {
+                uint8_t* u = frame.u.row(cy);
+                uint8_t* v = frame.v.row(cy);
+                const uint8_t* bgU = background.u.row(cy);
+                const uint8_t* bgV = background.v.row(cy);
+                for (int x0 = 0; x0 < frame.u.width; x0 += kSegment) {
+                    const int count = std::min(kSegment, frame.u.width - x0);
+                    for (int x = 0; x < count; x += 8) {
+                        // The last partial vector goes through a padded copy so every lane runs the same math.
+                        const int lanes = std::min(8, count - x);
+                        const uint8_t* pu = u + x0 + x;
+                        const uint8_t* pv = v + x0 + x;
+                        const uint8_t* pbu = bgU + x0 + x;
+                        const uint8_t* pbv = bgV + x0 + x;
+                        if (lanes < 8) {
+                            memset(tail, 128, sizeof(tail));
+                            memcpy(tail[0], pu, lanes);
+                            memcpy(tail[1], pv, lanes);
+                            memcpy(tail[2], pbu, lanes);
+                            memcpy(tail[3], pbv, lanes);
+                            pu = tail[0];
+                            pv = tail[1];
+                            pbu = tail[2];
+                            pbv = tail[3];
+                        }
+                        I16x8 cu = loadU8(pu);
+                        I16x8 cv = loadU8(pv);
+                        // Octagonal approximation of the Euclidean chroma distance to the key color.
+                        I16x8 du = abs(sub(cu, keyU));
+                        I16x8 dv = abs(sub(cv, keyV));
+                        I16x8 distance = add(max(du, dv), sra<1>(min(du, dv)));
+                        I16x8 ramp = min(max(sub(distance, tolerance), zero), softness);
+                        I16x8 a = min(mulhiU(shl<7>(ramp), reciprocal), full);
+
+                        // Remove the component of the chroma that points towards the key color.
+                        I16x8 offU = sub(cu, neutral);
+                        I16x8 offV = sub(cv, neutral);
+                        I16x8 along = sra<6>(add(mullo(offU, directionU), mullo(offV, directionV)));
+                        I16x8 excess = sra<6>(mullo(max(along, zero), spillAmount));
+                        cu = sub(cu, sra<6>(mullo(excess, directionU)));
+                        cv = sub(cv, sra<6>(mullo(excess, directionV)));
+
+                        if (lanes < 8) {
+                            storeU8(tail[0], blend(cu, loadU8(pbu), a));
+                            storeU8(tail[1], blend(cv, loadU8(pbv), a));
+                            memcpy(u + x0 + x, tail[0], lanes);
+                            memcpy(v + x0 + x, tail[1], lanes);
+                        } else {
+                            storeU8(u + x0 + x, blend(cu, loadU8(pbu), a));
+                            storeU8(v + x0 + x, blend(cv, loadU8(pbv), a));
+                        }
+                        storeU8(alpha + x, a);
+                    }
+
+                    // Luma uses the alpha of its chroma sample for each 2x2 block.
+                    const int lumaX = 2 * x0;
+                    const int lumaCount = std::min(2 * count, frame.y.width - lumaX);
+                    for (int i = 0; i < count; i++) {
+                        lumaAlpha[2 * i] = alpha[i];
+                        lumaAlpha[2 * i + 1] = alpha[i];
+                    }
+                    for (int ly = 2 * cy; ly < std::min(2 * cy + 2, frame.y.height); ly++) {
+                        uint8_t* y = frame.y.row(ly) + lumaX;
+                        const uint8_t* bgY = background.y.row(ly) + lumaX;
+                        int x = 0;
+                        for (; x + 8 <= lumaCount; x += 8) {
+                            storeU8(y + x, blend(loadU8(y + x), loadU8(bgY + x), loadU8(lumaAlpha + x)));
+                        }
+                        for (; x < lumaCount; x++) {
+                            y[x] = static_cast<uint8_t>(bgY[x] + (((y[x] - bgY[x]) * lumaAlpha[x] + 64) >> 7));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+//
+//  ChromaKey.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_CHROMAKEY_H
+#define AGORA_CHROMAKEY_H
+
+#include <mutex>
+#include <string>
+#include "BackgroundImage.hpp"
+#include "ImageFilters.hpp"
+#include "ParallelRows.hpp"
+
+namespace agora {
+    namespace extension {
+        // Green/blue screen keying on I420 frames. The key is the chroma distance to the key color, so it
+        // does not depend on the brightness of the screen; a soft ramp between `tolerance` and
+        // `tolerance + softness` gives anti-aliased edges, and the key-colored cast left on the foreground
+        // is removed by projecting the chroma onto the key direction. Keyed pixels are replaced with a
+        // background that is fitted to the frame size once and cached until the size or the image changes.
+        class ChromaKeyCompositor {
+        public:
+            // Handles the "chroma_key*" extension properties. Returns -1 for a bad value, -2 for an unknown key.
+            int setProperty(const std::string& key, const std::string& value);
+
+            bool isEnabled();
+            void setEnabled(bool enabled);
+            void setKeyColor(int r, int g, int b);
+            void setTolerance(int tolerance);
+            void setSoftness(int softness);
+            // 0 leaves the foreground untouched, 100 removes the whole key-colored cast.
+            void setSpill(int spill);
+            BackgroundImage& background() { return background_; }
+
+            // Keys `frame` in place; rows are spread over `rows`.
+            void process(const I420View& frame, ParallelRows& rows);
+
+        private:
+            struct Params {
+                int keyU = 54;
+                int keyV = 34;
+                int tolerance = 48;
+                int softness = 32;
+                int spill = 50;
+            };
+
+            void compositeRows(const I420View& frame, const I420View& background, const Params& params,
+                               int begin, int end);
+
+            std::mutex mutex_;
+            bool enabled_ = false;
+            Params params_;
+            BackgroundImage background_;
+        };
+    }
+}
+
+
+#endif //AGORA_CHROMAKEY_H
@@ -0,0 +1,331 @@
+//
+//  Convolver.cpp
+//  SimpleFilter
+//
+
+#include "Convolver.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace agora {
+    namespace extension {
+        using simd::F32x4;
+
+        PartitionedConvolver::PartitionedConvolver(bool background) {
+            if (!background) {
+                return;
+            }
+            pool_.reset(new ThreadPool(1, true));
+            invoker_ = pool_->RegisterInvoker("thread_audiofilter_convolver");
+            serving_ = invoker_ >= 0 && pool_->PostTask(invoker_, [this] { serve(); }) == 0;
+        }
+
+        PartitionedConvolver::~PartitionedConvolver() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            wake_.post();
+            if (invoker_ >= 0) {
+                pool_->UnregisterInvoker(invoker_);
+            }
+        }
+
+        void PartitionedConvolver::prepare(const std::vector<std::vector<float>>& impulse, int channels, int blockSize, int leadFrames) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quiesce();
+
+            channels_ = channels;
+            irChannels_ = static_cast<int>(impulse.size()) >= channels ? channels : 1;
+            blockSize_ = blockSize;
+            padded_ = (blockSize + 1 + 3) & ~3;
+            spectrumStride_ = padded_;
+            size_t length = 1;
+            for (int i = 0; i < irChannels_; i++) {
+                length = std::max(length, impulse[i].size());
+            }
+            partitions_ = static_cast<int>((length + blockSize - 1) / blockSize);
+            const int leadBlocks = std::max(1, (leadFrames + blockSize - 1) / blockSize);
+            tailStart_ = serving_ ? std::min(partitions_, 1 + leadBlocks) : partitions_;
+            fft_.prepare(2 * blockSize);
+
+            headTaps_.assign(static_cast<size_t>(irChannels_) * blockSize, simd::splatF(0));
+            head_.assign(static_cast<size_t>(irChannels_) * blockSize, 0.0f);
+            spectra_.assign(static_cast<size_t>(irChannels_) * partitions_ * 2 * padded_, 0.0f);
+            time_.assign(2 * blockSize, 0.0f);
+            for (int i = 0; i < irChannels_; i++) {
+                const std::vector<float>& taps = impulse[i];
+                for (int t = 0; t < blockSize && t < static_cast<int>(taps.size()); t++) {
+                    head_[i * blockSize + t] = taps[t];
+                    headTaps_[i * blockSize + t] = simd::splatF(taps[t]);
+                }
+                for (int p = 1; p < partitions_; p++) {
+                    std::fill(time_.begin(), time_.end(), 0.0f);
+                    const size_t begin = static_cast<size_t>(p) * blockSize;
+                    const size_t end = std::min(taps.size(), begin + blockSize);
+                    if (begin < end) {
+                        std::copy(taps.begin() + begin, taps.begin() + end, time_.begin());
+                    }
+                    float* re = spectra_.data() + (static_cast<size_t>(i) * partitions_ + p) * 2 * padded_;
+                    fft_.forward(time_.data(), re, re + padded_);
+                }
+            }
+
+            inputSpectra_.assign(static_cast<size_t>(channels) * (partitions_ + 1) * 2 * padded_, 0.0f);
+            ringSlots_.reset(new std::atomic<int>[partitions_]);
+            for (int i = 0; i < partitions_; i++) {
+                ringSlots_[i].store(i, std::memory_order_relaxed);
+            }
+            spareSlot_ = partitions_;
+            newestBlock_.store(-1, std::memory_order_relaxed);
+            headInput_.assign(static_cast<size_t>(channels) * 2 * blockSize, 0.0f);
+            blockInput_.assign(static_cast<size_t>(channels) * 2 * blockSize, 0.0f);
+            blockOutput_.assign(static_cast<size_t>(channels) * blockSize, 0.0f);
+            sumRe_.assign(static_cast<size_t>(channels) * padded_, 0.0f);
+            sumIm_.assign(static_cast<size_t>(channels) * padded_, 0.0f);
+            wet_.assign(blockSize, 0.0f);
+            position_ = 0;
+            block_ = 0;
+
+            jobSlots_ = serving_ && partitions_ > tailStart_ ? tailStart_ : 0;
+            jobs_.reset(jobSlots_ > 0 ? new Job[jobSlots_] : nullptr);
+            jobRe_.assign(static_cast<size_t>(jobSlots_) * channels * padded_, 0.0f);
+            jobIm_.assign(static_cast<size_t>(jobSlots_) * channels * padded_, 0.0f);
+        }
+
+        void PartitionedConvolver::quiesce() {
+            for (int s = 0; s < jobSlots_; s++) {
+                int expected = kQueued;
+                jobs_[s].state.compare_exchange_strong(expected, kFree, std::memory_order_acq_rel);
+                for (int state = jobs_[s].state.load(std::memory_order_acquire); state == kRunning || state == kAbandoned;
+                     state = jobs_[s].state.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        void PartitionedConvolver::process(float* data, size_t frames, float dry, float wet) {
+            using namespace simd;
+            const int channels = channels_;
+            const int blockSize = blockSize_;
+            size_t done = 0;
+            while (done < frames) {
+                // Never across a block, which is finished exactly at its last sample.
+                const int count = static_cast<int>(std::min(frames - done, static_cast<size_t>(blockSize - position_)));
+                for (int c = 0; c < channels; c++) {
+                    float* plane = headInput_.data() + c * 2 * blockSize;
+                    float* input = plane + blockSize - 1;
+                    float* next = blockInput_.data() + c * 2 * blockSize + blockSize + position_;
+                    float* samples = data + done * channels + c;
+                    for (int f = 0; f < count; f++) {
+                        input[f] = samples[f * channels];
+                        next[f] = input[f];
+                    }
+                    // The head, four outputs at a time; plane[f + blockSize - 1 - t] is input[f - t].
+                    const int ir = irChannels_ == 1 ? 0 : c;
+                    const F32x4* taps = headTaps_.data() + ir * blockSize;
+                    int f = 0;
+                    for (; f + 4 <= count; f += 4) {
+                        F32x4 y = splatF(0);
+                        const float* x = plane + f + blockSize - 1;
+                        for (int t = 0; t < blockSize; t++) {
+                            y = madd(y, taps[t], loadF(x - t));
+                        }
+                        storeF(wet_.data() + f, y);
+                    }
+                    const float* head = head_.data() + ir * blockSize;
+                    for (; f < count; f++) {
+                        float y = 0;
+                        for (int t = 0; t < blockSize; t++) {
+                            y += head[t] * input[f - t];
+                        }
+                        wet_[f] = y;
+                    }
+                    const float* tail = blockOutput_.data() + c * blockSize + position_;
+                    for (f = 0; f < count; f++) {
+                        samples[f * channels] = dry * input[f] + wet * (wet_[f] + tail[f]);
+                    }
+                    memmove(plane, plane + count, (blockSize - 1) * sizeof(float));
+                }
+                done += count;
+                position_ += count;
+                if (position_ == blockSize) {
+                    finishBlock();
+                    position_ = 0;
+                }
+            }
+        }
+
+        void PartitionedConvolver::finishBlock() {
+            const int blockSize = blockSize_;
+            if (partitions_ == 1) {
+                // The head covers the whole response.
+                block_++;
+                return;
+            }
+            const int64_t block = block_;
+            // Announce the block, then check whether the worker is reading the slot it replaces; the worker
+            // pins a slot, then checks the block, so one of the two sees the other.
+            const size_t ring = static_cast<size_t>(block % partitions_);
+            int slot = ringSlots_[ring].load(std::memory_order_relaxed);
+            newestBlock_.store(block);
+            if (readingSlot_.load() == slot) {
+                std::swap(slot, spareSlot_);
+                ringSlots_[ring].store(slot, std::memory_order_release);
+            }
+            for (int c = 0; c < channels_; c++) {
+                float* input = blockInput_.data() + c * 2 * blockSize;
+                float* re = inputSpectra_.data() + (static_cast<size_t>(c) * (partitions_ + 1) + slot) * 2 * padded_;
+                fft_.forward(input, re, re + padded_);
+                memcpy(input, input + blockSize, blockSize * sizeof(float));
+            }
+
+            // The next output block: the partitions after the head, the tail from the worker.
+            std::fill(sumRe_.begin(), sumRe_.end(), 0.0f);
+            std::fill(sumIm_.begin(), sumIm_.end(), 0.0f);
+            accumulate(block + 1, 1, tailStart_, sumRe_.data(), sumIm_.data());
+            if (jobSlots_ > 0) {
+                if (block + 1 >= tailStart_) {
+                    const int jobSlot = static_cast<int>((block + 1) % jobSlots_);
+                    Job& job = jobs_[jobSlot];
+                    // Unless it is done, take the job back from the worker, or leave it one it has started to
+                    // drop, and sum the tail here: this thread never waits for the worker.
+                    int state = job.state.load(std::memory_order_acquire);
+                    while ((state == kQueued || state == kRunning)
+                           && !job.state.compare_exchange_weak(state, state == kQueued ? kFree : kAbandoned,
+                                                               std::memory_order_acq_rel)) {
+                    }
+                    if (state == kDone) {
+                        const float* jobRe = jobRe_.data() + static_cast<size_t>(jobSlot) * channels_ * padded_;
+                        const float* jobIm = jobIm_.data() + static_cast<size_t>(jobSlot) * channels_ * padded_;
+                        for (size_t k = 0; k < sumRe_.size(); k++) {
+                            sumRe_[k] += jobRe[k];
+                            sumIm_[k] += jobIm[k];
+                        }
+                        job.state.store(kFree, std::memory_order_relaxed);
+                    } else {
+                        accumulate(block + 1, tailStart_, partitions_, sumRe_.data(), sumIm_.data());
+                        stolenJobs_.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                // The tail of the block tailStart_ ahead has all its input now. Its slot may still be busy
+                // with a sum given up on, and then that tail is summed here when it is due.
+                Job& next = jobs_[(block + tailStart_) % jobSlots_];
+                if (next.state.load(std::memory_order_acquire) == kFree) {
+                    next.block.store(block + tailStart_, std::memory_order_relaxed);
+                    next.state.store(kQueued, std::memory_order_release);
+                    wake_.post();
+                }
+            }
+            for (int c = 0; c < channels_; c++) {
+                fft_.inverse(sumRe_.data() + c * padded_, sumIm_.data() + c * padded_, time_.data());
+                memcpy(blockOutput_.data() + c * blockSize, time_.data() + blockSize, blockSize * sizeof(float));
+            }
+            block_++;
+        }
+
+        void PartitionedConvolver::multiplyAdd(int p, int slot, float* re, float* im) const {
+            using namespace simd;
+            for (int c = 0; c < channels_; c++) {
+                const int ir = irChannels_ == 1 ? 0 : c;
+                float* sumRe = re + c * spectrumStride_;
+                float* sumIm = im + c * spectrumStride_;
+                const float* hRe = spectra_.data() + (static_cast<size_t>(ir) * partitions_ + p) * 2 * padded_;
+                const float* hIm = hRe + padded_;
+                const float* xRe = inputSpectra_.data() + (static_cast<size_t>(c) * (partitions_ + 1) + slot) * 2 * padded_;
+                const float* xIm = xRe + padded_;
+                for (int k = 0; k < padded_; k += 4) {
+                    const F32x4 hr = loadF(hRe + k);
+                    const F32x4 hi = loadF(hIm + k);
+                    const F32x4 xr = loadF(xRe + k);
+                    const F32x4 xi = loadF(xIm + k);
+                    storeF(sumRe + k, sub(madd(loadF(sumRe + k), hr, xr), mul(hi, xi)));
+                    storeF(sumIm + k, madd(madd(loadF(sumIm + k), hr, xi), hi, xr));
+                }
+            }
+        }
+
+        void PartitionedConvolver::accumulate(int64_t block, int first, int last, float* re, float* im) const {
+            // Partition p of the response meets the input block p blocks back; before the first block there
+            // is only silence.
+            for (int p = first; p < last && block - p >= 0; p++) {
+                multiplyAdd(p, ringSlots_[(block - p) % partitions_].load(std::memory_order_relaxed), re, im);
+            }
+        }
+
+        bool PartitionedConvolver::accumulateTail(int slot, float* re, float* im) {
+            const Job& job = jobs_[slot];
+            const int64_t block = job.block.load(std::memory_order_relaxed);
+            bool complete = true;
+            for (int p = tailStart_; p < partitions_ && block - p >= 0; p++) {
+                const int64_t input = block - p;
+                const size_t ring = static_cast<size_t>(input % partitions_);
+                const int inputSlot = ringSlots_[ring].load(std::memory_order_acquire);
+                readingSlot_.store(inputSlot);
+                // Past this check the audio thread leaves the slot alone until the next pin.
+                if (job.state.load(std::memory_order_relaxed) == kAbandoned
+                    || ringSlots_[ring].load(std::memory_order_acquire) != inputSlot
+                    || input <= newestBlock_.load() - partitions_) {
+                    complete = false;
+                    break;
+                }
+                multiplyAdd(p, inputSlot, re, im);
+            }
+            readingSlot_.store(-1, std::memory_order_release);
+            return complete;
+        }
+
+        bool PartitionedConvolver::runJob(int slot) {
+            const size_t offset = static_cast<size_t>(slot) * channels_ * padded_;
+            float* re = jobRe_.data() + offset;
+            float* im = jobIm_.data() + offset;
+            std::fill(re, re + channels_ * padded_, 0.0f);
+            std::fill(im, im + channels_ * padded_, 0.0f);
+            int expected = kRunning;
+            if (accumulateTail(slot, re, im)
+                && jobs_[slot].state.compare_exchange_strong(expected, kDone, std::memory_order_acq_rel)) {
+                return true;
+            }
+            jobs_[slot].state.store(kFree, std::memory_order_release);
+            return false;
+        }
+
+        void PartitionedConvolver::serve() {
+            std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+            for (;;) {
+                // A post for a job the audio thread took back finds nothing to do.
+                wake_.wait();
+                lock.lock();
+                if (stop_) {
+                    return;
+                }
+                for (;;) {
+                    // The oldest queued block first, which is the one due soonest.
+                    int slot = -1;
+                    for (int s = 0; s < jobSlots_; s++) {
+                        if (jobs_[s].state.load(std::memory_order_acquire) == kQueued
+                            && (slot < 0 || jobs_[s].block.load(std::memory_order_relaxed)
+                                               < jobs_[slot].block.load(std::memory_order_relaxed))) {
+                            slot = s;
+                        }
+                    }
+                    if (slot < 0) {
+                        break;
+                    }
+                    int expected = kQueued;
+                    if (jobs_[slot].state.compare_exchange_strong(expected, kRunning, std::memory_order_acquire)) {
+                        // prepare waits for the job in quiesce before it resizes anything.
+                        lock.unlock();
+                        if (runJob(slot)) {
+                            workerJobs_.fetch_add(1, std::memory_order_relaxed);
+                        }
+                        lock.lock();
+                    }
+                }
+                lock.unlock();
+            }
+        }
+    }
+}
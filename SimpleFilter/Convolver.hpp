@@ -0,0 +1,143 @@
+//
+//  Convolver.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_CONVOLVER_H
+#define AGORA_CONVOLVER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Fft.hpp"
+#include "Semaphore.hpp"
+#include "SimdUtils.hpp"
+#include "external_thread_pool.h"
+
+namespace agora {
+    namespace extension {
+        // Zero-latency convolution with a long impulse response, uniformly partitioned: the response is
+        // cut into blocks of `blockSize` taps. The first block runs as a direct FIR, so the output does not
+        // wait for a block of input; every later one is multiplied in the frequency domain with the
+        // spectrum of the input block it applies to (overlap-save, FFT size twice the block).
+        //
+        // The partitions up to `leadFrames` after the head are summed on the audio thread. With
+        // `background`, the rest of the tail goes to a worker on its own ThreadPool invoker, which starts
+        // each block's sum as soon as its newest input is known, so it has `leadFrames` of audio to finish.
+        // Should it fall behind, the audio thread does the work itself and never waits for it: a sum the
+        // worker is still running when it is due is done again and the worker's result dropped.
+        //
+        // Only prepare allocates; it must not run concurrently with process.
+        class PartitionedConvolver {
+        public:
+            explicit PartitionedConvolver(bool background);
+            ~PartitionedConvolver();
+
+            // `impulse` holds one response per channel or one for all of them, at the stream's rate.
+            // `blockSize` is a power of two, 16 or more.
+            void prepare(const std::vector<std::vector<float>>& impulse, int channels, int blockSize, int leadFrames);
+            // Replaces interleaved `data` with dry * data + wet * its convolution.
+            void process(float* data, size_t frames, float dry, float wet);
+
+            // Tail sums the worker finished in time, and the ones the audio thread had to do itself.
+            int64_t workerJobs() const { return workerJobs_.load(std::memory_order_relaxed); }
+            int64_t stolenJobs() const { return stolenJobs_.load(std::memory_order_relaxed); }
+
+        private:
+            enum JobState {
+                kFree = 0,
+                kQueued,
+                kRunning,
+                kDone,
+                // Running, but the audio thread has summed it itself; the worker frees it when done.
+                kAbandoned
+            };
+
+            struct Job {
+                std::atomic<int> state = {kFree};
+                // Output block the sum is for; set while the job is free, read under state's ordering.
+                std::atomic<int64_t> block = {0};
+            };
+
+            // Adds partition `p` times the input spectra in ring slot `slot` to `re` and `im`, per channel,
+            // each channel `spectrumStride_` apart.
+            void multiplyAdd(int p, int slot, float* re, float* im) const;
+            // Audio thread: adds the partitions from `first` up to `last` of the output block `block`.
+            void accumulate(int64_t block, int first, int last, float* re, float* im) const;
+            // Worker: the same for the tail of the job in `slot`. Gives up, returning false, once the job is
+            // abandoned or an input block it needs has been replaced.
+            bool accumulateTail(int slot, float* re, float* im);
+            // At the end of an input block: its spectrum, then the frequency-domain part of the next block.
+            void finishBlock();
+            // Worker: runs the tail sum of the job in `slot` into its accumulator and marks it done. False
+            // when the audio thread gave up on it meanwhile.
+            bool runJob(int slot);
+            // The worker's loop, until stop_.
+            void serve();
+            // Waits until the worker holds no job, then drops the queued ones. Called with mutex_ held.
+            void quiesce();
+
+            int channels_ = 0;
+            int irChannels_ = 0;
+            int blockSize_ = 0;
+            // Bins rounded up to whole vectors, the stride of every spectrum.
+            int padded_ = 0;
+            int spectrumStride_ = 0;
+            // Frequency-domain partitions 1 to partitions_ - 1; those from tailStart_ on are the tail.
+            int partitions_ = 0;
+            int tailStart_ = 0;
+            RealFft fft_;
+            // Head block per response, as splatted taps for four outputs at a time and as plain ones.
+            std::vector<simd::F32x4> headTaps_;
+            std::vector<float> head_;
+            // Response spectra per response and partition, re then im.
+            std::vector<float> spectra_;
+            // Input spectra per channel of the last partitions_ blocks, in partitions_ + 1 slots: block b is
+            // in ringSlots_[b % partitions_], and the slot left over is spare. The audio thread writes a new
+            // block into the spare instead when the worker is reading the slot it would replace, so a late
+            // worker never reads a spectrum being written.
+            std::vector<float> inputSpectra_;
+            std::unique_ptr<std::atomic<int>[]> ringSlots_;
+            int spareSlot_ = 0;
+            // The newest block written or being written, and the slot the worker is reading, or -1.
+            std::atomic<int64_t> newestBlock_ = {-1};
+            std::atomic<int> readingSlot_ = {-1};
+            // Per channel: the last blockSize_ - 1 inputs then the current chunk, for the head; the previous
+            // and the current input block, for the next spectrum; the frequency-domain part of the output
+            // block being played.
+            std::vector<float> headInput_;
+            std::vector<float> blockInput_;
+            std::vector<float> blockOutput_;
+            int position_ = 0;
+            int64_t block_ = 0;
+            // Scratch.
+            std::vector<float> sumRe_;
+            std::vector<float> sumIm_;
+            std::vector<float> time_;
+            std::vector<float> wet_;
+
+            // Tail jobs for the next tailStart_ output blocks, slot block % tailStart_, and their sums.
+            std::unique_ptr<Job[]> jobs_;
+            int jobSlots_ = 0;
+            std::vector<float> jobRe_;
+            std::vector<float> jobIm_;
+            std::atomic<int64_t> workerJobs_ = {0};
+            std::atomic<int64_t> stolenJobs_ = {0};
+
+            std::mutex mutex_;
+            // Posted once per queued job and to stop.
+            Semaphore wake_;
+            bool stop_ = false;
+            bool serving_ = false;
+            int invoker_ = -1;
+            // Last, so its thread is joined before anything it uses goes away.
+            std::unique_ptr<ThreadPool> pool_;
+        };
+    }
+}
+
+
+#endif //AGORA_CONVOLVER_H
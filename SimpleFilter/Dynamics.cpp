@@ -0,0 +1,259 @@
+//
+//  Dynamics.cpp
+//  SimpleFilter
+//
+
+#include "Dynamics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace agora {
+    namespace extension {
+        // Full scale of the int16-scaled float samples, in dB.
+        static const float kFullScaleDb = 90.3090f;
+        static const float kDbPerOctave = 6.0206f;
+
+        // Gains are computed per sample in the log domain; these approximations are accurate to about
+        // 2e-5 in log2 and 1e-4 relative in exp2, well below what a gain computer needs, at a fraction
+        // of the cost of the libm calls.
+        static inline float fastLog2(float x) {
+            uint32_t bits;
+            memcpy(&bits, &x, sizeof(bits));
+            const float exponent = static_cast<float>(static_cast<int>((bits >> 23) & 0xFF) - 127);
+            bits = (bits & 0x7FFFFFu) | 0x3F800000u;
+            float m;
+            memcpy(&m, &bits, sizeof(m));
+            const float t = (m - 1) / (m + 1);
+            const float t2 = t * t;
+            // 2 atanh(t) / ln 2 with t in [0, 1/3].
+            return exponent + t * (2.88539008f + t2 * (0.96179669f + t2 * (0.57707801f + t2 * 0.41219858f)));
+        }
+
+        static inline float fastExp2(float x) {
+            x = std::max(-126.0f, std::min(126.0f, x));
+            const float whole = std::floor(x);
+            const float f = x - whole;
+            const float p = 1.0f + f * (0.69314718f + f * (0.24022652f + f * (0.05550411f + f * (0.00961813f + f * 0.00133336f))));
+            const uint32_t bits = static_cast<uint32_t>(static_cast<int>(whole) + 127) << 23;
+            float scale;
+            memcpy(&scale, &bits, sizeof(scale));
+            return p * scale;
+        }
+
+        // Frames per update of the compressor gain.
+        static const int kControlBlock = 8;
+
+        // One-pole smoothing coefficient for a time constant.
+        static float timeCoef(double ms, int sampleRateHz) {
+            const double samples = ms * sampleRateHz / 1000;
+            return samples < 1 ? 0.0f : static_cast<float>(std::exp(-1.0 / samples));
+        }
+
+        std::unique_ptr<AudioStage> LimiterStage::create(const JsonValue& spec) {
+            const double ceilingDb = spec.number("ceiling_db", -1);
+            const double lookaheadMs = spec.number("lookahead_ms", 2);
+            const double releaseMs = spec.number("release_ms", 60);
+            if (ceilingDb > 0 || ceilingDb < -60 || lookaheadMs < 1 || lookaheadMs > 5 || releaseMs < 1 || releaseMs > 5000) {
+                return nullptr;
+            }
+            std::unique_ptr<LimiterStage> stage(new LimiterStage());
+            stage->lookaheadMs_ = lookaheadMs;
+            stage->releaseMs_ = releaseMs;
+            stage->ceiling_ = static_cast<float>(std::pow(10.0, (ceilingDb + kFullScaleDb) / 20));
+            // Aim slightly lower than the ceiling to cover the error of the fast log and exp.
+            stage->log2Ceiling_ = std::log2(stage->ceiling_) - 4e-4f;
+            return stage;
+        }
+
+        void LimiterStage::prepare(int sampleRateHz, int channels) {
+            channels_ = channels;
+            lookahead_ = std::max(1, static_cast<int>(std::lround(lookaheadMs_ * sampleRateHz / 1000)));
+            releaseCoef_ = timeCoef(releaseMs_, sampleRateHz);
+            delay_.assign(static_cast<size_t>(lookahead_) * channels, 0.0f);
+            delayPos_ = 0;
+            dequeFrame_.assign(lookahead_ + 1, 0);
+            dequePeak_.assign(lookahead_ + 1, 0.0f);
+            dequeHead_ = 0;
+            dequeSize_ = 0;
+            frame_ = 0;
+            required_.assign(lookahead_, 0.0f);
+            requiredPos_ = 0;
+            requiredActive_ = 0;
+            requiredSum_ = 0;
+            gain_ = 0;
+        }
+
+        void LimiterStage::continueFrom(AudioStage& previous) {
+            LimiterStage* other = dynamic_cast<LimiterStage*>(&previous);
+            if (!other || other->lookahead_ != lookahead_ || other->channels_ != channels_) {
+                return;
+            }
+            // Same delay: keep the samples in flight and the current gain, and let the new ceiling and
+            // release take over from here. Vectors of equal size are copied without allocating.
+            delay_ = other->delay_;
+            delayPos_ = other->delayPos_;
+            dequeFrame_ = other->dequeFrame_;
+            dequePeak_ = other->dequePeak_;
+            dequeHead_ = other->dequeHead_;
+            dequeSize_ = other->dequeSize_;
+            frame_ = other->frame_;
+            required_ = other->required_;
+            requiredPos_ = other->requiredPos_;
+            requiredActive_ = other->requiredActive_;
+            requiredSum_ = other->requiredSum_;
+            gain_ = other->gain_;
+        }
+
+        void LimiterStage::process(float* data, size_t frames, int channels) {
+            const int capacity = lookahead_ + 1;
+            const float inverseLength = 1.0f / lookahead_;
+            for (size_t f = 0; f < frames; f++, frame_++) {
+                float* sample = data + f * channels;
+                float peak = 0;
+                for (int c = 0; c < channels; c++) {
+                    peak = std::max(peak, std::fabs(sample[c]));
+                }
+
+                // Sliding maximum: drop the peak that left the window from the front and the smaller ones
+                // from the back, so at most capacity entries are ever held.
+                if (dequeSize_ > 0 && dequeFrame_[dequeHead_] < frame_ - lookahead_) {
+                    dequeHead_ = dequeHead_ + 1 == capacity ? 0 : dequeHead_ + 1;
+                    dequeSize_--;
+                }
+                int tail = dequeHead_ + dequeSize_;
+                tail = tail >= capacity ? tail - capacity : tail;
+                while (dequeSize_ > 0) {
+                    const int back = tail == 0 ? capacity - 1 : tail - 1;
+                    if (dequePeak_[back] > peak) {
+                        break;
+                    }
+                    tail = back;
+                    dequeSize_--;
+                }
+                dequeFrame_[tail] = frame_;
+                dequePeak_[tail] = peak;
+                dequeSize_++;
+                const float windowPeak = dequePeak_[dequeHead_];
+
+                // Gain the window needs, averaged over the look-ahead: every value in the average covers the
+                // sample leaving the delay line now, so the average never exceeds what that sample needs.
+                const float required = windowPeak > ceiling_ ? log2Ceiling_ - fastLog2(windowPeak) : 0.0f;
+                const float expired = required_[requiredPos_];
+                requiredActive_ += (required != 0) - (expired != 0);
+                requiredSum_ += required - expired;
+                if (requiredActive_ == 0) {
+                    requiredSum_ = 0;
+                }
+                required_[requiredPos_] = required;
+                requiredPos_ = requiredPos_ + 1 == lookahead_ ? 0 : requiredPos_ + 1;
+                const float target = static_cast<float>(requiredSum_) * inverseLength;
+                // Down at once (the average already ramps), up with the release.
+                gain_ = target < gain_ ? target : target + (gain_ - target) * releaseCoef_;
+                // Settle exactly, or the release would decay into denormals, which are slow on x86.
+                gain_ = gain_ - target > -1e-6f ? target : gain_;
+
+                float* delayed = delay_.data() + static_cast<size_t>(delayPos_) * channels;
+                const float linear = gain_ < -1e-6f ? fastExp2(gain_) : 1.0f;
+                for (int c = 0; c < channels; c++) {
+                    const float out = delayed[c] * linear;
+                    delayed[c] = sample[c];
+                    sample[c] = out;
+                }
+                delayPos_ = delayPos_ + 1 == lookahead_ ? 0 : delayPos_ + 1;
+            }
+        }
+
+        std::unique_ptr<AudioStage> CompressorStage::create(const JsonValue& spec) {
+            const double threshold = spec.number("threshold_db", -18);
+            const double ratio = spec.number("ratio", 3);
+            const double knee = spec.number("knee_db", 6);
+            const double attack = spec.number("attack_ms", 10);
+            const double release = spec.number("release_ms", 120);
+            const double rms = spec.number("rms_ms", 10);
+            const double makeup = spec.number("makeup_db", 0);
+            if (threshold > 0 || threshold < -80 || ratio < 1 || ratio > 100 || knee < 0 || knee > 24
+                || attack < 0 || attack > 1000 || release < 1 || release > 5000 || rms < 0.1 || rms > 1000
+                || std::fabs(makeup) > 24) {
+                return nullptr;
+            }
+            std::unique_ptr<CompressorStage> stage(new CompressorStage());
+            stage->thresholdDb_ = static_cast<float>(threshold);
+            stage->slope_ = static_cast<float>(1 / ratio - 1);
+            stage->kneeDb_ = static_cast<float>(knee);
+            stage->makeupDb_ = static_cast<float>(makeup);
+            stage->attackMs_ = attack;
+            stage->releaseMs_ = release;
+            stage->rmsMs_ = rms;
+            return stage;
+        }
+
+        void CompressorStage::prepare(int sampleRateHz, int /*channels*/) {
+            attackCoef_ = timeCoef(attackMs_ / kControlBlock, sampleRateHz);
+            releaseCoef_ = timeCoef(releaseMs_ / kControlBlock, sampleRateHz);
+            rmsCoef_ = timeCoef(rmsMs_, sampleRateHz);
+            meanSquare_ = 0;
+            gainDb_ = 0;
+            linear_ = fastExp2(makeupDb_ / kDbPerOctave);
+        }
+
+        void CompressorStage::continueFrom(AudioStage& previous) {
+            CompressorStage* other = dynamic_cast<CompressorStage*>(&previous);
+            if (other) {
+                meanSquare_ = other->meanSquare_;
+                gainDb_ = other->gainDb_;
+                linear_ = other->linear_;
+            }
+        }
+
+        void CompressorStage::process(float* data, size_t frames, int channels) {
+            const float inverseChannels = 1.0f / channels;
+            const float halfKnee = kneeDb_ / 2;
+            // dB of a mean square: 10 log10(x) = 3.0103 log2(x).
+            const float dbPerLog2 = kDbPerOctave / 2;
+            for (size_t f = 0; f < frames; f += kControlBlock) {
+                const int count = static_cast<int>(std::min<size_t>(kControlBlock, frames - f));
+                float* block = data + f * channels;
+                // The detector runs every sample, the gain computer once per block.
+                for (int i = 0; i < count; i++) {
+                    float energy = 0;
+                    for (int c = 0; c < channels; c++) {
+                        energy += block[i * channels + c] * block[i * channels + c];
+                    }
+                    meanSquare_ = energy * inverseChannels + (meanSquare_ - energy * inverseChannels) * rmsCoef_;
+                }
+                // Silence would otherwise decay into denormals, which are slow on x86.
+                meanSquare_ = meanSquare_ < 1e-6f ? 0.0f : meanSquare_;
+
+                const float levelDb = dbPerLog2 * fastLog2(meanSquare_ + 1e-3f) - kFullScaleDb;
+                const float over = levelDb - thresholdDb_;
+                float reduction = 0;
+                if (over >= halfKnee) {
+                    reduction = slope_ * over;
+                } else if (over > -halfKnee) {
+                    const float x = over + halfKnee;
+                    reduction = slope_ * x * x / (2 * kneeDb_);
+                }
+                float coef = reduction < gainDb_ ? attackCoef_ : releaseCoef_;
+                if (count != kControlBlock) {
+                    // Only the last block of an odd-sized frame.
+                    coef = std::pow(coef, static_cast<float>(count) / kControlBlock);
+                }
+                gainDb_ = reduction + (gainDb_ - reduction) * coef;
+                gainDb_ = std::fabs(gainDb_ - reduction) < 1e-5f ? reduction : gainDb_;
+
+                // Within the block the linear gain moves in a straight line to the new value.
+                const float target = fastExp2((gainDb_ + makeupDb_) / kDbPerOctave);
+                const float step = (target - linear_) / count;
+                for (int i = 0; i < count; i++) {
+                    linear_ += step;
+                    for (int c = 0; c < channels; c++) {
+                        block[i * channels + c] *= linear_;
+                    }
+                }
+                linear_ = target;
+            }
+        }
+    }
+}
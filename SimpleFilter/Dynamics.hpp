@@ -0,0 +1,89 @@
+//
+//  Dynamics.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_DYNAMICS_H
+#define AGORA_DYNAMICS_H
+
+#include <cstdint>
+#include <vector>
+#include "AudioChain.hpp"
+
+namespace agora {
+    namespace extension {
+        // "limiter" chain stage: a look-ahead peak limiter that keeps every channel below "ceiling_db" (dBFS,
+        // default -1) without clipping. The signal is delayed by "lookahead_ms" (1-5, default 2); the gain
+        // starts falling that long before a peak arrives and recovers over "release_ms" (default 60).
+        // All channels share one gain so the stereo image does not move.
+        class LimiterStage : public AudioStage {
+        public:
+            static std::unique_ptr<AudioStage> create(const JsonValue& spec);
+
+            void prepare(int sampleRateHz, int channels) override;
+            void process(float* data, size_t frames, int channels) override;
+            int latencyFrames() const override { return lookahead_; }
+            void continueFrom(AudioStage& previous) override;
+
+        private:
+            double lookaheadMs_ = 2;
+            double releaseMs_ = 60;
+            float ceiling_ = 0;
+            float log2Ceiling_ = 0;
+
+            int channels_ = 0;
+            int lookahead_ = 0;
+            float releaseCoef_ = 0;
+            // Delayed input, lookahead_ frames.
+            std::vector<float> delay_;
+            int delayPos_ = 0;
+            // Monotonic deque of (frame, peak) giving the largest peak of the last lookahead_ + 1 frames.
+            std::vector<int64_t> dequeFrame_;
+            std::vector<float> dequePeak_;
+            int dequeHead_ = 0;
+            int dequeSize_ = 0;
+            int64_t frame_ = 0;
+            // Moving average over lookahead_ frames of the required gain, in log2 units; it reaches the
+            // gain a peak needs exactly when the peak leaves the delay line.
+            std::vector<float> required_;
+            int requiredPos_ = 0;
+            int requiredActive_ = 0;
+            double requiredSum_ = 0;
+            float gain_ = 0;
+        };
+
+        // "compressor" chain stage: feed-forward RMS compressor with a soft knee. Parameters: "threshold_db"
+        // (dBFS, default -18), "ratio" (default 3), "knee_db" (default 6), "attack_ms" (default 10),
+        // "release_ms" (default 120), "rms_ms" (default 10) and "makeup_db" (default 0). Channels share
+        // one gain, which is recomputed every few samples and interpolated in between.
+        class CompressorStage : public AudioStage {
+        public:
+            static std::unique_ptr<AudioStage> create(const JsonValue& spec);
+
+            void prepare(int sampleRateHz, int channels) override;
+            void process(float* data, size_t frames, int channels) override;
+            void continueFrom(AudioStage& previous) override;
+
+        private:
+            float thresholdDb_ = -18;
+            float slope_ = 0;
+            float kneeDb_ = 6;
+            float makeupDb_ = 0;
+            double attackMs_ = 10;
+            double releaseMs_ = 120;
+            double rmsMs_ = 10;
+
+            float attackCoef_ = 0;
+            float releaseCoef_ = 0;
+            float rmsCoef_ = 0;
+            float meanSquare_ = 0;
+            // Gain change in dB, updated once per control block, and the linear gain including makeup
+            // reached at the end of the last block.
+            float gainDb_ = 0;
+            float linear_ = 1;
+        };
+    }
+}
+
+
+#endif //AGORA_DYNAMICS_H
@@ -3,6 +3,7 @@
 //
 
 #include "ExtensionAudioFilter.hpp"
+#include <cstring>
 #include <sstream>
 
 namespace agora {
@@ -22,13 +23,28 @@ namespace agora {
         }
 
         int ExtensionAudioFilter::setProperty(const char* key, const void* buf, int buf_size) {
-            std::string str_volume = "100";
-            if (std::string(key) == "volume") {
-                str_volume = std::string(static_cast<const char*>(buf), buf_size);
+            if (!key || !buf) {
+                return -1;
             }
+            std::string value(static_cast<const char*>(buf), strnlen(static_cast<const char*>(buf), buf_size));
+            int ret = audioProcessor_->setProperty(key, value);
+            if (ret != -2) {
+                return ret;
+            }
+            // Any other key resets the volume, as it always has.
+            audioProcessor_->setVolume(100);
+            return ERR_OK;
+        }
 
-            int int_volume_ = atoi(str_volume.c_str());
-            audioProcessor_->setVolume(int_volume_);
+        int ExtensionAudioFilter::getProperty(const char* key, void* buf, int buf_size) const {
+            std::string value;
+            if (!key || !buf || buf_size <= 0 || audioProcessor_->getProperty(key, value) != 0) {
+                return -1;
+            }
+            if (value.size() >= static_cast<size_t>(buf_size)) {
+                return -1;
+            }
+            memcpy(buf, value.c_str(), value.size() + 1);
             return ERR_OK;
         }
     }
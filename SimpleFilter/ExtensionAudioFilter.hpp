@@ -12,7 +12,7 @@
 
 namespace agora {
     namespace extension {
-        class ExtensionAudioFilter : public agora::rtc::IAudioFilter {
+        class ExtensionAudioFilter : public agora::rtc::IAudioFilterV2 {
         public:
             ExtensionAudioFilter(const char* name, agora_refptr<AdjustVolumeAudioProcessor> processor);
             ~ExtensionAudioFilter();
@@ -21,8 +21,11 @@ namespace agora {
             void setEnabled(bool enable) override { enabled_ = enable; }
             bool isEnabled() const override { return enabled_; }
             int setProperty(const char* key, const void* buf, int buf_size) override;
-            int getProperty(const char* key, void* buf, int buf_size) const override { return ERR_OK; }
+            int getProperty(const char* key, void* buf, int buf_size) const override;
             const char* getName() const override { return filterName_.c_str(); }
+            void setExtensionControl(agora::agora_refptr<IAudioFilterV2::Control> control) override {
+                audioProcessor_->setExtensionControl(control);
+            }
         private:
             std::atomic_bool enabled_ = {true};
             std::string filterName_;
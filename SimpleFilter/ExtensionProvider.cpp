@@ -4,6 +4,8 @@
 
 #include "ExtensionProvider.hpp"
 
+#include <string.h>
+
 namespace agora {
     namespace extension {
         ExtensionProvider::ExtensionProvider() {
@@ -14,6 +16,7 @@ namespace agora {
         ExtensionProvider::~ExtensionProvider() {
             audioProcessor_.reset();
             YUVProcessor_.reset();
+            VideoFrameSink::clearRegistry();
         }
 
         // Provide information about all plug-ins that support packaging.
@@ -21,7 +24,7 @@ namespace agora {
         // You need to provide information about all plug-ins that support encapsulation.
         void ExtensionProvider::enumerateExtensions(ExtensionMetaInfo* extension_list,
                                                            int& extension_count) {
-            extension_count = 2;
+            extension_count = 3;
             //Declare a Video Filter, and IExtensionProvider::createVideoFilter will be called
             ExtensionMetaInfo i;
             i.type = EXTENSION_TYPE::VIDEO_PRE_PROCESSING_FILTER;
@@ -33,6 +36,25 @@ namespace agora {
             j.type = EXTENSION_TYPE::AUDIO_FILTER;
             j.extension_name = agora::extension::AUDIO_FILTER_NAME;
             extension_list[1] = j;
+
+            //Declare a Video Sink, and IExtensionProvider::createVideoSink will be called
+            ExtensionMetaInfo k;
+            k.type = EXTENSION_TYPE::VIDEO_SINK;
+            k.extension_name = agora::extension::VIDEO_SINK_NAME;
+            extension_list[2] = k;
+        }
+
+        // Report the interface version of each plug-in. The audio filter is an IAudioFilterV2, so the SDK
+        // hands it a control through setExtensionControl, which it needs to post events.
+        void ExtensionProvider::getExtensionVersion(const char* extension_name, rtc::ExtensionVersion& version) {
+            if (extension_name && strcmp(extension_name, AUDIO_FILTER_NAME) == 0) {
+                version = rtc::ExtensionInterfaceVersion<rtc::IAudioFilterV2>::Version();
+            } else if (extension_name && strcmp(extension_name, VIDEO_FILTER_NAME) == 0) {
+                version = rtc::ExtensionInterfaceVersion<rtc::IExtensionVideoFilter>::Version();
+            } else if (extension_name && strcmp(extension_name, VIDEO_SINK_NAME) == 0) {
+                // The SDK has no versioned sink interface yet, so the sink is at the first version.
+                version = rtc::ExtensionVersion(1, 0, 0);
+            }
         }
 
         // Create a video plug-in. After the SDK calls this method, you need to return the IExtensionVideoFilter instance
@@ -47,8 +69,11 @@ namespace agora {
             return audioFilter;
         }
 
+        // Create a video sink. Processed frames are delivered to it and passed on to the consumers registered with it
         agora_refptr<agora::rtc::IVideoSinkBase> ExtensionProvider::createVideoSink(const char* name) {
-            return nullptr;
+            agora_refptr<VideoFrameSink> videoSink = new agora::RefCountedObject<VideoFrameSink>();
+            VideoFrameSink::registerSink(name ? name : VIDEO_SINK_NAME, videoSink);
+            return videoSink;
         }
 
         void ExtensionProvider::setExtensionControl(rtc::IExtensionControl* control){
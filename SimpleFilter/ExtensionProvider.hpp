@@ -8,13 +8,16 @@
 #include "AgoraRtcKit/NGIAgoraExtensionProvider.h"
 #include "ExtensionAudioFilter.hpp"
 #include "ExtensionVideoFilter.hpp"
+#include "VideoFrameSink.hpp"
 
 namespace agora {
     namespace extension {
         static const char* AUDIO_FILTER_NAME = "VolumeChange";
         static const char* VIDEO_FILTER_NAME = "Grey";
+        // Consumers look the sink up with VideoFrameSink::find(VIDEO_SINK_NAME).
+        static const char* VIDEO_SINK_NAME = "FrameTap";
 
-        class ExtensionProvider : public agora::rtc::IExtensionProvider {
+        class ExtensionProvider : public agora::rtc::IExtensionProviderV2 {
         private:
             agora_refptr<AdjustVolumeAudioProcessor> audioProcessor_;
             agora_refptr<YUVImageProcessor> YUVProcessor_;
@@ -25,6 +28,7 @@ namespace agora {
 
             void setExtensionControl(rtc::IExtensionControl* control) override;
             void enumerateExtensions(ExtensionMetaInfo* extension_list, int& extension_count) override;
+            void getExtensionVersion(const char* extension_name, rtc::ExtensionVersion& version) override;
             agora_refptr<rtc::IAudioFilter> createAudioFilter(const char* name) override;
             agora_refptr<rtc::IExtensionVideoFilter> createVideoFilter(const char* name) override;
             agora_refptr<rtc::IVideoSinkBase> createVideoSink(const char* name) override;
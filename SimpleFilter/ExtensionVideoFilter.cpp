@@ -4,6 +4,7 @@
 
 #include "ExtensionVideoFilter.hpp"
 #include <sstream>
+#include <cstring>
 
 namespace agora {
     namespace extension {
@@ -74,7 +75,9 @@ namespace agora {
                 threadPool_.PostTask(invoker_id, [videoFrame=frame, processor=YUVProcessor, control=control_] {
                     rtc::VideoFrameData srcData;
                     videoFrame->getVideoFrameData(srcData);
-                    processor->processFrame(srcData);
+                    if (processor->processFrame(srcData) == YUVImageProcessor::kFrameDropped) {
+                        return;
+                    }
                     // In asynchronous mode (mode is set to Async),
                     // the plug-in needs to call this method to return the processed video frame to the SDK.
                     control->deliverVideoFrame(videoFrame);
@@ -93,7 +96,9 @@ namespace agora {
             if (isSyncMode && YUVProcessor) {
                 rtc::VideoFrameData srcData;
                 src->getVideoFrameData(srcData);
-                YUVProcessor->processFrame(srcData);
+                if (YUVProcessor->processFrame(srcData) == YUVImageProcessor::kFrameDropped) {
+                    return kDrop;
+                }
                 dst = src;
                 return kSuccess;
             }
@@ -104,10 +109,12 @@ namespace agora {
         // Agora SDK will call this method to set video plug-in properties
         int ExtensionVideoFilter::setProperty(const char *key, const void *buf,
                                                  size_t buf_size) {
-            printf("setProperty  %s  %s\n", key, buf);
-            std::string stringParameter((char*)buf);
-            YUVProcessor->setParameters(stringParameter);
-            return 0;
+            if (!key || !buf) {
+                return -1;
+            }
+            std::string stringParameter((char*)buf, strnlen((char*)buf, buf_size));
+            printf("setProperty  %s  %s\n", key, stringParameter.c_str());
+            return YUVProcessor->setProperty(key, stringParameter);
         }
 
         // When the app developer calls getExtensionProperty,
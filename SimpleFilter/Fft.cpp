@@ -0,0 +1,209 @@
+//
+//  Fft.cpp
+//  SimpleFilter
+//
+
+#include "Fft.hpp"
+#include "SimdUtils.hpp"
+
+#include <cmath>
+
+namespace agora {
+    namespace extension {
+        void RealFft::prepare(int size) {
+            size_ = size;
+            half_ = size / 2;
+            const int n = half_;
+            int bits = 0;
+            while ((1 << bits) < n) {
+                bits++;
+            }
+            reverse_.resize(n);
+            for (int i = 0; i < n; i++) {
+                int r = 0;
+                for (int b = 0; b < bits; b++) {
+                    r |= ((i >> b) & 1) << (bits - 1 - b);
+                }
+                reverse_[i] = r;
+            }
+            // A radix-2 stage over half-size h needs e^(-i pi j / h); a radix-4 stage over quarter-size h
+            // needs its first, second and third powers with j / 2h. Both are stored at [h + j].
+            stageRe_.assign(n, 0.0f);
+            stageIm_.assign(n, 0.0f);
+            for (int p = 0; p < 3; p++) {
+                quadRe_[p].assign(n, 0.0f);
+                quadIm_[p].assign(n, 0.0f);
+            }
+            for (int h = 1; h < n; h *= 2) {
+                for (int j = 0; j < h; j++) {
+                    stageRe_[h + j] = static_cast<float>(std::cos(M_PI * j / h));
+                    stageIm_[h + j] = static_cast<float>(-std::sin(M_PI * j / h));
+                    for (int p = 0; p < 3; p++) {
+                        quadRe_[p][h + j] = static_cast<float>(std::cos(M_PI * (p + 1) * j / (2 * h)));
+                        quadIm_[p][h + j] = static_cast<float>(-std::sin(M_PI * (p + 1) * j / (2 * h)));
+                    }
+                }
+            }
+            splitRe_.resize(n + 1);
+            splitIm_.resize(n + 1);
+            for (int k = 0; k <= n; k++) {
+                splitRe_[k] = static_cast<float>(std::cos(M_PI * k / n));
+                splitIm_[k] = static_cast<float>(-std::sin(M_PI * k / n));
+            }
+            workRe_.assign(n, 0.0f);
+            workIm_.assign(n, 0.0f);
+        }
+
+        // In place on the work arrays, which hold the input in bit-reversed order.
+        void RealFft::transform() {
+            using namespace simd;
+            const int n = half_;
+            float* re = workRe_.data();
+            float* im = workIm_.data();
+            // The first two stages have the trivial twiddles 1 and -i.
+            for (int s = 0; s < n; s += 4) {
+                const float r0 = re[s] + re[s + 1], i0 = im[s] + im[s + 1];
+                const float r1 = re[s] - re[s + 1], i1 = im[s] - im[s + 1];
+                const float r2 = re[s + 2] + re[s + 3], i2 = im[s + 2] + im[s + 3];
+                const float r3 = re[s + 2] - re[s + 3], i3 = im[s + 2] - im[s + 3];
+                re[s] = r0 + r2;
+                im[s] = i0 + i2;
+                re[s + 2] = r0 - r2;
+                im[s + 2] = i0 - i2;
+                // -i (r3 + i i3) = i3 - i r3
+                re[s + 1] = r1 + i3;
+                im[s + 1] = i1 - r3;
+                re[s + 3] = r1 - i3;
+                im[s + 3] = i1 + r3;
+            }
+            int h = 4;
+            int stages = 0;
+            for (int m = n / h; m > 1; m /= 2) {
+                stages++;
+            }
+            // One radix-2 stage when the remaining stages do not pair up.
+            if (stages % 2 != 0) {
+                const float* wRe = stageRe_.data() + h;
+                const float* wIm = stageIm_.data() + h;
+                for (int s = 0; s < n; s += 2 * h) {
+                    float* aRe = re + s;
+                    float* aIm = im + s;
+                    float* bRe = aRe + h;
+                    float* bIm = aIm + h;
+                    for (int j = 0; j < h; j += 4) {
+                        const F32x4 wr = loadF(wRe + j);
+                        const F32x4 wi = loadF(wIm + j);
+                        const F32x4 br = loadF(bRe + j);
+                        const F32x4 bi = loadF(bIm + j);
+                        const F32x4 tr = sub(mul(wr, br), mul(wi, bi));
+                        const F32x4 ti = madd(mul(wr, bi), wi, br);
+                        const F32x4 ar = loadF(aRe + j);
+                        const F32x4 ai = loadF(aIm + j);
+                        storeF(aRe + j, add(ar, tr));
+                        storeF(aIm + j, add(ai, ti));
+                        storeF(bRe + j, sub(ar, tr));
+                        storeF(bIm + j, sub(ai, ti));
+                    }
+                }
+                h *= 2;
+            }
+            // Radix 4: two radix-2 stages at once over four quarter-size transforms a, b, c, d, each twiddled
+            // by a power of v = e^(-i pi j / 2h): b1 = v^2 b, c1 = v c, d1 = v^3 d, then
+            // a + b1 + (c1 + d1), (a - b1) - i (c1 - d1), a + b1 - (c1 + d1), (a - b1) + i (c1 - d1).
+            for (; h < n; h *= 4) {
+                const float* w1Re = quadRe_[0].data() + h;
+                const float* w1Im = quadIm_[0].data() + h;
+                const float* w2Re = quadRe_[1].data() + h;
+                const float* w2Im = quadIm_[1].data() + h;
+                const float* w3Re = quadRe_[2].data() + h;
+                const float* w3Im = quadIm_[2].data() + h;
+                for (int s = 0; s < n; s += 4 * h) {
+                    float* aRe = re + s;
+                    float* aIm = im + s;
+                    for (int j = 0; j < h; j += 4) {
+                        F32x4 xr = loadF(aRe + h + j);
+                        F32x4 xi = loadF(aIm + h + j);
+                        F32x4 wr = loadF(w2Re + j);
+                        F32x4 wi = loadF(w2Im + j);
+                        const F32x4 br = sub(mul(wr, xr), mul(wi, xi));
+                        const F32x4 bi = madd(mul(wr, xi), wi, xr);
+                        xr = loadF(aRe + 2 * h + j);
+                        xi = loadF(aIm + 2 * h + j);
+                        wr = loadF(w1Re + j);
+                        wi = loadF(w1Im + j);
+                        const F32x4 cr = sub(mul(wr, xr), mul(wi, xi));
+                        const F32x4 ci = madd(mul(wr, xi), wi, xr);
+                        xr = loadF(aRe + 3 * h + j);
+                        xi = loadF(aIm + 3 * h + j);
+                        wr = loadF(w3Re + j);
+                        wi = loadF(w3Im + j);
+                        const F32x4 dr = sub(mul(wr, xr), mul(wi, xi));
+                        const F32x4 di = madd(mul(wr, xi), wi, xr);
+                        const F32x4 ar = loadF(aRe + j);
+                        const F32x4 ai = loadF(aIm + j);
+                        const F32x4 sumRe = add(ar, br), sumIm = add(ai, bi);
+                        const F32x4 diffRe = sub(ar, br), diffIm = sub(ai, bi);
+                        const F32x4 pairRe = add(cr, dr), pairIm = add(ci, di);
+                        const F32x4 crossRe = sub(cr, dr), crossIm = sub(ci, di);
+                        storeF(aRe + j, add(sumRe, pairRe));
+                        storeF(aIm + j, add(sumIm, pairIm));
+                        storeF(aRe + 2 * h + j, sub(sumRe, pairRe));
+                        storeF(aIm + 2 * h + j, sub(sumIm, pairIm));
+                        // -i (x + i y) = y - i x
+                        storeF(aRe + h + j, add(diffRe, crossIm));
+                        storeF(aIm + h + j, sub(diffIm, crossRe));
+                        storeF(aRe + 3 * h + j, sub(diffRe, crossIm));
+                        storeF(aIm + 3 * h + j, add(diffIm, crossRe));
+                    }
+                }
+            }
+        }
+
+        void RealFft::forward(const float* input, float* re, float* im) {
+            const int n = half_;
+            // Even samples as the real part, odd ones as the imaginary part of a half-size transform.
+            for (int m = 0; m < n; m++) {
+                workRe_[reverse_[m]] = input[2 * m];
+                workIm_[reverse_[m]] = input[2 * m + 1];
+            }
+            transform();
+            // Z[k] = E[k] + i O[k] with E and O the transforms of the even and odd samples, so
+            // E[k] = (Z[k] + conj Z[n - k]) / 2, O[k] = -i (Z[k] - conj Z[n - k]) / 2 and
+            // X[k] = E[k] + e^(-2 i pi k / size) O[k].
+            re[0] = workRe_[0] + workIm_[0];
+            im[0] = 0;
+            re[n] = workRe_[0] - workIm_[0];
+            im[n] = 0;
+            for (int k = 1; k < n; k++) {
+                const float zr = workRe_[k], zi = workIm_[k];
+                const float cr = workRe_[n - k], ci = -workIm_[n - k];
+                const float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+                const float or_ = 0.5f * (zi - ci), oi = -0.5f * (zr - cr);
+                re[k] = er + splitRe_[k] * or_ - splitIm_[k] * oi;
+                im[k] = ei + splitRe_[k] * oi + splitIm_[k] * or_;
+            }
+        }
+
+        void RealFft::inverse(const float* re, const float* im, float* output) {
+            const int n = half_;
+            // Rebuild Z[k] = E[k] + i O[k], with O[k] = (X[k] - conj X[n - k]) e^(2 i pi k / size) / 2, and
+            // run the forward transform on its conjugate.
+            for (int k = 0; k < n; k++) {
+                const float xr = re[k], xi = k == 0 ? 0.0f : im[k];
+                const float cr = re[n - k], ci = k == 0 ? 0.0f : -im[n - k];
+                const float er = 0.5f * (xr + cr), ei = 0.5f * (xi + ci);
+                const float dr = 0.5f * (xr - cr), di = 0.5f * (xi - ci);
+                const float or_ = dr * splitRe_[k] + di * splitIm_[k];
+                const float oi = di * splitRe_[k] - dr * splitIm_[k];
+                workRe_[reverse_[k]] = er - oi;
+                workIm_[reverse_[k]] = -(ei + or_);
+            }
+            transform();
+            const float scale = 1.0f / n;
+            for (int m = 0; m < n; m++) {
+                output[2 * m] = workRe_[m] * scale;
+                output[2 * m + 1] = -workIm_[m] * scale;
+            }
+        }
+    }
+}
@@ -0,0 +1,53 @@
+//
+//  Fft.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_FFT_H
+#define AGORA_FFT_H
+
+#include <vector>
+
+namespace agora {
+    namespace extension {
+        // FFT of real input with a power-of-two size, in split format: the real and imaginary parts of
+        // bins 0 to size / 2 are separate arrays, which is the layout the butterflies vectorize over. The
+        // input is packed into a half-size complex transform, radix 4 (plus one radix-2 stage for odd
+        // powers of two) with precomputed twiddles.
+        // Not thread-safe; each user keeps its own.
+        class RealFft {
+        public:
+            // Sizes the tables and work buffers for `size` samples (a power of two, 16 or more); the only
+            // call that allocates.
+            void prepare(int size);
+            int size() const { return size_; }
+            int bins() const { return size_ / 2 + 1; }
+
+            // `input` holds size() samples; `re` and `im` receive bins() values each. Not scaled.
+            void forward(const float* input, float* re, float* im);
+            // The inverse of forward, scaled by 1 / size() so that a round trip returns the input.
+            // Only the real part of the first and last bins is used.
+            void inverse(const float* re, const float* im, float* output);
+
+        private:
+            void transform();
+
+            int size_ = 0;
+            int half_ = 0;
+            std::vector<int> reverse_;
+            // Butterfly twiddles at [h + j] for every stage size h: radix 2 and the three of radix 4.
+            std::vector<float> stageRe_;
+            std::vector<float> stageIm_;
+            std::vector<float> quadRe_[3];
+            std::vector<float> quadIm_[3];
+            // e^(-2 i pi k / size) for k from 0 to size / 2, to split the packed transform.
+            std::vector<float> splitRe_;
+            std::vector<float> splitIm_;
+            std::vector<float> workRe_;
+            std::vector<float> workIm_;
+        };
+    }
+}
+
+
+#endif //AGORA_FFT_H
@@ -0,0 +1,208 @@
+//
+//  FrameFingerprint.cpp
+//  SimpleFilter
+//
+
+#include "FrameFingerprint.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace agora {
+    namespace extension {
+        static const int kGrid = 32;
+        static const int kCoefficients = 8;
+        // Rows summed per grid cell; the thumbnail does not need every row of a large frame.
+        static const int kRowsPerCell = 8;
+
+        // Rows 0 - 7 of the orthonormal 32-point DCT-II, transposed so that entry [n][k] multiplies sample n
+        // into coefficient k.
+        struct DctTable {
+            float basis[kGrid][kCoefficients];
+
+            DctTable() {
+                const double pi = 3.14159265358979323846;
+                for (int n = 0; n < kGrid; n++) {
+                    for (int k = 0; k < kCoefficients; k++) {
+                        double scale = std::sqrt((k == 0 ? 1.0 : 2.0) / kGrid);
+                        basis[n][k] = static_cast<float>(scale * std::cos(pi * (2 * n + 1) * k / (2 * kGrid)));
+                    }
+                }
+            }
+        };
+
+        static int popcount64(uint64_t v) {
+            int count = 0;
+            while (v) {
+                v &= v - 1;
+                count++;
+            }
+            return count;
+        }
+
+        int fingerprintDistance(const Fingerprint& a, const Fingerprint& b) {
+            return std::max(popcount64(a.pHash ^ b.pHash), popcount64(a.dHash ^ b.dHash));
+        }
+
+        Fingerprint FrameFingerprinter::compute(const PlaneView& luma, std::vector<uint32_t>& scratch) {
+            using namespace simd;
+            static const DctTable table;
+            Fingerprint result;
+            if (luma.width < kGrid || luma.height < kGrid) {
+                return result;
+            }
+
+            // Area-averaged 32x32 thumbnail from a subset of rows; every column of those rows counts.
+            scratch.resize(kGrid * kGrid + kGrid + kGrid + 1);
+            uint32_t* sums = scratch.data();
+            uint32_t* counts = sums + kGrid * kGrid;
+            uint32_t* edges = counts + kGrid;
+            for (int cx = 0; cx <= kGrid; cx++) {
+                edges[cx] = static_cast<uint32_t>(cx * luma.width / kGrid);
+            }
+            std::fill(sums, sums + kGrid * kGrid + kGrid, 0);
+            for (int cy = 0; cy < kGrid; cy++) {
+                const int y0 = cy * luma.height / kGrid;
+                const int y1 = (cy + 1) * luma.height / kGrid;
+                const int step = std::max(1, (y1 - y0) / kRowsPerCell);
+                uint32_t* row = sums + cy * kGrid;
+                for (int y = y0 + step / 2; y < y1; y += step) {
+                    const uint8_t* p = luma.row(y);
+                    for (int cx = 0; cx < kGrid; cx++) {
+                        uint32_t sum = 0;
+                        for (uint32_t x = edges[cx]; x < edges[cx + 1]; x++) {
+                            sum += p[x];
+                        }
+                        row[cx] += sum;
+                    }
+                    counts[cy] += 1;
+                }
+            }
+            float thumb[kGrid][kGrid];
+            for (int cy = 0; cy < kGrid; cy++) {
+                for (int cx = 0; cx < kGrid; cx++) {
+                    const int columns = (cx + 1) * luma.width / kGrid - cx * luma.width / kGrid;
+                    thumb[cy][cx] = static_cast<float>(sums[cy * kGrid + cx]) / (columns * counts[cy]);
+                }
+            }
+
+            // Only the low 8x8 block is needed: rows first into 32x8, then columns into 8x8.
+            float rows[kGrid][kCoefficients];
+            for (int r = 0; r < kGrid; r++) {
+                F32x4 lo = splatF(0);
+                F32x4 hi = splatF(0);
+                for (int n = 0; n < kGrid; n++) {
+                    F32x4 sample = splatF(thumb[r][n]);
+                    lo = madd(lo, sample, loadF(&table.basis[n][0]));
+                    hi = madd(hi, sample, loadF(&table.basis[n][4]));
+                }
+                storeF(&rows[r][0], lo);
+                storeF(&rows[r][4], hi);
+            }
+            float dct[kCoefficients * kCoefficients];
+            for (int k = 0; k < kCoefficients; k++) {
+                F32x4 lo = splatF(0);
+                F32x4 hi = splatF(0);
+                for (int r = 0; r < kGrid; r++) {
+                    F32x4 weight = splatF(table.basis[r][k]);
+                    lo = madd(lo, weight, loadF(&rows[r][0]));
+                    hi = madd(hi, weight, loadF(&rows[r][4]));
+                }
+                storeF(&dct[k * kCoefficients], lo);
+                storeF(&dct[k * kCoefficients + 4], hi);
+            }
+            // Compared with the median of the AC coefficients; the DC term only carries the brightness.
+            float ac[kCoefficients * kCoefficients - 1];
+            std::copy(dct + 1, dct + kCoefficients * kCoefficients, ac);
+            const int middle = (kCoefficients * kCoefficients - 1) / 2;
+            std::nth_element(ac, ac + middle, ac + kCoefficients * kCoefficients - 1);
+            const float median = ac[middle];
+            for (int i = 1; i < kCoefficients * kCoefficients; i++) {
+                if (dct[i] > median) {
+                    result.pHash |= uint64_t(1) << i;
+                }
+            }
+
+            // 9x8 thumbnail interpolated from the 32x32 one, then one bit per horizontal neighbour pair.
+            for (int y = 0; y < 8; y++) {
+                const float* top = thumb[y * 4 + 1];
+                const float* bottom = thumb[y * 4 + 2];
+                float previous = 0;
+                for (int x = 0; x < 9; x++) {
+                    const float fx = (x + 0.5f) * kGrid / 9 - 0.5f;
+                    const int x0 = std::min(static_cast<int>(fx), kGrid - 2);
+                    const float w = fx - x0;
+                    const float value = (top[x0] + bottom[x0]) * (1 - w) + (top[x0 + 1] + bottom[x0 + 1]) * w;
+                    if (x > 0 && value > previous) {
+                        result.dHash |= uint64_t(1) << (y * 8 + x - 1);
+                    }
+                    previous = value;
+                }
+            }
+            return result;
+        }
+
+        int FrameFingerprinter::setProperty(const std::string& key, const std::string& value) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            if (key == "fingerprint") {
+                enabled_ = (value == "1");
+                if (!enabled_) {
+                    hasPrevious_ = false;
+                }
+            } else if (key == "fingerprint_threshold") {
+                threshold_ = std::max(1, std::min(64, atoi(value.c_str())));
+            } else if (key == "fingerprint_cut_threshold") {
+                cutThreshold_ = std::max(1, std::min(64, atoi(value.c_str())));
+            } else if (key == "fingerprint_keepalive_ms") {
+                keepAliveMs_ = std::max(0, atoi(value.c_str()));
+            } else {
+                return -2;
+            }
+            return 0;
+        }
+
+        bool FrameFingerprinter::isEnabled() {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            return enabled_;
+        }
+
+        bool FrameFingerprinter::process(const PlaneView& luma, int64_t timestampMs, std::string& event) {
+            int threshold;
+            int cutThreshold;
+            int64_t keepAliveMs;
+            bool restart;
+            {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                if (!enabled_) {
+                    return false;
+                }
+                threshold = threshold_;
+                cutThreshold = cutThreshold_;
+                keepAliveMs = keepAliveMs_;
+                restart = !hasPrevious_;
+                hasPrevious_ = true;
+            }
+            Fingerprint current = compute(luma, scratch_);
+            int change = restart ? 64 : fingerprintDistance(current, previous_);
+            int drift = restart ? 64 : fingerprintDistance(current, reported_);
+            previous_ = current;
+            bool cut = change >= cutThreshold;
+            bool stale = keepAliveMs > 0 && timestampMs - reportedMs_ >= keepAliveMs;
+            if (!cut && drift < threshold && !stale) {
+                return false;
+            }
+            reported_ = current;
+            reportedMs_ = timestampMs;
+            char value[160];
+            snprintf(value, sizeof(value),
+                     "{\"phash\":\"%016" PRIx64 "\",\"dhash\":\"%016" PRIx64 "\",\"change\":%d,\"drift\":%d,\"cut\":%d}",
+                     current.pHash, current.dHash, change, drift, cut ? 1 : 0);
+            event = value;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+//
+//  FrameFingerprint.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_FRAMEFINGERPRINT_H
+#define AGORA_FRAMEFINGERPRINT_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ImageFilters.hpp"
+
+namespace agora {
+    namespace extension {
+        // 64-bit perceptual hashes of a luma plane. Similar pictures give hashes that differ in few bits,
+        // so the Hamming distance between two hashes measures how much the content changed.
+        struct Fingerprint {
+            uint64_t pHash = 0; // signs of the low 8x8 DCT coefficients of a 32x32 area-averaged thumbnail
+            uint64_t dHash = 0; // signs of the horizontal gradients of a 9x8 thumbnail
+        };
+
+        // Hamming distance of the pHash and dHash, whichever is larger, 0 - 64.
+        int fingerprintDistance(const Fingerprint& a, const Fingerprint& b);
+
+        // Computes a fingerprint of every frame and decides when the content changed enough to be worth
+        // looking at again, e.g. for moderation sampling: a frame is reported when it drifted at least
+        // `threshold` bits away from the last reported one, when it differs from the previous frame by
+        // `cutThreshold` bits (a scene cut), or when `keepAliveMs` passed without a report.
+        class FrameFingerprinter {
+        public:
+            // Handles the "fingerprint*" extension properties. Returns -1 for a bad value, -2 for an unknown key.
+            int setProperty(const std::string& key, const std::string& value);
+
+            bool isEnabled();
+
+            // Fingerprints `luma`. Returns true and fills `event` with the JSON to post when the frame should
+            // be reported. Video thread only.
+            bool process(const PlaneView& luma, int64_t timestampMs, std::string& event);
+
+            static Fingerprint compute(const PlaneView& luma, std::vector<uint32_t>& scratch);
+
+        private:
+            std::mutex mutex_;
+            bool enabled_ = false;
+            int threshold_ = 10;
+            int cutThreshold_ = 22;
+            int64_t keepAliveMs_ = 10000;
+            // Cleared when the stage is switched off so the first frame after switching on is reported.
+            bool hasPrevious_ = false;
+
+            // Video thread only.
+            std::vector<uint32_t> scratch_;
+            Fingerprint previous_;
+            Fingerprint reported_;
+            int64_t reportedMs_ = 0;
+        };
+    }
+}
+
+
+#endif //AGORA_FRAMEFINGERPRINT_H
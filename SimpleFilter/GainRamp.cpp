@@ -0,0 +1,84 @@
+//
+//  GainRamp.cpp
+//  SimpleFilter
+//
+
+#include "GainRamp.hpp"
+#include "AudioKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace agora {
+    namespace extension {
+        // -60 dB: where exponential ramps start from or end at when one side is silence.
+        static const float kExponentialFloor = 0.001f;
+
+        void GainRamp::update(int sampleRateHz) {
+            const float target = target_.load(std::memory_order_relaxed);
+            if (target != rampTarget_) {
+                rampTarget_ = target;
+                int64_t length = static_cast<int64_t>(rampMs_.load(std::memory_order_relaxed)) * std::max(sampleRateHz, 1) / 1000;
+                exponential_ = shape_.load(std::memory_order_relaxed) == kExponential;
+                if (length <= 0) {
+                    current_ = target;
+                    remaining_ = 0;
+                } else if (exponential_ && current_ * target >= 0) {
+                    // The shape works on the magnitude and keeps the sign of whichever end has one.
+                    const float sign = current_ < 0 || target < 0 ? -1.0f : 1.0f;
+                    float from = sign * std::max(std::fabs(current_), kExponentialFloor);
+                    float to = sign * std::max(std::fabs(target), kExponentialFloor);
+                    current_ = from;
+                    step_ = std::pow(to / from, 1.0f / length);
+                    remaining_ = length;
+                } else {
+                    // No constant ratio crosses zero, so such ramps go linearly whatever the shape.
+                    exponential_ = false;
+                    step_ = (target - current_) / length;
+                    remaining_ = length;
+                }
+                // The lanes are set up again from the new ramp on its first int16 frame.
+                lanes_.channels = 0;
+            }
+        }
+
+        void GainRamp::finishRamp(size_t done) {
+            remaining_ -= done;
+            if (remaining_ == 0) {
+                // Land exactly on the target, including silence at the end of an exponential ramp.
+                current_ = rampTarget_;
+            }
+        }
+
+        void GainRamp::process(const int16_t* in, int16_t* out, size_t frames, int channels, int sampleRateHz) {
+            update(sampleRateHz);
+            size_t done = 0;
+            if (remaining_ > 0) {
+                done = static_cast<size_t>(std::min<int64_t>(remaining_, frames));
+                if (lanes_.channels != channels) {
+                    prepareGainRamp(lanes_, channels, current_, step_, exponential_, rampTarget_);
+                }
+                current_ = applyGainRampS16(in, out, done, lanes_);
+                finishRamp(done);
+            }
+            if (done < frames) {
+                applyGainS16(in + done * channels, out + done * channels, (frames - done) * channels, current_);
+            }
+        }
+
+        void GainRamp::process(float* data, size_t frames, int channels, int sampleRateHz) {
+            update(sampleRateHz);
+            size_t done = 0;
+            if (remaining_ > 0) {
+                done = static_cast<size_t>(std::min<int64_t>(remaining_, frames));
+                current_ = applyGainRampF32(data, done, channels, current_, step_, exponential_);
+                // The int16 lanes are behind now.
+                lanes_.channels = 0;
+                finishRamp(done);
+            }
+            if (done < frames && current_ != 1.0f) {
+                applyGainF32(data + done * channels, (frames - done) * channels, current_);
+            }
+        }
+    }
+}
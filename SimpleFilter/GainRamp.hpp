@@ -0,0 +1,61 @@
+//
+//  GainRamp.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_GAINRAMP_H
+#define AGORA_GAINRAMP_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "AudioKernels.hpp"
+
+namespace agora {
+    namespace extension {
+        // Gain that glides to a new target instead of jumping, which avoids zipper noise and clicks on
+        // large volume changes. Targets may be set from any thread; process runs on the audio thread.
+        class GainRamp {
+        public:
+            enum Shape {
+                kLinear = 0,
+                // Constant rate in dB, which sounds even across the ramp; zero is approached from -60 dB.
+                kExponential
+            };
+
+            void setTarget(float gain) { target_ = gain; }
+            float target() const { return target_; }
+            // 0 applies changes at the next frame boundary, as before ramps existed.
+            void setRampMs(int ms) { rampMs_ = ms < 0 ? 0 : ms; }
+            void setShape(Shape shape) { shape_ = shape; }
+
+            // Applies the gain to `frames` interleaved frames; a ramp may span several calls.
+            void process(const int16_t* in, int16_t* out, size_t frames, int channels, int sampleRateHz);
+            // The same on float samples, in place.
+            void process(float* data, size_t frames, int channels, int sampleRateHz);
+            // Audio thread: true when the gain rests at 1 and process would leave the samples as they are.
+            bool isUnity() const { return current_ == 1.0f && remaining_ == 0 && target_.load(std::memory_order_relaxed) == 1.0f; }
+
+        private:
+            // Starts a new ramp if the target changed since the last frame.
+            void update(int sampleRateHz);
+            void finishRamp(size_t done);
+
+            std::atomic<float> target_ = {1.0f};
+            std::atomic<int> rampMs_ = {20};
+            std::atomic<int> shape_ = {kLinear};
+
+            // Audio thread only.
+            float current_ = 1.0f;
+            float rampTarget_ = 1.0f;
+            float step_ = 0;
+            bool exponential_ = false;
+            int64_t remaining_ = 0;
+            // The ramp in progress on the int16 path; no channels until it is set up.
+            GainRampLanes lanes_ = {};
+        };
+    }
+}
+
+
+#endif //AGORA_GAINRAMP_H
@@ -0,0 +1,251 @@
+//
+//  GainRampTest.cpp
+//  SimpleFilter
+//
+//  Checks and benchmark for GainRamp and the gain kernels. Not part of the extension target, build and run it
+//  on its own:
+//      c++ -O2 -std=c++14 AudioKernels.cpp GainRamp.cpp GainRampTest.cpp -o GainRampTest && ./GainRampTest
+//  Returns non-zero if any check fails. Add -mavx2 for the AVX2 path of applyGainS16.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "AudioKernels.hpp"
+#include "GainRamp.hpp"
+
+using namespace agora::extension;
+
+static int gFailures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        gFailures++;
+    }
+}
+
+// applyGainS16 matches FloatS16ToS16 for every int16 input, for gains from zero and tiny through negative
+// to far past clipping, and for any count.
+static void testConstantGain() {
+    std::vector<float> gains = {0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 1e-6f, -1e-6f, 100.0f, -100.0f, 32767.0f, 40000.0f};
+    srand(2);
+    while (gains.size() < 2000) {
+        gains.push_back((rand() / float(RAND_MAX) - 0.5f) * (gains.size() % 2 ? 4.0f : 200.0f));
+    }
+    std::vector<int16_t> in(65536 + 7), out(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = static_cast<int16_t>(i - 32768);
+    }
+    size_t mismatches = 0;
+    for (size_t g = 0; g < gains.size(); g++) {
+        // An odd count now and then, so the scalar tail runs too.
+        const size_t count = g % 3 ? in.size() : in.size() - g % 16;
+        applyGainS16(in.data(), out.data(), count, gains[g]);
+        for (size_t i = 0; i < count; i++) {
+            mismatches += out[i] != FloatS16ToS16(in[i] * gains[g]);
+        }
+    }
+    check(mismatches == 0, "applyGainS16 matches FloatS16ToS16");
+}
+
+// What the lanes of applyGainRampS16 compute, one sample at a time.
+static std::vector<int16_t> referenceRamp(const std::vector<int16_t>& in, size_t frames, int channels,
+                                          float gain, float step, bool exponential) {
+    std::vector<int16_t> out(frames * channels);
+    if (16 % channels != 0) {
+        for (size_t f = 0; f < frames; f++) {
+            for (int c = 0; c < channels; c++) {
+                out[f * channels + c] = FloatS16ToS16(in[f * channels + c] * gain);
+            }
+            gain = exponential ? gain * step : gain + step;
+        }
+        return out;
+    }
+    const int framesPerBlock = 16 / channels;
+    float lanes[16];
+    float frameGain = gain;
+    for (int f = 0; f < framesPerBlock; f++) {
+        for (int c = 0; c < channels; c++) {
+            lanes[f * channels + c] = frameGain;
+        }
+        frameGain = exponential ? frameGain * step : gain + step * (f + 1);
+    }
+    float delta = exponential ? 1.0f : step * framesPerBlock;
+    for (int f = 0; exponential && f < framesPerBlock; f++) {
+        delta *= step;
+    }
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = FloatS16ToS16(in[i] * lanes[i % 16]);
+        for (int l = 0; i % 16 == 15 && l < 16; l++) {
+            lanes[l] = exponential ? lanes[l] * delta : lanes[l] + delta;
+        }
+    }
+    return out;
+}
+
+// The vector paths match the reference bit for bit, with and without the clamp, however the frames are split
+// across calls.
+static void testRampKernel() {
+    struct Ramp { float gain, step; bool exponential; };
+    const Ramp ramps[] = {
+        {0.8f, 1e-3f, false}, {0.8f, 1.0007f, true}, {-0.5f, -1e-3f, false}, {-0.001f, 1.01f, true},
+        {30000.0f, 30.0f, false}, {2.0f, 1.3f, true}, {1.0f, -0.004f, false},
+    };
+    const int channelCounts[] = {1, 2, 4, 8, 16, 3, 6};
+    srand(1);
+    for (int channels : channelCounts) {
+        for (const Ramp& ramp : ramps) {
+            const size_t frames = 777;
+            std::vector<int16_t> in(frames * channels);
+            for (int16_t& s : in) {
+                s = static_cast<int16_t>(rand() % 65536 - 32768);
+            }
+            in[0] = 32767;
+            in[in.size() - 1] = -32768;
+            const std::vector<int16_t> expected = referenceRamp(in, frames, channels, ramp.gain, ramp.step, ramp.exponential);
+            for (int split = 0; split < 3; split++) {
+                std::vector<int16_t> out(in.size());
+                GainRampLanes lanes;
+                const float end = ramp.exponential ? ramp.gain * std::pow(ramp.step, float(frames))
+                                                    : ramp.gain + ramp.step * frames;
+                prepareGainRamp(lanes, channels, ramp.gain, ramp.step, ramp.exponential, end);
+                for (size_t done = 0; done < frames;) {
+                    size_t n = split == 0 ? frames : split == 1 ? 1 + rand() % 50 : 441;
+                    n = std::min(n, frames - done);
+                    applyGainRampS16(in.data() + done * channels, out.data() + done * channels, n, lanes);
+                    done += n;
+                }
+                check(out == expected, "ramp kernel matches the reference");
+            }
+        }
+    }
+}
+
+static void testNegativeGain() {
+    std::vector<int16_t> in(960, 10000), out(960);
+    GainRamp gain;
+    gain.setShape(GainRamp::kExponential);
+    gain.setRampMs(0);
+    gain.setTarget(-1.0f);
+    gain.process(in.data(), out.data(), 480, 2, 48000);
+    gain.setRampMs(10);
+    gain.setTarget(-0.25f);
+    gain.process(in.data(), out.data(), 480, 2, 48000);
+    bool negative = true;
+    for (size_t i = 2; i < out.size(); i++) {
+        negative = negative && out[i] < 0 && out[i] >= out[i - 2];
+    }
+    check(negative && out[0] == -10000, "exponential ramp between negative gains keeps the sign");
+    gain.process(in.data(), out.data(), 480, 2, 48000);
+    check(out[0] == -2500, "exponential ramp lands on a negative target");
+    gain.setTarget(0.5f);
+    gain.process(in.data(), out.data(), 480, 2, 48000);
+    bool rising = out[0] == -2500;
+    for (size_t i = 2; i < out.size(); i++) {
+        rising = rising && out[i] >= out[i - 2];
+    }
+    check(rising, "a ramp across zero goes through it");
+}
+
+template <class F>
+static double bestNs(F run) {
+    double best = 1e30;
+    for (int r = 0; r < 200; r++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 20; i++) {
+            run();
+        }
+        best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / 20);
+    }
+    return best;
+}
+
+// Times both in turns and reports the median of their ratios, which holds up better against the clock moving
+// between rounds than comparing two separate minimums does.
+template <class A, class B>
+static void compare(const char* what, A constant, B ramp) {
+    std::vector<double> ratios;
+    double constantNs = 1e30, rampNs = 1e30;
+    for (int round = 0; round < 31; round++) {
+        double c = bestNs(constant);
+        double r = bestNs(ramp);
+        ratios.push_back(r / c);
+        constantNs = std::min(constantNs, c);
+        rampNs = std::min(rampNs, r);
+    }
+    std::sort(ratios.begin(), ratios.end());
+    printf("%-32s constant %6.0f ns, ramp %6.0f ns, median overhead %+.1f%%\n", what, constantNs, rampNs,
+           (ratios[ratios.size() / 2] - 1) * 100);
+}
+
+// One 10 ms stereo frame at 48 kHz through applyGainS16, against the per-sample loop it replaced.
+static void benchConstantGain() {
+    std::vector<int16_t> in(960), out(960);
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = static_cast<int16_t>(8000 * std::sin(i * 0.05));
+    }
+    volatile float volume = 0.8f;
+    const double loopNs = bestNs([&] {
+        const float gain = volume;
+        for (size_t i = 0; i < in.size(); i++) {
+            out[i] = FloatS16ToS16(in[i] * gain);
+        }
+    });
+    const double kernelNs = bestNs([&] { applyGainS16(in.data(), out.data(), in.size(), volume); });
+    printf("%-32s loop %6.0f ns, kernel %6.0f ns\n", "applyGainS16, 960 samples", loopNs, kernelNs);
+}
+
+// 10 ms stereo frames at 48 kHz. The kernel runs a ramp in progress; GainRamp::process includes starting a
+// 20 ms ramp every other frame, against one resting at the same gain.
+static void benchRamp() {
+    const size_t frames = 480;
+    std::vector<int16_t> in(frames * 2), out(frames * 2);
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = static_cast<int16_t>(8000 * std::sin(i * 0.05));
+    }
+    for (int shape = 0; shape < 2; shape++) {
+        const bool exponential = shape == 1;
+        const float step = exponential ? 1.0001f : 1e-5f;
+        GainRampLanes lanes;
+        int calls = 0;
+        compare(exponential ? "applyGainRampS16, exponential" : "applyGainRampS16, linear",
+                [&] { applyGainS16(in.data(), out.data(), in.size(), 0.8f); },
+                [&] {
+                    // Starting over now and then keeps the gain where the constant one is.
+                    if (calls++ % 64 == 0) {
+                        prepareGainRamp(lanes, 2, exponential ? 0.8f : 0.79f, step, exponential, 20.0f);
+                    }
+                    applyGainRampS16(in.data(), out.data(), frames, lanes);
+                });
+
+        GainRamp resting, ramping;
+        resting.setTarget(0.8f);
+        ramping.setShape(exponential ? GainRamp::kExponential : GainRamp::kLinear);
+        float target = 0.8f;
+        compare(exponential ? "GainRamp::process, exponential" : "GainRamp::process, linear",
+                [&] {
+                    resting.process(in.data(), out.data(), frames, 2, 48000);
+                    resting.process(in.data(), out.data(), frames, 2, 48000);
+                },
+                [&] {
+                    target = target == 0.8f ? 0.7f : 0.8f;
+                    ramping.setTarget(target);
+                    ramping.process(in.data(), out.data(), frames, 2, 48000);
+                    ramping.process(in.data(), out.data(), frames, 2, 48000);
+                });
+    }
+}
+
+int main() {
+    testConstantGain();
+    testRampKernel();
+    testNegativeGain();
+    benchConstantGain();
+    benchRamp();
+    printf(gFailures ? "%d checks failed\n" : "all checks passed\n", gFailures);
+    return gFailures ? 1 : 0;
+}
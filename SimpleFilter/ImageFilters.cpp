@@ -0,0 +1,147 @@
+//
+//  ImageFilters.cpp
+//  SimpleFilter
+//
+
+#include "ImageFilters.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace agora {
+    namespace extension {
+        bool wrapI420(const agora::rtc::VideoFrameData& frame, I420View& view) {
+            if (frame.type != agora::rtc::VideoFrameData::Type::kRawPixels
+                || frame.pixels.format != agora::rtc::RawPixelBuffer::Format::kI420
+                || !frame.pixels.data || frame.width <= 0 || frame.height <= 0) {
+                return false;
+            }
+            int chromaWidth = (frame.width + 1) / 2;
+            int chromaHeight = (frame.height + 1) / 2;
+            size_t lumaSize = static_cast<size_t>(frame.width) * frame.height;
+            size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+            if (frame.pixels.size > 0 && static_cast<size_t>(frame.pixels.size) < lumaSize + 2 * chromaSize) {
+                return false;
+            }
+            view.y.data = frame.pixels.data;
+            view.y.width = frame.width;
+            view.y.height = frame.height;
+            view.y.stride = frame.width;
+            view.u.data = frame.pixels.data + lumaSize;
+            view.u.width = chromaWidth;
+            view.u.height = chromaHeight;
+            view.u.stride = chromaWidth;
+            view.v = view.u;
+            view.v.data = view.u.data + chromaSize;
+            return true;
+        }
+
+        void boxBlur(const PlaneView& src, const PlaneView& dst, int radius, BoxBlurScratch& scratch) {
+            const int w = src.width;
+            const int h = src.height;
+            if (w <= 0 || h <= 0) {
+                return;
+            }
+            if (radius <= 0) {
+                if (src.data != dst.data) {
+                    for (int y = 0; y < h; y++) {
+                        memcpy(dst.row(y), src.row(y), w);
+                    }
+                }
+                return;
+            }
+
+            // Multiplying by a 16-bit reciprocal instead of dividing; flooring it keeps 255 * n * inv
+            // below 256 << 16, so the rounded result always fits in a byte.
+            const uint32_t inv = 65536 / (2 * radius + 1);
+            scratch.rows.resize(static_cast<size_t>(w) * h);
+            scratch.sums.resize(w);
+
+            // Horizontal pass into scratch. The whole source is consumed before dst is written,
+            // which is what makes in-place blurring safe.
+            for (int y = 0; y < h; y++) {
+                const uint8_t* s = src.row(y);
+                uint8_t* t = &scratch.rows[static_cast<size_t>(y) * w];
+                uint32_t sum = s[0] * (radius + 1);
+                for (int i = 1; i <= radius; i++) {
+                    sum += s[std::min(i, w - 1)];
+                }
+                for (int x = 0; x < w; x++) {
+                    t[x] = static_cast<uint8_t>((sum * inv + 32768) >> 16);
+                    sum += s[std::min(x + radius + 1, w - 1)];
+                    sum -= s[std::max(x - radius, 0)];
+                }
+            }
+
+            // Vertical pass with one running sum per column; both inner loops vectorize.
+            uint32_t* sums = scratch.sums.data();
+            const uint8_t* rows = scratch.rows.data();
+            for (int x = 0; x < w; x++) {
+                sums[x] = rows[x] * (radius + 1);
+            }
+            for (int i = 1; i <= radius; i++) {
+                const uint8_t* r = rows + static_cast<size_t>(std::min(i, h - 1)) * w;
+                for (int x = 0; x < w; x++) {
+                    sums[x] += r[x];
+                }
+            }
+            for (int y = 0; y < h; y++) {
+                uint8_t* d = dst.row(y);
+                for (int x = 0; x < w; x++) {
+                    d[x] = static_cast<uint8_t>((sums[x] * inv + 32768) >> 16);
+                }
+                const uint8_t* add = rows + static_cast<size_t>(std::min(y + radius + 1, h - 1)) * w;
+                const uint8_t* sub = rows + static_cast<size_t>(std::max(y - radius, 0)) * w;
+                for (int x = 0; x < w; x++) {
+                    sums[x] += add[x] - sub[x];
+                }
+            }
+        }
+
+        // Blends one run of pixels with a constant spatial weight; kept branch-free so it vectorizes.
+        static void blendRun(uint8_t* d, const uint8_t* s, int count, int weight, int edgeScale) {
+            for (int x = 0; x < count; x++) {
+                int diff = s[x] - d[x];
+                int absDiff = diff < 0 ? -diff : diff;
+                int edge = 256 - ((absDiff * edgeScale) >> 8);
+                edge = edge < 0 ? 0 : edge;
+                int w = (weight * edge) >> 8;
+                d[x] = static_cast<uint8_t>(d[x] + ((diff * w + 128) >> 8));
+            }
+        }
+
+        void featherBlend(const PlaneView& dst, const PlaneView& src, int feather, int strength, int edgeThreshold) {
+            const int w = dst.width;
+            const int h = dst.height;
+            strength = std::max(0, std::min(256, strength));
+            if (w <= 0 || h <= 0 || strength == 0) {
+                return;
+            }
+            // Edge attenuation falls from 256 for identical pixels to 0 at |src - dst| == edgeThreshold.
+            const int edgeScale = (edgeThreshold > 0) ? 65536 / edgeThreshold : 0;
+            // Only the first and last `feather` columns ramp; the inside uses the row weight as is.
+            const int ramp = std::min(std::max(feather, 0), (w + 1) / 2);
+
+            for (int y = 0; y < h; y++) {
+                int dy = std::min(y, h - 1 - y);
+                int wy = (feather <= 0) ? 256 : std::min(256, dy * 256 / feather);
+                int rowWeight = wy * strength >> 8;
+                if (rowWeight == 0) {
+                    continue;
+                }
+                uint8_t* d = dst.row(y);
+                const uint8_t* s = src.row(y);
+                for (int x = 0; x < ramp; x++) {
+                    int weight = std::min(rowWeight, (x * 256 / feather) * strength >> 8);
+                    blendRun(d + x, s + x, 1, weight, edgeScale);
+                    int r = w - 1 - x;
+                    if (r >= ramp) {
+                        blendRun(d + r, s + r, 1, weight, edgeScale);
+                    }
+                }
+                blendRun(d + ramp, s + ramp, w - 2 * ramp, rowWeight, edgeScale);
+            }
+        }
+    }
+}
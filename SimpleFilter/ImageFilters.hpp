@@ -0,0 +1,63 @@
+//
+//  ImageFilters.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_IMAGEFILTERS_H
+#define AGORA_IMAGEFILTERS_H
+
+#include <cstdint>
+#include <vector>
+#include "AgoraRtcKit/NGIAgoraMediaNode.h"
+#include "VideoRoi.hpp"
+
+namespace agora {
+    namespace extension {
+        // Non-owning view of one 8-bit image plane.
+        struct PlaneView {
+            uint8_t* data = nullptr;
+            int width = 0;
+            int height = 0;
+            int stride = 0;
+
+            uint8_t* row(int y) const { return data + static_cast<size_t>(y) * stride; }
+
+            PlaneView crop(const PixelRect& rect) const {
+                PlaneView view;
+                view.data = data + static_cast<size_t>(rect.y) * stride + rect.x;
+                view.width = rect.w;
+                view.height = rect.h;
+                view.stride = stride;
+                return view;
+            }
+        };
+
+        struct I420View {
+            PlaneView y;
+            PlaneView u;
+            PlaneView v;
+        };
+
+        // Intermediate buffers of boxBlur, kept by the caller so that steady-state filtering never allocates.
+        struct BoxBlurScratch {
+            std::vector<uint8_t> rows;
+            std::vector<uint32_t> sums;
+        };
+
+        // Maps a tightly packed kI420 frame onto its three planes. Returns false for any other layout.
+        bool wrapI420(const agora::rtc::VideoFrameData& frame, I420View& view);
+
+        // Separable box blur of `src` into `dst` (same size, may alias) with a (2 * radius + 1) window
+        // and clamp-to-edge borders. Runs in O(1) per pixel regardless of the radius.
+        void boxBlur(const PlaneView& src, const PlaneView& dst, int radius, BoxBlurScratch& scratch);
+
+        // Blends `src` into `dst`: dst += (src - dst) * weight. The weight is `strength` / 256 in the inside
+        // and ramps linearly down to zero over `feather` pixels towards the border of the plane, so results
+        // computed on a sub-rectangle can be pasted back without visible seams. When `edgeThreshold` is
+        // non-zero the weight also fades out where |src - dst| approaches it, which keeps strong edges sharp.
+        void featherBlend(const PlaneView& dst, const PlaneView& src, int feather, int strength, int edgeThreshold);
+    }
+}
+
+
+#endif //AGORA_IMAGEFILTERS_H
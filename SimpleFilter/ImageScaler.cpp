@@ -0,0 +1,197 @@
+//
+//  ImageScaler.cpp
+//  SimpleFilter
+//
+
+#include "ImageScaler.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+
+namespace agora {
+    namespace extension {
+        PlanePool::Plane::Plane(Plane&& other) noexcept
+            : pool_(other.pool_), buffer_(std::move(other.buffer_)), view_(other.view_) {
+            other.pool_ = nullptr;
+            other.view_ = PlaneView();
+        }
+
+        PlanePool::Plane& PlanePool::Plane::operator=(Plane&& other) noexcept {
+            if (this != &other) {
+                if (pool_ && buffer_) {
+                    pool_->free_.push_back(std::move(buffer_));
+                }
+                pool_ = other.pool_;
+                buffer_ = std::move(other.buffer_);
+                view_ = other.view_;
+                other.pool_ = nullptr;
+                other.view_ = PlaneView();
+            }
+            return *this;
+        }
+
+        PlanePool::Plane::~Plane() {
+            if (pool_ && buffer_) {
+                pool_->free_.push_back(std::move(buffer_));
+            }
+        }
+
+        PlanePool::Plane PlanePool::acquire(int width, int height) {
+            size_t size = static_cast<size_t>(std::max(width, 0)) * std::max(height, 0);
+            // Prefer a buffer that is already large enough; otherwise grow the most recently released one.
+            auto it = std::find_if(free_.begin(), free_.end(),
+                                   [size](const std::unique_ptr<std::vector<uint8_t>>& b) { return b->size() >= size; });
+            Plane plane;
+            if (it != free_.end()) {
+                plane.buffer_ = std::move(*it);
+                free_.erase(it);
+            } else if (!free_.empty()) {
+                plane.buffer_ = std::move(free_.back());
+                free_.pop_back();
+            } else {
+                plane.buffer_.reset(new std::vector<uint8_t>());
+            }
+            if (plane.buffer_->size() < size) {
+                plane.buffer_->resize(size);
+            }
+            plane.pool_ = this;
+            plane.view_.data = plane.buffer_->data();
+            plane.view_.width = width;
+            plane.view_.height = height;
+            plane.view_.stride = width;
+            return plane;
+        }
+
+        void downscale2x(const PlaneView& src, const PlaneView& dst) {
+            const int w = std::min(dst.width, src.width / 2);
+            const int h = std::min(dst.height, src.height / 2);
+            for (int y = 0; y < h; y++) {
+                const uint8_t* s0 = src.row(2 * y);
+                const uint8_t* s1 = src.row(2 * y + 1);
+                uint8_t* d = dst.row(y);
+                int x = 0;
+#if defined(SF_SIMD_NEON)
+                for (; x + 8 <= w; x += 8) {
+                    uint16x8_t sum = vpaddlq_u8(vld1q_u8(s0 + 2 * x));
+                    sum = vpadalq_u8(sum, vld1q_u8(s1 + 2 * x));
+                    vst1_u8(d + x, vrshrn_n_u16(sum, 2));
+                }
+#elif defined(SF_SIMD_SSE2)
+                const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+                const __m128i two = _mm_set1_epi16(2);
+                for (; x + 8 <= w; x += 8) {
+                    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 2 * x));
+                    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 2 * x));
+                    __m128i sum = _mm_add_epi16(_mm_and_si128(a, lowBytes), _mm_srli_epi16(a, 8));
+                    sum = _mm_add_epi16(sum, _mm_and_si128(b, lowBytes));
+                    sum = _mm_add_epi16(sum, _mm_srli_epi16(b, 8));
+                    sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(d + x), _mm_packus_epi16(sum, sum));
+                }
+#endif
+                for (; x < w; x++) {
+                    d[x] = static_cast<uint8_t>((s0[2 * x] + s0[2 * x + 1] + s1[2 * x] + s1[2 * x + 1] + 2) >> 2);
+                }
+            }
+        }
+
+        void upscale2x(const PlaneView& src, const PlaneView& dst, std::vector<uint16_t>& scratch) {
+            const int w = src.width;
+            const int h = src.height;
+            if (w <= 0 || h <= 0 || dst.width <= 0 || dst.height <= 0) {
+                return;
+            }
+            // Output pixel 2i samples the source at i - 1/4 and 2i + 1 at i + 1/4, so every output is
+            // 3/4 of the nearest source pixel plus 1/4 of the next one on that side, in both directions.
+            scratch.resize(w);
+            uint16_t* v = scratch.data();
+            for (int y = 0; y < dst.height; y++) {
+                int j = std::min(y >> 1, h - 1);
+                int n = std::max(0, std::min((y & 1) ? (y >> 1) + 1 : (y >> 1) - 1, h - 1));
+                const uint8_t* nearRow = src.row(j);
+                const uint8_t* farRow = src.row(n);
+                for (int i = 0; i < w; i++) {
+                    v[i] = static_cast<uint16_t>(3 * nearRow[i] + farRow[i]);
+                }
+
+                uint8_t* d = dst.row(y);
+                const int outWidth = std::min(dst.width, 2 * w + 1);
+                d[0] = static_cast<uint8_t>((4 * v[0] + 8) >> 4);
+                const int pairs = std::min(w - 1, (outWidth - 1) / 2);
+                int i = 0;
+#if defined(SF_SIMD_NEON)
+                for (; i + 8 <= pairs; i += 8) {
+                    uint16x8_t a = vld1q_u16(v + i);
+                    uint16x8_t b = vld1q_u16(v + i + 1);
+                    uint8x8x2_t out;
+                    out.val[0] = vrshrn_n_u16(vmlaq_n_u16(b, a, 3), 4);
+                    out.val[1] = vrshrn_n_u16(vmlaq_n_u16(a, b, 3), 4);
+                    vst2_u8(d + 2 * i + 1, out);
+                }
+#elif defined(SF_SIMD_SSE2)
+                const __m128i eight = _mm_set1_epi16(8);
+                for (; i + 8 <= pairs; i += 8) {
+                    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+                    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i + 1));
+                    __m128i sum = _mm_add_epi16(a, b);
+                    __m128i odd = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(sum, _mm_slli_epi16(a, 1)), eight), 4);
+                    __m128i even = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(sum, _mm_slli_epi16(b, 1)), eight), 4);
+                    __m128i packed = _mm_packus_epi16(_mm_unpacklo_epi16(odd, even), _mm_unpackhi_epi16(odd, even));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 2 * i + 1), packed);
+                }
+#endif
+                for (; i < pairs; i++) {
+                    d[2 * i + 1] = static_cast<uint8_t>((3 * v[i] + v[i + 1] + 8) >> 4);
+                    d[2 * i + 2] = static_cast<uint8_t>((3 * v[i + 1] + v[i] + 8) >> 4);
+                }
+                for (int x = 2 * pairs + 1; x < outWidth; x++) {
+                    d[x] = static_cast<uint8_t>((4 * v[w - 1] + 8) >> 4);
+                }
+            }
+        }
+
+        void resizeBilinear(const PlaneView& src, const PlaneView& dst) {
+            if (src.width <= 0 || src.height <= 0 || dst.width <= 0 || dst.height <= 0) {
+                return;
+            }
+            // 16.16 fixed-point source coordinates of the destination pixel centers.
+            const int64_t stepX = (static_cast<int64_t>(src.width) << 16) / dst.width;
+            const int64_t stepY = (static_cast<int64_t>(src.height) << 16) / dst.height;
+            for (int y = 0; y < dst.height; y++) {
+                int64_t sy = std::max<int64_t>(0, (y * stepY) + stepY / 2 - 32768);
+                int y0 = std::min(static_cast<int>(sy >> 16), src.height - 1);
+                int y1 = std::min(y0 + 1, src.height - 1);
+                int fy = static_cast<int>((sy >> 8) & 0xFF);
+                const uint8_t* r0 = src.row(y0);
+                const uint8_t* r1 = src.row(y1);
+                uint8_t* d = dst.row(y);
+                for (int x = 0; x < dst.width; x++) {
+                    int64_t sx = std::max<int64_t>(0, (x * stepX) + stepX / 2 - 32768);
+                    int x0 = std::min(static_cast<int>(sx >> 16), src.width - 1);
+                    int x1 = std::min(x0 + 1, src.width - 1);
+                    int fx = static_cast<int>((sx >> 8) & 0xFF);
+                    int top = r0[x0] * (256 - fx) + r0[x1] * fx;
+                    int bottom = r1[x0] * (256 - fx) + r1[x1] * fx;
+                    d[x] = static_cast<uint8_t>((top * (256 - fy) + bottom * fy + 32768) >> 16);
+                }
+            }
+        }
+
+        PixelRect coverRect(int srcWidth, int srcHeight, int dstWidth, int dstHeight) {
+            PixelRect rect;
+            rect.w = srcWidth;
+            rect.h = srcHeight;
+            if (srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0) {
+                return rect;
+            }
+            if (static_cast<int64_t>(srcWidth) * dstHeight > static_cast<int64_t>(srcHeight) * dstWidth) {
+                rect.w = static_cast<int>(static_cast<int64_t>(srcHeight) * dstWidth / dstHeight);
+            } else {
+                rect.h = static_cast<int>(static_cast<int64_t>(srcWidth) * dstHeight / dstWidth);
+            }
+            rect.x = (srcWidth - rect.w) / 2;
+            rect.y = (srcHeight - rect.h) / 2;
+            return rect;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+//
+//  ImageScaler.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_IMAGESCALER_H
+#define AGORA_IMAGESCALER_H
+
+#include <memory>
+#include <vector>
+#include "ImageFilters.hpp"
+
+namespace agora {
+    namespace extension {
+        // Recycles plane-sized scratch buffers so that steady-state processing does not allocate.
+        // Not thread safe: each pool belongs to one processing thread.
+        class PlanePool {
+        public:
+            // Owns one pooled buffer and gives it back to the pool when destroyed.
+            class Plane {
+            public:
+                Plane() = default;
+                Plane(Plane&& other) noexcept;
+                Plane& operator=(Plane&& other) noexcept;
+                ~Plane();
+
+                const PlaneView& view() const { return view_; }
+
+            private:
+                friend class PlanePool;
+                PlanePool* pool_ = nullptr;
+                std::unique_ptr<std::vector<uint8_t>> buffer_;
+                PlaneView view_;
+            };
+
+            // Returns a tightly packed width x height plane with unspecified contents.
+            Plane acquire(int width, int height);
+
+        private:
+            std::vector<std::unique_ptr<std::vector<uint8_t>>> free_;
+        };
+
+        // Area-average downscale by 2 in both directions: every output pixel is the rounded mean of a
+        // 2x2 block. `dst` must be (src.width / 2) x (src.height / 2); an odd last column or row is dropped.
+        void downscale2x(const PlaneView& src, const PlaneView& dst);
+
+        // Bilinear upscale by 2 with pixel-center alignment, the inverse of downscale2x.
+        // `dst` may be up to one pixel larger than 2 * src in each direction; edges are clamped.
+        void upscale2x(const PlaneView& src, const PlaneView& dst, std::vector<uint16_t>& scratch);
+
+        // Bilinear resize of `src` to the size of `dst`, with pixel-center alignment. Scalar and meant for
+        // one-off preparation such as fitting a background image to the frame, not for per-frame work.
+        void resizeBilinear(const PlaneView& src, const PlaneView& dst);
+
+        // Largest centered rectangle of `src` with the aspect ratio of dstWidth x dstHeight, for
+        // scaling an image so that it covers the destination without distortion.
+        PixelRect coverRect(int srcWidth, int srcHeight, int dstWidth, int dstHeight);
+    }
+}
+
+
+#endif //AGORA_IMAGESCALER_H
@@ -0,0 +1,203 @@
+//
+//  Json.cpp
+//  SimpleFilter
+//
+
+#include "Json.hpp"
+
+#include <cctype>
+#include <cstdlib>
+
+namespace agora {
+    namespace extension {
+        // Nesting limit, so a hostile property value cannot exhaust the stack.
+        static const int kMaxDepth = 32;
+
+        class JsonParser {
+        public:
+            explicit JsonParser(const std::string& text) : p_(text.c_str()), end_(text.c_str() + text.size()) {}
+
+            bool parseDocument(JsonValue& value) {
+                if (!parseValue(value, 0)) {
+                    return false;
+                }
+                skipSpace();
+                return p_ == end_;
+            }
+
+        private:
+            void skipSpace() {
+                while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+                    p_++;
+                }
+            }
+
+            bool consume(char c) {
+                skipSpace();
+                if (p_ < end_ && *p_ == c) {
+                    p_++;
+                    return true;
+                }
+                return false;
+            }
+
+            bool literal(const char* word) {
+                const char* q = p_;
+                for (; *word; word++, q++) {
+                    if (q >= end_ || *q != *word) {
+                        return false;
+                    }
+                }
+                p_ = q;
+                return true;
+            }
+
+            bool parseValue(JsonValue& value, int depth) {
+                skipSpace();
+                if (p_ >= end_ || depth > kMaxDepth) {
+                    return false;
+                }
+                switch (*p_) {
+                    case '{':
+                        return parseObject(value, depth);
+                    case '[':
+                        return parseArray(value, depth);
+                    case '"':
+                        value.type_ = JsonValue::kString;
+                        return parseString(value.string_);
+                    case 't':
+                    case 'f':
+                        value.type_ = JsonValue::kBool;
+                        value.bool_ = *p_ == 't';
+                        return literal(value.bool_ ? "true" : "false");
+                    case 'n':
+                        value.type_ = JsonValue::kNull;
+                        return literal("null");
+                    default:
+                        return parseNumber(value);
+                }
+            }
+
+            bool parseNumber(JsonValue& value) {
+                // strtod accepts more than JSON does (hex, inf); only hand it the JSON number characters.
+                const char* q = p_;
+                while (q < end_ && (std::isdigit(static_cast<unsigned char>(*q)) || *q == '-' || *q == '+'
+                                    || *q == '.' || *q == 'e' || *q == 'E')) {
+                    q++;
+                }
+                if (q == p_) {
+                    return false;
+                }
+                std::string digits(p_, q);
+                char* stop = nullptr;
+                value.number_ = strtod(digits.c_str(), &stop);
+                if (stop != digits.c_str() + digits.size()) {
+                    return false;
+                }
+                value.type_ = JsonValue::kNumber;
+                p_ = q;
+                return true;
+            }
+
+            bool parseString(std::string& out) {
+                p_++;
+                while (p_ < end_ && *p_ != '"') {
+                    char c = *p_++;
+                    if (c != '\\') {
+                        out += c;
+                        continue;
+                    }
+                    if (p_ >= end_) {
+                        return false;
+                    }
+                    c = *p_++;
+                    switch (c) {
+                        case 'n': out += '\n'; break;
+                        case 't': out += '\t'; break;
+                        case 'r': out += '\r'; break;
+                        case 'b': out += '\b'; break;
+                        case 'f': out += '\f'; break;
+                        case 'u': {
+                            if (end_ - p_ < 4) {
+                                return false;
+                            }
+                            long code = strtol(std::string(p_, p_ + 4).c_str(), nullptr, 16);
+                            out += code < 0x80 ? static_cast<char>(code) : '?';
+                            p_ += 4;
+                            break;
+                        }
+                        default: out += c; break;
+                    }
+                }
+                return consume('"');
+            }
+
+            bool parseArray(JsonValue& value, int depth) {
+                p_++;
+                value.type_ = JsonValue::kArray;
+                if (consume(']')) {
+                    return true;
+                }
+                do {
+                    value.items_.emplace_back();
+                    if (!parseValue(value.items_.back(), depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume(']');
+            }
+
+            bool parseObject(JsonValue& value, int depth) {
+                p_++;
+                value.type_ = JsonValue::kObject;
+                if (consume('}')) {
+                    return true;
+                }
+                do {
+                    skipSpace();
+                    std::string key;
+                    if (p_ >= end_ || *p_ != '"' || !parseString(key) || !consume(':')) {
+                        return false;
+                    }
+                    if (!parseValue(value.members_[key], depth + 1)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume('}');
+            }
+
+            const char* p_;
+            const char* end_;
+        };
+
+        bool JsonValue::parse(const std::string& text, JsonValue& value) {
+            JsonValue parsed;
+            if (!JsonParser(text).parseDocument(parsed)) {
+                value = JsonValue();
+                return false;
+            }
+            value = std::move(parsed);
+            return true;
+        }
+
+        const JsonValue* JsonValue::find(const std::string& key) const {
+            auto it = members_.find(key);
+            return it == members_.end() ? nullptr : &it->second;
+        }
+
+        double JsonValue::number(const std::string& key, double fallback) const {
+            const JsonValue* v = find(key);
+            return v && v->type_ == kNumber ? v->number_ : fallback;
+        }
+
+        bool JsonValue::boolean(const std::string& key, bool fallback) const {
+            const JsonValue* v = find(key);
+            return v && v->type_ == kBool ? v->bool_ : fallback;
+        }
+
+        std::string JsonValue::string(const std::string& key, const std::string& fallback) const {
+            const JsonValue* v = find(key);
+            return v && v->type_ == kString ? v->string_ : fallback;
+        }
+    }
+}
@@ -0,0 +1,62 @@
+//
+//  Json.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_JSON_H
+#define AGORA_JSON_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace agora {
+    namespace extension {
+        // Just enough JSON for extension properties that carry structured configuration. Numbers are
+        // doubles, objects keep their keys sorted; \u escapes outside ASCII are not decoded.
+        class JsonValue {
+        public:
+            enum Type {
+                kNull = 0,
+                kBool,
+                kNumber,
+                kString,
+                kArray,
+                kObject
+            };
+
+            // Returns false, leaving `value` null, if `text` is not a single well-formed JSON value.
+            static bool parse(const std::string& text, JsonValue& value);
+
+            Type type() const { return type_; }
+            bool isArray() const { return type_ == kArray; }
+            bool isObject() const { return type_ == kObject; }
+
+            const std::vector<JsonValue>& items() const { return items_; }
+            // Member of an object, or nullptr if there is none or this is not an object.
+            const JsonValue* find(const std::string& key) const;
+
+            // Members converted to the requested type, `fallback` when missing or of another type.
+            double number(const std::string& key, double fallback) const;
+            bool boolean(const std::string& key, bool fallback) const;
+            std::string string(const std::string& key, const std::string& fallback) const;
+
+            double asNumber() const { return number_; }
+            bool asBool() const { return bool_; }
+            const std::string& asString() const { return string_; }
+
+        private:
+            friend class JsonParser;
+
+            Type type_ = kNull;
+            bool bool_ = false;
+            double number_ = 0;
+            std::string string_;
+            std::vector<JsonValue> items_;
+            std::map<std::string, JsonValue> members_;
+        };
+    }
+}
+
+
+#endif //AGORA_JSON_H
@@ -0,0 +1,287 @@
+//
+//  LoudnessMeter.cpp
+//  SimpleFilter
+//
+
+#include "LoudnessMeter.hpp"
+#include "AudioKernels.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace agora {
+    namespace extension {
+        // Gating and histogram range, in LUFS.
+        static const float kAbsoluteGate = -70.0f;
+        static const float kRelativeGate = -10.0f;
+        static const float kBinsPerLu = 10.0f;
+        // Mean square of a full-scale int16 sine reads 0 LUFS once the -0.691 offset is applied.
+        static const double kFullScale = 32768.0 * 32768.0;
+
+        static float loudness(double meanSquare) {
+            return meanSquare > 0 ? std::max(static_cast<float>(-0.691 + 10 * std::log10(meanSquare / kFullScale)), kLoudnessFloor)
+                                  : kLoudnessFloor;
+        }
+
+        static float levelDb(double amplitude) {
+            return amplitude > 0 ? std::max(static_cast<float>(20 * std::log10(amplitude / 32768.0)), kLoudnessFloor) : kLoudnessFloor;
+        }
+
+        std::string LoudnessReading::toJson() const {
+            char text[224];
+            snprintf(text, sizeof(text),
+                     "{\"momentary\":%.1f,\"short_term\":%.1f,\"integrated\":%.1f,\"rms_db\":%.1f,"
+                     "\"peak_db\":%.1f,\"true_peak_db\":%.1f,\"max_true_peak_db\":%.1f}",
+                     momentary, shortTerm, integrated, rmsDb, peakDb, truePeakDb, maxTruePeakDb);
+            return text;
+        }
+
+        void LoudnessMeter::prepare(int sampleRateHz, int channels) {
+            sampleRateHz_ = sampleRateHz;
+            channels_ = channels;
+
+            // BS.1770 K-weighting: the head's high shelf, then the RLB high-pass, designed for any rate.
+            BiquadCoefficients sections[2];
+            double k = std::tan(M_PI * 1681.974450955533 / sampleRateHz);
+            double q = 0.7071752369554196;
+            const double vh = std::pow(10.0, 3.999843853973347 / 20);
+            const double vb = std::pow(vh, 0.4996667741545416);
+            double a0 = 1 + k / q + k * k;
+            sections[0].b0 = static_cast<float>((vh + vb * k / q + k * k) / a0);
+            sections[0].b1 = static_cast<float>(2 * (k * k - vh) / a0);
+            sections[0].b2 = static_cast<float>((vh - vb * k / q + k * k) / a0);
+            sections[0].a1 = static_cast<float>(2 * (k * k - 1) / a0);
+            sections[0].a2 = static_cast<float>((1 - k / q + k * k) / a0);
+            k = std::tan(M_PI * 38.13547087602444 / sampleRateHz);
+            q = 0.5003270373238773;
+            a0 = 1 + k / q + k * k;
+            sections[1].b0 = 1;
+            sections[1].b1 = -2;
+            sections[1].b2 = 1;
+            sections[1].a1 = static_cast<float>(2 * (k * k - 1) / a0);
+            sections[1].a2 = static_cast<float>((1 - k / q + k * k) / a0);
+            weighting_.setCoefficients(sections, 2, 0);
+            weighting_.prepare(channels);
+
+            for (int c = 0; c < 8; c++) {
+                // L R C LFE Ls Rs: the surrounds count 1.5 dB more, the LFE not at all.
+                channelWeights_[c] = channels == 6 && c == 3 ? 0.0f : (channels == 6 && c >= 4 ? 1.41f : 1.0f);
+            }
+
+            // Phase p of the 4x interpolator sits p / 4 of a sample after the centre tap, so phase 0
+            // returns the samples themselves. Hann-windowed sinc.
+            const int centre = kTruePeakTaps / 2;
+            for (int p = 0; p < 4; p++) {
+                for (int t = 0; t < kTruePeakTaps; t++) {
+                    const double d = centre - t - p / 4.0;
+                    const double sinc = d == 0 ? 1 : std::sin(M_PI * d) / (M_PI * d);
+                    const double window = 0.5 + 0.5 * std::cos(M_PI * d / (centre + 0.5));
+                    truePeakKernel_[t][p] = static_cast<float>(sinc * window);
+                    if (p > 0) {
+                        truePeakTaps_[t][p - 1] = simd::splatF(truePeakKernel_[t][p]);
+                    }
+                }
+            }
+            std::fill(truePeakInput_, truePeakInput_ + sizeof(truePeakInput_) / sizeof(float), 0.0f);
+
+            hopFrames_ = std::max(sampleRateHz / 10, 1);
+            hopDone_ = 0;
+            hopWeighted_ = 0;
+            hopSquares_ = 0;
+            hopPeak_ = 0;
+            hopTruePeak_ = 0;
+            maxTruePeak_ = 0;
+            hopIndex_ = 0;
+            hopCount_ = 0;
+            std::fill(binCount_, binCount_ + kBins, 0u);
+            std::fill(binEnergy_, binEnergy_ + kBins, 0.0);
+            // Nothing measured yet, rather than what the meter read before.
+            snapshot_.back() = LoudnessReading();
+            snapshot_.publish();
+        }
+
+        static void loadChunk(const int16_t* data, float* out, size_t count) {
+            s16ToFloat(data, out, count);
+        }
+
+        static void loadChunk(const float* data, float* out, size_t count) {
+            memcpy(out, data, count * sizeof(float));
+        }
+
+        void LoudnessMeter::process(const int16_t* data, size_t frames, int channels, int sampleRateHz) {
+            processSamples(data, frames, channels, sampleRateHz);
+        }
+
+        void LoudnessMeter::process(const float* data, size_t frames, int channels, int sampleRateHz) {
+            processSamples(data, frames, channels, sampleRateHz);
+        }
+
+        template <typename Sample>
+        void LoudnessMeter::processSamples(const Sample* data, size_t frames, int channels, int sampleRateHz) {
+            if (channels <= 0 || channels > 8 || sampleRateHz <= 0) {
+                return;
+            }
+            if (reset_.exchange(false, std::memory_order_relaxed) || sampleRateHz != sampleRateHz_ || channels != channels_) {
+                prepare(sampleRateHz, channels);
+            }
+            const size_t chunkFrames = kChunkSamples / channels;
+            while (frames > 0) {
+                // Never across a hop, so each hop is finished exactly at its last sample.
+                const size_t count = std::min(std::min(frames, chunkFrames), hopFrames_ - hopDone_);
+                loadChunk(data, work_, count * channels);
+                processChunk(count);
+                data += count * channels;
+                frames -= count;
+                hopDone_ += count;
+                if (hopDone_ == hopFrames_) {
+                    finishHop();
+                }
+            }
+        }
+
+        void LoudnessMeter::processChunk(size_t frames) {
+            using namespace simd;
+            const int channels = channels_;
+            const size_t count = frames * channels;
+
+            // Unweighted: squares, sample peak and the interpolated peak, per channel plane.
+            const size_t stride = kTruePeakTaps - 1 + kChunkSamples / channels;
+            float peak = 0;
+            float tailPeak = 0;
+            F32x4 truePeak = splatF(0);
+            const F32x4 zero = splatF(0);
+            double squares = 0;
+            for (int c = 0; c < channels; c++) {
+                float* plane = truePeakInput_ + c * stride;
+                float* input = plane + kTruePeakTaps - 1;
+                float sum = 0;
+                for (size_t f = 0; f < frames; f++) {
+                    const float x = work_[f * channels + c];
+                    input[f] = x;
+                    sum += x * x;
+                    peak = std::max(peak, std::fabs(x));
+                }
+                squares += sum;
+                // Phases 1-3 for four consecutive samples at a time; phase 0 is the samples themselves.
+                // plane[f + kTruePeakTaps - 1 - t] is input[f - t].
+                size_t f = 0;
+                for (; f + 4 <= frames; f += 4) {
+                    F32x4 y1 = zero;
+                    F32x4 y2 = zero;
+                    F32x4 y3 = zero;
+                    for (int t = 0; t < kTruePeakTaps; t++) {
+                        const F32x4 x = loadF(plane + f + kTruePeakTaps - 1 - t);
+                        y1 = madd(y1, truePeakTaps_[t][0], x);
+                        y2 = madd(y2, truePeakTaps_[t][1], x);
+                        y3 = madd(y3, truePeakTaps_[t][2], x);
+                    }
+                    truePeak = max(truePeak, max(max(y1, sub(zero, y1)), max(y2, sub(zero, y2))));
+                    truePeak = max(truePeak, max(y3, sub(zero, y3)));
+                }
+                for (; f < frames; f++) {
+                    for (int p = 1; p < 4; p++) {
+                        float y = 0;
+                        for (int t = 0; t < kTruePeakTaps; t++) {
+                            y += truePeakKernel_[t][p] * plane[f + kTruePeakTaps - 1 - t];
+                        }
+                        tailPeak = std::max(tailPeak, std::fabs(y));
+                    }
+                }
+                memmove(plane, plane + frames, (kTruePeakTaps - 1) * sizeof(float));
+            }
+            float lanes[4];
+            storeF(lanes, truePeak);
+            hopPeak_ = std::max(hopPeak_, peak);
+            hopTruePeak_ = std::max(std::max(hopTruePeak_, std::max(peak, tailPeak)), std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3])));
+            hopSquares_ += squares;
+
+            // K-weighted squares, channel by channel through the lanes when they divide four.
+            weighting_.process(work_, frames);
+            double weighted = 0;
+            if (4 % channels == 0) {
+                F32x4 sum = splatF(0);
+                size_t i = 0;
+                for (; i + 4 <= count; i += 4) {
+                    const F32x4 v = loadF(work_ + i);
+                    sum = madd(sum, v, v);
+                }
+                storeF(lanes, sum);
+                for (int lane = 0; lane < 4; lane++) {
+                    weighted += lanes[lane] * channelWeights_[lane % channels];
+                }
+                for (; i < count; i++) {
+                    weighted += work_[i] * work_[i] * channelWeights_[i % channels];
+                }
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    weighted += work_[i] * work_[i] * channelWeights_[i % channels];
+                }
+            }
+            hopWeighted_ += weighted;
+        }
+
+        void LoudnessMeter::finishHop() {
+            hops_[hopIndex_] = hopWeighted_ / hopFrames_;
+            hopIndex_ = (hopIndex_ + 1) % kHistory;
+            hopCount_ = std::min(hopCount_ + 1, kHistory);
+
+            double momentary = 0;
+            double shortTerm = 0;
+            for (int i = 0; i < hopCount_; i++) {
+                const double hop = hops_[(hopIndex_ - 1 - i + kHistory) % kHistory];
+                if (i < 4) {
+                    momentary += hop;
+                }
+                shortTerm += hop;
+            }
+            momentary /= 4;
+            shortTerm /= kHistory;
+
+            // Each 400 ms block, overlapping by 75%, goes into the histogram if above the absolute gate.
+            const float blockLoudness = loudness(momentary);
+            if (hopCount_ >= 4 && blockLoudness >= kAbsoluteGate) {
+                const int bin = std::min(static_cast<int>((blockLoudness - kAbsoluteGate) * kBinsPerLu), kBins - 1);
+                binCount_[bin]++;
+                binEnergy_[bin] += momentary;
+            }
+            double energy = 0;
+            double blocks = 0;
+            for (int b = 0; b < kBins; b++) {
+                energy += binEnergy_[b];
+                blocks += binCount_[b];
+            }
+            float integrated = kLoudnessFloor;
+            if (blocks > 0) {
+                const float gate = loudness(energy / blocks) + kRelativeGate;
+                const int first = std::max(static_cast<int>(std::ceil((gate - kAbsoluteGate) * kBinsPerLu - 0.5f)), 0);
+                energy = 0;
+                blocks = 0;
+                for (int b = first; b < kBins; b++) {
+                    energy += binEnergy_[b];
+                    blocks += binCount_[b];
+                }
+                integrated = blocks > 0 ? loudness(energy / blocks) : kLoudnessFloor;
+            }
+
+            maxTruePeak_ = std::max(maxTruePeak_, hopTruePeak_);
+            LoudnessReading& reading = snapshot_.back();
+            reading.momentary = hopCount_ >= 4 ? loudness(momentary) : kLoudnessFloor;
+            reading.shortTerm = hopCount_ >= kHistory ? loudness(shortTerm) : kLoudnessFloor;
+            reading.integrated = integrated;
+            reading.rmsDb = levelDb(std::sqrt(hopSquares_ / (static_cast<double>(hopFrames_) * channels_)));
+            reading.peakDb = levelDb(hopPeak_);
+            reading.truePeakDb = levelDb(hopTruePeak_);
+            reading.maxTruePeakDb = levelDb(maxTruePeak_);
+            snapshot_.publish();
+
+            hopDone_ = 0;
+            hopWeighted_ = 0;
+            hopSquares_ = 0;
+            hopPeak_ = 0;
+            hopTruePeak_ = 0;
+        }
+    }
+}
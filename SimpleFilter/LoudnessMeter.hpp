@@ -0,0 +1,111 @@
+//
+//  LoudnessMeter.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_LOUDNESSMETER_H
+#define AGORA_LOUDNESSMETER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "Biquad.hpp"
+#include "SimdUtils.hpp"
+#include "Snapshot.hpp"
+
+namespace agora {
+    namespace extension {
+        // Values below the meter's range read as this.
+        static const float kLoudnessFloor = -100.0f;
+
+        struct LoudnessReading {
+            // EBU R128 loudness in LUFS over 400 ms, 3 s and, gated, since the last reset.
+            float momentary = kLoudnessFloor;
+            float shortTerm = kLoudnessFloor;
+            float integrated = kLoudnessFloor;
+            // Unweighted level of the last 100 ms in dBFS: RMS over all channels, sample and true peak.
+            float rmsDb = kLoudnessFloor;
+            float peakDb = kLoudnessFloor;
+            float truePeakDb = kLoudnessFloor;
+            // Highest true peak since the last reset, in dBTP.
+            float maxTruePeakDb = kLoudnessFloor;
+
+            // {"momentary":-23.0,...} with the keys above in snake case.
+            std::string toJson() const;
+        };
+
+        // ITU-R BS.1770 / EBU R128 loudness meter for interleaved audio, 16-bit or float on the same scale
+        // (float may go beyond full scale, and reads above 0 dB then): K-weighting, 400 ms blocks
+        // every 100 ms, absolute (-70 LUFS) and relative (-10 LU) gating for the integrated value, and a
+        // 4x oversampled true peak. Memory and work per frame are bounded: the gated blocks are kept as
+        // a histogram in 0.1 LU steps. Channels beyond stereo follow WAVE order for the surround weights.
+        // process runs on one audio thread; read and reset may be called from another.
+        class LoudnessMeter {
+        public:
+            void process(const int16_t* data, size_t frames, int channels, int sampleRateHz);
+            void process(const float* data, size_t frames, int channels, int sampleRateHz);
+            // Starts over with the next frame: the reading goes back to the floor, and the integrated
+            // loudness and maximum true peak cover only what follows.
+            void reset() { reset_ = true; }
+
+            // Latest reading, updated every 100 ms; any thread may read, and process never waits for it.
+            LoudnessReading read() const {
+                std::lock_guard<std::mutex> lock(readMutex_);
+                return snapshot_.read();
+            }
+
+        private:
+            static const int kChunkSamples = 3840;
+            static const int kTruePeakTaps = 12;
+            static const int kHistory = 30;
+            static const int kBins = 750;
+
+            void prepare(int sampleRateHz, int channels);
+            template <typename Sample>
+            void processSamples(const Sample* data, size_t frames, int channels, int sampleRateHz);
+            // Measures the chunk in work_.
+            void processChunk(size_t frames);
+            void finishHop();
+
+            std::atomic<bool> reset_ = {false};
+            // Reading swaps the reader's slot, which does not change the meter's value. The snapshot has
+            // one reader, so readers take readMutex_; the audio thread never does.
+            mutable std::mutex readMutex_;
+            mutable Snapshot<LoudnessReading> snapshot_;
+
+            // Audio thread only.
+            int sampleRateHz_ = 0;
+            int channels_ = 0;
+            BiquadCascade weighting_;
+            float channelWeights_[8];
+            // Oversampling kernel: tap k holds the four phases; the vector kernel repeats phases 1-3.
+            float truePeakKernel_[kTruePeakTaps][4];
+            simd::F32x4 truePeakTaps_[kTruePeakTaps][3];
+            // Per channel: the previous kTruePeakTaps - 1 samples, then the chunk.
+            float truePeakInput_[kChunkSamples + 8 * kTruePeakTaps];
+            float work_[kChunkSamples];
+
+            // Current 100 ms hop.
+            size_t hopFrames_ = 0;
+            size_t hopDone_ = 0;
+            double hopWeighted_ = 0;
+            double hopSquares_ = 0;
+            float hopPeak_ = 0;
+            float hopTruePeak_ = 0;
+            float maxTruePeak_ = 0;
+
+            // Weighted mean square of the last kHistory hops.
+            double hops_[kHistory];
+            int hopIndex_ = 0;
+            int hopCount_ = 0;
+            // Blocks above the absolute gate, binned by loudness: count and summed mean square.
+            uint32_t binCount_[kBins];
+            double binEnergy_[kBins];
+        };
+    }
+}
+
+
+#endif //AGORA_LOUDNESSMETER_H
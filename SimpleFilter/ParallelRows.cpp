@@ -0,0 +1,66 @@
+//
+//  ParallelRows.cpp
+//  SimpleFilter
+//
+
+#include "ParallelRows.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace agora {
+    namespace extension {
+        ParallelRows::ParallelRows(int threads) : pool_(std::max(threads - 1, 1), true) {
+            for (int i = 1; i < threads; i++) {
+                int invoker = pool_.RegisterInvoker("thread_videofilter_rows_" + std::to_string(i));
+                if (invoker >= 0) {
+                    invokers_.push_back(invoker);
+                }
+            }
+        }
+
+        ParallelRows::~ParallelRows() {
+            for (int invoker : invokers_) {
+                pool_.UnregisterInvoker(invoker);
+            }
+        }
+
+        void ParallelRows::run(int rows, int alignment, const std::function<void(int begin, int end)>& body) {
+            if (rows <= 0) {
+                return;
+            }
+            alignment = std::max(alignment, 1);
+            int parts = static_cast<int>(invokers_.size()) + 1;
+            int chunk = (rows + parts - 1) / parts;
+            chunk = (chunk + alignment - 1) / alignment * alignment;
+
+            // Hand the tail ranges to the workers, keep the first one for the calling thread.
+            for (int i = 1; i < parts && i * chunk < rows; i++) {
+                int begin = i * chunk;
+                int end = std::min(rows, begin + chunk);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    pending_++;
+                }
+                int err = pool_.PostTask(invokers_[i - 1], [this, &body, begin, end] {
+                    body(begin, end);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (--pending_ == 0) {
+                        done_.notify_one();
+                    }
+                });
+                if (err != 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        pending_--;
+                    }
+                    body(begin, end);
+                }
+            }
+            body(0, std::min(rows, chunk));
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return pending_ == 0; });
+        }
+    }
+}
@@ -0,0 +1,42 @@
+//
+//  ParallelRows.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_PARALLELROWS_H
+#define AGORA_PARALLELROWS_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "external_thread_pool.h"
+
+namespace agora {
+    namespace extension {
+        // Splits row ranges of a frame across the calling thread and a few dedicated workers.
+        // run() blocks until every range is done, so the body may capture frame-local state by reference.
+        class ParallelRows {
+        public:
+            // `threads` counts the calling thread, so 2 means one extra worker.
+            explicit ParallelRows(int threads);
+            ~ParallelRows();
+
+            // Calls body(begin, end) on disjoint ranges covering [0, rows). Ranges are multiples of
+            // `alignment` rows except for the last one.
+            void run(int rows, int alignment, const std::function<void(int begin, int end)>& body);
+
+            int threads() const { return static_cast<int>(invokers_.size()) + 1; }
+
+        private:
+            ThreadPool pool_;
+            std::vector<int> invokers_;
+            std::mutex mutex_;
+            std::condition_variable done_;
+            int pending_ = 0;
+        };
+    }
+}
+
+
+#endif //AGORA_PARALLELROWS_H
@@ -0,0 +1,284 @@
+//
+//  PitchShift.cpp
+//  SimpleFilter
+//
+
+#include "PitchShift.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace agora {
+    namespace extension {
+        static const int kOverlap = 4;
+        static const int kMaxLatencyMs = 20;
+        // Width of the envelope smoothing, wider than the harmonic spacing of a voice.
+        static const double kEnvelopeHz = 500;
+        // Limit of the formant correction, so bins near silence are not lifted into noise.
+        static const float kMaxFormantGain = 8.0f;
+        static const float kTwoPi = 6.28318531f;
+        static const float kLanes[4] = {0, 1, 2, 3};
+
+        using simd::F32x4;
+
+        static inline F32x4 wrapPhase(F32x4 phase) {
+            using namespace simd;
+            return sub(phase, mul(splatF(kTwoPi), roundF(mul(phase, splatF(1 / kTwoPi)))));
+        }
+
+        // Every bin of every frame goes through one atan2 and one sine and cosine; these polynomials,
+        // four bins at a time, are accurate to about 3e-7 radians and 5e-7, far below what the vocoder
+        // can hear, and several times cheaper than the libm calls.
+        static inline F32x4 atan2F(F32x4 y, F32x4 x) {
+            using namespace simd;
+            const F32x4 zero = splatF(0);
+            const F32x4 ax = abs(x);
+            const F32x4 ay = abs(y);
+            const F32x4 a = div(min(ax, ay), add(max(ax, ay), splatF(1e-30f)));
+            const F32x4 s = mul(a, a);
+            // Abramowitz and Stegun 4.4.49 for atan on [0, 1].
+            F32x4 p = madd(splatF(-0.0161657367f), s, splatF(0.0028662257f));
+            p = madd(splatF(0.0429096138f), s, p);
+            p = madd(splatF(-0.0752896400f), s, p);
+            p = madd(splatF(0.1065626393f), s, p);
+            p = madd(splatF(-0.1420889944f), s, p);
+            p = madd(splatF(0.1999355085f), s, p);
+            p = madd(splatF(-0.3333314528f), s, p);
+            F32x4 r = madd(a, mul(a, s), p);
+            r = select(less(ax, ay), sub(splatF(1.57079633f), r), r);
+            r = select(less(x, zero), sub(splatF(3.14159265f), r), r);
+            return select(less(y, zero), sub(zero, r), r);
+        }
+
+        // `phase` within [-pi, pi]: reduced to at most an eighth of a turn, then rotated back.
+        static inline void sinCosF(F32x4 phase, F32x4& sine, F32x4& cosine) {
+            using namespace simd;
+            const F32x4 zero = splatF(0);
+            const F32x4 quarters = roundF(mul(phase, splatF(0.636619772f)));
+            const F32x4 r = sub(phase, mul(quarters, splatF(1.57079633f)));
+            const F32x4 r2 = mul(r, r);
+            F32x4 s = madd(splatF(0.00833333333f), r2, splatF(-0.000198412698f));
+            s = madd(splatF(-0.166666667f), r2, s);
+            s = madd(r, mul(r, r2), s);
+            F32x4 c = madd(splatF(-0.00138888889f), r2, splatF(0.0000248015873f));
+            c = madd(splatF(0.0416666667f), r2, c);
+            c = madd(splatF(-0.5f), r2, c);
+            c = madd(splatF(1), r2, c);
+            // quarters is -2 to 2: odd ones swap sine and cosine, the sign follows the quadrant.
+            const F32x4 turns = abs(quarters);
+            const F32x4 odd = less(abs(sub(turns, splatF(1))), splatF(0.5f));
+            const F32x4 half = less(splatF(1.5f), turns);
+            const F32x4 negative = less(quarters, zero);
+            sine = select(odd, select(negative, sub(zero, c), c), select(half, sub(zero, s), s));
+            cosine = select(odd, select(negative, s, sub(zero, s)), select(half, sub(zero, c), c));
+        }
+
+        std::unique_ptr<AudioStage> PitchShiftStage::create(const JsonValue& spec) {
+            const double semitones = spec.number("semitones", 0);
+            if (semitones < -12 || semitones > 12) {
+                return nullptr;
+            }
+            std::unique_ptr<PitchShiftStage> stage(new PitchShiftStage());
+            stage->ratio_ = static_cast<float>(std::pow(2.0, semitones / 12));
+            stage->formants_ = spec.boolean("formants", false);
+            return stage;
+        }
+
+        void PitchShiftStage::prepare(int sampleRateHz, int channels) {
+            sampleRateHz_ = sampleRateHz;
+            channels_ = channels;
+            size_ = 16;
+            while (size_ * 2 * 1000 <= kMaxLatencyMs * sampleRateHz) {
+                size_ *= 2;
+            }
+            hop_ = size_ / kOverlap;
+            bins_ = size_ / 2 + 1;
+            padded_ = (bins_ + 3) & ~3;
+            envelopeRadius_ = std::max(1, static_cast<int>(kEnvelopeHz * size_ / sampleRateHz / 2));
+            fill_ = 0;
+            fft_.prepare(size_);
+
+            // Hann analysis and synthesis windows; at 75% overlap their product sums to 1.5.
+            window_.resize(size_);
+            for (int i = 0; i < size_; i++) {
+                window_[i] = static_cast<float>((0.5 - 0.5 * std::cos(2 * M_PI * i / size_)) / std::sqrt(1.5));
+            }
+            input_.assign(static_cast<size_t>(size_) * channels, 0.0f);
+            overlap_.assign(static_cast<size_t>(size_) * channels, 0.0f);
+            output_.assign(static_cast<size_t>(hop_) * channels, 0.0f);
+            analysisPhase_.assign(static_cast<size_t>(padded_) * channels, 0.0f);
+            synthesisPhase_.assign(static_cast<size_t>(padded_) * channels, 0.0f);
+            frame_.assign(size_, 0.0f);
+            re_.assign(padded_, 0.0f);
+            im_.assign(padded_, 0.0f);
+            magnitude_.assign(padded_, 0.0f);
+            frequency_.assign(padded_, 0.0f);
+            shiftedMagnitude_.assign(padded_, 0.0f);
+            shiftedPhase_.assign(padded_, 0.0f);
+            strongest_.assign(padded_, 0.0f);
+            peaks_.clear();
+            peaks_.reserve(bins_);
+            envelope_.assign(bins_, 0.0f);
+            prefix_.assign(bins_ + 1, 0.0f);
+        }
+
+        void PitchShiftStage::continueFrom(AudioStage& previous) {
+            PitchShiftStage* other = dynamic_cast<PitchShiftStage*>(&previous);
+            if (other && other->size_ == size_ && other->channels_ == channels_) {
+                fill_ = other->fill_;
+                input_ = other->input_;
+                overlap_ = other->overlap_;
+                output_ = other->output_;
+                analysisPhase_ = other->analysisPhase_;
+                synthesisPhase_ = other->synthesisPhase_;
+            }
+        }
+
+        void PitchShiftStage::process(float* data, size_t frames, int channels) {
+            size_t done = 0;
+            while (done < frames) {
+                const size_t count = std::min(frames - done, static_cast<size_t>(hop_ - fill_));
+                for (int c = 0; c < channels; c++) {
+                    float* input = input_.data() + c * size_ + size_ - hop_ + fill_;
+                    const float* output = output_.data() + c * hop_ + fill_;
+                    float* samples = data + done * channels + c;
+                    for (size_t f = 0; f < count; f++) {
+                        input[f] = samples[f * channels];
+                        samples[f * channels] = output[f];
+                    }
+                }
+                done += count;
+                fill_ += static_cast<int>(count);
+                if (fill_ == hop_) {
+                    for (int c = 0; c < channels; c++) {
+                        shiftFrame(c);
+                    }
+                    fill_ = 0;
+                }
+            }
+        }
+
+        void PitchShiftStage::shiftFrame(int channel) {
+            float* input = input_.data() + channel * size_;
+            float* overlap = overlap_.data() + channel * size_;
+            float* analysisPhase = analysisPhase_.data() + channel * padded_;
+            float* synthesisPhase = synthesisPhase_.data() + channel * padded_;
+            // Phase a bin-centred partial advances by in one hop, per bin index.
+            const float expected = kTwoPi * hop_ / size_;
+
+            for (int i = 0; i < size_; i++) {
+                frame_[i] = input[i] * window_[i];
+            }
+            fft_.forward(frame_.data(), re_.data(), im_.data());
+            {
+                using namespace simd;
+                const F32x4 step = splatF(expected);
+                const F32x4 perStep = splatF(1 / expected);
+                F32x4 bin = loadF(kLanes);
+                for (int k = 0; k < padded_; k += 4) {
+                    const F32x4 re = loadF(&re_[k]);
+                    const F32x4 im = loadF(&im_[k]);
+                    const F32x4 phase = atan2F(im, re);
+                    const F32x4 deviation = wrapPhase(sub(sub(phase, loadF(analysisPhase + k)), mul(bin, step)));
+                    storeF(analysisPhase + k, phase);
+                    storeF(&magnitude_[k], sqrt(madd(mul(re, re), im, im)));
+                    // In bins: the partial's frequency is its bin plus the deviation's share of a hop.
+                    storeF(&frequency_[k], madd(bin, deviation, perStep));
+                    bin = add(bin, splatF(4));
+                }
+            }
+
+            if (ratio_ == 1 && !formants_) {
+                // Nothing moves: the frame is resynthesized as analysed, which the overlap-add returns exactly.
+                std::copy(analysisPhase, analysisPhase + bins_, synthesisPhase);
+            } else {
+                if (formants_) {
+                    measureEnvelope(magnitude_.data());
+                }
+                // Identity phase locking (Laroche and Dolson): every spectral peak moves with the bins around
+                // it, down to the midpoints between neighbouring peaks, by a whole number of bins so the
+                // window's lobe keeps its shape. The peak's phase advances at its new frequency; the bins
+                // around it keep their phase relative to the peak.
+                peaks_.clear();
+                float loudest = 0;
+                for (int k = 0; k < bins_; k++) {
+                    loudest = std::max(loudest, magnitude_[k]);
+                }
+                const float threshold = loudest * 1e-4f;
+                for (int k = 1; k + 1 < bins_; k++) {
+                    if (magnitude_[k] > threshold && magnitude_[k] > magnitude_[k - 1] && magnitude_[k] >= magnitude_[k + 1]) {
+                        peaks_.push_back(k);
+                    }
+                }
+                std::fill(shiftedMagnitude_.begin(), shiftedMagnitude_.end(), 0.0f);
+                std::fill(strongest_.begin(), strongest_.end(), 0.0f);
+                for (int k = 0; k < bins_; k++) {
+                    // Bins nothing moves into keep turning at their own frequency.
+                    shiftedPhase_[k] = synthesisPhase[k] + k * expected;
+                }
+                for (size_t i = 0; i < peaks_.size(); i++) {
+                    const int peak = peaks_[i];
+                    const int first = i == 0 ? 0 : (peaks_[i - 1] + peak + 1) / 2;
+                    const int last = i + 1 == peaks_.size() ? bins_ : (peak + peaks_[i + 1] + 1) / 2;
+                    const float frequency = frequency_[peak] * ratio_;
+                    const int shift = static_cast<int>(std::floor(frequency - frequency_[peak] + 0.5f));
+                    if (peak + shift < 0 || peak + shift >= bins_) {
+                        continue;
+                    }
+                    const float peakPhase = synthesisPhase[peak + shift] + frequency * expected;
+                    for (int k = std::max(first, -shift); k < std::min(last, bins_ - shift); k++) {
+                        const int target = k + shift;
+                        float magnitude = magnitude_[k];
+                        if (formants_) {
+                            // Keep the level the envelope had at the new frequency rather than the old one.
+                            magnitude *= std::min(envelope_[target] / envelope_[k], kMaxFormantGain);
+                        }
+                        shiftedMagnitude_[target] += magnitude;
+                        // Where regions overlap the stronger one sets the phase.
+                        if (magnitude > strongest_[target]) {
+                            strongest_[target] = magnitude;
+                            shiftedPhase_[target] = peakPhase + analysisPhase[k] - analysisPhase[peak];
+                        }
+                    }
+                }
+
+                for (int k = 0; k < padded_; k += 4) {
+                    using namespace simd;
+                    const F32x4 phase = wrapPhase(loadF(&shiftedPhase_[k]));
+                    const F32x4 magnitude = loadF(&shiftedMagnitude_[k]);
+                    F32x4 sine, cosine;
+                    sinCosF(phase, sine, cosine);
+                    storeF(synthesisPhase + k, phase);
+                    storeF(&re_[k], mul(magnitude, cosine));
+                    storeF(&im_[k], mul(magnitude, sine));
+                }
+            }
+            fft_.inverse(re_.data(), im_.data(), frame_.data());
+            for (int i = 0; i < size_; i++) {
+                overlap[i] += frame_[i] * window_[i];
+            }
+
+            // The first hop has all its overlapping frames now.
+            float* output = output_.data() + channel * hop_;
+            std::copy(overlap, overlap + hop_, output);
+            std::copy(overlap + hop_, overlap + size_, overlap);
+            std::fill(overlap + size_ - hop_, overlap + size_, 0.0f);
+            std::copy(input + hop_, input + size_, input);
+        }
+
+        void PitchShiftStage::measureEnvelope(const float* magnitude) {
+            prefix_[0] = 0;
+            for (int k = 0; k < bins_; k++) {
+                prefix_[k + 1] = prefix_[k] + magnitude[k];
+            }
+            // A floor keeps the ratios finite in silent regions.
+            const float floor = prefix_[bins_] / bins_ * 1e-3f + 1e-6f;
+            for (int k = 0; k < bins_; k++) {
+                const int first = std::max(k - envelopeRadius_, 0);
+                const int last = std::min(k + envelopeRadius_ + 1, bins_);
+                envelope_[k] = (prefix_[last] - prefix_[first]) / (last - first) + floor;
+            }
+        }
+    }
+}
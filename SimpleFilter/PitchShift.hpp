@@ -0,0 +1,79 @@
+//
+//  PitchShift.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_PITCHSHIFT_H
+#define AGORA_PITCHSHIFT_H
+
+#include <vector>
+#include "AudioChain.hpp"
+#include "Fft.hpp"
+
+namespace agora {
+    namespace extension {
+        // "pitch" chain stage: a phase vocoder that moves the pitch by "semitones" (-12 to 12, default 0)
+        // without changing the duration. With "formants": true the spectral envelope stays where it was,
+        // so a voice changes pitch without sounding larger or smaller.
+        //
+        // Each channel is analysed in Hann-windowed frames, the largest power of two that keeps the delay
+        // within 20 ms (512 samples at 32 to 48 kHz, 256 at 16 kHz), overlapping by 75%. The partials'
+        // frequencies are estimated from the phase advance between frames; each spectral peak is moved
+        // with its neighbourhood to the new frequency and resynthesized with phases locked to the peak.
+        // The stage delays the signal by one frame.
+        class PitchShiftStage : public AudioStage {
+        public:
+            static std::unique_ptr<AudioStage> create(const JsonValue& spec);
+
+            void prepare(int sampleRateHz, int channels) override;
+            void process(float* data, size_t frames, int channels) override;
+            int latencyFrames() const override { return size_; }
+            void continueFrom(AudioStage& previous) override;
+
+        private:
+            // Analyses the frame that ends with the last hop of `channel`, adds its resynthesis to the
+            // channel's output and moves both on by a hop.
+            void shiftFrame(int channel);
+            // Smooths `magnitude` across bins into `envelope_`, removing the harmonic ripple.
+            void measureEnvelope(const float* magnitude);
+
+            float ratio_ = 1;
+            bool formants_ = false;
+
+            int sampleRateHz_ = 0;
+            int channels_ = 0;
+            int size_ = 0;
+            int hop_ = 0;
+            int bins_ = 0;
+            // Bins rounded up to whole vectors; the per-bin arrays have this many, the extra ones zero.
+            int padded_ = 0;
+            int envelopeRadius_ = 0;
+            // Position in the current hop, the same for every channel.
+            int fill_ = 0;
+            RealFft fft_;
+            std::vector<float> window_;
+            // Per channel: the last frame of input, the overlap-add of the resynthesized frames and the
+            // finished hop being played out; the analysis and synthesis phases of every bin.
+            std::vector<float> input_;
+            std::vector<float> overlap_;
+            std::vector<float> output_;
+            std::vector<float> analysisPhase_;
+            std::vector<float> synthesisPhase_;
+            // Scratch for one frame.
+            std::vector<float> frame_;
+            std::vector<float> re_;
+            std::vector<float> im_;
+            std::vector<float> magnitude_;
+            std::vector<float> frequency_;
+            std::vector<float> shiftedMagnitude_;
+            std::vector<float> shiftedPhase_;
+            std::vector<float> strongest_;
+            std::vector<int> peaks_;
+            std::vector<float> envelope_;
+            std::vector<float> prefix_;
+        };
+    }
+}
+
+
+#endif //AGORA_PITCHSHIFT_H
@@ -0,0 +1,180 @@
+//
+//  PitchShiftTest.cpp
+//  SimpleFilter
+//
+//  Checks and benchmark for the "pitch" chain stage and RealFft. Not part of the extension target, build and
+//  run it on its own, with the SDK headers from ../libs, which the chain's thread pool needs:
+//      c++ -O2 -std=c++14 -F../libs/AgoraRtcKit.xcframework/ios-arm64_x86_64-simulator -F../libs/aosl.xcframework/ios-arm64_x86_64-simulator PitchShiftTest.cpp PitchShift.cpp AudioChain.cpp AudioKernels.cpp Biquad.cpp Convolver.cpp Dynamics.cpp Fft.cpp Json.cpp Reverb.cpp external_thread_pool.cpp -o PitchShiftTest && ./PitchShiftTest
+//  Returns non-zero if any check fails. Add -DSF_DISABLE_SIMD to time the scalar path.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+#include "AudioChain.hpp"
+#include "Fft.hpp"
+
+using namespace agora::extension;
+
+static int gFailures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        gFailures++;
+    }
+}
+
+// Runs `config` over interleaved `samples` in 10 ms frames, as the filter does.
+static std::vector<float> runChain(const char* config, int rate, int channels, std::vector<float> samples, int* latency = nullptr) {
+    std::unique_ptr<AudioChain> chain = AudioChain::create(config);
+    chain->prepare(rate, channels);
+    if (latency) {
+        *latency = chain->latencyFrames();
+    }
+    const size_t frames = samples.size() / channels;
+    const size_t perCall = rate / 100;
+    for (size_t f = 0; f < frames; f += perCall) {
+        chain->process(samples.data() + f * channels, std::min(perCall, frames - f), channels);
+    }
+    return samples;
+}
+
+// Amplitude of the `hz` component of channel `c` over `count` frames from `from`.
+static double toneLevel(const std::vector<float>& x, int channels, int c, double hz, int rate, size_t from, size_t count) {
+    double re = 0, im = 0;
+    for (size_t t = 0; t < count; t++) {
+        const double v = x[(from + t) * channels + c];
+        re += v * std::cos(2 * M_PI * hz * t / rate);
+        im += v * std::sin(2 * M_PI * hz * t / rate);
+    }
+    return 2 * std::sqrt(re * re + im * im) / count;
+}
+
+static void testFftRoundTrip() {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> uniform(-1, 1);
+    double worst = 0;
+    for (int size = 16; size <= 4096; size *= 2) {
+        RealFft fft;
+        fft.prepare(size);
+        std::vector<float> input(size), output(size), re(fft.bins() + 3), im(fft.bins() + 3);
+        for (float& v : input) {
+            v = uniform(random);
+        }
+        fft.forward(input.data(), re.data(), im.data());
+        fft.inverse(re.data(), im.data(), output.data());
+        for (int i = 0; i < size; i++) {
+            worst = std::max(worst, static_cast<double>(std::fabs(output[i] - input[i])));
+        }
+    }
+    printf("RealFft round trip, sizes 16-4096: max error %.1e\n", worst);
+    check(worst < 2e-6, "RealFft round trip returns the input");
+}
+
+// Without a shift or formants the stage resynthesizes what it analysed, so it is a delay of latencyFrames.
+static void testUnity() {
+    const int rate = 48000;
+    std::vector<float> input(rate);
+    for (int i = 0; i < rate; i++) {
+        input[i] = static_cast<float>(8000 * std::sin(2 * M_PI * 440 * i / rate) + 4000 * std::sin(2 * M_PI * 1234 * i / rate));
+    }
+    int latency = 0;
+    const std::vector<float> output = runChain("[{\"type\":\"pitch\",\"semitones\":0}]", rate, 1, input, &latency);
+    double error = 0, signal = 0;
+    for (int i = 2000; i < rate; i++) {
+        const double d = output[i] - input[i - latency];
+        error += d * d;
+        signal += input[i - latency] * input[i - latency];
+    }
+    const double snr = 10 * std::log10(signal / error);
+    printf("unity: latency %d frames (%.1f ms), SNR against the delayed input %.0f dB\n", latency, latency * 1000.0 / rate, snr);
+    check(latency == 512 && snr > 80, "unity shift is a plain delay of one frame");
+}
+
+// A shifted sine keeps its level: each window lobe moves intact.
+static void testShiftedSine() {
+    const int rate = 48000;
+    for (int semitones : {12, 7, -5, -12}) {
+        std::vector<float> input(2 * rate);
+        for (int i = 0; i < rate; i++) {
+            input[2 * i] = input[2 * i + 1] = static_cast<float>(8000 * std::sin(2 * M_PI * 440 * i / rate));
+        }
+        char config[64];
+        snprintf(config, sizeof(config), "[{\"type\":\"pitch\",\"semitones\":%d}]", semitones);
+        const std::vector<float> output = runChain(config, rate, 2, input);
+        const double hz = 440 * std::pow(2, semitones / 12.0);
+        const double level = 20 * std::log10(toneLevel(output, 2, 1, hz, rate, rate / 2, rate / 2) / 8000);
+        const double left = 20 * std::log10(toneLevel(output, 2, 1, 440, rate, rate / 2, rate / 2) / 8000);
+        printf("%+3d st: %.1f Hz at %+.2f dB, 440 Hz left at %.0f dB\n", semitones, hz, level, left);
+        check(std::fabs(level) < 0.5 && left < -30, "a shifted sine moves whole and keeps its level");
+    }
+}
+
+// A 150 Hz harmonic series under a formant at 1 kHz, up 7 semitones: with formants kept, the strongest
+// harmonic stays near 1 kHz instead of moving up with the pitch.
+static void testFormants() {
+    const int rate = 48000;
+    std::vector<float> input(rate);
+    for (int i = 0; i < rate; i++) {
+        double v = 0;
+        for (int h = 1; h < 30; h++) {
+            const double hz = 150.0 * h;
+            v += 3000 / (1 + std::pow((hz - 1000) / 300, 2)) * std::sin(2 * M_PI * hz * i / rate);
+        }
+        input[i] = static_cast<float>(v);
+    }
+    const double f0 = 150 * std::pow(2, 7 / 12.0);
+    double strongest[2] = {0, 0};
+    const char* configs[2] = {"[{\"type\":\"pitch\",\"semitones\":7}]", "[{\"type\":\"pitch\",\"semitones\":7,\"formants\":true}]"};
+    for (int k = 0; k < 2; k++) {
+        const std::vector<float> output = runChain(configs[k], rate, 1, input);
+        double best = 0;
+        for (int h = 1; h < 20; h++) {
+            const double level = toneLevel(output, 1, 0, f0 * h, rate, rate / 2, rate / 2);
+            if (level > best) {
+                best = level;
+                strongest[k] = f0 * h;
+            }
+        }
+    }
+    printf("+7 st on a 1 kHz formant: strongest harmonic %.0f Hz plain, %.0f Hz with formants\n", strongest[0], strongest[1]);
+    check(std::fabs(strongest[1] - 1000) < std::fabs(strongest[0] - 1000) && std::fabs(strongest[1] - 1000) < f0,
+          "formant mode keeps the envelope in place");
+}
+
+// +5 semitones with formants, the heaviest setting, per stream and 10 ms frame.
+static void benchPitch() {
+    for (int rate : {48000, 16000}) {
+        for (int channels : {1, 2}) {
+            std::vector<float> samples(static_cast<size_t>(rate) * channels * 10);
+            for (size_t i = 0; i < samples.size(); i++) {
+                samples[i] = static_cast<float>(8000 * std::sin(i * 0.01));
+            }
+            std::unique_ptr<AudioChain> chain = AudioChain::create("[{\"type\":\"pitch\",\"semitones\":5,\"formants\":true}]");
+            chain->prepare(rate, channels);
+            const size_t perCall = rate / 100;
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t f = 0; f + perCall <= samples.size() / channels; f += perCall) {
+                chain->process(samples.data() + f * channels, perCall, channels);
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            printf("%d Hz, %d channel%s: %6.1f us per 10 ms frame, %.2f%% of a core\n", rate, channels,
+                   channels > 1 ? "s" : "", seconds / 1000 * 1e6, seconds / 10 * 100);
+        }
+    }
+}
+
+int main() {
+    testFftRoundTrip();
+    testUnity();
+    testShiftedSine();
+    testFormants();
+    benchPitch();
+    printf(gFailures ? "%d checks failed\n" : "all checks passed\n", gFailures);
+    return gFailures ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+//
+//  QualityGovernor.cpp
+//  SimpleFilter
+//
+
+#include "QualityGovernor.hpp"
+
+#include <algorithm>
+
+namespace agora {
+    namespace extension {
+        // Weight of the newest sample in the moving averages of the frame cost and the frame interval.
+        static const double kCostSmoothing = 0.1;
+        static const double kIntervalSmoothing = 0.05;
+        // Consecutive frames over budget before stepping down; a few frames react within ~150 ms at 30 fps.
+        static const int kDownFrames = 5;
+        // Cost must stay below this share of the budget before stepping up again.
+        static const double kUpRatio = 0.5;
+        static const int kBaseUpDwellFrames = 60;
+        static const int kMaxUpDwellFrames = 960;
+        // A step down within this many frames of a step up counts as a bounce.
+        static const int kBounceFrames = 90;
+        // Frames without any level change after which the up dwell returns to its base value.
+        static const int kRelaxFrames = 1800;
+
+        QualityGovernor::QualityGovernor() {
+            reset();
+        }
+
+        void QualityGovernor::reset() {
+            level_ = kFull;
+            costMs_ = 0;
+            lastLevelCostMs_ = 0;
+            intervalMs_ = 1000.0 / 30;
+            lastTimestampMs_ = -1;
+            frameCount_ = 0;
+            overBudgetFrames_ = 0;
+            underBudgetFrames_ = 0;
+            upDwellFrames_ = kBaseUpDwellFrames;
+            framesSinceUp_ = -1;
+            stableFrames_ = 0;
+        }
+
+        void QualityGovernor::setBudgetRatio(double ratio) {
+            budgetRatio_ = std::max(0.05, std::min(1.0, ratio));
+        }
+
+        void QualityGovernor::setEnabled(bool enabled) {
+            enabled_ = enabled;
+            if (!enabled_) {
+                setLevel(kFull);
+            }
+        }
+
+        bool QualityGovernor::beginFrame(int64_t timestampMs) {
+            // Ignore gaps of a second or more (capture restarts, backgrounding) when estimating the interval.
+            if (timestampMs > 0 && lastTimestampMs_ > 0 && timestampMs > lastTimestampMs_
+                && timestampMs - lastTimestampMs_ < 1000) {
+                double interval = static_cast<double>(timestampMs - lastTimestampMs_);
+                intervalMs_ += kIntervalSmoothing * (interval - intervalMs_);
+            }
+            if (timestampMs > 0) {
+                lastTimestampMs_ = timestampMs;
+            }
+            frameCount_++;
+            return !(enabled_ && level_ == kHalfRate && (frameCount_ & 1));
+        }
+
+        bool QualityGovernor::endFrame(double elapsedMs) {
+            costMs_ = (costMs_ <= 0) ? elapsedMs : costMs_ + kCostSmoothing * (elapsedMs - costMs_);
+            if (!enabled_) {
+                return false;
+            }
+
+            double budget = budgetMs();
+            if (costMs_ > budget) {
+                overBudgetFrames_++;
+                underBudgetFrames_ = 0;
+            } else if (costMs_ < budget * kUpRatio) {
+                underBudgetFrames_++;
+                overBudgetFrames_ = 0;
+            } else {
+                overBudgetFrames_ = 0;
+                underBudgetFrames_ = 0;
+            }
+            if (framesSinceUp_ >= 0) {
+                framesSinceUp_++;
+            }
+
+            if (overBudgetFrames_ >= kDownFrames && level_ < kHalfRate) {
+                if (framesSinceUp_ >= 0 && framesSinceUp_ < kBounceFrames) {
+                    upDwellFrames_ = std::min(upDwellFrames_ * 2, kMaxUpDwellFrames);
+                }
+                framesSinceUp_ = -1;
+                setLevel(static_cast<Level>(level_ + 1));
+                return true;
+            }
+            if (underBudgetFrames_ >= upDwellFrames_ && level_ > kFull) {
+                framesSinceUp_ = 0;
+                setLevel(static_cast<Level>(level_ - 1));
+                return true;
+            }
+            if (++stableFrames_ >= kRelaxFrames) {
+                upDwellFrames_ = kBaseUpDwellFrames;
+            }
+            return false;
+        }
+
+        void QualityGovernor::setLevel(Level level) {
+            level_ = level;
+            lastLevelCostMs_ = costMs_;
+            // The cost of the old level says little about the new one; start averaging afresh.
+            costMs_ = 0;
+            overBudgetFrames_ = 0;
+            underBudgetFrames_ = 0;
+            stableFrames_ = 0;
+        }
+    }
+}
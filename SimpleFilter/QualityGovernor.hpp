@@ -0,0 +1,70 @@
+//
+//  QualityGovernor.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_QUALITYGOVERNOR_H
+#define AGORA_QUALITYGOVERNOR_H
+
+#include <cstdint>
+
+namespace agora {
+    namespace extension {
+        // Picks how much work the video filter may do per frame. The governor compares the smoothed
+        // processing time with a budget derived from the observed frame interval, steps down quickly
+        // when the budget is exceeded and steps back up slowly once there is plenty of headroom again.
+        class QualityGovernor {
+        public:
+            enum Level {
+                kFull = 0,          // every stage enabled
+                kReducedResolution, // heavy stages run at half resolution or lower
+                kRoiOnly,           // heavy stages restricted to the ROIs, skipped when there are none
+                kEssentialOnly,     // heavy stages skipped, only the cheap ones run
+                kHalfRate,          // as kEssentialOnly, and every other frame is dropped
+                kLevelCount
+            };
+
+            QualityGovernor();
+
+            // Called for every frame before it is processed. Returns false if the frame should be
+            // dropped at the current level; such frames must not be reported through endFrame.
+            bool beginFrame(int64_t timestampMs);
+
+            // Reports the processing time of the frame admitted by the last beginFrame.
+            // Returns true if the level changed.
+            bool endFrame(double elapsedMs);
+
+            Level level() const { return level_; }
+            // Smoothed processing time; right after a level change, the value that triggered the change.
+            double frameCostMs() const { return costMs_ > 0 ? costMs_ : lastLevelCostMs_; }
+            double budgetMs() const { return intervalMs_ * budgetRatio_; }
+
+            // Share of the frame interval the filter may spend, e.g. 0.5 for half of it.
+            void setBudgetRatio(double ratio);
+            void setEnabled(bool enabled);
+            void reset();
+
+        private:
+            void setLevel(Level level);
+
+            bool enabled_ = true;
+            double budgetRatio_ = 0.5;
+            Level level_ = kFull;
+            double costMs_ = 0;
+            double lastLevelCostMs_ = 0;
+            double intervalMs_ = 1000.0 / 30;
+            int64_t lastTimestampMs_ = -1;
+            uint32_t frameCount_ = 0;
+            int overBudgetFrames_ = 0;
+            int underBudgetFrames_ = 0;
+            // Frames of sustained headroom required before stepping up. Doubled whenever a step up is
+            // followed by a quick step down, so a level that cannot be held is not retried every second.
+            int upDwellFrames_ = 0;
+            int framesSinceUp_ = -1;
+            int stableFrames_ = 0;
+        };
+    }
+}
+
+
+#endif //AGORA_QUALITYGOVERNOR_H
@@ -0,0 +1,219 @@
+//
+//  Reverb.cpp
+//  SimpleFilter
+//
+
+#include "Reverb.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace agora {
+    namespace extension {
+        static const double kMaxImpulseSeconds = 10;
+        // The worker gets this much audio to finish the tail of a block, two typical 10 ms frames.
+        static const int kWorkerLeadMs = 20;
+
+        static uint32_t readLittleEndian(const uint8_t* bytes, int count) {
+            uint32_t value = 0;
+            for (int i = count - 1; i >= 0; i--) {
+                value = (value << 8) | bytes[i];
+            }
+            return value;
+        }
+
+        // Reads the first two channels of a PCM or float WAV file, as gains in [-1, 1].
+        static bool readWav(const std::string& path, std::vector<std::vector<float>>& impulse, int& sampleRateHz) {
+            FILE* file = fopen(path.c_str(), "rb");
+            if (!file) {
+                return false;
+            }
+            std::vector<uint8_t> bytes;
+            uint8_t buffer[4096];
+            size_t read = 0;
+            while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                bytes.insert(bytes.end(), buffer, buffer + read);
+            }
+            fclose(file);
+            if (bytes.size() < 12 || memcmp(bytes.data(), "RIFF", 4) != 0 || memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+                return false;
+            }
+            int format = 0, channels = 0, bits = 0;
+            const uint8_t* data = nullptr;
+            size_t dataSize = 0;
+            for (size_t offset = 12; offset + 8 <= bytes.size();) {
+                const uint8_t* chunk = bytes.data() + offset;
+                const size_t size = std::min<size_t>(readLittleEndian(chunk + 4, 4), bytes.size() - offset - 8);
+                if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+                    format = static_cast<int>(readLittleEndian(chunk + 8, 2));
+                    channels = static_cast<int>(readLittleEndian(chunk + 10, 2));
+                    sampleRateHz = static_cast<int>(readLittleEndian(chunk + 12, 4));
+                    bits = static_cast<int>(readLittleEndian(chunk + 22, 2));
+                    // WAVE_FORMAT_EXTENSIBLE carries the real format in its sub-format GUID.
+                    if (format == 0xFFFE && size >= 26) {
+                        format = static_cast<int>(readLittleEndian(chunk + 32, 2));
+                    }
+                } else if (memcmp(chunk, "data", 4) == 0) {
+                    data = chunk + 8;
+                    dataSize = size;
+                }
+                offset += 8 + size + (size & 1);
+            }
+            const bool pcm = format == 1 && (bits == 16 || bits == 24 || bits == 32);
+            const bool ieee = format == 3 && bits == 32;
+            if (!data || channels <= 0 || sampleRateHz <= 0 || (!pcm && !ieee)) {
+                return false;
+            }
+            const int bytesPerSample = bits / 8;
+            const size_t frames = std::min(dataSize / (bytesPerSample * channels),
+                                           static_cast<size_t>(kMaxImpulseSeconds * sampleRateHz));
+            impulse.assign(std::min(channels, 2), std::vector<float>(frames));
+            for (size_t f = 0; f < frames; f++) {
+                for (size_t c = 0; c < impulse.size(); c++) {
+                    const uint8_t* sample = data + (f * channels + c) * bytesPerSample;
+                    const uint32_t raw = readLittleEndian(sample, bytesPerSample);
+                    float value;
+                    if (ieee) {
+                        memcpy(&value, &raw, sizeof(value));
+                    } else {
+                        // Sign-extend from the top bit of the sample.
+                        const int32_t extended = static_cast<int32_t>(raw << (32 - bits)) >> (32 - bits);
+                        value = static_cast<float>(extended / std::ldexp(1.0, bits - 1));
+                    }
+                    impulse[c][f] = value;
+                }
+            }
+            return frames > 0;
+        }
+
+        // Reads "ir" as numbers, or as one array of numbers per channel.
+        static bool readTaps(const JsonValue& value, std::vector<std::vector<float>>& impulse) {
+            if (!value.isArray() || value.items().empty()) {
+                return false;
+            }
+            const bool nested = value.items()[0].isArray();
+            const std::vector<JsonValue> single(1, value);
+            const std::vector<JsonValue>& channels = nested ? value.items() : single;
+            if (channels.size() > 2) {
+                return false;
+            }
+            impulse.clear();
+            for (const JsonValue& channel : channels) {
+                if (!channel.isArray() || channel.items().empty()) {
+                    return false;
+                }
+                impulse.emplace_back();
+                for (const JsonValue& tap : channel.items()) {
+                    if (tap.type() != JsonValue::kNumber) {
+                        return false;
+                    }
+                    impulse.back().push_back(static_cast<float>(tap.asNumber()));
+                }
+            }
+            return true;
+        }
+
+        std::unique_ptr<AudioStage> ReverbStage::create(const JsonValue& spec) {
+            const double dryDb = spec.number("dry_db", 0);
+            const double wetDb = spec.number("wet_db", -12);
+            const int partition = static_cast<int>(spec.number("partition", 128));
+            const double decayMs = spec.number("decay_ms", 1500);
+            const double predelayMs = spec.number("predelay_ms", 20);
+            const double damping = spec.number("damping", 0.5);
+            const int impulseRateHz = static_cast<int>(spec.number("ir_rate", 48000));
+            if (dryDb < -96 || dryDb > 12 || wetDb < -96 || wetDb > 12
+                || partition < 32 || partition > 1024 || (partition & (partition - 1)) != 0
+                || decayMs < 100 || decayMs > 10000 || predelayMs < 0 || predelayMs > 200
+                || damping < 0 || damping > 1 || impulseRateHz < 8000 || impulseRateHz > 192000) {
+                return nullptr;
+            }
+            std::unique_ptr<ReverbStage> stage(new ReverbStage(spec.boolean("background", true)));
+            const std::string path = spec.string("ir_file", "");
+            const JsonValue* taps = spec.find("ir");
+            if (!path.empty()) {
+                if (!readWav(path, stage->impulse_, stage->impulseRateHz_)) {
+                    return nullptr;
+                }
+            } else if (taps) {
+                if (!readTaps(*taps, stage->impulse_)
+                    || stage->impulse_[0].size() > kMaxImpulseSeconds * impulseRateHz) {
+                    return nullptr;
+                }
+                stage->impulseRateHz_ = impulseRateHz;
+            }
+            stage->decayMs_ = decayMs;
+            stage->predelayMs_ = predelayMs;
+            stage->damping_ = damping;
+            stage->normalize_ = spec.boolean("normalize", true);
+            stage->partition_ = partition;
+            stage->dry_ = dryDb <= -96 ? 0.0f : static_cast<float>(std::pow(10.0, dryDb / 20));
+            stage->wet_ = wetDb <= -96 ? 0.0f : static_cast<float>(std::pow(10.0, wetDb / 20));
+            return stage;
+        }
+
+        void ReverbStage::prepare(int sampleRateHz, int channels) {
+            std::vector<std::vector<float>> impulse;
+            if (impulse_.empty()) {
+                // Exponentially decaying noise; a one-pole low-pass that closes as the tail goes on makes
+                // the highs die away first, as air and soft surfaces do.
+                const size_t predelay = static_cast<size_t>(predelayMs_ * sampleRateHz / 1000);
+                const size_t decay = static_cast<size_t>(decayMs_ * sampleRateHz / 1000);
+                uint32_t seed = 0x2545F491u;
+                impulse.assign(2, std::vector<float>(predelay + decay, 0.0f));
+                for (std::vector<float>& taps : impulse) {
+                    float lowPass = 0;
+                    for (size_t i = 0; i < decay; i++) {
+                        seed = seed * 1664525u + 1013904223u;
+                        const float noise = static_cast<float>(seed >> 8) / (1 << 23) - 1.0f;
+                        const double t = static_cast<double>(i) / decay;
+                        lowPass += static_cast<float>(1 - 0.95 * damping_ * t) * (noise - lowPass);
+                        // -60 dB, a factor of 1000, at the end of the decay.
+                        taps[predelay + i] = lowPass * static_cast<float>(std::exp(-6.907755 * t));
+                    }
+                }
+            } else {
+                // Linear interpolation to the stream's rate.
+                const double step = static_cast<double>(impulseRateHz_) / sampleRateHz;
+                for (const std::vector<float>& source : impulse_) {
+                    const size_t length = std::min(static_cast<size_t>(source.size() / step),
+                                                   static_cast<size_t>(kMaxImpulseSeconds * sampleRateHz));
+                    impulse.emplace_back(std::max<size_t>(length, 1), 0.0f);
+                    for (size_t i = 0; i < length; i++) {
+                        const double position = i * step;
+                        const size_t index = static_cast<size_t>(position);
+                        const float fraction = static_cast<float>(position - index);
+                        const float next = index + 1 < source.size() ? source[index + 1] : 0.0f;
+                        impulse.back()[i] = source[index] + (next - source[index]) * fraction;
+                    }
+                }
+            }
+            if (normalize_) {
+                double energy = 0;
+                for (const std::vector<float>& taps : impulse) {
+                    for (float tap : taps) {
+                        energy += static_cast<double>(tap) * tap;
+                    }
+                }
+                energy /= impulse.size();
+                if (energy > 0) {
+                    const float scale = static_cast<float>(1 / std::sqrt(energy));
+                    for (std::vector<float>& taps : impulse) {
+                        for (float& tap : taps) {
+                            tap *= scale;
+                        }
+                    }
+                }
+            }
+            if (impulse.size() != 2 || channels != 2) {
+                impulse.resize(1);
+            }
+            convolver_.prepare(impulse, channels, partition_, kWorkerLeadMs * sampleRateHz / 1000);
+        }
+
+        void ReverbStage::process(float* data, size_t frames, int /*channels*/) {
+            convolver_.process(data, frames, dry_, wet_);
+        }
+    }
+}
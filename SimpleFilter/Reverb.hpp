@@ -0,0 +1,55 @@
+//
+//  Reverb.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_REVERB_H
+#define AGORA_REVERB_H
+
+#include <vector>
+#include "AudioChain.hpp"
+#include "Convolver.hpp"
+
+namespace agora {
+    namespace extension {
+        // "reverb" chain stage: convolution with an impulse response, mixed as "dry_db" (default 0) plus
+        // "wet_db" (default -12), without delaying the dry signal. The response comes from one of:
+        //  - "ir_file": a WAV file (16, 24 or 32-bit PCM, or 32-bit float; mono or stereo);
+        //  - "ir": the taps inline, an array of numbers or one array per channel, at "ir_rate" (default
+        //    48000);
+        //  - otherwise a synthetic room: decaying noise that falls 60 dB over "decay_ms" (100-10000, default
+        //    1500) after "predelay_ms" (0-200, default 20), dulled over time by "damping" (0-1, default 0.5),
+        //    decorrelated between left and right.
+        // Responses are resampled to the stream's rate, cut at 10 s and, unless "normalize" is false,
+        // scaled to unit energy so that "wet_db" is the level of the reverberation relative to the input.
+        // A stereo response applies per channel to stereo; anything else uses the first channel everywhere.
+        //
+        // "partition" (32-1024, a power of two, default 128) is the block of the uniformly partitioned
+        // convolution, see PartitionedConvolver; "background": false keeps the tail on the audio thread.
+        class ReverbStage : public AudioStage {
+        public:
+            static std::unique_ptr<AudioStage> create(const JsonValue& spec);
+
+            void prepare(int sampleRateHz, int channels) override;
+            void process(float* data, size_t frames, int channels) override;
+
+        private:
+            explicit ReverbStage(bool background) : convolver_(background) {}
+
+            // The loaded response, or empty for the synthetic room, which is made at the stream's rate.
+            std::vector<std::vector<float>> impulse_;
+            int impulseRateHz_ = 0;
+            double decayMs_ = 1500;
+            double predelayMs_ = 20;
+            double damping_ = 0.5;
+            bool normalize_ = true;
+            int partition_ = 128;
+            float dry_ = 1;
+            float wet_ = 0;
+            PartitionedConvolver convolver_;
+        };
+    }
+}
+
+
+#endif //AGORA_REVERB_H
@@ -0,0 +1,54 @@
+//
+//  Semaphore.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_SEMAPHORE_H
+#define AGORA_SEMAPHORE_H
+
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <cerrno>
+#include <semaphore.h>
+#endif
+
+namespace agora {
+    namespace extension {
+        // Lets the audio thread wake a worker: post takes no lock and never blocks, and it is counted, so a
+        // worker that was just about to wait still wakes up. The worker sleeps until there is work instead of
+        // polling for it.
+        class Semaphore {
+        public:
+#if defined(__APPLE__)
+            Semaphore() { semaphore_create(mach_task_self(), &semaphore_, SYNC_POLICY_FIFO, 0); }
+            ~Semaphore() { semaphore_destroy(mach_task_self(), semaphore_); }
+            void post() { semaphore_signal(semaphore_); }
+            void wait() {
+                while (semaphore_wait(semaphore_) == KERN_ABORTED) {
+                }
+            }
+#else
+            Semaphore() { sem_init(&semaphore_, 0, 0); }
+            ~Semaphore() { sem_destroy(&semaphore_); }
+            void post() { sem_post(&semaphore_); }
+            void wait() {
+                while (sem_wait(&semaphore_) != 0 && errno == EINTR) {
+                }
+            }
+#endif
+            Semaphore(const Semaphore&) = delete;
+            Semaphore& operator=(const Semaphore&) = delete;
+
+        private:
+#if defined(__APPLE__)
+            semaphore_t semaphore_;
+#else
+            sem_t semaphore_;
+#endif
+        };
+    }
+}
+
+
+#endif //AGORA_SEMAPHORE_H
@@ -0,0 +1,335 @@
+//
+//  SimdUtils.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_SIMDUTILS_H
+#define AGORA_SIMDUTILS_H
+
+#include <cmath>
+#include <cstdint>
+
+// Selects the vector instruction set the kernels are compiled for. Devices build the NEON paths,
+// the simulator builds the SSE2 ones; every kernel also keeps a scalar path, which handles the
+// tails and can be forced with SF_DISABLE_SIMD to compare results.
+#if !defined(SF_DISABLE_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define SF_SIMD_NEON 1
+#elif !defined(SF_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define SF_SIMD_SSE2 1
+#if defined(__AVX2__)
+// Only when the target enables it; a few wide kernels use it on top of SSE2.
+#include <immintrin.h>
+#define SF_SIMD_AVX2 1
+#endif
+#endif
+
+namespace agora {
+    namespace extension {
+        namespace simd {
+            // Eight signed 16-bit lanes, the working type of the 8-bit pixel kernels: pixels are widened
+            // on load, processed with headroom and narrowed with saturation on store. The scalar
+            // fallback has identical semantics, including the wrap-around of add/sub/mullo.
+            struct I16x8 {
+#if defined(SF_SIMD_NEON)
+                int16x8_t v;
+#elif defined(SF_SIMD_SSE2)
+                __m128i v;
+#else
+                int16_t v[8];
+#endif
+            };
+
+            // Four float lanes, for the few kernels that need floating point such as transforms.
+            struct F32x4 {
+#if defined(SF_SIMD_NEON)
+                float32x4_t v;
+#elif defined(SF_SIMD_SSE2)
+                __m128 v;
+#else
+                float v[4];
+#endif
+            };
+
+#if defined(SF_SIMD_NEON)
+            inline I16x8 make(int16x8_t v) { I16x8 r; r.v = v; return r; }
+            inline I16x8 loadU8(const uint8_t* p) { return make(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)))); }
+            inline void storeU8(uint8_t* p, I16x8 a) { vst1_u8(p, vqmovun_s16(a.v)); }
+            inline I16x8 splat(int16_t x) { return make(vdupq_n_s16(x)); }
+            inline I16x8 add(I16x8 a, I16x8 b) { return make(vaddq_s16(a.v, b.v)); }
+            inline I16x8 sub(I16x8 a, I16x8 b) { return make(vsubq_s16(a.v, b.v)); }
+            inline I16x8 mullo(I16x8 a, I16x8 b) { return make(vmulq_s16(a.v, b.v)); }
+            inline I16x8 min(I16x8 a, I16x8 b) { return make(vminq_s16(a.v, b.v)); }
+            inline I16x8 max(I16x8 a, I16x8 b) { return make(vmaxq_s16(a.v, b.v)); }
+            inline I16x8 abs(I16x8 a) { return make(vabsq_s16(a.v)); }
+            template <int N> inline I16x8 sra(I16x8 a) { return make(vshrq_n_s16(a.v, N)); }
+            template <int N> inline I16x8 shl(I16x8 a) { return make(vshlq_n_s16(a.v, N)); }
+            // High half of the unsigned 16 x 16 bit product.
+            inline I16x8 mulhiU(I16x8 a, I16x8 b) {
+                uint16x8_t ua = vreinterpretq_u16_s16(a.v);
+                uint16x8_t ub = vreinterpretq_u16_s16(b.v);
+                uint32x4_t lo = vmull_u16(vget_low_u16(ua), vget_low_u16(ub));
+                uint32x4_t hi = vmull_u16(vget_high_u16(ua), vget_high_u16(ub));
+                return make(vreinterpretq_s16_u16(vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16))));
+            }
+            inline int sumLanes(I16x8 a) { return vaddvq_s32(vpaddlq_s16(a.v)); }
+
+            inline F32x4 makeF(float32x4_t v) { F32x4 r; r.v = v; return r; }
+            inline F32x4 loadF(const float* p) { return makeF(vld1q_f32(p)); }
+            inline void storeF(float* p, F32x4 a) { vst1q_f32(p, a.v); }
+            inline F32x4 splatF(float x) { return makeF(vdupq_n_f32(x)); }
+            inline F32x4 add(F32x4 a, F32x4 b) { return makeF(vaddq_f32(a.v, b.v)); }
+            inline F32x4 sub(F32x4 a, F32x4 b) { return makeF(vsubq_f32(a.v, b.v)); }
+            inline F32x4 mul(F32x4 a, F32x4 b) { return makeF(vmulq_f32(a.v, b.v)); }
+            // a + b * c
+            inline F32x4 madd(F32x4 a, F32x4 b, F32x4 c) { return makeF(vmlaq_f32(a.v, b.v, c.v)); }
+            inline F32x4 min(F32x4 a, F32x4 b) { return makeF(vminq_f32(a.v, b.v)); }
+            inline F32x4 max(F32x4 a, F32x4 b) { return makeF(vmaxq_f32(a.v, b.v)); }
+            // Lanes [begin, end) all ones, the others zero; a mask for select.
+            inline F32x4 laneMaskF(int begin, int end) {
+                const uint32_t m[4] = {begin <= 0 && end > 0 ? ~0u : 0u, begin <= 1 && end > 1 ? ~0u : 0u,
+                                       begin <= 2 && end > 2 ? ~0u : 0u, begin <= 3 && end > 3 ? ~0u : 0u};
+                return makeF(vreinterpretq_f32_u32(vld1q_u32(m)));
+            }
+            // Lanes of `a` where `mask` is set, of `b` elsewhere.
+            inline F32x4 select(F32x4 mask, F32x4 a, F32x4 b) { return makeF(vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v)); }
+            inline F32x4 div(F32x4 a, F32x4 b) { return makeF(vdivq_f32(a.v, b.v)); }
+            inline F32x4 sqrt(F32x4 a) { return makeF(vsqrtq_f32(a.v)); }
+            inline F32x4 abs(F32x4 a) { return makeF(vabsq_f32(a.v)); }
+            // A mask of the lanes where a < b.
+            inline F32x4 less(F32x4 a, F32x4 b) { return makeF(vreinterpretq_f32_u32(vcltq_f32(a.v, b.v))); }
+            // Nearest whole number, for values within the int range.
+            inline F32x4 roundF(F32x4 a) { return makeF(vrndnq_f32(a.v)); }
+
+            // Moves for kernels that keep N interleaved channels (1, 2 or 4) in the low or high lanes.
+            template <int N> struct FloatLanes;
+            template <> struct FloatLanes<4> {
+                static F32x4 loadLow(const float* p) { return makeF(vld1q_f32(p)); }
+                static void storeHigh(float* p, F32x4 a) { vst1q_f32(p, a.v); }
+                // The N lanes of `low` followed by the first 4 - N lanes of `a`.
+                static F32x4 shiftUp(F32x4 /*a*/, F32x4 low) { return low; }
+                // The same with the N high lanes of `high` moving into the low lanes.
+                static F32x4 shiftUpHigh(F32x4 /*a*/, F32x4 high) { return high; }
+            };
+            template <> struct FloatLanes<2> {
+                static F32x4 loadLow(const float* p) { return makeF(vcombine_f32(vld1_f32(p), vdup_n_f32(0))); }
+                static void storeHigh(float* p, F32x4 a) { vst1_f32(p, vget_high_f32(a.v)); }
+                static F32x4 shiftUp(F32x4 a, F32x4 low) {
+                    return makeF(vcombine_f32(vget_low_f32(low.v), vget_low_f32(a.v)));
+                }
+                static F32x4 shiftUpHigh(F32x4 a, F32x4 high) {
+                    return makeF(vcombine_f32(vget_high_f32(high.v), vget_low_f32(a.v)));
+                }
+            };
+            template <> struct FloatLanes<1> {
+                static F32x4 loadLow(const float* p) { return makeF(vsetq_lane_f32(p[0], vdupq_n_f32(0), 0)); }
+                static void storeHigh(float* p, F32x4 a) { vst1q_lane_f32(p, a.v, 3); }
+                static F32x4 shiftUp(F32x4 a, F32x4 low) { return makeF(vextq_f32(vextq_f32(low.v, low.v, 1), a.v, 3)); }
+                static F32x4 shiftUpHigh(F32x4 a, F32x4 high) { return makeF(vextq_f32(high.v, a.v, 3)); }
+            };
+#elif defined(SF_SIMD_SSE2)
+            inline I16x8 make(__m128i v) { I16x8 r; r.v = v; return r; }
+            inline I16x8 loadU8(const uint8_t* p) {
+                return make(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128()));
+            }
+            inline void storeU8(uint8_t* p, I16x8 a) { _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_packus_epi16(a.v, a.v)); }
+            inline I16x8 splat(int16_t x) { return make(_mm_set1_epi16(x)); }
+            inline I16x8 add(I16x8 a, I16x8 b) { return make(_mm_add_epi16(a.v, b.v)); }
+            inline I16x8 sub(I16x8 a, I16x8 b) { return make(_mm_sub_epi16(a.v, b.v)); }
+            inline I16x8 mullo(I16x8 a, I16x8 b) { return make(_mm_mullo_epi16(a.v, b.v)); }
+            inline I16x8 min(I16x8 a, I16x8 b) { return make(_mm_min_epi16(a.v, b.v)); }
+            inline I16x8 max(I16x8 a, I16x8 b) { return make(_mm_max_epi16(a.v, b.v)); }
+            inline I16x8 abs(I16x8 a) { return make(_mm_max_epi16(a.v, _mm_sub_epi16(_mm_setzero_si128(), a.v))); }
+            template <int N> inline I16x8 sra(I16x8 a) { return make(_mm_srai_epi16(a.v, N)); }
+            template <int N> inline I16x8 shl(I16x8 a) { return make(_mm_slli_epi16(a.v, N)); }
+            inline I16x8 mulhiU(I16x8 a, I16x8 b) { return make(_mm_mulhi_epu16(a.v, b.v)); }
+            inline int sumLanes(I16x8 a) {
+                __m128i s = _mm_madd_epi16(a.v, _mm_set1_epi16(1));
+                s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+                s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+                return _mm_cvtsi128_si32(s);
+            }
+
+            inline F32x4 makeF(__m128 v) { F32x4 r; r.v = v; return r; }
+            inline F32x4 loadF(const float* p) { return makeF(_mm_loadu_ps(p)); }
+            inline void storeF(float* p, F32x4 a) { _mm_storeu_ps(p, a.v); }
+            inline F32x4 splatF(float x) { return makeF(_mm_set1_ps(x)); }
+            inline F32x4 add(F32x4 a, F32x4 b) { return makeF(_mm_add_ps(a.v, b.v)); }
+            inline F32x4 sub(F32x4 a, F32x4 b) { return makeF(_mm_sub_ps(a.v, b.v)); }
+            inline F32x4 mul(F32x4 a, F32x4 b) { return makeF(_mm_mul_ps(a.v, b.v)); }
+            inline F32x4 madd(F32x4 a, F32x4 b, F32x4 c) { return makeF(_mm_add_ps(a.v, _mm_mul_ps(b.v, c.v))); }
+            inline F32x4 min(F32x4 a, F32x4 b) { return makeF(_mm_min_ps(a.v, b.v)); }
+            inline F32x4 max(F32x4 a, F32x4 b) { return makeF(_mm_max_ps(a.v, b.v)); }
+            inline F32x4 laneMaskF(int begin, int end) {
+                return makeF(_mm_castsi128_ps(_mm_set_epi32(begin <= 3 && end > 3 ? -1 : 0, begin <= 2 && end > 2 ? -1 : 0,
+                                                            begin <= 1 && end > 1 ? -1 : 0, begin <= 0 && end > 0 ? -1 : 0)));
+            }
+            inline F32x4 select(F32x4 mask, F32x4 a, F32x4 b) {
+                return makeF(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+            }
+            inline F32x4 div(F32x4 a, F32x4 b) { return makeF(_mm_div_ps(a.v, b.v)); }
+            inline F32x4 sqrt(F32x4 a) { return makeF(_mm_sqrt_ps(a.v)); }
+            inline F32x4 abs(F32x4 a) { return makeF(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+            inline F32x4 less(F32x4 a, F32x4 b) { return makeF(_mm_cmplt_ps(a.v, b.v)); }
+            inline F32x4 roundF(F32x4 a) { return makeF(_mm_cvtepi32_ps(_mm_cvtps_epi32(a.v))); }
+
+            template <int N> struct FloatLanes;
+            template <> struct FloatLanes<4> {
+                static F32x4 loadLow(const float* p) { return makeF(_mm_loadu_ps(p)); }
+                static void storeHigh(float* p, F32x4 a) { _mm_storeu_ps(p, a.v); }
+                static F32x4 shiftUp(F32x4 /*a*/, F32x4 low) { return low; }
+                static F32x4 shiftUpHigh(F32x4 /*a*/, F32x4 high) { return high; }
+            };
+            template <> struct FloatLanes<2> {
+                static F32x4 loadLow(const float* p) { return makeF(_mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64*>(p))); }
+                static void storeHigh(float* p, F32x4 a) { _mm_storeh_pi(reinterpret_cast<__m64*>(p), a.v); }
+                static F32x4 shiftUp(F32x4 a, F32x4 low) { return makeF(_mm_movelh_ps(low.v, a.v)); }
+                static F32x4 shiftUpHigh(F32x4 a, F32x4 high) { return makeF(_mm_shuffle_ps(high.v, a.v, _MM_SHUFFLE(1, 0, 3, 2))); }
+            };
+            template <> struct FloatLanes<1> {
+                static F32x4 loadLow(const float* p) { return makeF(_mm_load_ss(p)); }
+                static void storeHigh(float* p, F32x4 a) { _mm_store_ss(p, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 3, 3, 3))); }
+                // Shifting in zeros keeps only lane 0 of `low`, which loadLow leaves as the only non-zero one.
+                static F32x4 shiftUp(F32x4 a, F32x4 low) {
+                    return makeF(_mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(a.v), 4)), low.v));
+                }
+                static F32x4 shiftUpHigh(F32x4 a, F32x4 high) {
+                    return shiftUp(a, makeF(_mm_shuffle_ps(high.v, high.v, _MM_SHUFFLE(3, 3, 3, 3))));
+                }
+            };
+#else
+            template <typename F> inline I16x8 map(I16x8 a, I16x8 b, F f) {
+                I16x8 r;
+                for (int i = 0; i < 8; i++) {
+                    r.v[i] = static_cast<int16_t>(f(a.v[i], b.v[i]));
+                }
+                return r;
+            }
+            inline I16x8 loadU8(const uint8_t* p) {
+                I16x8 r;
+                for (int i = 0; i < 8; i++) {
+                    r.v[i] = p[i];
+                }
+                return r;
+            }
+            inline void storeU8(uint8_t* p, I16x8 a) {
+                for (int i = 0; i < 8; i++) {
+                    p[i] = static_cast<uint8_t>(a.v[i] < 0 ? 0 : (a.v[i] > 255 ? 255 : a.v[i]));
+                }
+            }
+            inline I16x8 splat(int16_t x) {
+                I16x8 r;
+                for (int i = 0; i < 8; i++) {
+                    r.v[i] = x;
+                }
+                return r;
+            }
+            inline I16x8 add(I16x8 a, I16x8 b) { return map(a, b, [](int x, int y) { return x + y; }); }
+            inline I16x8 sub(I16x8 a, I16x8 b) { return map(a, b, [](int x, int y) { return x - y; }); }
+            inline I16x8 mullo(I16x8 a, I16x8 b) { return map(a, b, [](int x, int y) { return x * y; }); }
+            inline I16x8 min(I16x8 a, I16x8 b) { return map(a, b, [](int x, int y) { return x < y ? x : y; }); }
+            inline I16x8 max(I16x8 a, I16x8 b) { return map(a, b, [](int x, int y) { return x > y ? x : y; }); }
+            inline I16x8 abs(I16x8 a) { return map(a, a, [](int x, int) { return x < 0 ? -x : x; }); }
+            template <int N> inline I16x8 sra(I16x8 a) { return map(a, a, [](int x, int) { return x >> N; }); }
+            template <int N> inline I16x8 shl(I16x8 a) { return map(a, a, [](int x, int) { return static_cast<int>(static_cast<unsigned>(x) << N); }); }
+            inline I16x8 mulhiU(I16x8 a, I16x8 b) {
+                return map(a, b, [](int x, int y) {
+                    return static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(x)) * static_cast<uint16_t>(y)) >> 16);
+                });
+            }
+            inline int sumLanes(I16x8 a) {
+                int sum = 0;
+                for (int i = 0; i < 8; i++) {
+                    sum += a.v[i];
+                }
+                return sum;
+            }
+
+            template <typename F> inline F32x4 mapF(F32x4 a, F32x4 b, F f) {
+                F32x4 r;
+                for (int i = 0; i < 4; i++) {
+                    r.v[i] = f(a.v[i], b.v[i]);
+                }
+                return r;
+            }
+            inline F32x4 loadF(const float* p) {
+                F32x4 r;
+                for (int i = 0; i < 4; i++) {
+                    r.v[i] = p[i];
+                }
+                return r;
+            }
+            inline void storeF(float* p, F32x4 a) {
+                for (int i = 0; i < 4; i++) {
+                    p[i] = a.v[i];
+                }
+            }
+            inline F32x4 splatF(float x) {
+                F32x4 r;
+                for (int i = 0; i < 4; i++) {
+                    r.v[i] = x;
+                }
+                return r;
+            }
+            inline F32x4 add(F32x4 a, F32x4 b) { return mapF(a, b, [](float x, float y) { return x + y; }); }
+            inline F32x4 sub(F32x4 a, F32x4 b) { return mapF(a, b, [](float x, float y) { return x - y; }); }
+            inline F32x4 mul(F32x4 a, F32x4 b) { return mapF(a, b, [](float x, float y) { return x * y; }); }
+            inline F32x4 madd(F32x4 a, F32x4 b, F32x4 c) { return add(a, mul(b, c)); }
+            inline F32x4 min(F32x4 a, F32x4 b) { return mapF(a, b, [](float x, float y) { return x < y ? x : y; }); }
+            inline F32x4 max(F32x4 a, F32x4 b) { return mapF(a, b, [](float x, float y) { return x > y ? x : y; }); }
+            // Mask lanes are 1 or 0 here rather than bit patterns.
+            inline F32x4 laneMaskF(int begin, int end) {
+                F32x4 r;
+                for (int i = 0; i < 4; i++) {
+                    r.v[i] = begin <= i && end > i ? 1.0f : 0.0f;
+                }
+                return r;
+            }
+            inline F32x4 select(F32x4 mask, F32x4 a, F32x4 b) {
+                F32x4 r;
+                for (int i = 0; i < 4; i++) {
+                    r.v[i] = mask.v[i] != 0 ? a.v[i] : b.v[i];
+                }
+                return r;
+            }
+            inline F32x4 div(F32x4 a, F32x4 b) { return mapF(a, b, [](float x, float y) { return x / y; }); }
+            inline F32x4 sqrt(F32x4 a) { return mapF(a, a, [](float x, float) { return std::sqrt(x); }); }
+            inline F32x4 abs(F32x4 a) { return mapF(a, a, [](float x, float) { return std::fabs(x); }); }
+            inline F32x4 less(F32x4 a, F32x4 b) { return mapF(a, b, [](float x, float y) { return x < y ? 1.0f : 0.0f; }); }
+            inline F32x4 roundF(F32x4 a) { return mapF(a, a, [](float x, float) { return std::nearbyint(x); }); }
+
+            template <int N> struct FloatLanes {
+                static F32x4 loadLow(const float* p) {
+                    F32x4 r = splatF(0);
+                    for (int i = 0; i < N; i++) {
+                        r.v[i] = p[i];
+                    }
+                    return r;
+                }
+                static void storeHigh(float* p, F32x4 a) {
+                    for (int i = 0; i < N; i++) {
+                        p[i] = a.v[4 - N + i];
+                    }
+                }
+                static F32x4 shiftUp(F32x4 a, F32x4 low) {
+                    F32x4 r;
+                    for (int i = 0; i < 4; i++) {
+                        r.v[i] = i < N ? low.v[i] : a.v[i - N];
+                    }
+                    return r;
+                }
+                static F32x4 shiftUpHigh(F32x4 a, F32x4 high) {
+                    F32x4 r;
+                    for (int i = 0; i < 4; i++) {
+                        r.v[i] = i < N ? high.v[4 - N + i] : a.v[i - N];
+                    }
+                    return r;
+                }
+            };
+#endif
+        }
+    }
+}
+
+#endif //AGORA_SIMDUTILS_H
@@ -0,0 +1,43 @@
+//
+//  Snapshot.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_SNAPSHOT_H
+#define AGORA_SNAPSHOT_H
+
+#include <atomic>
+
+namespace agora {
+    namespace extension {
+        // Hands the latest value from one writer thread to one reader thread without locks: a triple
+        // buffer, so the writer never waits for the reader and the reader always gets a complete value.
+        template <typename T>
+        class Snapshot {
+        public:
+            // Writer: fill in all of back(), which may hold any earlier value, then publish() it.
+            T& back() { return slots_[back_]; }
+            void publish() { back_ = ready_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex; }
+
+            // Reader: the last value published, or T() before the first.
+            T read() {
+                if (ready_.load(std::memory_order_relaxed) & kFresh) {
+                    front_ = ready_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+                }
+                return slots_[front_];
+            }
+
+        private:
+            static const int kIndex = 3;
+            static const int kFresh = 4;
+
+            T slots_[3];
+            int back_ = 0;
+            std::atomic<int> ready_ = {1};
+            int front_ = 2;
+        };
+    }
+}
+
+
+#endif //AGORA_SNAPSHOT_H
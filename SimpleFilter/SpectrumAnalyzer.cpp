@@ -0,0 +1,230 @@
+//
+//  SpectrumAnalyzer.cpp
+//  SimpleFilter
+//
+
+#include "SpectrumAnalyzer.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace agora {
+    namespace extension {
+        static const float kLowestBandHz = 20.0f;
+        static const float kFloorDb = -120.0f;
+
+        static void appendDb(std::string& text, const char* key, const float* power, int count) {
+            char number[16];
+            text += ",\"";
+            text += key;
+            text += "\":[";
+            for (int i = 0; i < count; i++) {
+                const float db = power[i] > 0 ? std::max(10 * std::log10(power[i]), kFloorDb) : kFloorDb;
+                snprintf(number, sizeof(number), i == 0 ? "%.1f" : ",%.1f", db);
+                text += number;
+            }
+            text += "]";
+        }
+
+        std::string SpectrumReading::toJson(bool withBins) const {
+            char text[96];
+            snprintf(text, sizeof(text), "{\"sequence\":%u,\"size\":%d,\"sample_rate\":%d,\"band_hz\":[",
+                     sequence, size, sampleRateHz);
+            std::string json = text;
+            for (int b = 0; b <= bands && bands > 0; b++) {
+                snprintf(text, sizeof(text), b == 0 ? "%.0f" : ",%.0f", bandHz[b]);
+                json += text;
+            }
+            json += "]";
+            appendDb(json, "bands", bandPower, bands);
+            if (withBins) {
+                appendDb(json, "bins", binPower, size > 0 ? size / 2 + 1 : 0);
+            }
+            json += "}";
+            return json;
+        }
+
+        SpectrumAnalyzer::SpectrumAnalyzer() {
+            ffts_[sizeIndex(sizeSetting_.load())].prepare(sizeSetting_.load());
+        }
+
+        int SpectrumAnalyzer::sizeIndex(int size) {
+            int index = 0;
+            while ((kMinSize << index) < size) {
+                index++;
+            }
+            return index;
+        }
+
+        bool SpectrumAnalyzer::setSize(int size) {
+            if (size < kMinSize || size > kMaxSize || (size & (size - 1)) != 0) {
+                return false;
+            }
+            RealFft& fft = ffts_[sizeIndex(size)];
+            if (fft.size() != size) {
+                fft.prepare(size);
+            }
+            sizeSetting_.store(size, std::memory_order_release);
+            return true;
+        }
+
+        bool SpectrumAnalyzer::setBands(int count) {
+            if (count < 1 || count > SpectrumReading::kMaxBands) {
+                return false;
+            }
+            bandsSetting_ = count;
+            return true;
+        }
+
+        void SpectrumAnalyzer::prepare(int size, int bands, int sampleRateHz) {
+            size_ = size;
+            bands_ = bands;
+            sampleRateHz_ = sampleRateHz;
+            fft_ = &ffts_[sizeIndex(size)];
+            // Periodic Hann. A full-scale sine centred on a bin gives |X| = 32768 * sum(w) / 2 there.
+            // The bands divide by the window's noise bandwidth in bins, which is 1.5 for Hann.
+            double sum = 0;
+            double squares = 0;
+            for (int i = 0; i < size; i++) {
+                window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * M_PI * i / size));
+                sum += window_[i];
+                squares += window_[i] * window_[i];
+            }
+            powerScale_ = static_cast<float>(4.0 / (sum * sum * 32768.0 * 32768.0));
+            bandScale_ = static_cast<float>(sum * sum / (size * squares));
+            std::fill(history_, history_ + kMaxSize, 0.0f);
+            historyPos_ = 0;
+            untilNext_ = size;
+
+            // Log-spaced edges from 20 Hz, or the first bin above DC, to Nyquist.
+            const int bins = size / 2 + 1;
+            const float binHz = static_cast<float>(sampleRateHz) / size;
+            const float lowest = std::max(kLowestBandHz, binHz);
+            const float highest = sampleRateHz / 2.0f;
+            float* edges = bandHz_;
+            for (int b = 0; b <= bands; b++) {
+                edges[b] = lowest * std::pow(highest / lowest, static_cast<float>(b) / bands);
+            }
+            for (int b = 0; b < bands; b++) {
+                // Bins k with edges[b] <= k * binHz < edges[b + 1]; the last band includes Nyquist.
+                int first = static_cast<int>(std::ceil(edges[b] / binHz - 1e-4f));
+                int last = b == bands - 1 ? bins : static_cast<int>(std::ceil(edges[b + 1] / binHz - 1e-4f));
+                if (last <= first) {
+                    first = std::min(static_cast<int>(std::lround(std::sqrt(edges[b] * edges[b + 1]) / binHz)), bins - 1);
+                    last = first + 1;
+                }
+                firstBin_[b] = first;
+                lastBin_[b] = std::min(last, bins);
+            }
+            // Nothing analysed yet, rather than the previous settings' spectrum.
+            SpectrumReading& reading = snapshot_.back();
+            reading = SpectrumReading();
+            reading.sequence = sequence_;
+            reading.size = size;
+            reading.sampleRateHz = sampleRateHz;
+            reading.bands = bands;
+            std::copy(edges, edges + bands + 1, reading.bandHz);
+            std::fill(reading.binPower, reading.binPower + bins, 0.0f);
+            std::fill(reading.bandPower, reading.bandPower + bands, 0.0f);
+            snapshot_.publish();
+        }
+
+        void SpectrumAnalyzer::process(const int16_t* data, size_t frames, int channels, int sampleRateHz) {
+            processSamples(data, frames, channels, sampleRateHz);
+        }
+
+        void SpectrumAnalyzer::process(const float* data, size_t frames, int channels, int sampleRateHz) {
+            processSamples(data, frames, channels, sampleRateHz);
+        }
+
+        template <typename Sample>
+        void SpectrumAnalyzer::processSamples(const Sample* data, size_t frames, int channels, int sampleRateHz) {
+            if (channels <= 0 || sampleRateHz <= 0) {
+                return;
+            }
+            const int size = sizeSetting_.load(std::memory_order_acquire);
+            const int bands = bandsSetting_.load(std::memory_order_relaxed);
+            if (reset_.exchange(false, std::memory_order_relaxed) || size != size_ || bands != bands_ || sampleRateHz != sampleRateHz_) {
+                prepare(size, bands, sampleRateHz);
+            }
+            const int hopSetting = hopSetting_.load(std::memory_order_relaxed);
+            const int hop = hopSetting > 0 ? hopSetting : size_ / 2;
+            const float scale = 1.0f / channels;
+            while (frames > 0) {
+                // Up to the next spectrum or the end of the history, whichever comes first.
+                const size_t count = std::min(std::min(frames, static_cast<size_t>(untilNext_)),
+                                              static_cast<size_t>(kMaxSize - historyPos_));
+                float* out = history_ + historyPos_;
+                if (channels == 1) {
+                    for (size_t f = 0; f < count; f++) {
+                        out[f] = data[f];
+                    }
+                } else {
+                    for (size_t f = 0; f < count; f++) {
+                        float sum = 0;
+                        for (int c = 0; c < channels; c++) {
+                            sum += data[f * channels + c];
+                        }
+                        out[f] = sum * scale;
+                    }
+                }
+                data += count * channels;
+                frames -= count;
+                historyPos_ = (historyPos_ + static_cast<int>(count)) & (kMaxSize - 1);
+                untilNext_ -= static_cast<int>(count);
+                if (untilNext_ == 0) {
+                    analyze();
+                    untilNext_ = hop;
+                }
+            }
+        }
+
+        void SpectrumAnalyzer::analyze() {
+            using namespace simd;
+            const int size = size_;
+            const int bins = size / 2 + 1;
+            // The frame is the last `size` samples, in two pieces when it wraps around the history.
+            const int start = (historyPos_ - size) & (kMaxSize - 1);
+            const int head = std::min(size, kMaxSize - start);
+            int i = 0;
+            for (; i + 4 <= head; i += 4) {
+                storeF(frame_ + i, mul(loadF(history_ + start + i), loadF(window_ + i)));
+            }
+            for (; i < size; i++) {
+                frame_[i] = history_[(start + i) & (kMaxSize - 1)] * window_[i];
+            }
+            fft_->forward(frame_, re_, im_);
+
+            SpectrumReading& reading = snapshot_.back();
+            const F32x4 scale = splatF(powerScale_);
+            int k = 0;
+            for (; k + 4 <= bins; k += 4) {
+                const F32x4 r = loadF(re_ + k);
+                const F32x4 m = loadF(im_ + k);
+                storeF(reading.binPower + k, mul(madd(mul(r, r), m, m), scale));
+            }
+            for (; k < bins; k++) {
+                reading.binPower[k] = (re_[k] * re_[k] + im_[k] * im_[k]) * powerScale_;
+            }
+            // DC and Nyquist have no mirror image to fold in.
+            reading.binPower[0] *= 0.25f;
+            reading.binPower[bins - 1] *= 0.25f;
+            for (int b = 0; b < bands_; b++) {
+                float sum = 0;
+                for (int j = firstBin_[b]; j < lastBin_[b]; j++) {
+                    sum += reading.binPower[j];
+                }
+                reading.bandPower[b] = sum * bandScale_;
+            }
+            // The back slot may hold a spectrum from other settings, so all of it is written.
+            std::copy(bandHz_, bandHz_ + bands_ + 1, reading.bandHz);
+            reading.sequence = ++sequence_;
+            reading.size = size;
+            reading.sampleRateHz = sampleRateHz_;
+            reading.bands = bands_;
+            snapshot_.publish();
+        }
+    }
+}
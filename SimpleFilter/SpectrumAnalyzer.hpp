@@ -0,0 +1,112 @@
+//
+//  SpectrumAnalyzer.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_SPECTRUMANALYZER_H
+#define AGORA_SPECTRUMANALYZER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Fft.hpp"
+#include "Snapshot.hpp"
+
+namespace agora {
+    namespace extension {
+        struct SpectrumReading {
+            static const int kMaxBins = 2049;
+            static const int kMaxBands = 64;
+
+            // Counts the spectra since the analyzer started; 0 before the first.
+            uint32_t sequence = 0;
+            int size = 0;
+            int sampleRateHz = 0;
+            int bands = 0;
+            // Power per bin and per band, 1 for a full-scale sine: a bin reads the amplitude of a tone on
+            // its centre, a band the power of the bins whose centre lies between its edges, bandHz[b] and
+            // bandHz[b + 1], so a tone or noise within it reads its level.
+            float binPower[kMaxBins];
+            float bandPower[kMaxBands];
+            float bandHz[kMaxBands + 1];
+
+            // {"sequence":..,"size":..,"sample_rate":..,"band_hz":[..],"bands":[..]} in dBFS, with "bins"
+            // appended when `withBins`.
+            std::string toJson(bool withBins) const;
+        };
+
+        // Windowed spectra of the mono mix of interleaved audio, 16-bit or float on the same scale: Hann
+        // frames of "size" samples (256 to 4096) every "hop" samples, with the bins also summed into
+        // log-spaced bands from 20 Hz (or the first bin) to Nyquist for visualizers. Settings change from
+        // any thread and apply at the next frame; only setSize allocates, on the caller's thread, the first
+        // time a size is used. process runs on one audio thread; read may be called from another.
+        class SpectrumAnalyzer {
+        public:
+            static const int kMinSize = 256;
+            static const int kMaxSize = 4096;
+
+            SpectrumAnalyzer();
+
+            // Returns false unless `size` is a power of two in range.
+            bool setSize(int size);
+            // Samples between spectra; 0 is half the size.
+            void setHop(int frames) { hopSetting_ = frames; }
+            // Returns false unless 1 to kMaxBands.
+            bool setBands(int count);
+            // Starts over with the next frame, waiting for a full frame of new samples.
+            void reset() { reset_ = true; }
+
+            void process(const int16_t* data, size_t frames, int channels, int sampleRateHz);
+            void process(const float* data, size_t frames, int channels, int sampleRateHz);
+
+            // Latest spectrum; lock-free, for one reader thread at a time.
+            SpectrumReading read() const { return snapshot_.read(); }
+
+        private:
+            static const int kSizes = 5;
+
+            static int sizeIndex(int size);
+
+            template <typename Sample>
+            void processSamples(const Sample* data, size_t frames, int channels, int sampleRateHz);
+            void prepare(int size, int bands, int sampleRateHz);
+            void analyze();
+
+            RealFft ffts_[kSizes];
+            // Every size has its own tables, prepared before the size is first published.
+            std::atomic<int> sizeSetting_ = {1024};
+            std::atomic<int> hopSetting_ = {0};
+            std::atomic<int> bandsSetting_ = {32};
+            std::atomic<bool> reset_ = {false};
+            mutable Snapshot<SpectrumReading> snapshot_;
+
+            // Audio thread only.
+            RealFft* fft_ = nullptr;
+            int size_ = 0;
+            int bands_ = 0;
+            int sampleRateHz_ = 0;
+            // Samples still to come before the next spectrum.
+            int untilNext_ = 0;
+            uint32_t sequence_ = 0;
+            float powerScale_ = 0;
+            float bandScale_ = 0;
+            // The last kMaxSize samples of the mix, written at historyPos_.
+            float history_[kMaxSize];
+            int historyPos_ = 0;
+            float window_[kMaxSize];
+            float frame_[kMaxSize];
+            // Bins rounded up to whole vectors.
+            float re_[kMaxSize / 2 + 4];
+            float im_[kMaxSize / 2 + 4];
+            // Band b sums bins firstBin_[b] up to lastBin_[b]; a band narrower than a bin takes the bin
+            // around its centre.
+            int firstBin_[SpectrumReading::kMaxBands];
+            int lastBin_[SpectrumReading::kMaxBands];
+            float bandHz_[SpectrumReading::kMaxBands + 1];
+        };
+    }
+}
+
+
+#endif //AGORA_SPECTRUMANALYZER_H
@@ -0,0 +1,151 @@
+//
+//  TemporalDenoise.cpp
+//  SimpleFilter
+//
+
+#include "TemporalDenoise.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace agora {
+    namespace extension {
+        // Luma block size of the motion decision; chroma uses half of it.
+        static const int kBlock = 16;
+
+        void TemporalDenoiser::setStrength(int strength) {
+            strength_ = std::max(0, std::min(100, strength));
+        }
+
+        void TemporalDenoiser::reset() {
+            hasHistory_ = false;
+        }
+
+        void TemporalDenoiser::process(const I420View& frame, ParallelRows& rows) {
+            const int strength = strength_;
+            if (strength <= 0) {
+                hasHistory_ = false;
+                return;
+            }
+            const PlaneView* planes[3] = {&frame.y, &frame.u, &frame.v};
+            if (hasHistory_ && (history_[0].view().width != frame.y.width
+                                || history_[0].view().height != frame.y.height)) {
+                hasHistory_ = false;
+            }
+            if (!hasHistory_) {
+                for (int i = 0; i < 3; i++) {
+                    history_[i] = PlanePool::Plane();
+                    history_[i] = planePool_.acquire(planes[i]->width, planes[i]->height);
+                    for (int y = 0; y < planes[i]->height; y++) {
+                        memcpy(history_[i].view().row(y), planes[i]->row(y), planes[i]->width);
+                    }
+                }
+                hasHistory_ = true;
+                return;
+            }
+
+            // The recursion converges to a noise variance of (1 - w) / (1 + w) of the input, so 112 / 128
+            // cuts the noise amplitude by about four while keeping some fresh input in every frame.
+            maxWeight_ = 40 + strength * 72 / 100;
+            // Mean absolute difference below which a block counts as static; covers the camera noise.
+            threshold_ = 3 + strength * 9 / 100;
+            blocksX_ = (frame.y.width + kBlock - 1) / kBlock;
+            const int blocksY = (frame.y.height + kBlock - 1) / kBlock;
+            weights_.resize(static_cast<size_t>(blocksX_) * blocksY);
+
+            rows.run(blocksY, 1, [&](int begin, int end) {
+                for (int b = begin; b < end; b++) {
+                    blockWeights(frame, b);
+                    blendRows(frame.y, history_[0].view(), kBlock, b);
+                    blendRows(frame.u, history_[1].view(), kBlock / 2, b);
+                    blendRows(frame.v, history_[2].view(), kBlock / 2, b);
+                }
+            });
+        }
+
+        void TemporalDenoiser::blockWeights(const I420View& frame, int blockRow) {
+            using namespace simd;
+            const PlaneView& current = frame.y;
+            const PlaneView& history = history_[0].view();
+            const int y0 = blockRow * kBlock;
+            const int y1 = std::min(y0 + kBlock, current.height);
+            const int t = threshold_;
+            for (int bx = 0; bx < blocksX_; bx++) {
+                const int x0 = bx * kBlock;
+                const int x1 = std::min(x0 + kBlock, current.width);
+                int sad = 0;
+                if (x1 - x0 == kBlock) {
+                    // 32 rows at most per lane, so the 16-bit sums cannot overflow.
+                    I16x8 acc = splat(0);
+                    for (int y = y0; y < y1; y++) {
+                        const uint8_t* c = current.row(y) + x0;
+                        const uint8_t* h = history.row(y) + x0;
+                        acc = add(acc, abs(sub(loadU8(c), loadU8(h))));
+                        acc = add(acc, abs(sub(loadU8(c + 8), loadU8(h + 8))));
+                    }
+                    sad = sumLanes(acc);
+                } else {
+                    for (int y = y0; y < y1; y++) {
+                        const uint8_t* c = current.row(y);
+                        const uint8_t* h = history.row(y);
+                        for (int x = x0; x < x1; x++) {
+                            sad += std::abs(c[x] - h[x]);
+                        }
+                    }
+                }
+                // Full weight up to a mean difference of t, fading out linearly until 2t.
+                const int count = (x1 - x0) * (y1 - y0);
+                int weight = (2 * t * count - sad) * maxWeight_ / (t * count);
+                weights_[static_cast<size_t>(blockRow) * blocksX_ + bx] =
+                    static_cast<uint8_t>(std::max(0, std::min(maxWeight_, weight)));
+            }
+        }
+
+        void TemporalDenoiser::blendRows(const PlaneView& frame, const PlaneView& history, int blockSize, int blockRow) {
+            using namespace simd;
+            const int t = threshold_;
+            // Per-pixel factor: 128 while |d| <= t, down to 0 at |d| = 2t.
+            const I16x8 twiceT = splat(static_cast<int16_t>(2 * t));
+            const I16x8 reciprocal = splat(static_cast<int16_t>((65536 + t - 1) / t));
+            const I16x8 zero = splat(0);
+            const I16x8 full = splat(128);
+            const I16x8 half = splat(64);
+            const uint8_t* weights = &weights_[static_cast<size_t>(blockRow) * blocksX_];
+            const int y0 = blockRow * blockSize;
+            const int y1 = std::min(y0 + blockSize, frame.height);
+            for (int y = y0; y < y1; y++) {
+                uint8_t* c = frame.row(y);
+                uint8_t* h = history.row(y);
+                for (int bx = 0; bx < blocksX_; bx++) {
+                    const int x0 = bx * blockSize;
+                    const int x1 = std::min(x0 + blockSize, frame.width);
+                    const int w = weights[bx];
+                    int x = x0;
+                    if (w == 0) {
+                        // Moving block: the output is the input, which also becomes the new history.
+                        memcpy(h + x0, c + x0, std::max(0, x1 - x0));
+                        continue;
+                    }
+                    const I16x8 blockWeight = splat(static_cast<int16_t>(w));
+                    for (; x + 8 <= x1; x += 8) {
+                        I16x8 cur = loadU8(c + x);
+                        I16x8 d = sub(loadU8(h + x), cur);
+                        I16x8 ramp = min(mulhiU(shl<7>(max(sub(twiceT, abs(d)), zero)), reciprocal), full);
+                        I16x8 weight = sra<7>(mullo(ramp, blockWeight));
+                        I16x8 out = add(cur, sra<7>(add(mullo(d, weight), half)));
+                        storeU8(c + x, out);
+                        storeU8(h + x, out);
+                    }
+                    for (; x < x1; x++) {
+                        int d = h[x] - c[x];
+                        int ramp = std::min(128, std::max(0, 2 * t - std::abs(d)) * 128 * ((65536 + t - 1) / t) >> 16);
+                        int weight = ramp * w >> 7;
+                        c[x] = h[x] = static_cast<uint8_t>(c[x] + ((d * weight + 64) >> 7));
+                    }
+                }
+            }
+        }
+    }
+}
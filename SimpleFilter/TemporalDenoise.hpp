@@ -0,0 +1,53 @@
+//
+//  TemporalDenoise.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_TEMPORALDENOISE_H
+#define AGORA_TEMPORALDENOISE_H
+
+#include <atomic>
+#include <vector>
+#include "ImageFilters.hpp"
+#include "ImageScaler.hpp"
+#include "ParallelRows.hpp"
+
+namespace agora {
+    namespace extension {
+        // Motion-adaptive recursive temporal filter for I420 frames. Every 16x16 block is compared with
+        // the previous output; static blocks are blended towards it, moving ones are passed through.
+        // A per-pixel ramp on top of the block decision keeps small moving details from ghosting.
+        // Since the previous output already carries the filtered history, one pooled frame is enough.
+        class TemporalDenoiser {
+        public:
+            // 0 disables the filter, 100 is the strongest setting.
+            void setStrength(int strength);
+            int strength() const { return strength_; }
+
+            // Denoises `frame` in place. Video thread only.
+            void process(const I420View& frame, ParallelRows& rows);
+
+            // Forgets the history, e.g. after frames were skipped. Video thread only.
+            void reset();
+
+        private:
+            void blockWeights(const I420View& frame, int blockRow);
+            void blendRows(const PlaneView& frame, const PlaneView& history, int blockSize, int blockRow);
+
+            std::atomic<int> strength_ = {0};
+
+            // Video thread only.
+            PlanePool planePool_;
+            PlanePool::Plane history_[3];
+            bool hasHistory_ = false;
+            // Blend weight of every block for the current frame, 0 - 128.
+            std::vector<uint8_t> weights_;
+            int blocksX_ = 0;
+            int maxWeight_ = 0;
+            int threshold_ = 0;
+        };
+    }
+}
+
+
+#endif //AGORA_TEMPORALDENOISE_H
@@ -0,0 +1,322 @@
+//
+//  VideoFrameSink.cpp
+//  SimpleFilter
+//
+
+#include "VideoFrameSink.hpp"
+#include "ImageScaler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <AgoraRtcKit/AgoraRefCountedObject.h>
+
+namespace agora {
+    namespace extension {
+        static size_t i420Size(int width, int height) {
+            return static_cast<size_t>(width) * height
+                + 2 * static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+        }
+
+        static void wrapPacked(uint8_t* data, int width, int height, I420View& view) {
+            agora::rtc::VideoFrameData frame;
+            frame.type = agora::rtc::VideoFrameData::Type::kRawPixels;
+            frame.pixels.format = agora::rtc::RawPixelBuffer::Format::kI420;
+            frame.pixels.data = data;
+            frame.pixels.size = 0;
+            frame.width = width;
+            frame.height = height;
+            wrapI420(frame, view);
+        }
+
+        static void copyPlane(const uint8_t* src, int srcStride, const PlaneView& dst) {
+            for (int y = 0; y < dst.height; y++) {
+                memcpy(dst.row(y), src + static_cast<size_t>(y) * srcStride, dst.width);
+            }
+        }
+
+        static uint8_t clampByte(int v) {
+            return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+
+        // Byte buffers shared by the frames of one sink and their variants. Frames are released on consumer
+        // threads, so unlike PlanePool this one is locked.
+        class SinkBufferPool {
+        public:
+            std::unique_ptr<std::vector<uint8_t>> acquire(size_t size) {
+                std::unique_ptr<std::vector<uint8_t>> buffer;
+                {
+                    const std::lock_guard<std::mutex> lock(mutex_);
+                    auto it = std::find_if(free_.begin(), free_.end(),
+                                           [size](const std::unique_ptr<std::vector<uint8_t>>& b) { return b->size() >= size; });
+                    if (it != free_.end()) {
+                        buffer = std::move(*it);
+                        free_.erase(it);
+                    } else if (!free_.empty()) {
+                        buffer = std::move(free_.back());
+                        free_.pop_back();
+                    }
+                }
+                if (!buffer) {
+                    buffer.reset(new std::vector<uint8_t>());
+                }
+                if (buffer->size() < size) {
+                    buffer->resize(size);
+                }
+                return buffer;
+            }
+
+            void release(std::unique_ptr<std::vector<uint8_t>> buffer) {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                // Bounded so that a burst of queued frames does not pin its memory forever.
+                if (buffer && free_.size() < kMaxFree) {
+                    free_.push_back(std::move(buffer));
+                }
+            }
+
+        private:
+            static const size_t kMaxFree = 32;
+            std::mutex mutex_;
+            std::vector<std::unique_ptr<std::vector<uint8_t>>> free_;
+        };
+
+        SinkFrame::SinkFrame(std::shared_ptr<SinkBufferPool> pool, int width, int height) : pool_(std::move(pool)) {
+            buffer_ = pool_->acquire(i420Size(width, height));
+            wrapPacked(buffer_->data(), width, height, view_);
+        }
+
+        SinkFrame::~SinkFrame() {
+            for (auto& variant : variants_) {
+                pool_->release(std::move(variant->buffer));
+            }
+            pool_->release(std::move(buffer_));
+        }
+
+        const uint8_t* SinkFrame::variant(Format format, int width, int height, size_t* size) {
+            if (width <= 0 || height <= 0) {
+                return nullptr;
+            }
+            if (format == kI420 && width == view_.y.width && height == view_.y.height) {
+                if (size) {
+                    *size = i420Size(width, height);
+                }
+                return view_.y.data;
+            }
+            const std::lock_guard<std::mutex> lock(mutex_);
+            const Variant* result = findOrCreate(format, width, height);
+            if (size) {
+                *size = result->size;
+            }
+            return result->buffer->data();
+        }
+
+        const SinkFrame::Variant* SinkFrame::findOrCreate(Format format, int width, int height) {
+            for (const auto& variant : variants_) {
+                if (variant->format == format && variant->width == width && variant->height == height) {
+                    return variant.get();
+                }
+            }
+
+            // Every format is derived from I420 at the requested size.
+            I420View source;
+            if (width == view_.y.width && height == view_.y.height) {
+                source = view_;
+            } else if (format != kI420) {
+                const Variant* scaled = findOrCreate(kI420, width, height);
+                wrapPacked(scaled->buffer->data(), width, height, source);
+            }
+
+            std::unique_ptr<Variant> variant(new Variant());
+            variant->format = format;
+            variant->width = width;
+            variant->height = height;
+            variant->size = format == kRGBA ? static_cast<size_t>(width) * height * 4 : i420Size(width, height);
+            variant->buffer = pool_->acquire(variant->size);
+            uint8_t* data = variant->buffer->data();
+
+            if (format == kI420) {
+                I420View target;
+                wrapPacked(data, width, height, target);
+                // Halving steps are exact area averages; sizes they cannot reach fall back to bilinear.
+                const I420View* from = &view_;
+                I420View half;
+                if (width == view_.y.width / 4 && height == view_.y.height / 4) {
+                    const Variant* halved = findOrCreate(kI420, view_.y.width / 2, view_.y.height / 2);
+                    wrapPacked(halved->buffer->data(), halved->width, halved->height, half);
+                    from = &half;
+                }
+                const PlaneView* src[3] = {&from->y, &from->u, &from->v};
+                const PlaneView* dst[3] = {&target.y, &target.u, &target.v};
+                for (int i = 0; i < 3; i++) {
+                    if (dst[i]->width == src[i]->width / 2 && dst[i]->height == src[i]->height / 2) {
+                        downscale2x(*src[i], *dst[i]);
+                    } else {
+                        resizeBilinear(*src[i], *dst[i]);
+                    }
+                }
+            } else if (format == kNV12) {
+                PlaneView luma;
+                luma.data = data;
+                luma.width = width;
+                luma.height = height;
+                luma.stride = width;
+                copyPlane(source.y.data, source.y.stride, luma);
+                uint8_t* uv = data + static_cast<size_t>(width) * height;
+                for (int y = 0; y < source.u.height; y++) {
+                    const uint8_t* u = source.u.row(y);
+                    const uint8_t* v = source.v.row(y);
+                    uint8_t* d = uv + static_cast<size_t>(y) * source.u.width * 2;
+                    for (int x = 0; x < source.u.width; x++) {
+                        d[2 * x] = u[x];
+                        d[2 * x + 1] = v[x];
+                    }
+                }
+            } else {
+                // BT.601 limited range to full-range RGB.
+                for (int y = 0; y < height; y++) {
+                    const uint8_t* ly = source.y.row(y);
+                    const uint8_t* lu = source.u.row(y / 2);
+                    const uint8_t* lv = source.v.row(y / 2);
+                    uint8_t* d = data + static_cast<size_t>(y) * width * 4;
+                    for (int x = 0; x < width; x++) {
+                        int c = 298 * (ly[x] - 16) + 128;
+                        int du = lu[x / 2] - 128;
+                        int dv = lv[x / 2] - 128;
+                        d[4 * x] = clampByte((c + 409 * dv) >> 8);
+                        d[4 * x + 1] = clampByte((c - 100 * du - 208 * dv) >> 8);
+                        d[4 * x + 2] = clampByte((c + 516 * du) >> 8);
+                        d[4 * x + 3] = 255;
+                    }
+                }
+            }
+            variants_.push_back(std::move(variant));
+            return variants_.back().get();
+        }
+
+        FrameQueue::FrameQueue(int capacity) {
+            size_t size = 2;
+            while (size < static_cast<size_t>(std::max(capacity, 1))) {
+                size <<= 1;
+            }
+            slots_.assign(size, nullptr);
+            mask_ = size - 1;
+        }
+
+        FrameQueue::~FrameQueue() {
+            agora_refptr<SinkFrame> frame;
+            while (pop(frame)) {
+            }
+        }
+
+        bool FrameQueue::push(SinkFrame* frame) {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) > mask_) {
+                dropped_++;
+                return false;
+            }
+            frame->AddRef();
+            slots_[tail & mask_] = frame;
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool FrameQueue::pop(agora_refptr<SinkFrame>& frame) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            SinkFrame* slot = slots_[head & mask_];
+            head_.store(head + 1, std::memory_order_release);
+            // Hand the queue's reference over to the caller.
+            frame = slot;
+            slot->Release();
+            return true;
+        }
+
+        VideoFrameSink::VideoFrameSink() : pool_(std::make_shared<SinkBufferPool>()),
+                                           queues_(std::make_shared<const QueueList>()) {
+        }
+
+        int VideoFrameSink::onFrame(const agora::media::base::VideoFrame& videoFrame) {
+            std::shared_ptr<const QueueList> queues = std::atomic_load(&queues_);
+            if (queues->empty()) {
+                return 0;
+            }
+            if ((videoFrame.type != agora::media::base::VIDEO_PIXEL_I420
+                 && videoFrame.type != agora::media::base::VIDEO_PIXEL_NV12)
+                || !videoFrame.yBuffer || !videoFrame.uBuffer || videoFrame.width <= 0 || videoFrame.height <= 0) {
+                unsupported_++;
+                return 0;
+            }
+
+            agora_refptr<SinkFrame> frame = new agora::RefCountedObject<SinkFrame>(pool_, videoFrame.width, videoFrame.height);
+            frame->rotation_ = videoFrame.rotation;
+            frame->renderTimeMs_ = videoFrame.renderTimeMs;
+            const I420View& view = frame->view_;
+            copyPlane(videoFrame.yBuffer, videoFrame.yStride, view.y);
+            if (videoFrame.type == agora::media::base::VIDEO_PIXEL_I420) {
+                copyPlane(videoFrame.uBuffer, videoFrame.uStride, view.u);
+                copyPlane(videoFrame.vBuffer, videoFrame.vStride, view.v);
+            } else {
+                for (int y = 0; y < view.u.height; y++) {
+                    const uint8_t* uv = videoFrame.uBuffer + static_cast<size_t>(y) * videoFrame.uStride;
+                    uint8_t* u = view.u.row(y);
+                    uint8_t* v = view.v.row(y);
+                    for (int x = 0; x < view.u.width; x++) {
+                        u[x] = uv[2 * x];
+                        v[x] = uv[2 * x + 1];
+                    }
+                }
+            }
+            for (const auto& queue : *queues) {
+                queue->push(frame.get());
+            }
+            return 0;
+        }
+
+        std::shared_ptr<FrameQueue> VideoFrameSink::subscribe(int capacity) {
+            auto queue = std::make_shared<FrameQueue>(capacity);
+            const std::lock_guard<std::mutex> lock(mutex_);
+            auto queues = std::make_shared<QueueList>(*queues_);
+            queues->push_back(queue);
+            std::atomic_store(&queues_, std::shared_ptr<const QueueList>(queues));
+            return queue;
+        }
+
+        void VideoFrameSink::unsubscribe(const std::shared_ptr<FrameQueue>& queue) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            auto queues = std::make_shared<QueueList>(*queues_);
+            queues->erase(std::remove(queues->begin(), queues->end(), queue), queues->end());
+            std::atomic_store(&queues_, std::shared_ptr<const QueueList>(queues));
+        }
+
+        static std::mutex& registryMutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+
+        static std::map<std::string, agora_refptr<VideoFrameSink>>& registry() {
+            static std::map<std::string, agora_refptr<VideoFrameSink>> sinks;
+            return sinks;
+        }
+
+        void VideoFrameSink::registerSink(const std::string& name, agora_refptr<VideoFrameSink> sink) {
+            const std::lock_guard<std::mutex> lock(registryMutex());
+            registry()[name] = sink;
+        }
+
+        agora_refptr<VideoFrameSink> VideoFrameSink::find(const std::string& name) {
+            const std::lock_guard<std::mutex> lock(registryMutex());
+            auto it = registry().find(name);
+            if (it == registry().end()) {
+                return nullptr;
+            }
+            return it->second;
+        }
+
+        void VideoFrameSink::clearRegistry() {
+            const std::lock_guard<std::mutex> lock(registryMutex());
+            registry().clear();
+        }
+    }
+}
@@ -0,0 +1,128 @@
+//
+//  VideoFrameSink.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_VIDEOFRAMESINK_H
+#define AGORA_VIDEOFRAMESINK_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "AgoraRtcKit/NGIAgoraMediaNode.h"
+#include "ImageFilters.hpp"
+
+namespace agora {
+    namespace extension {
+        class SinkBufferPool;
+
+        // A frame received by VideoFrameSink. The pixels are copied once out of the SDK buffer, which is only
+        // valid during onFrame, into a pooled buffer; consumers then share the frame by reference.
+        class SinkFrame : public RefCountInterface {
+        public:
+            enum Format {
+                kI420 = 0,
+                kNV12,
+                kRGBA
+            };
+
+            SinkFrame(std::shared_ptr<SinkBufferPool> pool, int width, int height);
+
+            int width() const { return view_.y.width; }
+            int height() const { return view_.y.height; }
+            int rotation() const { return rotation_; }
+            int64_t renderTimeMs() const { return renderTimeMs_; }
+            // The frame as received, tightly packed I420.
+            const I420View& view() const { return view_; }
+
+            // Returns the frame in `format` at width x height, tightly packed. Every variant is computed on the
+            // first request and cached with the frame, so consumers asking for the same one share the work.
+            // The pointer stays valid as long as the frame. Returns nullptr for an empty size.
+            const uint8_t* variant(Format format, int width, int height, size_t* size = nullptr);
+
+        protected:
+            ~SinkFrame();
+
+        private:
+            friend class VideoFrameSink;
+
+            struct Variant {
+                Format format;
+                int width;
+                int height;
+                size_t size;
+                std::unique_ptr<std::vector<uint8_t>> buffer;
+            };
+
+            const Variant* findOrCreate(Format format, int width, int height);
+
+            std::shared_ptr<SinkBufferPool> pool_;
+            std::unique_ptr<std::vector<uint8_t>> buffer_;
+            I420View view_;
+            int rotation_ = 0;
+            int64_t renderTimeMs_ = 0;
+            std::mutex mutex_;
+            std::vector<std::unique_ptr<Variant>> variants_;
+        };
+
+        // Bounded single-producer single-consumer queue between the sink and one consumer. Never blocks:
+        // when the consumer falls behind, new frames are dropped and counted.
+        class FrameQueue {
+        public:
+            explicit FrameQueue(int capacity);
+            ~FrameQueue();
+
+            // Consumer side. Returns false if no frame is waiting.
+            bool pop(agora_refptr<SinkFrame>& frame);
+            uint64_t dropped() const { return dropped_; }
+
+        private:
+            friend class VideoFrameSink;
+
+            // Producer side. Takes a reference on success.
+            bool push(SinkFrame* frame);
+
+            std::vector<SinkFrame*> slots_;
+            size_t mask_;
+            std::atomic<size_t> head_ = {0};
+            std::atomic<size_t> tail_ = {0};
+            std::atomic<uint64_t> dropped_ = {0};
+        };
+
+        // Video sink extension that taps frames for in-process consumers such as recorders or ML models.
+        // Each consumer subscribes for its own queue; with no subscribers onFrame returns without copying.
+        class VideoFrameSink : public agora::rtc::IVideoSinkBase {
+        public:
+            VideoFrameSink();
+
+            int onFrame(const agora::media::base::VideoFrame& videoFrame) override;
+
+            std::shared_ptr<FrameQueue> subscribe(int capacity);
+            void unsubscribe(const std::shared_ptr<FrameQueue>& queue);
+            // Frames in a format the sink cannot copy, e.g. textures.
+            uint64_t unsupportedFrames() const { return unsupported_; }
+
+            // Sinks created by ExtensionProvider, so consumers can find them by extension name.
+            static void registerSink(const std::string& name, agora_refptr<VideoFrameSink> sink);
+            static agora_refptr<VideoFrameSink> find(const std::string& name);
+            static void clearRegistry();
+
+        protected:
+            ~VideoFrameSink() {}
+
+        private:
+            using QueueList = std::vector<std::shared_ptr<FrameQueue>>;
+
+            std::shared_ptr<SinkBufferPool> pool_;
+            std::mutex mutex_;
+            // Replaced as a whole under mutex_ and read with atomic_load, so onFrame never takes the lock.
+            std::shared_ptr<const QueueList> queues_;
+            std::atomic<uint64_t> unsupported_ = {0};
+        };
+    }
+}
+
+
+#endif //AGORA_VIDEOFRAMESINK_H
@@ -4,11 +4,17 @@
 
 #include "VideoProcessor.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 
 namespace agora {
     namespace extension {
     bool enableGrey = true;
+    // Luma difference at which smoothing fades out completely, so that facial features stay sharp.
+    static const int kSmoothEdgeThreshold = 24;
+
         bool YUVImageProcessor::initOpenGL() {
             const std::lock_guard<std::mutex> lock(mutex_);
             return true;
@@ -20,13 +26,38 @@ namespace agora {
         }
 
         int YUVImageProcessor::processFrame(agora::rtc::VideoFrameData &capturedFrame) {
+            bool governorEnabled = governorEnabled_;
+            governor_.setEnabled(governorEnabled);
+            governor_.setBudgetRatio(governorBudget_ / 100.0);
+            if (!governor_.beginFrame(capturedFrame.timestamp_ms)) {
+                return kFrameDropped;
+            }
+            auto start = std::chrono::steady_clock::now();
             if (wmEffectEnabled_) {
                 process(capturedFrame);
             }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (governor_.endFrame(elapsed.count())) {
+                reportQualityLevel();
+            }
             return 0;
         }
 
         void YUVImageProcessor::process(const agora::rtc::VideoFrameData &capturedFrame) {
+            I420View image;
+            if (wrapI420(capturedFrame, image)) {
+                if (governor_.level() < QualityGovernor::kEssentialOnly) {
+                    denoiser_.process(image, rows_);
+                } else {
+                    denoiser_.reset();
+                }
+                runHeavyStages(capturedFrame, image);
+                chromaKey_.process(image, rows_);
+                virtualBackground_.process(image, rows_);
+                if (fingerprinter_.process(image.y, capturedFrame.timestamp_ms, fingerprintEvent_) && control_) {
+                    control_->postEvent("fingerprint", fingerprintEvent_.c_str());
+                }
+            }
             if(!enableGrey){
                 return;
             }
@@ -36,6 +67,159 @@ namespace agora {
             memset(pic + offset, 128, capturedFrame.height * capturedFrame.width / 2);
         }
 
+        void YUVImageProcessor::runHeavyStages(const agora::rtc::VideoFrameData &capturedFrame, I420View& image) {
+            bool roiMode;
+            int feather;
+            int strength;
+            int scale;
+            std::shared_ptr<RoiProvider> provider;
+            QualityGovernor::Level level = governor_.level();
+            if (level >= QualityGovernor::kEssentialOnly) {
+                return;
+            }
+            {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                if (smoothLevel_ <= 0) {
+                    return;
+                }
+                strength = smoothLevel_ * 256 / 100;
+                roiMode = roiMode_ || level == QualityGovernor::kRoiOnly;
+                scale = processScale_;
+                feather = roiFeather_;
+                provider = roiProvider_;
+                if (roiMode && !provider) {
+                    frameRois_ = rois_;
+                }
+            }
+
+            if (level >= QualityGovernor::kReducedResolution) {
+                scale = std::max(scale, 2);
+            }
+
+            // Scale the window with the frame so the look does not depend on the capture resolution.
+            int radius = std::max(1, image.y.height / 180);
+            if (!roiMode) {
+                smooth(image.y, radius, strength, 0, scale);
+                return;
+            }
+            if (provider) {
+                frameRois_.clear();
+                (*provider)(capturedFrame, frameRois_);
+            }
+            // The feather ramp is laid outside the requested rectangle so the ROI itself gets full strength.
+            for (const PixelRect& rect : resolveRois(frameRois_, image.y.width, image.y.height, feather)) {
+                smooth(image.y.crop(rect), radius, strength, feather, scale);
+            }
+        }
+
+        void YUVImageProcessor::smooth(const PlaneView& plane, int radius, int strength, int feather, int scale) {
+            // Too small to be worth scaling, e.g. a tiny ROI.
+            if (plane.width < 4 * scale || plane.height < 4 * scale) {
+                scale = 1;
+            }
+            if (scale <= 1) {
+                PlanePool::Plane blurred = planePool_.acquire(plane.width, plane.height);
+                boxBlur(plane, blurred.view(), radius, blurScratch_);
+                featherBlend(plane, blurred.view(), feather, strength, kSmoothEdgeThreshold);
+                return;
+            }
+
+            // Blur a 1/2 or 1/4 copy, bring it back to full size and blend it against the full-resolution
+            // original: the edge-aware weights still see every detail that the small copy lost.
+            PlanePool::Plane half = planePool_.acquire(plane.width / 2, plane.height / 2);
+            downscale2x(plane, half.view());
+            PlanePool::Plane quarter;
+            const PlaneView* small = &half.view();
+            if (scale >= 4) {
+                quarter = planePool_.acquire(half.view().width / 2, half.view().height / 2);
+                downscale2x(half.view(), quarter.view());
+                small = &quarter.view();
+            }
+            boxBlur(*small, *small, std::max(1, radius / scale), blurScratch_);
+            if (scale >= 4) {
+                upscale2x(quarter.view(), half.view(), upscaleScratch_);
+            }
+            PlanePool::Plane full = planePool_.acquire(plane.width, plane.height);
+            upscale2x(half.view(), full.view(), upscaleScratch_);
+            featherBlend(plane, full.view(), feather, strength, kSmoothEdgeThreshold);
+        }
+
+        int YUVImageProcessor::setProperty(const std::string& key, const std::string& value) {
+            if (key.compare(0, 10, "chroma_key") == 0) {
+                int ret = chromaKey_.setProperty(key, value);
+                if (ret != -2) {
+                    return ret;
+                }
+            }
+            if (key.compare(0, 11, "fingerprint") == 0) {
+                int ret = fingerprinter_.setProperty(key, value);
+                if (ret != -2) {
+                    return ret;
+                }
+            }
+            if (key.compare(0, 18, "virtual_background") == 0) {
+                int ret = virtualBackground_.setProperty(key, value);
+                if (ret != -2) {
+                    return ret;
+                }
+            }
+            if (key == "smooth") {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                smoothLevel_ = std::max(0, std::min(100, atoi(value.c_str())));
+                return 0;
+            }
+            if (key == "denoise") {
+                denoiser_.setStrength(atoi(value.c_str()));
+                return 0;
+            }
+            if (key == "roi_mode") {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                roiMode_ = (value == "1");
+                return 0;
+            }
+            if (key == "process_scale") {
+                int scale = atoi(value.c_str());
+                if (scale != 1 && scale != 2 && scale != 4) {
+                    return -1;
+                }
+                const std::lock_guard<std::mutex> lock(mutex_);
+                processScale_ = scale;
+                return 0;
+            }
+            if (key == "roi_feather") {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                roiFeather_ = std::max(0, atoi(value.c_str()));
+                return 0;
+            }
+            if (key == "quality_governor") {
+                governorEnabled_ = (value == "1");
+                return 0;
+            }
+            if (key == "quality_budget") {
+                governorBudget_ = std::max(5, std::min(100, atoi(value.c_str())));
+                return 0;
+            }
+            if (key == "roi") {
+                std::vector<RoiRect> rois;
+                if (!parseRoiList(value, rois)) {
+                    return -1;
+                }
+                setRois(rois);
+                return 0;
+            }
+            return setParameters(value);
+        }
+
+        void YUVImageProcessor::setRois(const std::vector<RoiRect>& rois) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            rois_ = rois;
+        }
+
+        void YUVImageProcessor::setRoiProvider(RoiProvider provider) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            roiProvider_ = provider ? std::make_shared<RoiProvider>(std::move(provider)) : nullptr;
+        }
+
         int YUVImageProcessor::setParameters(std::string parameter) {
             const std::lock_guard<std::mutex> lock(mutex_);
             if(parameter == "1"){
@@ -52,6 +236,16 @@ namespace agora {
             return id;
         }
 
+        void YUVImageProcessor::reportQualityLevel() {
+            if (!control_) {
+                return;
+            }
+            char value[128];
+            snprintf(value, sizeof(value), "{\"level\":%d,\"cost_ms\":%.2f,\"budget_ms\":%.2f}",
+                     governor_.level(), governor_.frameCostMs(), governor_.budgetMs());
+            control_->postEvent("quality", value);
+        }
+
         void YUVImageProcessor::dataCallback(const char* data){
             if (control_) {
                 control_->postEvent("key", data);
@@ -9,15 +9,34 @@
 #include <string>
 #include <mutex>
 #include <vector>
+#include <functional>
+#include <memory>
+#include <atomic>
 #include <AgoraRtcKit/AgoraRefPtr.h>
 #include "AgoraRtcKit/NGIAgoraMediaNode.h"
 
 #include "AgoraRtcKit/AgoraMediaBase.h"
+#include "ChromaKey.hpp"
+#include "FrameFingerprint.hpp"
+#include "ImageFilters.hpp"
+#include "ImageScaler.hpp"
+#include "ParallelRows.hpp"
+#include "QualityGovernor.hpp"
+#include "TemporalDenoise.hpp"
+#include "VideoRoi.hpp"
+#include "VirtualBackground.hpp"
 
 namespace agora {
     namespace extension {
         class YUVImageProcessor  : public RefCountInterface {
         public:
+            // Fills `rois` with the regions of interest of `frame` in normalized coordinates,
+            // e.g. from a face detector. Called on the video thread before the heavy stages run.
+            using RoiProvider = std::function<void(const agora::rtc::VideoFrameData& frame, std::vector<RoiRect>& rois)>;
+
+            // Returned by processFrame when the quality governor decided to drop the frame.
+            static const int kFrameDropped = 1;
+
             bool initOpenGL();
 
             bool releaseOpenGL();
@@ -26,6 +45,16 @@ namespace agora {
 
             int setParameters(std::string parameter);
 
+            // Handles a property set through ExtensionVideoFilter::setProperty. Keys without a dedicated
+            // meaning fall back to setParameters for compatibility with the "grey" switch.
+            int setProperty(const std::string& key, const std::string& value);
+
+            // Replaces the ROIs used in ROI mode. They stay in effect until replaced or cleared.
+            void setRois(const std::vector<RoiRect>& rois);
+
+            // When set, the provider is queried for every frame and takes precedence over setRois.
+            void setRoiProvider(RoiProvider provider);
+
             std::thread::id getThreadId();
 
             int setExtensionControl(agora::agora_refptr<rtc::IExtensionVideoFilter::Control> control){
@@ -37,9 +66,40 @@ namespace agora {
             ~YUVImageProcessor() {}
         private:
             void process(const agora::rtc::VideoFrameData &capturedFrame);
+            void runHeavyStages(const agora::rtc::VideoFrameData &capturedFrame, I420View& image);
+            void smooth(const PlaneView& plane, int radius, int strength, int feather, int scale);
             void dataCallback(const char* data);
+            void reportQualityLevel();
             
             std::mutex mutex_;
+            // Heavy stages: run inside the ROIs only when roiMode_ is on, over the whole frame otherwise.
+            int smoothLevel_ = 0;
+            bool roiMode_ = false;
+            int roiFeather_ = 16;
+            // Heavy stages run on a 1/processScale_ copy of the plane that is scaled back afterwards.
+            int processScale_ = 1;
+            std::vector<RoiRect> rois_;
+            std::shared_ptr<RoiProvider> roiProvider_;
+            // Video thread only.
+            std::vector<RoiRect> frameRois_;
+            PlanePool planePool_;
+            BoxBlurScratch blurScratch_;
+            std::vector<uint16_t> upscaleScratch_;
+            QualityGovernor governor_;
+            // Off unless "quality_governor" is "1": when on, heavy stages can be switched off under load and
+            // at the lowest level every other frame is dropped.
+            std::atomic_bool governorEnabled_ = {false};
+            std::atomic<int> governorBudget_ = {50};
+            // Runs before every other stage so they all see the cleaned frame; skipped with the heavy stages.
+            TemporalDenoiser denoiser_;
+            // Compositing is treated as essential, so the governor never skips it: dropping it would
+            // reveal the real background.
+            ChromaKeyCompositor chromaKey_;
+            VirtualBackground virtualBackground_;
+            // Hashes the final luma; cheap enough to run at every governor level.
+            FrameFingerprinter fingerprinter_;
+            std::string fingerprintEvent_;
+            ParallelRows rows_{2};
             agora::agora_refptr<rtc::IExtensionVideoFilter::Control> control_;
             bool wmEffectEnabled_ = true;
             std::string wmStr_= "Agora";
@@ -0,0 +1,237 @@
+//
+//  VideoProcessorTest.cpp
+//  SimpleFilter
+//
+//  Checks and benchmarks for the video stages. Not part of the extension target, build and run it on its own,
+//  with the SDK headers from ../libs and zlib:
+//      c++ -O2 -std=c++14 -F../libs/AgoraRtcKit.xcframework/ios-arm64_x86_64-simulator -F../libs/aosl.xcframework/ios-arm64_x86_64-simulator VideoProcessorTest.cpp VideoProcessor.cpp ImageFilters.cpp ImageScaler.cpp QualityGovernor.cpp ParallelRows.cpp TemporalDenoise.cpp VideoRoi.cpp ChromaKey.cpp BackgroundImage.cpp VirtualBackground.cpp FrameFingerprint.cpp external_thread_pool.cpp -lz -o VideoProcessorTest && ./VideoProcessorTest
+//  Returns non-zero if any check fails. Add -DSF_DISABLE_SIMD for the scalar paths; the denoise checksums match.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include <AgoraRtcKit/AgoraRefCountedObject.h>
+#include "ImageScaler.hpp"
+#include "TemporalDenoise.hpp"
+#include "VideoProcessor.hpp"
+
+using namespace agora::extension;
+
+static int gFailures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        gFailures++;
+    }
+}
+
+static double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static PlaneView viewOf(std::vector<uint8_t>& pixels, int width, int height) {
+    PlaneView view;
+    view.data = pixels.data();
+    view.width = width;
+    view.height = height;
+    view.stride = width;
+    return view;
+}
+
+static agora::rtc::VideoFrameData i420Frame(std::vector<uint8_t>& pixels, int width, int height) {
+    agora::rtc::VideoFrameData frame;
+    frame.type = agora::rtc::VideoFrameData::Type::kRawPixels;
+    frame.pixels.format = agora::rtc::RawPixelBuffer::Format::kI420;
+    frame.pixels.data = pixels.data();
+    frame.pixels.size = pixels.size();
+    frame.width = width;
+    frame.height = height;
+    frame.timestamp_ms = 0;
+    return frame;
+}
+
+// Luma PSNR of two I420 frames.
+static double psnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int width, int height) {
+    double sum = 0;
+    for (int i = 0; i < width * height; i++) {
+        const double d = a[i] - b[i];
+        sum += d * d;
+    }
+    return sum == 0 ? INFINITY : 10 * std::log10(255.0 * 255.0 * width * height / sum);
+}
+
+// What downscale2x and upscale2x compute, one pixel at a time, over sizes that leave every vector tail.
+static void testScalers() {
+    std::mt19937 random(5);
+    for (int round = 0; round < 40; round++) {
+        const int width = 2 + random() % 300;
+        const int height = 2 + random() % 40;
+        std::vector<uint8_t> src(width * height);
+        for (uint8_t& p : src) {
+            p = static_cast<uint8_t>(random());
+        }
+        const int halfWidth = width / 2;
+        const int halfHeight = height / 2;
+        std::vector<uint8_t> half(halfWidth * halfHeight);
+        downscale2x(viewOf(src, width, height), viewOf(half, halfWidth, halfHeight));
+        bool same = true;
+        for (int y = 0; y < halfHeight; y++) {
+            for (int x = 0; x < halfWidth; x++) {
+                const uint8_t* p = src.data() + 2 * y * width + 2 * x;
+                same = same && half[y * halfWidth + x] == ((p[0] + p[1] + p[width] + p[width + 1] + 2) >> 2);
+            }
+        }
+        check(same, "downscale2x is the rounded mean of each 2x2 block");
+
+        // Up to one pixel larger than twice the source, as smooth asks for with odd sizes.
+        const int upWidth = 2 * halfWidth + (width & 1);
+        const int upHeight = 2 * halfHeight + (height & 1);
+        std::vector<uint8_t> up(upWidth * upHeight);
+        std::vector<uint16_t> scratch;
+        upscale2x(viewOf(half, halfWidth, halfHeight), viewOf(up, upWidth, upHeight), scratch);
+        // Each output is 3/4 of the nearest source pixel and 1/4 of the next one on its side, per axis.
+        auto near = [](int i, int size) { return std::min(i >> 1, size - 1); };
+        auto far = [](int i, int size) { return std::max(0, std::min((i & 1) ? (i >> 1) + 1 : (i >> 1) - 1, size - 1)); };
+        for (int y = 0; y < upHeight; y++) {
+            const uint8_t* nearRow = half.data() + near(y, halfHeight) * halfWidth;
+            const uint8_t* farRow = half.data() + far(y, halfHeight) * halfWidth;
+            for (int x = 0; x < upWidth; x++) {
+                const int a = 3 * nearRow[near(x, halfWidth)] + farRow[near(x, halfWidth)];
+                const int b = 3 * nearRow[far(x, halfWidth)] + farRow[far(x, halfWidth)];
+                same = same && up[y * upWidth + x] == ((3 * a + b + 8) >> 4);
+            }
+        }
+        check(same, "upscale2x is the separable 3/4, 1/4 bilinear");
+    }
+}
+
+// 1080p, smooth 80: the cost of a frame and how far the result is from the full-resolution one per
+// process_scale. The blend against the full-resolution original stays, so the gain is well below the blur's.
+static void benchProcessScale() {
+    const int width = 1920, height = 1080;
+    std::vector<uint8_t> input(width * height * 3 / 2, 128);
+    std::mt19937 random(3);
+    std::normal_distribution<float> noise(0, 8);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const float v = 100 + 60 * std::sin(x * 0.01f) * std::cos(y * 0.013f) + ((x / 200 + y / 150) % 2 ? 40 : 0) + noise(random);
+            input[y * width + x] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, v)));
+        }
+    }
+    std::vector<uint8_t> full;
+    for (int scale : {1, 2, 4}) {
+        std::vector<uint8_t> pixels = input;
+        agora::rtc::VideoFrameData frame = i420Frame(pixels, width, height);
+        agora::agora_refptr<YUVImageProcessor> processor = new agora::RefCountedObject<YUVImageProcessor>();
+        processor->setProperty("quality_governor", "0");
+        processor->setProperty("smooth", "80");
+        processor->setProperty("process_scale", std::to_string(scale));
+        processor->processFrame(frame);
+        const std::vector<uint8_t> result = pixels;
+        if (scale == 1) {
+            full = result;
+        }
+        double best = 1e30;
+        for (int round = 0; round < 10; round++) {
+            pixels = input;
+            const auto start = std::chrono::steady_clock::now();
+            processor->processFrame(frame);
+            best = std::min(best, msSince(start));
+        }
+        printf("process_scale %d: %6.2f ms per 1080p frame, luma PSNR against scale 1 %.1f dB\n", scale, best,
+               psnr(full, result, width, height));
+        check(scale == 1 || psnr(full, result, width, height) > 45, "reduced-resolution smoothing stays close to full");
+    }
+}
+
+// Frame `t` of a 720p scene: a static textured background and a block moving 6 pixels per frame.
+static void denoiseScene(std::vector<uint8_t>& frame, int width, int height, int t) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int v = static_cast<int>(110 + 50 * std::sin(x * 0.02f) * std::cos(y * 0.017f)) + ((x / 64 + y / 64) % 2 ? 25 : 0);
+            if (x >= 200 + 6 * t && x < 360 + 6 * t && y >= 260 && y < 420) {
+                v = 200 - (x + y) % 40;
+            }
+            frame[y * width + x] = static_cast<uint8_t>(v);
+        }
+    }
+    for (size_t i = static_cast<size_t>(width) * height; i < frame.size(); i++) {
+        frame[i] = static_cast<uint8_t>(128 + (i / 37) % 7);
+    }
+}
+
+static size_t compressedSize(const std::vector<uint8_t>& data) {
+    uLongf size = compressBound(data.size());
+    std::vector<uint8_t> out(size);
+    compress2(out.data(), &size, data.data(), data.size(), 6);
+    return size;
+}
+
+// 60 frames of the scene with sigma 6 noise, per strength. There is no encoder here, so the bits an
+// inter-frame encoder would spend are approximated by zlib on the quantized residual against the previous
+// output.
+static void benchDenoise() {
+    const int width = 1280, height = 720, frames = 60;
+    double psnrOff = 0, psnrFull = 0;
+    size_t bytesOff = 0, bytesFull = 0;
+    for (int strength : {0, 60, 100}) {
+        TemporalDenoiser denoiser;
+        denoiser.setStrength(strength);
+        ParallelRows rows(1);
+        std::vector<uint8_t> clean(width * height * 3 / 2), pixels(clean.size()), previous(clean.size(), 128), residual(clean.size());
+        agora::rtc::VideoFrameData frame = i420Frame(pixels, width, height);
+        I420View view;
+        wrapI420(frame, view);
+        std::mt19937 random(7);
+        std::normal_distribution<float> noise(0, 6);
+        size_t bytes = 0;
+        double ms = 0, squares = 0;
+        uint32_t checksum = 0;
+        for (int t = 0; t < frames; t++) {
+            denoiseScene(clean, width, height, t);
+            for (size_t i = 0; i < pixels.size(); i++) {
+                const float n = noise(random) * (i < static_cast<size_t>(width) * height ? 1.0f : 0.5f);
+                pixels[i] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, clean[i] + n)));
+            }
+            const auto start = std::chrono::steady_clock::now();
+            denoiser.process(view, rows);
+            ms += msSince(start);
+            for (size_t i = 0; i < pixels.size(); i++) {
+                residual[i] = static_cast<uint8_t>(128 + (pixels[i] - previous[i]) / 4);
+                checksum = checksum * 31 + pixels[i];
+            }
+            bytes += compressedSize(residual);
+            previous = pixels;
+            for (int i = 0; i < width * height; i++) {
+                const double d = pixels[i] - clean[i];
+                squares += d * d;
+            }
+        }
+        const double psnr = 10 * std::log10(255.0 * 255.0 * width * height * frames / squares);
+        printf("denoise %3d: residual %5.1f MB, %5.2f ms per 720p frame, luma PSNR against clean %.1f dB, checksum %08x\n",
+               strength, bytes / 1e6, ms / frames, psnr, checksum);
+        if (strength == 0) {
+            psnrOff = psnr;
+            bytesOff = bytes;
+        } else if (strength == 100) {
+            psnrFull = psnr;
+            bytesFull = bytes;
+        }
+    }
+    check(psnrFull > psnrOff + 3 && bytesFull < bytesOff / 2, "full-strength denoise cleans and shrinks the residual");
+}
+
+int main() {
+    testScalers();
+    benchProcessScale();
+    benchDenoise();
+    printf(gFailures ? "%d checks failed\n" : "all checks passed\n", gFailures);
+    return gFailures ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+//
+//  VideoRoi.cpp
+//  SimpleFilter
+//
+
+#include "VideoRoi.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace agora {
+    namespace extension {
+        bool parseRoiList(const std::string& text, std::vector<RoiRect>& rois) {
+            std::vector<float> values;
+            const char* p = text.c_str();
+            while (*p) {
+                char* end = nullptr;
+                float v = strtof(p, &end);
+                if (end == p) {
+                    p++;
+                    continue;
+                }
+                // nan and inf parse too, and would be undefined once scaled to pixels.
+                if (!std::isfinite(v)) {
+                    return false;
+                }
+                values.push_back(v);
+                p = end;
+            }
+            if (values.size() % 4 != 0) {
+                return false;
+            }
+            rois.clear();
+            for (size_t i = 0; i < values.size(); i += 4) {
+                RoiRect roi;
+                roi.x = values[i];
+                roi.y = values[i + 1];
+                roi.w = values[i + 2];
+                roi.h = values[i + 3];
+                rois.push_back(roi);
+            }
+            return true;
+        }
+
+        static bool overlaps(const PixelRect& a, const PixelRect& b) {
+            return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+        }
+
+        static PixelRect unite(const PixelRect& a, const PixelRect& b) {
+            PixelRect r;
+            r.x = std::min(a.x, b.x);
+            r.y = std::min(a.y, b.y);
+            r.w = std::max(a.x + a.w, b.x + b.w) - r.x;
+            r.h = std::max(a.y + a.h, b.y + b.h) - r.y;
+            return r;
+        }
+
+        std::vector<PixelRect> resolveRois(const std::vector<RoiRect>& rois, int width, int height, int margin) {
+            std::vector<PixelRect> rects;
+            for (const RoiRect& roi : rois) {
+                // Clamped to a little beyond the frame, so a huge value from a provider still converts to int.
+                auto edge = [](float v) { return std::max(-1.0f, std::min(2.0f, v)); };
+                int x0 = static_cast<int>(std::floor(edge(roi.x) * width)) - margin;
+                int y0 = static_cast<int>(std::floor(edge(roi.y) * height)) - margin;
+                int x1 = static_cast<int>(std::ceil(edge(roi.x + roi.w) * width)) + margin;
+                int y1 = static_cast<int>(std::ceil(edge(roi.y + roi.h) * height)) + margin;
+                x0 = std::max(0, x0) & ~1;
+                y0 = std::max(0, y0) & ~1;
+                x1 = std::min(width, (x1 + 1) & ~1);
+                y1 = std::min(height, (y1 + 1) & ~1);
+                PixelRect rect;
+                rect.x = x0;
+                rect.y = y0;
+                rect.w = x1 - x0;
+                rect.h = y1 - y0;
+                if (!rect.empty()) {
+                    rects.push_back(rect);
+                }
+            }
+
+            // Merging two rectangles can make the union overlap a third one, so repeat until stable.
+            bool merged = true;
+            while (merged) {
+                merged = false;
+                for (size_t i = 0; i < rects.size() && !merged; i++) {
+                    for (size_t j = i + 1; j < rects.size(); j++) {
+                        if (overlaps(rects[i], rects[j])) {
+                            rects[i] = unite(rects[i], rects[j]);
+                            rects.erase(rects.begin() + j);
+                            merged = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            return rects;
+        }
+    }
+}
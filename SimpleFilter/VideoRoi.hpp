@@ -0,0 +1,47 @@
+//
+//  VideoRoi.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_VIDEOROI_H
+#define AGORA_VIDEOROI_H
+
+#include <string>
+#include <vector>
+
+namespace agora {
+    namespace extension {
+        // Region of interest in normalized frame coordinates, every field in [0, 1].
+        struct RoiRect {
+            float x = 0;
+            float y = 0;
+            float w = 0;
+            float h = 0;
+        };
+
+        // Region of interest resolved against a concrete plane, in pixels.
+        struct PixelRect {
+            int x = 0;
+            int y = 0;
+            int w = 0;
+            int h = 0;
+
+            bool empty() const { return w <= 0 || h <= 0; }
+        };
+
+        // Parses a list of normalized rectangles. Numbers are taken four at a time (x, y, w, h) and any
+        // other character acts as a separator, so both "0.1,0.2,0.3,0.3;0.5,0.5,0.2,0.2" and
+        // "[[0.1,0.2,0.3,0.3]]" are accepted. An empty string yields an empty list.
+        // Returns false if the number count is not a multiple of four.
+        bool parseRoiList(const std::string& text, std::vector<RoiRect>& rois);
+
+        // Converts normalized ROIs into pixel rectangles of a width x height frame. Each rectangle is grown
+        // by `margin` pixels on every side, clipped to the frame and snapped to even coordinates so that it
+        // maps exactly onto the I420 chroma planes. Overlapping rectangles are merged so that no pixel is
+        // processed twice.
+        std::vector<PixelRect> resolveRois(const std::vector<RoiRect>& rois, int width, int height, int margin);
+    }
+}
+
+
+#endif //AGORA_VIDEOROI_H
@@ -0,0 +1,249 @@
+//
+//  VirtualBackground.cpp
+//  SimpleFilter
+//
+
+#include "VirtualBackground.hpp"
+#include "SimdUtils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace agora {
+    namespace extension {
+        // Rows are composited in segments of this many chroma samples so the per-row alpha fits on the stack.
+        static const int kSegment = 256;
+        // Three stacked box blurs are close enough to a Gaussian that no box edges show.
+        static const int kBlurPasses = 3;
+
+        static int base64Value(char c) {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+' || c == '-') return 62;
+            if (c == '/' || c == '_') return 63;
+            return -1;
+        }
+
+        int VirtualBackground::setProperty(const std::string& key, const std::string& value) {
+            if (key == "virtual_background") {
+                if (value == "0" || value == "off") {
+                    setMode(kOff);
+                } else if (value == "1" || value == "blur") {
+                    setMode(kBlur);
+                } else if (value == "2" || value == "replace") {
+                    setMode(kReplace);
+                } else {
+                    return -1;
+                }
+            } else if (key == "virtual_background_blur") {
+                setBlurLevel(atoi(value.c_str()));
+            } else if (key == "virtual_background_image") {
+                if (!background_.set(value)) {
+                    return -1;
+                }
+            } else if (key == "virtual_background_mask") {
+                if (!setMaskBase64(value)) {
+                    return -1;
+                }
+            } else {
+                return -2;
+            }
+            return 0;
+        }
+
+        void VirtualBackground::setMode(Mode mode) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            mode_ = mode;
+        }
+
+        void VirtualBackground::setBlurLevel(int level) {
+            const std::lock_guard<std::mutex> lock(mutex_);
+            blurLevel_ = std::max(0, std::min(100, level));
+        }
+
+        bool VirtualBackground::setMask(const uint8_t* mask, int width, int height) {
+            if (!mask || width <= 0 || height <= 0) {
+                return false;
+            }
+            const std::lock_guard<std::mutex> lock(mutex_);
+            pendingMask_.assign(mask, mask + static_cast<size_t>(width) * height);
+            pendingWidth_ = width;
+            pendingHeight_ = height;
+            maskVersion_++;
+            return true;
+        }
+
+        // "<width>x<height>:<base64>" with one byte per mask pixel, so masks can travel through setProperty.
+        bool VirtualBackground::setMaskBase64(const std::string& value) {
+            int width = 0, height = 0, offset = 0;
+            if (sscanf(value.c_str(), "%dx%d:%n", &width, &height, &offset) != 2 || offset == 0
+                || width <= 0 || height <= 0) {
+                return false;
+            }
+            size_t size = static_cast<size_t>(width) * height;
+            const std::lock_guard<std::mutex> lock(mutex_);
+            // Both buffers keep their capacity from mask to mask, so steady-state updates do not allocate.
+            decodedMask_.resize(size);
+            size_t written = 0;
+            uint32_t bits = 0;
+            int count = 0;
+            for (size_t i = offset; i < value.size() && written < size; i++) {
+                int v = base64Value(value[i]);
+                if (v < 0) {
+                    continue;
+                }
+                bits = (bits << 6) | v;
+                count += 6;
+                if (count >= 8) {
+                    count -= 8;
+                    decodedMask_[written++] = static_cast<uint8_t>(bits >> count);
+                }
+            }
+            if (written != size) {
+                return false;
+            }
+            pendingMask_.swap(decodedMask_);
+            pendingWidth_ = width;
+            pendingHeight_ = height;
+            maskVersion_++;
+            return true;
+        }
+
+        void VirtualBackground::process(const I420View& frame, ParallelRows& rows) {
+            Mode mode;
+            int level;
+            {
+                const std::lock_guard<std::mutex> lock(mutex_);
+                mode = mode_;
+                level = blurLevel_;
+                if (mode != kOff && frameMaskVersion_ != maskVersion_) {
+                    mask_.swap(pendingMask_);
+                    maskView_.data = mask_.data();
+                    maskView_.width = pendingWidth_;
+                    maskView_.height = pendingHeight_;
+                    maskView_.stride = pendingWidth_;
+                    frameMaskVersion_ = maskVersion_;
+                }
+            }
+            if (mode == kOff || !maskView_.data) {
+                return;
+            }
+
+            if (tapsFor_[0] != frame.u.width || tapsFor_[1] != maskView_.width) {
+                const int width = frame.u.width;
+                const int64_t step = (static_cast<int64_t>(maskView_.width) << 16) / width;
+                maskX_.resize(2 * width);
+                maskFx_.resize(width);
+                for (int x = 0; x < width; x++) {
+                    int64_t sx = std::max<int64_t>(0, x * step + step / 2 - 32768);
+                    int x0 = std::min(static_cast<int>(sx >> 16), maskView_.width - 1);
+                    maskX_[2 * x] = x0;
+                    maskX_[2 * x + 1] = std::min(x0 + 1, maskView_.width - 1);
+                    maskFx_[x] = static_cast<uint8_t>((sx >> 8) & 0xFF);
+                }
+                tapsFor_[0] = frame.u.width;
+                tapsFor_[1] = maskView_.width;
+            }
+
+            PlanePool::Plane blurred[3];
+            I420View background;
+            if (mode == kBlur) {
+                if (frame.y.width < 8 || frame.y.height < 8) {
+                    return;
+                }
+                blurBackground(frame, level, blurred);
+                background.y = blurred[0].view();
+                background.u = blurred[1].view();
+                background.v = blurred[2].view();
+            } else {
+                background = background_.fitted(frame.y.width, frame.y.height);
+            }
+            rows.run(frame.u.height, 1, [&](int begin, int end) {
+                compositeRows(frame, background, begin, end);
+            });
+        }
+
+        void VirtualBackground::blurBackground(const I420View& frame, int level, PlanePool::Plane (&planes)[3]) {
+            // Luma goes down to a quarter and chroma, already at half resolution, by another half, so
+            // all three planes are blurred on the same grid with the same radius.
+            const int radius = std::max(1, level * frame.y.height / 12000);
+            PlanePool::Plane half = planePool_.acquire(frame.y.width / 2, frame.y.height / 2);
+            PlanePool::Plane quarter = planePool_.acquire(frame.y.width / 4, frame.y.height / 4);
+            downscale2x(frame.y, half.view());
+            downscale2x(half.view(), quarter.view());
+            for (int i = 0; i < kBlurPasses; i++) {
+                boxBlur(quarter.view(), quarter.view(), radius, blurScratch_);
+            }
+            upscale2x(quarter.view(), half.view(), upscaleScratch_);
+            planes[0] = planePool_.acquire(frame.y.width, frame.y.height);
+            upscale2x(half.view(), planes[0].view(), upscaleScratch_);
+
+            const PlaneView* chroma[2] = {&frame.u, &frame.v};
+            for (int c = 0; c < 2; c++) {
+                PlanePool::Plane small = planePool_.acquire(chroma[c]->width / 2, chroma[c]->height / 2);
+                downscale2x(*chroma[c], small.view());
+                for (int i = 0; i < kBlurPasses; i++) {
+                    boxBlur(small.view(), small.view(), radius, blurScratch_);
+                }
+                planes[c + 1] = planePool_.acquire(chroma[c]->width, chroma[c]->height);
+                upscale2x(small.view(), planes[c + 1].view(), upscaleScratch_);
+            }
+        }
+
+        void VirtualBackground::compositeRows(const I420View& frame, const I420View& background, int begin, int end) {
+            using namespace simd;
+            const I16x8 half = splat(64);
+            // dst = bg + (fg - bg) * alpha / 128, alpha in [0, 128] so the product fits in 16 bits.
+            auto blend = [&](uint8_t* dst, const uint8_t* bg, const uint8_t* alpha, int count) {
+                int x = 0;
+                for (; x + 8 <= count; x += 8) {
+                    I16x8 b = loadU8(bg + x);
+                    storeU8(dst + x, add(b, sra<7>(add(mullo(sub(loadU8(dst + x), b), loadU8(alpha + x)), half))));
+                }
+                for (; x < count; x++) {
+                    dst[x] = static_cast<uint8_t>(bg[x] + (((dst[x] - bg[x]) * alpha[x] + 64) >> 7));
+                }
+            };
+
+            const PlaneView& mask = maskView_;
+            const int64_t stepY = (static_cast<int64_t>(mask.height) << 16) / frame.u.height;
+            uint8_t alpha[kSegment];
+            uint8_t lumaAlpha[2 * kSegment];
+            for (int cy = begin; cy < end; cy++) {
+                int64_t sy = std::max<int64_t>(0, cy * stepY + stepY / 2 - 32768);
+                int y0 = std::min(static_cast<int>(sy >> 16), mask.height - 1);
+                const uint8_t* m0 = mask.row(y0);
+                const uint8_t* m1 = mask.row(std::min(y0 + 1, mask.height - 1));
+                const int fy = static_cast<int>((sy >> 8) & 0xFF);
+
+                for (int x0 = 0; x0 < frame.u.width; x0 += kSegment) {
+                    const int count = std::min(kSegment, frame.u.width - x0);
+                    for (int i = 0; i < count; i++) {
+                        const int* taps = &maskX_[2 * (x0 + i)];
+                        const int fx = maskFx_[x0 + i];
+                        int top = m0[taps[0]] * (256 - fx) + m0[taps[1]] * fx;
+                        int bottom = m1[taps[0]] * (256 - fx) + m1[taps[1]] * fx;
+                        int m = (top * (256 - fy) + bottom * fy + 32768) >> 16;
+                        // 0 - 255 onto 0 - 128 with both ends exact.
+                        alpha[i] = static_cast<uint8_t>((m + (m >> 7)) >> 1);
+                    }
+                    blend(frame.u.row(cy) + x0, background.u.row(cy) + x0, alpha, count);
+                    blend(frame.v.row(cy) + x0, background.v.row(cy) + x0, alpha, count);
+
+                    // Luma uses the alpha of its chroma sample for each 2x2 block.
+                    const int lumaX = 2 * x0;
+                    const int lumaCount = std::min(2 * count, frame.y.width - lumaX);
+                    for (int i = 0; i < count; i++) {
+                        lumaAlpha[2 * i] = alpha[i];
+                        lumaAlpha[2 * i + 1] = alpha[i];
+                    }
+                    for (int ly = 2 * cy; ly < std::min(2 * cy + 2, frame.y.height); ly++) {
+                        blend(frame.y.row(ly) + lumaX, background.y.row(ly) + lumaX, lumaAlpha, lumaCount);
+                    }
+                }
+            }
+        }
+    }
+}
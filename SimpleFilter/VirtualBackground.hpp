@@ -0,0 +1,76 @@
+//
+//  VirtualBackground.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_VIRTUALBACKGROUND_H
+#define AGORA_VIRTUALBACKGROUND_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "BackgroundImage.hpp"
+#include "ImageFilters.hpp"
+#include "ImageScaler.hpp"
+#include "ParallelRows.hpp"
+
+namespace agora {
+    namespace extension {
+        // Blurs or replaces the background of I420 frames using a segmentation mask supplied from outside,
+        // typically at a much lower resolution than the frame (255 = person, 0 = background). The mask is
+        // upsampled bilinearly inside the compositing pass, which blends all three planes in one go; the
+        // blurred background is a stacked box blur computed at a quarter of the frame resolution.
+        class VirtualBackground {
+        public:
+            enum Mode {
+                kOff = 0,
+                kBlur,
+                kReplace
+            };
+
+            // Handles the "virtual_background*" extension properties. Returns -1 for a bad value, -2 for an unknown key.
+            int setProperty(const std::string& key, const std::string& value);
+
+            void setMode(Mode mode);
+            // 0 - 100, scaled with the frame height.
+            void setBlurLevel(int level);
+            // Copies `mask`; the buffer is reused as long as the mask size does not change.
+            bool setMask(const uint8_t* mask, int width, int height);
+            BackgroundImage& background() { return background_; }
+
+            // Composites `frame` in place; does nothing until a mask has been set.
+            void process(const I420View& frame, ParallelRows& rows);
+
+        private:
+            bool setMaskBase64(const std::string& value);
+            void blurBackground(const I420View& frame, int level, PlanePool::Plane (&planes)[3]);
+            void compositeRows(const I420View& frame, const I420View& background, int begin, int end);
+
+            std::mutex mutex_;
+            Mode mode_ = kOff;
+            int blurLevel_ = 60;
+            // Written by setMask, swapped with mask_ by the video thread when maskVersion_ moves.
+            std::vector<uint8_t> pendingMask_;
+            int pendingWidth_ = 0;
+            int pendingHeight_ = 0;
+            unsigned maskVersion_ = 0;
+            std::vector<uint8_t> decodedMask_;
+            BackgroundImage background_;
+
+            // Video thread only.
+            std::vector<uint8_t> mask_;
+            PlaneView maskView_;
+            unsigned frameMaskVersion_ = 0;
+            // Horizontal bilinear taps from chroma columns into the mask, rebuilt when either width changes.
+            std::vector<int> maskX_;
+            std::vector<uint8_t> maskFx_;
+            int tapsFor_[2] = {0, 0};
+            PlanePool planePool_;
+            BoxBlurScratch blurScratch_;
+            std::vector<uint16_t> upscaleScratch_;
+        };
+    }
+}
+
+
+#endif //AGORA_VIRTUALBACKGROUND_H
@@ -0,0 +1,117 @@
+//
+//  VoiceActivity.cpp
+//  SimpleFilter
+//
+
+#include "VoiceActivity.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace agora {
+    namespace extension {
+        static const float kPi = 3.14159265f;
+        static const float kFullScaleDb = 90.3090f;
+        // Edges of the speech band.
+        static const float kHighPassHz = 150;
+        static const float kLowPassHz = 4000;
+        // Frames quieter than this are never speech.
+        static const float kMinSpeechDb = -60;
+        // Voiced speech crosses zero less often than this once band-limited; hiss crosses far more.
+        static const float kMaxVoicedCrossingsPerSecond = 3000;
+        static const float kOnsetMs = 20;
+        // The floor drops to quieter frames within a few frames and rises slowly, more slowly still
+        // while the frames look like speech so that talking does not raise it.
+        static const float kFloorFallMs = 20;
+        static const float kFloorRiseDbPerSecond = 10;
+        static const float kVoicedFloorRiseDbPerSecond = 1;
+
+        void VoiceActivityDetector::prepare(int sampleRateHz) {
+            sampleRateHz_ = sampleRateHz;
+            highPassCoef_ = std::exp(-2 * kPi * kHighPassHz / sampleRateHz);
+            lowPassCoef_ = 1 - std::exp(-2 * kPi * std::min(kLowPassHz, sampleRateHz * 0.45f) / sampleRateHz);
+            previousInput_ = 0;
+            highPass_ = 0;
+            band_ = 0;
+            floorKnown_ = false;
+            onset_ = 0;
+            hangover_ = 0;
+            speaking_.store(false, std::memory_order_relaxed);
+        }
+
+        bool VoiceActivityDetector::process(const int16_t* data, size_t frames, int channels, int sampleRateHz) {
+            if (frames == 0 || channels <= 0 || sampleRateHz <= 0) {
+                return false;
+            }
+            if (reset_.exchange(false, std::memory_order_relaxed) || sampleRateHz != sampleRateHz_) {
+                prepare(sampleRateHz);
+            }
+            const bool wasSpeaking = speaking_.load(std::memory_order_relaxed);
+
+            // Mono mix through a one-pole high-pass and low-pass.
+            const float inverseChannels = 1.0f / channels;
+            float previous = previousInput_;
+            float highPass = highPass_;
+            float band = band_;
+            float energy = 0;
+            int crossings = 0;
+            for (size_t f = 0; f < frames; f++) {
+                float input = 0;
+                for (int c = 0; c < channels; c++) {
+                    input += data[f * channels + c];
+                }
+                input *= inverseChannels;
+                highPass = highPassCoef_ * (highPass + input - previous);
+                previous = input;
+                const float next = band + lowPassCoef_ * (highPass - band);
+                crossings += (next < 0) != (band < 0);
+                band = next;
+                energy += band * band;
+            }
+            // Silence would otherwise decay into denormals, which are slow on x86.
+            previousInput_ = previous;
+            highPass_ = std::fabs(highPass) < 1e-6f ? 0.0f : highPass;
+            band_ = std::fabs(band) < 1e-6f ? 0.0f : band;
+
+            const float levelDb = 10 * std::log10(energy / frames + 1e-3f) - kFullScaleDb;
+            const float crossingsPerSecond = static_cast<float>(crossings) * sampleRateHz / frames;
+            const float frameSeconds = static_cast<float>(frames) / sampleRateHz;
+            if (!floorKnown_) {
+                floorDb_ = levelDb;
+                floorKnown_ = true;
+            }
+            const float thresholdDb = thresholdDb_.load(std::memory_order_relaxed);
+            const float snrDb = levelDb - floorDb_;
+            // Speech has to start voiced; once going, unvoiced sounds such as fricatives keep it going.
+            const bool voiced = levelDb > kMinSpeechDb && snrDb > thresholdDb
+                && (wasSpeaking || crossingsPerSecond < kMaxVoicedCrossingsPerSecond);
+
+            if (levelDb < floorDb_) {
+                floorDb_ += (levelDb - floorDb_) * (1 - std::exp(-frameSeconds * 1000 / kFloorFallMs));
+            } else {
+                const float rise = voiced ? kVoicedFloorRiseDbPerSecond : kFloorRiseDbPerSecond;
+                floorDb_ = std::min(levelDb, floorDb_ + rise * frameSeconds);
+            }
+
+            bool speaking = wasSpeaking;
+            if (voiced) {
+                onset_ += frames;
+                if (onset_ * 1000 >= kOnsetMs * sampleRateHz) {
+                    speaking = true;
+                }
+                hangover_ = static_cast<int64_t>(hangoverMs_.load(std::memory_order_relaxed)) * sampleRateHz / 1000;
+            } else {
+                onset_ = 0;
+                hangover_ -= frames;
+                if (hangover_ < 0) {
+                    speaking = false;
+                }
+            }
+
+            levelDb_.store(levelDb, std::memory_order_relaxed);
+            noiseFloorDb_.store(floorDb_, std::memory_order_relaxed);
+            speaking_.store(speaking, std::memory_order_relaxed);
+            return speaking != wasSpeaking;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+//
+//  VoiceActivity.hpp
+//  SimpleFilter
+//
+
+#ifndef AGORA_VOICEACTIVITY_H
+#define AGORA_VOICEACTIVITY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace agora {
+    namespace extension {
+        // Frame-level voice activity detection from the energy in the speech band (150 Hz - 4 kHz), its
+        // zero-crossing rate and a noise floor that follows the quiet frames. A frame counts when it stands
+        // out from the floor by the threshold. Speech starts after 20 ms of such frames that also cross zero
+        // no more often than voiced speech does, which passes over clicks and hiss, and ends after the
+        // hangover.
+        // Settings may be changed from any thread; process runs on the audio thread.
+        class VoiceActivityDetector {
+        public:
+            void setThresholdDb(float db) { thresholdDb_ = db; }
+            void setHangoverMs(int ms) { hangoverMs_ = ms < 0 ? 0 : ms; }
+
+            // Analyses one frame of interleaved samples. Returns true if the speaking state changed.
+            bool process(const int16_t* data, size_t frames, int channels, int sampleRateHz);
+            // Starts over, learning the noise floor again.
+            void reset() { reset_ = true; }
+
+            bool speaking() const { return speaking_.load(std::memory_order_relaxed); }
+            // Speech band level of the last frame and the current noise floor, in dBFS.
+            float levelDb() const { return levelDb_.load(std::memory_order_relaxed); }
+            float noiseFloorDb() const { return noiseFloorDb_.load(std::memory_order_relaxed); }
+
+        private:
+            void prepare(int sampleRateHz);
+
+            std::atomic<float> thresholdDb_ = {9.0f};
+            std::atomic<int> hangoverMs_ = {200};
+            std::atomic<bool> reset_ = {true};
+            std::atomic<bool> speaking_ = {false};
+            std::atomic<float> levelDb_ = {-100.0f};
+            std::atomic<float> noiseFloorDb_ = {-100.0f};
+
+            // Audio thread only.
+            int sampleRateHz_ = 0;
+            float highPassCoef_ = 0;
+            float lowPassCoef_ = 0;
+            float previousInput_ = 0;
+            float highPass_ = 0;
+            float band_ = 0;
+            float floorDb_ = 0;
+            bool floorKnown_ = false;
+            // Consecutive voiced samples, and samples left before speech counts as ended.
+            int64_t onset_ = 0;
+            int64_t hangover_ = 0;
+        };
+    }
+}
+
+
+#endif //AGORA_VOICEACTIVITY_H